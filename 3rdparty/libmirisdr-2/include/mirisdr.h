@@ -55,6 +55,7 @@ MIRISDR_API int mirisdr_cancel_async (mirisdr_dev_t *p);
 MIRISDR_API int mirisdr_cancel_async_now (mirisdr_dev_t *p);            /* extra */
 MIRISDR_API int mirisdr_start_async (mirisdr_dev_t *p);                 /* extra */
 MIRISDR_API int mirisdr_stop_async (mirisdr_dev_t *p);                  /* extra */
+MIRISDR_API uint32_t mirisdr_get_samples_lost (mirisdr_dev_t *p);       /* extra */
 
 /* adc */
 MIRISDR_API int mirisdr_adc_init (mirisdr_dev_t *p);                    /* extra */
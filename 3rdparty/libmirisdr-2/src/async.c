@@ -97,6 +97,16 @@ static void LIBUSB_CALL _libusb_callback (struct libusb_transfer *xfer) {
 
     /* zpracujeme pouze kompletní přenos */
     if (xfer->status == LIBUSB_TRANSFER_COMPLETED) {
+        /* převodní buffer patřící k tomuto přenosu */
+        for (i = 0; i < p->xfer_buf_num; i++) {
+            if (p->xfer[i] == xfer) {
+                samples = p->xfer_conv[i];
+                break;
+            }
+        }
+
+        if (!samples) goto failed;
+
         /*
          * Určení správné velikosti bufferu, tato část musí být provedena
          * v jednom kroku, jinak může dojít ke změně formátu uprostřed procesu,
@@ -106,7 +116,6 @@ static void LIBUSB_CALL _libusb_callback (struct libusb_transfer *xfer) {
         case LIBUSB_TRANSFER_TYPE_ISOCHRONOUS:
             switch (p->format) {
             case MIRISDR_FORMAT_252_S16:
-                samples = malloc(504 * DEFAULT_ISO_BUFFERS * DEFAULT_ISO_PACKETS * 2);
                 for (i = 0; i < DEFAULT_ISO_PACKETS; i++) {
                     struct libusb_iso_packet_descriptor *packet = &xfer->iso_packet_desc[i];
 
@@ -120,7 +129,6 @@ static void LIBUSB_CALL _libusb_callback (struct libusb_transfer *xfer) {
                 }
                 break;
             case MIRISDR_FORMAT_336_S16:
-                samples = malloc(672 * DEFAULT_ISO_BUFFERS * DEFAULT_ISO_PACKETS * 2);
                 for (i = 0; i < DEFAULT_ISO_PACKETS; i++) {
                     struct libusb_iso_packet_descriptor *packet = &xfer->iso_packet_desc[i];
                     if ((packet->actual_length > 0) &&
@@ -131,7 +139,6 @@ static void LIBUSB_CALL _libusb_callback (struct libusb_transfer *xfer) {
                 }
                 break;
             case MIRISDR_FORMAT_384_S16:
-                samples = malloc(768 * DEFAULT_ISO_BUFFERS * DEFAULT_ISO_PACKETS * 2);
                 for (i = 0; i < DEFAULT_ISO_PACKETS; i++) {
                     struct libusb_iso_packet_descriptor *packet = &xfer->iso_packet_desc[i];
                     if ((packet->actual_length > 0) &&
@@ -142,7 +149,6 @@ static void LIBUSB_CALL _libusb_callback (struct libusb_transfer *xfer) {
                 }
                 break;
             case MIRISDR_FORMAT_504_S16:
-                samples = malloc(1008 * DEFAULT_ISO_BUFFERS * DEFAULT_ISO_PACKETS * 2);
                 for (i = 0; i < DEFAULT_ISO_PACKETS; i++) {
                     struct libusb_iso_packet_descriptor *packet = &xfer->iso_packet_desc[i];
                     if ((packet->actual_length > 0) &&
@@ -153,7 +159,6 @@ static void LIBUSB_CALL _libusb_callback (struct libusb_transfer *xfer) {
                 }
                 break;
             case MIRISDR_FORMAT_504_S8:
-                samples = malloc(1008 * DEFAULT_ISO_BUFFERS * DEFAULT_ISO_PACKETS);
                 for (i = 0; i < DEFAULT_ISO_PACKETS; i++) {
                     struct libusb_iso_packet_descriptor *packet = &xfer->iso_packet_desc[i];
                     if ((packet->actual_length > 0) &&
@@ -168,23 +173,18 @@ static void LIBUSB_CALL _libusb_callback (struct libusb_transfer *xfer) {
         case LIBUSB_TRANSFER_TYPE_BULK:
             switch (p->format) {
             case MIRISDR_FORMAT_252_S16:
-                samples = malloc((DEFAULT_BULK_BUFFER / 1024) * 1008);
                 bytes = mirisdr_samples_convert_252_s16(p, xfer->buffer, samples, xfer->actual_length);
                 break;
             case MIRISDR_FORMAT_336_S16:
-                samples = malloc((DEFAULT_BULK_BUFFER / 1024) * 1344);
                 bytes = mirisdr_samples_convert_336_s16(p, xfer->buffer, samples, xfer->actual_length);
                 break;
             case MIRISDR_FORMAT_384_S16:
-                samples = malloc((DEFAULT_BULK_BUFFER / 1024) * 1536);
                 bytes = mirisdr_samples_convert_384_s16(p, xfer->buffer, samples, xfer->actual_length);
                 break;
             case MIRISDR_FORMAT_504_S16:
-                samples = malloc((DEFAULT_BULK_BUFFER / 1024) * 2016);
                 bytes = mirisdr_samples_convert_504_s16(p, xfer->buffer, samples, xfer->actual_length);
                 break;
             case MIRISDR_FORMAT_504_S8:
-                samples = malloc((DEFAULT_BULK_BUFFER / 1024) * 1008);
                 bytes = mirisdr_samples_convert_504_s8(p, xfer->buffer, samples, xfer->actual_length);
                 break;
             }
@@ -196,8 +196,6 @@ static void LIBUSB_CALL _libusb_callback (struct libusb_transfer *xfer) {
 
         if (bytes > 0) mirisdr_feed_async(p, samples, bytes);
 
-        if (samples) free(samples);
-
         /* pokračujeme dalším přenosem */
         if (libusb_submit_transfer(xfer) < 0) {
             fprintf(stderr, "error re-submitting URB on device %u\n", p->index);
@@ -270,6 +268,18 @@ failed:
     return -1;
 }
 
+/* velikost převodního bufferu, počítá s nejširším formátem (504 S16) */
+static size_t mirisdr_async_conv_size (mirisdr_dev_t *p) {
+    switch (p->transfer) {
+    case MIRISDR_TRANSFER_BULK:
+        return (DEFAULT_BULK_BUFFER / 1024) * 2016;
+    case MIRISDR_TRANSFER_ISOC:
+        return 1008 * DEFAULT_ISO_BUFFERS * DEFAULT_ISO_PACKETS * 2;
+    }
+
+    return 0;
+}
+
 /* alokace asynchronních bufferů */
 static int mirisdr_async_alloc (mirisdr_dev_t *p) {
     size_t i;
@@ -302,6 +312,13 @@ static int mirisdr_async_alloc (mirisdr_dev_t *p) {
                 break;
             }
         }
+
+        /* výstup převodu, aby se v callbacku nealokovalo */
+        p->xfer_conv = malloc(p->xfer_buf_num * sizeof(*p->xfer_conv));
+
+        for (i = 0; i < p->xfer_buf_num; i++) {
+            p->xfer_conv[i] = malloc(mirisdr_async_conv_size(p));
+        }
     }
 
     if ((!p->xfer_out) &&
@@ -342,6 +359,15 @@ static int mirisdr_async_free (mirisdr_dev_t *p) {
         p->xfer_buf = NULL;
     }
 
+    if (p->xfer_conv) {
+        for (i = 0; i < p->xfer_buf_num; i++) {
+            if (p->xfer_conv[i]) free(p->xfer_conv[i]);
+        }
+
+        free(p->xfer_conv);
+        p->xfer_conv = NULL;
+    }
+
     if (p->xfer_out) {
         free(p->xfer_out);
         p->xfer_out = NULL;
@@ -369,6 +395,7 @@ int mirisdr_read_async (mirisdr_dev_t *p, mirisdr_read_async_cb_t cb, void *ctx,
     /* jde o fixní velikost výstupního bufferu */
     p->xfer_out_len = (len == 0) ? 0 : len;
     p->xfer_out_pos = 0;
+    p->lost = 0;
 
     fprintf(stderr, "async read on device %u, buffers: %zu, output size: ", p->index, p->xfer_buf_num);
     if (p->xfer_out_len) {
@@ -491,6 +518,18 @@ failed:
     return -1;
 }
 
+/* ztracené vzorky od posledního volání, podle adres v hlavičkách paketů */
+uint32_t mirisdr_get_samples_lost (mirisdr_dev_t *p) {
+    uint32_t lost;
+
+    if (!p) return 0;
+
+    lost = p->lost;
+    p->lost = 0;
+
+    return lost;
+}
+
 /* spuštění streamování */
 int mirisdr_start_async (mirisdr_dev_t *p) {
     size_t i;
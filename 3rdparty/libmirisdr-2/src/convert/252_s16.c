@@ -11,6 +11,7 @@ static int mirisdr_samples_convert_252_s16 (mirisdr_dev_t *p, unsigned char* buf
     uint32_t addr = 0;
     uint8_t *src = buf;
     int16_t *dst = (int16_t*) dst8;
+    int simd = mirisdr_simd_level();
 
     /* dostáváme 1-3 1024 bytů dlouhé bloky */
     for (i_max = cnt >> 10, i = 0; i < i_max; i++, src+= 1008) {
@@ -20,10 +21,21 @@ static int mirisdr_samples_convert_252_s16 (mirisdr_dev_t *p, unsigned char* buf
         /* potenciálně ztracená data */
         if ((i == 0) && (addr != p->addr)) {
             fprintf(stderr, "%u samples lost, %d, %08x:%08x\n", addr - p->addr, cnt, p->addr, addr);
+            p->lost+= addr - p->addr;
         }
 
         /* přeskočíme hlavičku 16 bitů, 252 I+Q párů */
-        for (src+= 16, j = 0; j < 1008; j+= 4, ret+= 2) {
+        src+= 16;
+
+#ifdef MIRISDR_SIMD
+        if (simd >= MIRISDR_SIMD_SSE2) {
+            mirisdr_unpack_252_sse2(src, dst + ret);
+            ret+= 504;
+            continue;
+        }
+#endif
+
+        for (j = 0; j < 1008; j+= 4, ret+= 2) {
             /* maximální rozsah */
             dst[ret + 0] = (src[j + 0] << 2) | (src[j + 1] << 10);
             dst[ret + 1] = (src[j + 2] << 2) | (src[j + 3] << 10);
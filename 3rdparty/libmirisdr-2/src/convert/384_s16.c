@@ -14,6 +14,7 @@ static int mirisdr_samples_convert_384_s16 (mirisdr_dev_t *p, unsigned char* buf
     uint32_t addr = 0, shift;
     uint8_t *src = buf;
     int16_t *dst = (int16_t*) dst8;
+    int simd = mirisdr_simd_level();
 
     /* dostáváme 1-3 1024 bytů dlouhé bloky, poslední část je 24 bitů, tu nezpracováváme */
     for (i_max = cnt >> 10, i = 0; i < i_max; i++, src+= 24) {
@@ -23,6 +24,7 @@ static int mirisdr_samples_convert_384_s16 (mirisdr_dev_t *p, unsigned char* buf
         /* potenciálně ztracená data */
         if ((i == 0) && (addr != p->addr)) {
             fprintf(stderr, "%u samples lost, %d, %08x:%08x\n", addr - p->addr, cnt, p->addr, addr);
+            p->lost+= addr - p->addr;
         }
 
         /* přeskočíme hlavičku 16 bitů, 6 bloků, poslední 4 bajtový posuvný blok zpracujeme */
@@ -30,6 +32,15 @@ static int mirisdr_samples_convert_384_s16 (mirisdr_dev_t *p, unsigned char* buf
             /* 2 bity pro každou hodnotu - určení posunu */
             shift = src[160 + 3] << 24 | src[160 + 2] << 16 | src[160 + 1] << 8 | src[160 + 0] << 0;
 
+#ifdef MIRISDR_SIMD
+            if (simd >= MIRISDR_SIMD_SSSE3) {
+                mirisdr_unpack_384_ssse3(src, dst + ret, shift);
+                src+= 160;
+                ret+= 128;
+                continue;
+            }
+#endif
+
             /* 16x 10 bajtů */
             for (k = 0; k < 16; k++, src+= 10, ret+= 8) {
                 /* 10 bajtů na 8 vzorků, plný rozsah zaručí správné znaménko */
@@ -13,6 +13,7 @@ static int mirisdr_samples_convert_504_s8 (mirisdr_dev_t *p, unsigned char* src,
     /* ztracená data */
     if (p->addr != addr) {
         fprintf(stderr, "%u samples lost, %d, %08x:%08x\n", addr - p->addr, cnt, p->addr, addr);
+        p->lost+= addr - p->addr;
         p->addr = addr;
     }
 
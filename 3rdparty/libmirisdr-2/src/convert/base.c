@@ -1,4 +1,5 @@
 
+#include "simd.c"
 #include "252_s16.c"
 #include "336_s16.c"
 #include "384_s16.c"
@@ -0,0 +1,127 @@
+
+/*
+ * SIMD varianty rozbalování, výstup je bitově shodný se skalárními verzemi
+ * SSE2:  252, 504 (posuny)
+ * SSSE3: 336, 384 (pshufb rozdělí zabalené hodnoty do 16b slov)
+ */
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define MIRISDR_SIMD
+#endif
+
+#define MIRISDR_SIMD_NONE       0
+#define MIRISDR_SIMD_SSE2       1
+#define MIRISDR_SIMD_SSSE3      2
+
+/* -1 = zatím nezjištěno, nastavením na 0 se vynutí skalární verze */
+static int mirisdr_simd = -1;
+
+#ifdef MIRISDR_SIMD
+#include <emmintrin.h>
+#include <tmmintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define MIRISDR_TARGET_SSE2
+#define MIRISDR_TARGET_SSSE3
+#else
+#include <cpuid.h>
+#define MIRISDR_TARGET_SSE2     __attribute__((target("sse2")))
+#define MIRISDR_TARGET_SSSE3    __attribute__((target("ssse3")))
+#endif
+#endif
+
+static int mirisdr_simd_level (void) {
+    if (mirisdr_simd < 0) {
+#ifdef MIRISDR_SIMD
+        unsigned int ecx = 0, edx = 0;
+#ifdef _MSC_VER
+        int info[4];
+
+        __cpuid(info, 1);
+        ecx = info[2];
+        edx = info[3];
+#else
+        unsigned int eax, ebx;
+
+        __get_cpuid(1, &eax, &ebx, &ecx, &edx);
+#endif
+        if (ecx & (1 << 9)) {
+            mirisdr_simd = MIRISDR_SIMD_SSSE3;
+        } else if (edx & (1 << 26)) {
+            mirisdr_simd = MIRISDR_SIMD_SSE2;
+        } else {
+            mirisdr_simd = MIRISDR_SIMD_NONE;
+        }
+#else
+        mirisdr_simd = MIRISDR_SIMD_NONE;
+#endif
+    }
+
+    return mirisdr_simd;
+}
+
+#ifdef MIRISDR_SIMD
+
+/* 1008 bajtů, 504 hodnot: 16b slovo posunuté o 2 bity vlevo */
+static MIRISDR_TARGET_SSE2 void mirisdr_unpack_252_sse2 (const uint8_t *src, int16_t *dst) {
+    int j;
+
+    for (j = 0; j < 1008; j+= 16, dst+= 8) {
+        __m128i v = _mm_loadu_si128((const __m128i*) (src + j));
+        _mm_storeu_si128((__m128i*) dst, _mm_slli_epi16(v, 2));
+    }
+}
+
+/* 1008 bajtů, 1008 hodnot: bajt do horní poloviny slova */
+static MIRISDR_TARGET_SSE2 void mirisdr_unpack_504_sse2 (const uint8_t *src, int16_t *dst) {
+    __m128i zero = _mm_setzero_si128();
+    int j;
+
+    for (j = 0; j < 1008; j+= 16, dst+= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*) (src + j));
+        _mm_storeu_si128((__m128i*) (dst + 0), _mm_unpacklo_epi8(zero, v));
+        _mm_storeu_si128((__m128i*) (dst + 8), _mm_unpackhi_epi8(zero, v));
+    }
+}
+
+/* 1008 bajtů, 672 hodnot: 12 bajtů na 8 hodnot */
+static MIRISDR_TARGET_SSSE3 void mirisdr_unpack_336_ssse3 (const uint8_t *src, int16_t *dst) {
+    const __m128i shuf = _mm_setr_epi8(0, 1, 1, 2, 3, 4, 4, 5, 6, 7, 7, 8, 9, 10, 10, 11);
+    const __m128i even = _mm_set1_epi32(0x0000ffff);
+    const __m128i odd = _mm_set1_epi32((int) 0xfff00000);
+    int j;
+
+    /* poslední skupina by četla za konec bloku, dokončí ji skalární kód */
+    for (j = 0; j < 996; j+= 12, dst+= 8) {
+        __m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) (src + j)), shuf);
+        v = _mm_or_si128(_mm_and_si128(_mm_slli_epi16(v, 4), even), _mm_and_si128(v, odd));
+        _mm_storeu_si128((__m128i*) dst, v);
+    }
+
+    for (; j < 1008; j+= 3, dst+= 2) {
+        dst[0] = ((src[j + 0] & 0xff) << 4) | ((src[j + 1] & 0x0f) << 12);
+        dst[1] = ((src[j + 1] & 0xf0) << 0) | ((src[j + 2] & 0xff) << 8);
+    }
+}
+
+/* 160 bajtů, 128 hodnot: 16x 10 bajtů na 8 hodnot, každá skupina má svůj posun */
+static MIRISDR_TARGET_SSSE3 void mirisdr_unpack_384_ssse3 (const uint8_t *src, int16_t *dst, uint32_t shift) {
+    const __m128i shuf = _mm_setr_epi8(0, 1, 1, 2, 2, 3, 3, 4, 5, 6, 6, 7, 7, 8, 8, 9);
+    const __m128i mul = _mm_setr_epi16(64, 16, 4, 1, 64, 16, 4, 1);
+    const __m128i mask = _mm_set1_epi16((short) 0xffc0);
+    int k, s;
+
+    /* čtení 16 bajtů na konci podbloku zasahuje do posuvného bloku, ne za konec bufferu */
+    for (k = 0; k < 16; k++, src+= 10, dst+= 8) {
+        __m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) src), shuf);
+        v = _mm_and_si128(_mm_mullo_epi16(v, mul), mask);
+
+        /* 0 = >> 2, 1 = >> 1, 2 = 3 = beze změny */
+        s = (shift >> (2 * k)) & 0x3;
+        if (s < 2) v = _mm_sra_epi16(v, _mm_cvtsi32_si128(2 - s));
+
+        _mm_storeu_si128((__m128i*) dst, v);
+    }
+}
+
+#endif
@@ -0,0 +1,285 @@
+/*
+ * MiriSDR
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Compares the scalar and SIMD sample unpackers on raw USB payloads, either
+ * a capture of 1024 byte packets as they come off the endpoint or packets
+ * filled with random data.  Both paths must produce identical output.
+ *
+ * Each unpacker is timed at several block sizes, counted in 1024 byte
+ * packets per call: 3 is one isochronous packet, 16 one bulk transfer.
+ * GB/s counts the USB payload read plus the samples written.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <time.h>
+#else
+#include <Windows.h>
+#include "getopt/getopt.h"
+#endif
+
+#include <libusb.h>
+
+#ifndef LIBUSB_CALL
+#define LIBUSB_CALL
+#endif
+
+#include "mirisdr.h"
+
+#include "constants.h"
+#include "structs.h"
+#include "convert/base.c"
+
+#define DEFAULT_PACKETS		4096
+#define DEFAULT_ITERATIONS	200
+#define MAX_BLOCKS		8
+
+static const uint32_t default_blocks[] = { 3, 16, 256 };
+
+typedef int (*convert_fn)(mirisdr_dev_t *p, unsigned char *buf, uint8_t *dst, int cnt);
+
+static const struct {
+	int format;
+	uint32_t samples;	/* I+Q pairs per packet */
+	convert_fn convert;
+} formats[] = {
+	{ 252, 252, mirisdr_samples_convert_252_s16 },
+	{ 336, 336, mirisdr_samples_convert_336_s16 },
+	{ 384, 384, mirisdr_samples_convert_384_s16 },
+	{ 504, 504, mirisdr_samples_convert_504_s16 },
+};
+
+void usage(void)
+{
+	fprintf(stderr,
+		"Usage:\t miri_bench [-m sample format (default: all)]\n"
+		"\t    252, 336, 384 or 504\n"
+		"\t[-n iterations (default: %d)]\n"
+		"\t[-p packets to generate (default: %d)]\n"
+		"\t[-b packets per call, may be repeated (default: 3, 16, 256 and all)]\n"
+		"\t[filename (raw 1024 byte USB packets, needs -m)]\n\n",
+		DEFAULT_ITERATIONS, DEFAULT_PACKETS);
+	exit(1);
+}
+
+static double now_sec(void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER f, t;
+	QueryPerformanceFrequency(&f);
+	QueryPerformanceCounter(&t);
+	return (double)t.QuadPart / (double)f.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+static void generate(uint8_t *buf, uint32_t packets, uint32_t samples)
+{
+	uint32_t i, j, addr = 0;
+
+	for (i = 0; i < packets; i++, addr += samples) {
+		uint8_t *pkt = buf + i * 1024;
+
+		for (j = 0; j < 1024; j++)
+			pkt[j] = rand() & 0xff;
+
+		pkt[0] = addr >> 0;
+		pkt[1] = addr >> 8;
+		pkt[2] = addr >> 16;
+		pkt[3] = addr >> 24;
+	}
+}
+
+static double run(mirisdr_dev_t *p, convert_fn convert, uint8_t *in, uint32_t packets, uint32_t block, uint8_t *out, int iterations, int simd)
+{
+	uint32_t addr = in[3] << 24 | in[2] << 16 | in[1] << 8 | in[0] << 0;
+	uint32_t done, n;
+	double start;
+	int i, len;
+
+	mirisdr_simd = simd;
+
+	start = now_sec();
+	for (i = 0; i < iterations; i++) {
+		p->addr = addr;
+		len = 0;
+
+		for (done = 0; done < packets; done += n) {
+			n = (packets - done < block) ? packets - done : block;
+			len += convert(p, in + (size_t)done * 1024, out + len, n * 1024);
+		}
+	}
+
+	return now_sec() - start;
+}
+
+static int bench(int index, uint8_t *in, uint32_t packets, const uint32_t *blocks, int num_blocks, int iterations)
+{
+	mirisdr_dev_t dev;
+	uint8_t *scalar_out, *simd_out;
+	size_t out_len = (size_t)packets * 2016;
+	double t_scalar, t_simd, n, bytes;
+	uint32_t block;
+	int b, simd, same = 1;
+
+	memset(&dev, 0, sizeof(dev));
+
+	mirisdr_simd = -1;
+	simd = mirisdr_simd_level();
+
+	scalar_out = calloc(1, out_len);
+	simd_out = calloc(1, out_len);
+	if (!scalar_out || !simd_out) {
+		fprintf(stderr, "Failed to allocate output buffers\n");
+		return 1;
+	}
+
+	/* nakonec všechny pakety najednou */
+	for (b = 0; b <= num_blocks; b++) {
+		if (b < num_blocks && blocks[b] >= packets)
+			continue;
+
+		block = (b < num_blocks) ? blocks[b] : packets;
+
+		memset(scalar_out, 0, out_len);
+		memset(simd_out, 0, out_len);
+
+		t_scalar = run(&dev, formats[index].convert, in, packets, block, scalar_out, iterations, MIRISDR_SIMD_NONE);
+		t_simd = run(&dev, formats[index].convert, in, packets, block, simd_out, iterations, simd);
+		same &= (memcmp(scalar_out, simd_out, out_len) == 0);
+
+		n = (double)packets * formats[index].samples * iterations;
+		bytes = (double)packets * (1024 + formats[index].samples * 4) * iterations;
+		printf("%d_s16 %5u pkts: scalar %6.2f ns/sample %6.2f GB/s, simd %6.2f ns/sample %6.2f GB/s, %.2fx, %s\n",
+			formats[index].format,
+			block,
+			t_scalar * 1e9 / n,
+			bytes / t_scalar * 1e-9,
+			t_simd * 1e9 / n,
+			bytes / t_simd * 1e-9,
+			t_scalar / t_simd,
+			same ? "output identical" : "OUTPUT DIFFERS");
+	}
+
+	free(scalar_out);
+	free(simd_out);
+
+	return same ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+	char *filename = NULL;
+	int opt, i, format = 0;
+	uint32_t blocks[MAX_BLOCKS];
+	int num_blocks = 0;
+	int iterations = DEFAULT_ITERATIONS;
+	uint32_t packets = DEFAULT_PACKETS;
+	uint8_t *buffer;
+	FILE *file;
+	long len;
+	int failed = 0;
+
+	while ((opt = getopt(argc, argv, "m:n:p:b:")) != -1) {
+		switch (opt) {
+		case 'm':
+			format = atoi(optarg);
+			break;
+		case 'n':
+			iterations = atoi(optarg);
+			break;
+		case 'p':
+			packets = (uint32_t)atoi(optarg);
+			break;
+		case 'b':
+			if (num_blocks < MAX_BLOCKS && atoi(optarg) > 0)
+				blocks[num_blocks++] = (uint32_t)atoi(optarg);
+			break;
+		default:
+			usage();
+			break;
+		}
+	}
+
+	if (argc > optind)
+		filename = argv[optind];
+
+	if (filename && !format)
+		usage();
+
+	if (!num_blocks) {
+		for (i = 0; i < (int)(sizeof(default_blocks) / sizeof(default_blocks[0])); i++)
+			blocks[num_blocks++] = default_blocks[i];
+	}
+
+	mirisdr_simd = -1;
+	printf("simd level: %d (0 none, 1 sse2, 2 ssse3)\n", mirisdr_simd_level());
+
+	for (i = 0; i < (int)(sizeof(formats) / sizeof(formats[0])); i++) {
+		if (format && formats[i].format != format)
+			continue;
+
+		if (filename) {
+			file = fopen(filename, "rb");
+			if (!file) {
+				fprintf(stderr, "Failed to open %s\n", filename);
+				return 1;
+			}
+
+			fseek(file, 0, SEEK_END);
+			len = ftell(file);
+			fseek(file, 0, SEEK_SET);
+
+			packets = (uint32_t)(len / 1024);
+			if (!packets) {
+				fprintf(stderr, "%s holds no complete 1024 byte packets\n", filename);
+				fclose(file);
+				return 1;
+			}
+
+			buffer = malloc(packets * 1024);
+			if (!buffer || fread(buffer, 1024, packets, file) != packets) {
+				fprintf(stderr, "Failed to read %s\n", filename);
+				fclose(file);
+				return 1;
+			}
+
+			fclose(file);
+		} else {
+			buffer = malloc(packets * 1024);
+			if (!buffer) {
+				fprintf(stderr, "Failed to allocate input buffer\n");
+				return 1;
+			}
+
+			generate(buffer, packets, formats[i].samples);
+		}
+
+		failed |= bench(i, buffer, packets, blocks, num_blocks, iterations);
+		free(buffer);
+	}
+
+	return failed;
+}
@@ -88,9 +88,11 @@ struct mirisdr_dev {
     size_t              xfer_buf_num;
     struct libusb_transfer **xfer;
     unsigned char       **xfer_buf;
+    unsigned char       **xfer_conv;
     size_t              xfer_out_len;
     size_t              xfer_out_pos;
     unsigned char       *xfer_out;
     uint32_t            addr;
+    uint32_t            lost;
 };
 
@@ -0,0 +1,252 @@
+// Copyright Scott Cutler
+// This source file is licensed under the GNU Lesser General Public License (LGPL)
+
+#include <math.h>
+#include <string.h>
+
+#include <emmintrin.h>
+
+#include "sdrio_channelize.h"
+#include "sdrio_convert.h"
+
+#define PI 3.14159265358979323846
+
+static void * carve(sdrio_uint8 **mem, size_t bytes)
+{
+    void *p = *mem;
+    *mem += (bytes + SDRIO_POOL_ALIGNMENT - 1) & ~(size_t)(SDRIO_POOL_ALIGNMENT - 1);
+    return p;
+}
+
+static size_t carved(size_t bytes)
+{
+    return (bytes + SDRIO_POOL_ALIGNMENT - 1) & ~(size_t)(SDRIO_POOL_ALIGNMENT - 1);
+}
+
+// Blackman windowed sinc with its cutoff at the channel edge.
+static void design_prototype(sdrio_channelizer *chan)
+{
+    sdrio_uint32 m = chan->num_channels;
+    sdrio_uint32 span = m * chan->taps_per_channel;
+    double c = (span - 1) / 2.0;
+    double sum = 0.0, x, h;
+    sdrio_uint32 n, j, q;
+
+    for (n=0; n<span; n++)
+    {
+        x = (n - c) / m;
+        h = (x == 0.0) ? 1.0 : sin(PI * x) / (PI * x);
+        sum += h * (0.42 - 0.5 * cos(2 * PI * n / (span - 1)) + 0.08 * cos(4 * PI * n / (span - 1)));
+    }
+
+    // Branch j, lane q holds h[j m + m - 1 - q] so the multiply-accumulate
+    // walks the input forwards.
+    for (j=0; j<chan->taps_per_channel; j++)
+    {
+        for (q=0; q<m; q++)
+        {
+            n = j * m + m - 1 - q;
+            x = (n - c) / m;
+            h = (x == 0.0) ? 1.0 : sin(PI * x) / (PI * x);
+            h *= 0.42 - 0.5 * cos(2 * PI * n / (span - 1)) + 0.08 * cos(4 * PI * n / (span - 1));
+            chan->taps[2 * (j * m + q)] = (sdrio_float32)(h / sum);
+            chan->taps[2 * (j * m + q) + 1] = (sdrio_float32)(h / sum);
+        }
+    }
+}
+
+sdrio_int32 sdrio_channelizer_init(sdrio_channelizer *chan, sdrio_uint32 num_channels, sdrio_uint32 taps_per_channel)
+{
+    sdrio_uint32 span, k;
+    size_t bytes;
+    sdrio_uint8 *mem;
+
+    memset(chan, 0, sizeof(sdrio_channelizer));
+
+    if (!taps_per_channel)
+    {
+        taps_per_channel = SDRIO_CHANNELIZER_DEFAULT_TAPS;
+    }
+
+    if (!sdrio_fft_init(&chan->fft, num_channels))
+    {
+        return 0;
+    }
+
+    span = num_channels * taps_per_channel;
+
+    chan->num_channels = num_channels;
+    chan->taps_per_channel = taps_per_channel;
+    chan->capacity = SDRIO_CHANNELIZER_BUFFER + span;
+    chan->num_out_max = (SDRIO_CHANNELIZER_BUFFER / num_channels) ? (SDRIO_CHANNELIZER_BUFFER / num_channels) : 1;
+
+    bytes = carved(span * 2 * sizeof(sdrio_float32))
+          + carved(num_channels * sizeof(sdrio_iq))
+          + carved(chan->capacity * sizeof(sdrio_iq))
+          + carved(num_channels * sizeof(sdrio_iq))
+          + carved((size_t)num_channels * chan->num_out_max * sizeof(sdrio_iq))
+          + carved(num_channels * sizeof(sdrio_channel));
+
+    if (!sdrio_pool_init(&chan->pool, 1, (sdrio_uint32)bytes, 0))
+    {
+        sdrio_fft_free(&chan->fft);
+        return 0;
+    }
+
+    mem = (sdrio_uint8 *)sdrio_pool_block(&chan->pool, 0);
+    memset(mem, 0, bytes);
+
+    chan->taps = (sdrio_float32 *)carve(&mem, span * 2 * sizeof(sdrio_float32));
+    chan->rotate = (sdrio_iq *)carve(&mem, num_channels * sizeof(sdrio_iq));
+    chan->buffer = (sdrio_iq *)carve(&mem, chan->capacity * sizeof(sdrio_iq));
+    chan->work = (sdrio_iq *)carve(&mem, num_channels * sizeof(sdrio_iq));
+    chan->out = (sdrio_iq *)carve(&mem, (size_t)num_channels * chan->num_out_max * sizeof(sdrio_iq));
+    chan->channels = (sdrio_channel *)carve(&mem, num_channels * sizeof(sdrio_channel));
+
+    design_prototype(chan);
+
+    for (k=0; k<num_channels; k++)
+    {
+        chan->rotate[k].i = (sdrio_float32)cos(-2 * PI * k / num_channels);
+        chan->rotate[k].q = (sdrio_float32)sin(-2 * PI * k / num_channels);
+    }
+
+    chan->mac = (sdrio_get_cpu_features() & SDRIO_CPU_SSE2) ? sdrio_channelizer_mac_sse2 : sdrio_channelizer_mac_scalar;
+
+    // Start with a window's worth of silence so the first output needs only
+    // num_channels new samples.
+    chan->fill = span - num_channels;
+    chan->next = 0;
+
+    return 1;
+}
+
+void sdrio_channelizer_free(sdrio_channelizer *chan)
+{
+    sdrio_fft_free(&chan->fft);
+    sdrio_pool_free(&chan->pool);
+    chan->num_channels = 0;
+}
+
+sdrio_int32 sdrio_channelizer_set_callback(sdrio_channelizer *chan, sdrio_uint32 channel, sdrio_rx_async_callback callback, void *context)
+{
+    if (channel >= chan->num_channels)
+    {
+        return 0;
+    }
+
+    chan->channels[channel].callback = callback;
+    chan->channels[channel].context = context;
+    return 1;
+}
+
+static void flush(sdrio_channelizer *chan)
+{
+    sdrio_uint32 k;
+
+    for (k=0; k<chan->num_channels; k++)
+    {
+        if (chan->channels[k].callback)
+        {
+            chan->channels[k].callback(chan->channels[k].context, chan->out + (size_t)k * chan->num_out_max, chan->num_out);
+        }
+    }
+
+    chan->num_out = 0;
+}
+
+// Filters one window starting at x into every branch, then the FFT turns the
+// branch outputs into one sample per channel.  The FFT of the lane-reversed
+// branches is off by e^(2 pi i k / m) from the channel output.
+static void filter_one(sdrio_channelizer *chan, const sdrio_iq *x)
+{
+    sdrio_uint32 m = chan->num_channels;
+    sdrio_uint32 p = chan->taps_per_channel;
+    sdrio_iq *out = chan->out + chan->num_out;
+    sdrio_uint32 j, k;
+    sdrio_iq y;
+
+    memset(chan->work, 0, m * sizeof(sdrio_iq));
+    for (j=0; j<p; j++)
+    {
+        chan->mac((sdrio_float32 *)chan->work, chan->taps + 2 * j * m, (const sdrio_float32 *)(x + (p - 1 - j) * m), 2 * m);
+    }
+
+    sdrio_fft_forward(&chan->fft, chan->work);
+
+    for (k=0; k<m; k++, out += chan->num_out_max)
+    {
+        y = chan->work[k];
+        out->i = y.i * chan->rotate[k].i - y.q * chan->rotate[k].q;
+        out->q = y.i * chan->rotate[k].q + y.q * chan->rotate[k].i;
+    }
+
+    if (++chan->num_out == chan->num_out_max)
+    {
+        flush(chan);
+    }
+}
+
+void sdrio_channelizer_process(sdrio_channelizer *chan, const sdrio_iq *samples, sdrio_uint32 num_samples)
+{
+    sdrio_uint32 span = chan->num_channels * chan->taps_per_channel;
+    sdrio_uint32 n;
+
+    while (num_samples)
+    {
+        if (chan->capacity - chan->fill < chan->num_channels)
+        {
+            memmove(chan->buffer, chan->buffer + chan->next, (chan->fill - chan->next) * sizeof(sdrio_iq));
+            chan->fill -= chan->next;
+            chan->next = 0;
+        }
+
+        n = chan->capacity - chan->fill;
+        if (n > num_samples)
+        {
+            n = num_samples;
+        }
+
+        memcpy(chan->buffer + chan->fill, samples, n * sizeof(sdrio_iq));
+        chan->fill += n;
+        samples += n;
+        num_samples -= n;
+
+        while (chan->fill - chan->next >= span)
+        {
+            filter_one(chan, chan->buffer + chan->next);
+            chan->next += chan->num_channels;
+        }
+    }
+
+    if (chan->num_out)
+    {
+        flush(chan);
+    }
+}
+
+sdrio_int32 sdrio_channelizer_callback(void *context, sdrio_iq *samples, sdrio_uint32 length)
+{
+    sdrio_channelizer_process((sdrio_channelizer *)context, samples, length);
+    return 0;
+}
+
+void sdrio_channelizer_mac_scalar(sdrio_float32 *acc, const sdrio_float32 *taps, const sdrio_float32 *in, sdrio_uint32 num_floats)
+{
+    sdrio_uint32 n;
+
+    for (n=0; n<num_floats; n++)
+    {
+        acc[n] += taps[n] * in[n];
+    }
+}
+
+void sdrio_channelizer_mac_sse2(sdrio_float32 *acc, const sdrio_float32 *taps, const sdrio_float32 *in, sdrio_uint32 num_floats)
+{
+    sdrio_uint32 n;
+
+    for (n=0; n<num_floats; n+=4)
+    {
+        _mm_store_ps(acc + n, _mm_add_ps(_mm_load_ps(acc + n), _mm_mul_ps(_mm_load_ps(taps + n), _mm_loadu_ps(in + n))));
+    }
+}
@@ -0,0 +1,78 @@
+// Copyright Scott Cutler
+// This source file is licensed under the GNU Lesser General Public License (LGPL)
+
+#ifndef SDRIO_CHANNELIZE_H
+#define SDRIO_CHANNELIZE_H
+
+#include "sdrio_ext.h"
+#include "sdrio_pool.h"
+#include "sdrio_fft.h"
+
+#define SDRIO_CHANNELIZER_DEFAULT_TAPS 8    // prototype taps per channel
+#define SDRIO_CHANNELIZER_BUFFER 4096       // input samples buffered between compactions
+
+typedef void (*sdrio_channelizer_mac_t)(sdrio_float32 *acc, const sdrio_float32 *taps, const sdrio_float32 *in, sdrio_uint32 num_floats);
+
+typedef struct sdrio_channel_t
+{
+    sdrio_rx_async_callback callback;
+    void *context;
+} sdrio_channel;
+
+// Critically sampled polyphase filter bank: splits a stream at fs into
+// num_channels streams at fs / num_channels.  Channel k is centred on
+// k * fs / num_channels; channels above num_channels / 2 are the negative
+// frequencies.  Each output costs one pass over the prototype filter and one
+// num_channels point FFT, however many channels have callbacks.
+//
+// Feed it from an sdrio_start_rx callback, or pass sdrio_channelizer_callback
+// with the channelizer as context.  Channel callbacks run on the caller's
+// thread, once per process call, with everything produced by that call.
+typedef struct sdrio_channelizer_t
+{
+    sdrio_uint32 num_channels;
+    sdrio_uint32 taps_per_channel;
+    sdrio_float32 *taps;        // per branch, reversed and duplicated for I and Q
+    sdrio_iq *rotate;           // e^(-2 pi i k / num_channels)
+    sdrio_channelizer_mac_t mac;
+
+    sdrio_iq *buffer;
+    sdrio_uint32 capacity;
+    sdrio_uint32 fill;
+    sdrio_uint32 next;          // first sample of the next window
+
+    sdrio_iq *work;
+    sdrio_iq *out;              // num_out_max per channel
+    sdrio_uint32 num_out_max;
+    sdrio_uint32 num_out;
+
+    sdrio_channel *channels;
+    sdrio_fft fft;
+    sdrio_pool pool;
+} sdrio_channelizer;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    // num_channels must be a power of two.  taps_per_channel trades
+    // adjacent channel rejection for CPU; 0 picks the default.
+    sdrio_int32 sdrio_channelizer_init(sdrio_channelizer *chan, sdrio_uint32 num_channels, sdrio_uint32 taps_per_channel);
+    void sdrio_channelizer_free(sdrio_channelizer *chan);
+
+    // A null callback turns the channel off.
+    sdrio_int32 sdrio_channelizer_set_callback(sdrio_channelizer *chan, sdrio_uint32 channel, sdrio_rx_async_callback callback, void *context);
+
+    void sdrio_channelizer_process(sdrio_channelizer *chan, const sdrio_iq *samples, sdrio_uint32 num_samples);
+
+    // An sdrio_rx_async_callback; context is the channelizer.
+    sdrio_int32 sdrio_channelizer_callback(void *context, sdrio_iq *samples, sdrio_uint32 length);
+
+    void sdrio_channelizer_mac_scalar(sdrio_float32 *acc, const sdrio_float32 *taps, const sdrio_float32 *in, sdrio_uint32 num_floats);
+    void sdrio_channelizer_mac_sse2(sdrio_float32 *acc, const sdrio_float32 *taps, const sdrio_float32 *in, sdrio_uint32 num_floats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SDRIO_CHANNELIZE_H
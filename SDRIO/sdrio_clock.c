@@ -0,0 +1,32 @@
+// Copyright Scott Cutler
+// This source file is licensed under the GNU Lesser General Public License (LGPL)
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "sdrio_clock.h"
+
+sdrio_float64 sdrio_clock_now()
+{
+#if defined(_WIN32)
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER now;
+
+    // The counter's frequency is fixed at boot, so reading it once is enough.
+    if (!frequency.QuadPart)
+    {
+        QueryPerformanceFrequency(&frequency);
+    }
+
+    QueryPerformanceCounter(&now);
+    return (sdrio_float64)now.QuadPart / (sdrio_float64)frequency.QuadPart;
+#else
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (sdrio_float64)now.tv_sec + now.tv_nsec * 1e-9;
+#endif
+}
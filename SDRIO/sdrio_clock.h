@@ -0,0 +1,22 @@
+// Copyright Scott Cutler
+// This source file is licensed under the GNU Lesser General Public License (LGPL)
+
+#ifndef SDRIO_CLOCK_H
+#define SDRIO_CLOCK_H
+
+#include "sdrio_ext.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    // Seconds on the host's monotonic clock (QueryPerformanceCounter on
+    // Windows).  Only differences mean anything; all devices in a process
+    // share the same clock, so it can line captures up against each other.
+    sdrio_float64 sdrio_clock_now();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SDRIO_CLOCK_H
@@ -0,0 +1,713 @@
+// Copyright Scott Cutler
+// This source file is licensed under the GNU Lesser General Public License (LGPL)
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <emmintrin.h>
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define SDRIO_TARGET_AVX2
+#else
+#include <cpuid.h>
+#define SDRIO_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+#include "sdrio_convert.h"
+
+#define U8_OFFSET 127.5f
+#define U8_SCALE  0.0078431373f
+#define S8_SCALE  (1.0f / 127.0f)
+#define S16_SCALE (1.0f / 32767.0f)
+#define Q12_SCALE 0.000030517578125f
+
+static void sdrio_cpuid(int info[4], int leaf, int subleaf)
+{
+#ifdef _MSC_VER
+    __cpuidex(info, leaf, subleaf);
+#else
+    __cpuid_count(leaf, subleaf, info[0], info[1], info[2], info[3]);
+#endif
+}
+
+static sdrio_uint64 sdrio_xgetbv(sdrio_uint32 index)
+{
+#ifdef _MSC_VER
+    return _xgetbv(index);
+#else
+    sdrio_uint32 eax, edx;
+    __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(index));
+    return ((sdrio_uint64)edx << 32) | eax;
+#endif
+}
+
+sdrio_uint32 sdrio_get_cpu_features()
+{
+    static volatile sdrio_int32 features = -1;
+
+    if (features < 0)
+    {
+        sdrio_uint32 f = 0;
+        int info[4];
+
+        sdrio_cpuid(info, 0, 0);
+        if (info[0] >= 1)
+        {
+            sdrio_cpuid(info, 1, 0);
+            if (info[3] & (1 << 26)) f |= SDRIO_CPU_SSE2;
+            if (info[2] & (1 <<  9)) f |= SDRIO_CPU_SSSE3;
+
+            // AVX2 also needs the OS to save the upper halves of the ymm registers
+            if ((info[2] & (1 << 27)) && (info[2] & (1 << 28)) && ((sdrio_xgetbv(0) & 6) == 6))
+            {
+                sdrio_cpuid(info, 0, 0);
+                if (info[0] >= 7)
+                {
+                    sdrio_cpuid(info, 7, 0);
+                    if (info[1] & (1 << 5)) f |= SDRIO_CPU_AVX2;
+                }
+            }
+        }
+
+        features = (sdrio_int32)f;
+    }
+
+    return (sdrio_uint32)features;
+}
+
+sdrio_uint32 sdrio_get_format_size(sdrio_sample_format format)
+{
+    switch (format)
+    {
+    case sdrio_sample_format_cu8:     return 2;
+    case sdrio_sample_format_cs8:     return 2;
+    case sdrio_sample_format_cs16:    return 4;
+    case sdrio_sample_format_sc16q12: return 4;
+    case sdrio_sample_format_cf32:    return 8;
+    default:                          return 0;
+    }
+}
+
+// Float to integer conversion shared by the scalar and SIMD kernels: scale,
+// clamp to +/-limit, then round half away from zero.  The scalar version
+// mirrors the operand order of maxps/minps so both give identical results.
+static __inline sdrio_int32 f32_to_int(sdrio_float32 x, sdrio_float32 limit)
+{
+    sdrio_float32 v = x * limit;
+    v = (v > -limit) ? v : -limit;
+    v = (v < limit) ? v : limit;
+    v += (v < 0.0f) ? -0.5f : 0.5f;
+    return (sdrio_int32)v;
+}
+
+static __inline __m128i f32_to_int_sse2(__m128 x, __m128 limit)
+{
+    const __m128 sign = _mm_castsi128_ps(_mm_set1_epi32(0x80000000));
+    const __m128 half = _mm_set1_ps(0.5f);
+    __m128 v = _mm_mul_ps(x, limit);
+    v = _mm_max_ps(v, _mm_xor_ps(limit, sign));
+    v = _mm_min_ps(v, limit);
+    v = _mm_add_ps(v, _mm_or_ps(_mm_and_ps(v, sign), half));
+    return _mm_cvttps_epi32(v);
+}
+
+static __inline void store_s16_f32_sse2(sdrio_float32 *out, __m128i w, __m128 scale)
+{
+    _mm_storeu_ps(out + 0, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(w, w), 16)), scale));
+    _mm_storeu_ps(out + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(w, w), 16)), scale));
+}
+
+//
+// RTL-SDR: unsigned 8 bit
+//
+
+void sdrio_convert_u8_f32_scalar(void *dst, const void *src, sdrio_uint32 num_samples)
+{
+    const sdrio_uint8 *in = (const sdrio_uint8 *)src;
+    sdrio_float32 *out = (sdrio_float32 *)dst;
+    sdrio_uint32 count = num_samples * 2;
+    sdrio_uint32 i;
+
+    for (i=0; i<count; i++)
+    {
+        out[i] = ((float)in[i] - U8_OFFSET) * U8_SCALE;
+    }
+}
+
+void sdrio_convert_u8_f32_sse2(void *dst, const void *src, sdrio_uint32 num_samples)
+{
+    const sdrio_uint8 *in = (const sdrio_uint8 *)src;
+    sdrio_float32 *out = (sdrio_float32 *)dst;
+    sdrio_uint32 count = num_samples * 2;
+    sdrio_uint32 i;
+
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 offset = _mm_set1_ps(U8_OFFSET);
+    const __m128 scale = _mm_set1_ps(U8_SCALE);
+
+    for (i=0; i+16<=count; i+=16)
+    {
+        __m128i b  = _mm_loadu_si128((const __m128i *)(in + i));
+        __m128i lo = _mm_unpacklo_epi8(b, zero);
+        __m128i hi = _mm_unpackhi_epi8(b, zero);
+
+        _mm_storeu_ps(out + i +  0, _mm_mul_ps(_mm_sub_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)), offset), scale));
+        _mm_storeu_ps(out + i +  4, _mm_mul_ps(_mm_sub_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)), offset), scale));
+        _mm_storeu_ps(out + i +  8, _mm_mul_ps(_mm_sub_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)), offset), scale));
+        _mm_storeu_ps(out + i + 12, _mm_mul_ps(_mm_sub_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)), offset), scale));
+    }
+
+    sdrio_convert_u8_f32_scalar(out + i, in + i, (count - i) / 2);
+}
+
+SDRIO_TARGET_AVX2 void sdrio_convert_u8_f32_avx2(void *dst, const void *src, sdrio_uint32 num_samples)
+{
+    const sdrio_uint8 *in = (const sdrio_uint8 *)src;
+    sdrio_float32 *out = (sdrio_float32 *)dst;
+    sdrio_uint32 count = num_samples * 2;
+    sdrio_uint32 i;
+
+    const __m256 offset = _mm256_set1_ps(U8_OFFSET);
+    const __m256 scale = _mm256_set1_ps(U8_SCALE);
+
+    for (i=0; i+32<=count; i+=32)
+    {
+        __m256i a = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(in + i +  0)));
+        __m256i b = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(in + i +  8)));
+        __m256i c = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(in + i + 16)));
+        __m256i d = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(in + i + 24)));
+
+        _mm256_storeu_ps(out + i +  0, _mm256_mul_ps(_mm256_sub_ps(_mm256_cvtepi32_ps(a), offset), scale));
+        _mm256_storeu_ps(out + i +  8, _mm256_mul_ps(_mm256_sub_ps(_mm256_cvtepi32_ps(b), offset), scale));
+        _mm256_storeu_ps(out + i + 16, _mm256_mul_ps(_mm256_sub_ps(_mm256_cvtepi32_ps(c), offset), scale));
+        _mm256_storeu_ps(out + i + 24, _mm256_mul_ps(_mm256_sub_ps(_mm256_cvtepi32_ps(d), offset), scale));
+    }
+
+    _mm256_zeroupper();
+
+    sdrio_convert_u8_f32_sse2(out + i, in + i, (count - i) / 2);
+}
+
+// (x - 127.5) * 256 is always an integer, so this is exact.
+void sdrio_convert_u8_s16_scalar(void *dst, const void *src, sdrio_uint32 num_samples)
+{
+    const sdrio_uint8 *in = (const sdrio_uint8 *)src;
+    sdrio_int16 *out = (sdrio_int16 *)dst;
+    sdrio_uint32 count = num_samples * 2;
+    sdrio_uint32 i;
+
+    for (i=0; i<count; i++)
+    {
+        out[i] = (sdrio_int16)(((sdrio_int32)in[i] << 8) - 32640);
+    }
+}
+
+void sdrio_convert_u8_s16_sse2(void *dst, const void *src, sdrio_uint32 num_samples)
+{
+    const sdrio_uint8 *in = (const sdrio_uint8 *)src;
+    sdrio_int16 *out = (sdrio_int16 *)dst;
+    sdrio_uint32 count = num_samples * 2;
+    sdrio_uint32 i;
+
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i offset = _mm_set1_epi16(32640);
+
+    for (i=0; i+16<=count; i+=16)
+    {
+        __m128i b = _mm_loadu_si128((const __m128i *)(in + i));
+        _mm_storeu_si128((__m128i *)(out + i + 0), _mm_sub_epi16(_mm_unpacklo_epi8(zero, b), offset));
+        _mm_storeu_si128((__m128i *)(out + i + 8), _mm_sub_epi16(_mm_unpackhi_epi8(zero, b), offset));
+    }
+
+    sdrio_convert_u8_s16_scalar(out + i, in + i, (count - i) / 2);
+}
+
+// x - 128; the output format carries an offset of -0.5 to stay exact.
+void sdrio_convert_u8_s8_scalar(void *dst, const void *src, sdrio_uint32 num_samples)
+{
+    const sdrio_uint8 *in = (const sdrio_uint8 *)src;
+    sdrio_int8 *out = (sdrio_int8 *)dst;
+    sdrio_uint32 count = num_samples * 2;
+    sdrio_uint32 i;
+
+    for (i=0; i<count; i++)
+    {
+        out[i] = (sdrio_int8)(in[i] ^ 0x80);
+    }
+}
+
+void sdrio_convert_u8_s8_sse2(void *dst, const void *src, sdrio_uint32 num_samples)
+{
+    const sdrio_uint8 *in = (const sdrio_uint8 *)src;
+    sdrio_int8 *out = (sdrio_int8 *)dst;
+    sdrio_uint32 count = num_samples * 2;
+    sdrio_uint32 i;
+
+    const __m128i flip = _mm_set1_epi8((char)0x80);
+
+    for (i=0; i+16<=count; i+=16)
+    {
+        _mm_storeu_si128((__m128i *)(out + i), _mm_xor_si128(_mm_loadu_si128((const __m128i *)(in + i)), flip));
+    }
+
+    sdrio_convert_u8_s8_scalar(out + i, in + i, (count - i) / 2);
+}
+
+//
+// hackRF: signed 8 bit
+//
+
+void sdrio_convert_s8_f32_scalar(void *dst, const void *src, sdrio_uint32 num_samples)
+{
+    const sdrio_int8 *in = (const sdrio_int8 *)src;
+    sdrio_float32 *out = (sdrio_float32 *)dst;
+    sdrio_uint32 count = num_samples * 2;
+    sdrio_uint32 i;
+
+    for (i=0; i<count; i++)
+    {
+        out[i] = (sdrio_float32)in[i] * S8_SCALE;
+    }
+}
+
+void sdrio_convert_s8_f32_sse2(void *dst, const void *src, sdrio_uint32 num_samples)
+{
+    const sdrio_int8 *in = (const sdrio_int8 *)src;
+    sdrio_float32 *out = (sdrio_float32 *)dst;
+    sdrio_uint32 count = num_samples * 2;
+    sdrio_uint32 i;
+
+    const __m128 scale = _mm_set1_ps(S8_SCALE);
+
+    for (i=0; i+16<=count; i+=16)
+    {
+        __m128i b = _mm_loadu_si128((const __m128i *)(in + i));
+        store_s16_f32_sse2(out + i + 0, _mm_srai_epi16(_mm_unpacklo_epi8(b, b), 8), scale);
+        store_s16_f32_sse2(out + i + 8, _mm_srai_epi16(_mm_unpackhi_epi8(b, b), 8), scale);
+    }
+
+    sdrio_convert_s8_f32_scalar(out + i, in + i, (count - i) / 2);
+}
+
+SDRIO_TARGET_AVX2 void sdrio_convert_s8_f32_avx2(void *dst, const void *src, sdrio_uint32 num_samples)
+{
+    const sdrio_int8 *in = (const sdrio_int8 *)src;
+    sdrio_float32 *out = (sdrio_float32 *)dst;
+    sdrio_uint32 count = num_samples * 2;
+    sdrio_uint32 i;
+
+    const __m256 scale = _mm256_set1_ps(S8_SCALE);
+
+    for (i=0; i+32<=count; i+=32)
+    {
+        __m256i a = _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i *)(in + i +  0)));
+        __m256i b = _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i *)(in + i +  8)));
+        __m256i c = _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i *)(in + i + 16)));
+        __m256i d = _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i *)(in + i + 24)));
+
+        _mm256_storeu_ps(out + i +  0, _mm256_mul_ps(_mm256_cvtepi32_ps(a), scale));
+        _mm256_storeu_ps(out + i +  8, _mm256_mul_ps(_mm256_cvtepi32_ps(b), scale));
+        _mm256_storeu_ps(out + i + 16, _mm256_mul_ps(_mm256_cvtepi32_ps(c), scale));
+        _mm256_storeu_ps(out + i + 24, _mm256_mul_ps(_mm256_cvtepi32_ps(d), scale));
+    }
+
+    _mm256_zeroupper();
+
+    sdrio_convert_s8_f32_sse2(out + i, in + i, (count - i) / 2);
+}
+
+void sdrio_convert_s8_s16_scalar(void *dst, const void *src, sdrio_uint32 num_samples)
+{
+    const sdrio_int8 *in = (const sdrio_int8 *)src;
+    sdrio_int16 *out = (sdrio_int16 *)dst;
+    sdrio_uint32 count = num_samples * 2;
+    sdrio_uint32 i;
+
+    for (i=0; i<count; i++)
+    {
+        out[i] = (sdrio_int16)(in[i] * 256);
+    }
+}
+
+void sdrio_convert_s8_s16_sse2(void *dst, const void *src, sdrio_uint32 num_samples)
+{
+    const sdrio_int8 *in = (const sdrio_int8 *)src;
+    sdrio_int16 *out = (sdrio_int16 *)dst;
+    sdrio_uint32 count = num_samples * 2;
+    sdrio_uint32 i;
+
+    const __m128i zero = _mm_setzero_si128();
+
+    for (i=0; i+16<=count; i+=16)
+    {
+        __m128i b = _mm_loadu_si128((const __m128i *)(in + i));
+        _mm_storeu_si128((__m128i *)(out + i + 0), _mm_unpacklo_epi8(zero, b));
+        _mm_storeu_si128((__m128i *)(out + i + 8), _mm_unpackhi_epi8(zero, b));
+    }
+
+    sdrio_convert_s8_s16_scalar(out + i, in + i, (count - i) / 2);
+}
+
+//
+// Mirics/FUNcube: signed 16 bit
+//
+
+void sdrio_convert_s16_f32_scalar(void *dst, const void *src, sdrio_uint32 num_samples)
+{
+    const sdrio_int16 *in = (const sdrio_int16 *)src;
+    sdrio_float32 *out = (sdrio_float32 *)dst;
+    sdrio_uint32 count = num_samples * 2;
+    sdrio_uint32 i;
+
+    for (i=0; i<count; i++)
+    {
+        out[i] = (sdrio_float32)in[i] * S16_SCALE;
+    }
+}
+
+void sdrio_convert_s16_f32_sse2(void *dst, const void *src, sdrio_uint32 num_samples)
+{
+    const sdrio_int16 *in = (const sdrio_int16 *)src;
+    sdrio_float32 *out = (sdrio_float32 *)dst;
+    sdrio_uint32 count = num_samples * 2;
+    sdrio_uint32 i;
+
+    const __m128 scale = _mm_set1_ps(S16_SCALE);
+
+    for (i=0; i+16<=count; i+=16)
+    {
+        store_s16_f32_sse2(out + i + 0, _mm_loadu_si128((const __m128i *)(in + i + 0)), scale);
+        store_s16_f32_sse2(out + i + 8, _mm_loadu_si128((const __m128i *)(in + i + 8)), scale);
+    }
+
+    sdrio_convert_s16_f32_scalar(out + i, in + i, (count - i) / 2);
+}
+
+SDRIO_TARGET_AVX2 void sdrio_convert_s16_f32_avx2(void *dst, const void *src, sdrio_uint32 num_samples)
+{
+    const sdrio_int16 *in = (const sdrio_int16 *)src;
+    sdrio_float32 *out = (sdrio_float32 *)dst;
+    sdrio_uint32 count = num_samples * 2;
+    sdrio_uint32 i;
+
+    const __m256 scale = _mm256_set1_ps(S16_SCALE);
+
+    for (i=0; i+32<=count; i+=32)
+    {
+        __m256i a = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(in + i +  0)));
+        __m256i b = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(in + i +  8)));
+        __m256i c = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(in + i + 16)));
+        __m256i d = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(in + i + 24)));
+
+        _mm256_storeu_ps(out + i +  0, _mm256_mul_ps(_mm256_cvtepi32_ps(a), scale));
+        _mm256_storeu_ps(out + i +  8, _mm256_mul_ps(_mm256_cvtepi32_ps(b), scale));
+        _mm256_storeu_ps(out + i + 16, _mm256_mul_ps(_mm256_cvtepi32_ps(c), scale));
+        _mm256_storeu_ps(out + i + 24, _mm256_mul_ps(_mm256_cvtepi32_ps(d), scale));
+    }
+
+    _mm256_zeroupper();
+
+    sdrio_convert_s16_f32_sse2(out + i, in + i, (count - i) / 2);
+}
+
+void sdrio_convert_s16_s8_scalar(void *dst, const void *src, sdrio_uint32 num_samples)
+{
+    const sdrio_int16 *in = (const sdrio_int16 *)src;
+    sdrio_int8 *out = (sdrio_int8 *)dst;
+    sdrio_uint32 count = num_samples * 2;
+    sdrio_uint32 i;
+
+    for (i=0; i<count; i++)
+    {
+        out[i] = (sdrio_int8)(in[i] >> 8);
+    }
+}
+
+void sdrio_convert_s16_s8_sse2(void *dst, const void *src, sdrio_uint32 num_samples)
+{
+    const sdrio_int16 *in = (const sdrio_int16 *)src;
+    sdrio_int8 *out = (sdrio_int8 *)dst;
+    sdrio_uint32 count = num_samples * 2;
+    sdrio_uint32 i;
+
+    for (i=0; i+16<=count; i+=16)
+    {
+        __m128i a = _mm_srai_epi16(_mm_loadu_si128((const __m128i *)(in + i + 0)), 8);
+        __m128i b = _mm_srai_epi16(_mm_loadu_si128((const __m128i *)(in + i + 8)), 8);
+        _mm_storeu_si128((__m128i *)(out + i), _mm_packs_epi16(a, b));
+    }
+
+    sdrio_convert_s16_s8_scalar(out + i, in + i, (count - i) / 2);
+}
+
+//
+// bladeRF: signed 12 bit in 16 bit containers
+//
+
+void sdrio_convert_q12_f32_scalar(void *dst, const void *src, sdrio_uint32 num_samples)
+{
+    const sdrio_int16 *in = (const sdrio_int16 *)src;
+    sdrio_float32 *out = (sdrio_float32 *)dst;
+    sdrio_uint32 count = num_samples * 2;
+    sdrio_uint32 i;
+
+    for (i=0; i<count; i++)
+    {
+        out[i] = (sdrio_float32)(sdrio_int16)(in[i] << 4) * Q12_SCALE;
+    }
+}
+
+void sdrio_convert_q12_f32_sse2(void *dst, const void *src, sdrio_uint32 num_samples)
+{
+    const sdrio_int16 *in = (const sdrio_int16 *)src;
+    sdrio_float32 *out = (sdrio_float32 *)dst;
+    sdrio_uint32 count = num_samples * 2;
+    sdrio_uint32 i;
+
+    const __m128 scale = _mm_set1_ps(Q12_SCALE);
+
+    for (i=0; i+16<=count; i+=16)
+    {
+        store_s16_f32_sse2(out + i + 0, _mm_slli_epi16(_mm_loadu_si128((const __m128i *)(in + i + 0)), 4), scale);
+        store_s16_f32_sse2(out + i + 8, _mm_slli_epi16(_mm_loadu_si128((const __m128i *)(in + i + 8)), 4), scale);
+    }
+
+    sdrio_convert_q12_f32_scalar(out + i, in + i, (count - i) / 2);
+}
+
+SDRIO_TARGET_AVX2 void sdrio_convert_q12_f32_avx2(void *dst, const void *src, sdrio_uint32 num_samples)
+{
+    const sdrio_int16 *in = (const sdrio_int16 *)src;
+    sdrio_float32 *out = (sdrio_float32 *)dst;
+    sdrio_uint32 count = num_samples * 2;
+    sdrio_uint32 i;
+
+    const __m256 scale = _mm256_set1_ps(Q12_SCALE);
+
+    for (i=0; i+32<=count; i+=32)
+    {
+        __m256i a = _mm256_cvtepi16_epi32(_mm_slli_epi16(_mm_loadu_si128((const __m128i *)(in + i +  0)), 4));
+        __m256i b = _mm256_cvtepi16_epi32(_mm_slli_epi16(_mm_loadu_si128((const __m128i *)(in + i +  8)), 4));
+        __m256i c = _mm256_cvtepi16_epi32(_mm_slli_epi16(_mm_loadu_si128((const __m128i *)(in + i + 16)), 4));
+        __m256i d = _mm256_cvtepi16_epi32(_mm_slli_epi16(_mm_loadu_si128((const __m128i *)(in + i + 24)), 4));
+
+        _mm256_storeu_ps(out + i +  0, _mm256_mul_ps(_mm256_cvtepi32_ps(a), scale));
+        _mm256_storeu_ps(out + i +  8, _mm256_mul_ps(_mm256_cvtepi32_ps(b), scale));
+        _mm256_storeu_ps(out + i + 16, _mm256_mul_ps(_mm256_cvtepi32_ps(c), scale));
+        _mm256_storeu_ps(out + i + 24, _mm256_mul_ps(_mm256_cvtepi32_ps(d), scale));
+    }
+
+    _mm256_zeroupper();
+
+    sdrio_convert_q12_f32_sse2(out + i, in + i, (count - i) / 2);
+}
+
+void sdrio_convert_q12_s16_scalar(void *dst, const void *src, sdrio_uint32 num_samples)
+{
+    const sdrio_int16 *in = (const sdrio_int16 *)src;
+    sdrio_int16 *out = (sdrio_int16 *)dst;
+    sdrio_uint32 count = num_samples * 2;
+    sdrio_uint32 i;
+
+    for (i=0; i<count; i++)
+    {
+        out[i] = (sdrio_int16)(in[i] << 4);
+    }
+}
+
+void sdrio_convert_q12_s16_sse2(void *dst, const void *src, sdrio_uint32 num_samples)
+{
+    const sdrio_int16 *in = (const sdrio_int16 *)src;
+    sdrio_int16 *out = (sdrio_int16 *)dst;
+    sdrio_uint32 count = num_samples * 2;
+    sdrio_uint32 i;
+
+    for (i=0; i+8<=count; i+=8)
+    {
+        _mm_storeu_si128((__m128i *)(out + i), _mm_slli_epi16(_mm_loadu_si128((const __m128i *)(in + i)), 4));
+    }
+
+    sdrio_convert_q12_s16_scalar(out + i, in + i, (count - i) / 2);
+}
+
+void sdrio_convert_q12_s8_scalar(void *dst, const void *src, sdrio_uint32 num_samples)
+{
+    const sdrio_int16 *in = (const sdrio_int16 *)src;
+    sdrio_int8 *out = (sdrio_int8 *)dst;
+    sdrio_uint32 count = num_samples * 2;
+    sdrio_uint32 i;
+
+    for (i=0; i<count; i++)
+    {
+        out[i] = (sdrio_int8)((sdrio_int16)(in[i] << 4) >> 8);
+    }
+}
+
+void sdrio_convert_q12_s8_sse2(void *dst, const void *src, sdrio_uint32 num_samples)
+{
+    const sdrio_int16 *in = (const sdrio_int16 *)src;
+    sdrio_int8 *out = (sdrio_int8 *)dst;
+    sdrio_uint32 count = num_samples * 2;
+    sdrio_uint32 i;
+
+    for (i=0; i+16<=count; i+=16)
+    {
+        __m128i a = _mm_srai_epi16(_mm_slli_epi16(_mm_loadu_si128((const __m128i *)(in + i + 0)), 4), 8);
+        __m128i b = _mm_srai_epi16(_mm_slli_epi16(_mm_loadu_si128((const __m128i *)(in + i + 8)), 4), 8);
+        _mm_storeu_si128((__m128i *)(out + i), _mm_packs_epi16(a, b));
+    }
+
+    sdrio_convert_q12_s8_scalar(out + i, in + i, (count - i) / 2);
+}
+
+//
+// null device: 32 bit float
+//
+
+void sdrio_convert_f32_s16_scalar(void *dst, const void *src, sdrio_uint32 num_samples)
+{
+    const sdrio_float32 *in = (const sdrio_float32 *)src;
+    sdrio_int16 *out = (sdrio_int16 *)dst;
+    sdrio_uint32 count = num_samples * 2;
+    sdrio_uint32 i;
+
+    for (i=0; i<count; i++)
+    {
+        out[i] = (sdrio_int16)f32_to_int(in[i], 32767.0f);
+    }
+}
+
+void sdrio_convert_f32_s16_sse2(void *dst, const void *src, sdrio_uint32 num_samples)
+{
+    const sdrio_float32 *in = (const sdrio_float32 *)src;
+    sdrio_int16 *out = (sdrio_int16 *)dst;
+    sdrio_uint32 count = num_samples * 2;
+    sdrio_uint32 i;
+
+    const __m128 limit = _mm_set1_ps(32767.0f);
+
+    for (i=0; i+8<=count; i+=8)
+    {
+        __m128i a = f32_to_int_sse2(_mm_loadu_ps(in + i + 0), limit);
+        __m128i b = f32_to_int_sse2(_mm_loadu_ps(in + i + 4), limit);
+        _mm_storeu_si128((__m128i *)(out + i), _mm_packs_epi32(a, b));
+    }
+
+    sdrio_convert_f32_s16_scalar(out + i, in + i, (count - i) / 2);
+}
+
+void sdrio_convert_f32_s8_scalar(void *dst, const void *src, sdrio_uint32 num_samples)
+{
+    const sdrio_float32 *in = (const sdrio_float32 *)src;
+    sdrio_int8 *out = (sdrio_int8 *)dst;
+    sdrio_uint32 count = num_samples * 2;
+    sdrio_uint32 i;
+
+    for (i=0; i<count; i++)
+    {
+        out[i] = (sdrio_int8)f32_to_int(in[i], 127.0f);
+    }
+}
+
+void sdrio_convert_f32_s8_sse2(void *dst, const void *src, sdrio_uint32 num_samples)
+{
+    const sdrio_float32 *in = (const sdrio_float32 *)src;
+    sdrio_int8 *out = (sdrio_int8 *)dst;
+    sdrio_uint32 count = num_samples * 2;
+    sdrio_uint32 i;
+
+    const __m128 limit = _mm_set1_ps(127.0f);
+
+    for (i=0; i+16<=count; i+=16)
+    {
+        __m128i a = f32_to_int_sse2(_mm_loadu_ps(in + i +  0), limit);
+        __m128i b = f32_to_int_sse2(_mm_loadu_ps(in + i +  4), limit);
+        __m128i c = f32_to_int_sse2(_mm_loadu_ps(in + i +  8), limit);
+        __m128i d = f32_to_int_sse2(_mm_loadu_ps(in + i + 12), limit);
+        _mm_storeu_si128((__m128i *)(out + i), _mm_packs_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d)));
+    }
+
+    sdrio_convert_f32_s8_scalar(out + i, in + i, (count - i) / 2);
+}
+
+//
+// Kernel selection
+//
+
+static const sdrio_converter_entry converters[] =
+{
+    {sdrio_sample_format_cu8,     sdrio_sample_format_cf32, 0.0f,  1.0f,      sdrio_convert_u8_f32_scalar,  sdrio_convert_u8_f32_sse2,  sdrio_convert_u8_f32_avx2},
+    {sdrio_sample_format_cu8,     sdrio_sample_format_cs16, 0.0f,  256.0f,    sdrio_convert_u8_s16_scalar,  sdrio_convert_u8_s16_sse2,  0},
+    {sdrio_sample_format_cu8,     sdrio_sample_format_cs8, -0.5f,  1.0f,      sdrio_convert_u8_s8_scalar,   sdrio_convert_u8_s8_sse2,   0},
+    {sdrio_sample_format_cs8,     sdrio_sample_format_cf32, 0.0f,  1.0f,      sdrio_convert_s8_f32_scalar,  sdrio_convert_s8_f32_sse2,  sdrio_convert_s8_f32_avx2},
+    {sdrio_sample_format_cs8,     sdrio_sample_format_cs16, 0.0f,  256.0f,    sdrio_convert_s8_s16_scalar,  sdrio_convert_s8_s16_sse2,  0},
+    {sdrio_sample_format_cs16,    sdrio_sample_format_cf32, 0.0f,  1.0f,      sdrio_convert_s16_f32_scalar, sdrio_convert_s16_f32_sse2, sdrio_convert_s16_f32_avx2},
+    {sdrio_sample_format_cs16,    sdrio_sample_format_cs8,  0.0f,  1.0f/256,  sdrio_convert_s16_s8_scalar,  sdrio_convert_s16_s8_sse2,  0},
+    {sdrio_sample_format_sc16q12, sdrio_sample_format_cf32, 0.0f,  1.0f,      sdrio_convert_q12_f32_scalar, sdrio_convert_q12_f32_sse2, sdrio_convert_q12_f32_avx2},
+    {sdrio_sample_format_sc16q12, sdrio_sample_format_cs16, 0.0f,  16.0f,     sdrio_convert_q12_s16_scalar, sdrio_convert_q12_s16_sse2, 0},
+    {sdrio_sample_format_sc16q12, sdrio_sample_format_cs8,  0.0f,  1.0f/16,   sdrio_convert_q12_s8_scalar,  sdrio_convert_q12_s8_sse2,  0},
+    {sdrio_sample_format_cf32,    sdrio_sample_format_cs16, 0.0f,  32767.0f,  sdrio_convert_f32_s16_scalar, sdrio_convert_f32_s16_sse2, 0},
+    {sdrio_sample_format_cf32,    sdrio_sample_format_cs8,  0.0f,  127.0f,    sdrio_convert_f32_s8_scalar,  sdrio_convert_f32_s8_sse2,  0},
+};
+
+const sdrio_converter_entry * sdrio_get_converters(sdrio_uint32 *count)
+{
+    *count = sizeof(converters)/sizeof(converters[0]);
+    return converters;
+}
+
+sdrio_convert_t sdrio_get_convert(sdrio_sample_format src, sdrio_sample_format dst)
+{
+    sdrio_uint32 features = sdrio_get_cpu_features();
+    sdrio_uint32 i;
+
+    for (i=0; i<sizeof(converters)/sizeof(converters[0]); i++)
+    {
+        if ((converters[i].src == src) && (converters[i].dst == dst))
+        {
+            if ((features & SDRIO_CPU_AVX2) && converters[i].avx2) return converters[i].avx2;
+            if ((features & SDRIO_CPU_SSE2) && converters[i].sse2) return converters[i].sse2;
+            return converters[i].scalar;
+        }
+    }
+
+    return 0;
+}
+
+sdrio_int32 sdrio_get_converter(const sdrio_format_desc *src, sdrio_sample_format dst, sdrio_convert_t *convert, sdrio_format_desc *dst_format)
+{
+    sdrio_uint32 i;
+
+    if (src->format == dst)
+    {
+        *convert = 0;
+        *dst_format = *src;
+        return 1;
+    }
+
+    for (i=0; i<sizeof(converters)/sizeof(converters[0]); i++)
+    {
+        if ((converters[i].src == src->format) && (converters[i].dst == dst))
+        {
+            *convert = sdrio_get_convert(src->format, dst);
+
+            dst_format->format = dst;
+            dst_format->bytes_per_sample = sdrio_get_format_size(dst);
+            if (dst == sdrio_sample_format_cf32)
+            {
+                dst_format->offset = 0.0f;
+                dst_format->scale = 1.0f;
+            }
+            else
+            {
+                dst_format->offset = converters[i].offset;
+                dst_format->scale = src->scale / converters[i].gain;
+            }
+            return 1;
+        }
+    }
+
+    return 0;
+}
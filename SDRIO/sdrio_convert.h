@@ -0,0 +1,88 @@
+// Copyright Scott Cutler
+// This source file is licensed under the GNU Lesser General Public License (LGPL)
+
+#ifndef SDRIO_CONVERT_H
+#define SDRIO_CONVERT_H
+
+#include "sdrio_ext.h"
+
+#define SDRIO_CPU_SSE2  0x00000001
+#define SDRIO_CPU_SSSE3 0x00000002
+#define SDRIO_CPU_AVX2  0x00000004
+
+// Converts num_samples interleaved I/Q pairs from src into dst.
+typedef void (*sdrio_convert_t)(void *dst, const void *src, sdrio_uint32 num_samples);
+
+// A supported conversion.  sse2 and avx2 are 0 where there is no such kernel.
+typedef struct sdrio_converter_entry_t
+{
+    sdrio_sample_format src;
+    sdrio_sample_format dst;
+    sdrio_float32 offset;       // offset of the converted samples
+    sdrio_float32 gain;         // converted = source * gain, so scale is divided by it
+    sdrio_convert_t scalar;
+    sdrio_convert_t sse2;
+    sdrio_convert_t avx2;
+} sdrio_converter_entry;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    sdrio_uint32 sdrio_get_cpu_features();
+
+    sdrio_uint32 sdrio_get_format_size(sdrio_sample_format format);
+
+    // Best kernel for this CPU, or 0 if the pair is not supported.
+    sdrio_convert_t sdrio_get_convert(sdrio_sample_format src, sdrio_sample_format dst);
+
+    // Picks the kernel and fills in the description of the converted samples.
+    // *convert is set to 0 when src is already in the requested format.
+    sdrio_int32 sdrio_get_converter(const sdrio_format_desc *src, sdrio_sample_format dst, sdrio_convert_t *convert, sdrio_format_desc *dst_format);
+
+    // Every supported conversion with all of its kernels, for tests.
+    const sdrio_converter_entry * sdrio_get_converters(sdrio_uint32 *count);
+
+    // RTL-SDR: unsigned 8 bit
+    void sdrio_convert_u8_f32_scalar(void *dst, const void *src, sdrio_uint32 num_samples);
+    void sdrio_convert_u8_f32_sse2(void *dst, const void *src, sdrio_uint32 num_samples);
+    void sdrio_convert_u8_f32_avx2(void *dst, const void *src, sdrio_uint32 num_samples);
+    void sdrio_convert_u8_s16_scalar(void *dst, const void *src, sdrio_uint32 num_samples);
+    void sdrio_convert_u8_s16_sse2(void *dst, const void *src, sdrio_uint32 num_samples);
+    void sdrio_convert_u8_s8_scalar(void *dst, const void *src, sdrio_uint32 num_samples);
+    void sdrio_convert_u8_s8_sse2(void *dst, const void *src, sdrio_uint32 num_samples);
+
+    // hackRF: signed 8 bit
+    void sdrio_convert_s8_f32_scalar(void *dst, const void *src, sdrio_uint32 num_samples);
+    void sdrio_convert_s8_f32_sse2(void *dst, const void *src, sdrio_uint32 num_samples);
+    void sdrio_convert_s8_f32_avx2(void *dst, const void *src, sdrio_uint32 num_samples);
+    void sdrio_convert_s8_s16_scalar(void *dst, const void *src, sdrio_uint32 num_samples);
+    void sdrio_convert_s8_s16_sse2(void *dst, const void *src, sdrio_uint32 num_samples);
+
+    // Mirics/FUNcube: signed 16 bit
+    void sdrio_convert_s16_f32_scalar(void *dst, const void *src, sdrio_uint32 num_samples);
+    void sdrio_convert_s16_f32_sse2(void *dst, const void *src, sdrio_uint32 num_samples);
+    void sdrio_convert_s16_f32_avx2(void *dst, const void *src, sdrio_uint32 num_samples);
+    void sdrio_convert_s16_s8_scalar(void *dst, const void *src, sdrio_uint32 num_samples);
+    void sdrio_convert_s16_s8_sse2(void *dst, const void *src, sdrio_uint32 num_samples);
+
+    // bladeRF: signed 12 bit in 16 bit containers
+    void sdrio_convert_q12_f32_scalar(void *dst, const void *src, sdrio_uint32 num_samples);
+    void sdrio_convert_q12_f32_sse2(void *dst, const void *src, sdrio_uint32 num_samples);
+    void sdrio_convert_q12_f32_avx2(void *dst, const void *src, sdrio_uint32 num_samples);
+    void sdrio_convert_q12_s16_scalar(void *dst, const void *src, sdrio_uint32 num_samples);
+    void sdrio_convert_q12_s16_sse2(void *dst, const void *src, sdrio_uint32 num_samples);
+    void sdrio_convert_q12_s8_scalar(void *dst, const void *src, sdrio_uint32 num_samples);
+    void sdrio_convert_q12_s8_sse2(void *dst, const void *src, sdrio_uint32 num_samples);
+
+    // null device: 32 bit float
+    void sdrio_convert_f32_s16_scalar(void *dst, const void *src, sdrio_uint32 num_samples);
+    void sdrio_convert_f32_s16_sse2(void *dst, const void *src, sdrio_uint32 num_samples);
+    void sdrio_convert_f32_s8_scalar(void *dst, const void *src, sdrio_uint32 num_samples);
+    void sdrio_convert_f32_s8_sse2(void *dst, const void *src, sdrio_uint32 num_samples);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SDRIO_CONVERT_H
@@ -0,0 +1,305 @@
+// Copyright Scott Cutler
+// This source file is licensed under the GNU Lesser General Public License (LGPL)
+
+#include <math.h>
+
+#include <emmintrin.h>
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#define SDRIO_TARGET_AVX2
+#else
+#define SDRIO_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+#include "sdrio_correct.h"
+#include "sdrio_convert.h"
+
+void sdrio_dc_init(sdrio_dc_state *state)
+{
+    state->i = 0.0f;
+    state->q = 0.0f;
+    state->alpha = SDRIO_DC_ALPHA;
+}
+
+sdrio_dc_correct_t sdrio_get_dc_correct()
+{
+    sdrio_uint32 features = sdrio_get_cpu_features();
+
+    if (features & SDRIO_CPU_AVX2)
+    {
+        return sdrio_dc_correct_avx2;
+    }
+    else if (features & SDRIO_CPU_SSE2)
+    {
+        return sdrio_dc_correct_sse2;
+    }
+    else
+    {
+        return sdrio_dc_correct_scalar;
+    }
+}
+
+void sdrio_dc_correct_scalar(sdrio_dc_state *state, sdrio_iq *samples, sdrio_uint32 num_samples)
+{
+    sdrio_float32 sum_i = 0.0f;
+    sdrio_float32 sum_q = 0.0f;
+    sdrio_uint32 n;
+
+    for (n=0; n<num_samples; n++)
+    {
+        samples[n].i -= state->i;
+        samples[n].q -= state->q;
+        sum_i += samples[n].i;
+        sum_q += samples[n].q;
+    }
+
+    state->i += state->alpha * sum_i;
+    state->q += state->alpha * sum_q;
+}
+
+void sdrio_dc_correct_sse2(sdrio_dc_state *state, sdrio_iq *samples, sdrio_uint32 num_samples)
+{
+    __m128 dc = _mm_setr_ps(state->i, state->q, state->i, state->q);
+    __m128 acc = _mm_setzero_ps();
+    float *p = (float *)samples;
+    float sum[4];
+    sdrio_uint32 n = 0;
+
+    for (; n + 2 <= num_samples; n += 2, p += 4)
+    {
+        __m128 v = _mm_sub_ps(_mm_loadu_ps(p), dc);
+        acc = _mm_add_ps(acc, v);
+        _mm_storeu_ps(p, v);
+    }
+
+    acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+    _mm_storeu_ps(sum, acc);
+
+    for (; n < num_samples; n++)
+    {
+        samples[n].i -= state->i;
+        samples[n].q -= state->q;
+        sum[0] += samples[n].i;
+        sum[1] += samples[n].q;
+    }
+
+    state->i += state->alpha * sum[0];
+    state->q += state->alpha * sum[1];
+}
+
+SDRIO_TARGET_AVX2 void sdrio_dc_correct_avx2(sdrio_dc_state *state, sdrio_iq *samples, sdrio_uint32 num_samples)
+{
+    __m256 dc = _mm256_setr_ps(state->i, state->q, state->i, state->q, state->i, state->q, state->i, state->q);
+    __m256 acc = _mm256_setzero_ps();
+    __m128 acc4;
+    float *p = (float *)samples;
+    float sum[4];
+    sdrio_uint32 n = 0;
+
+    for (; n + 4 <= num_samples; n += 4, p += 8)
+    {
+        __m256 v = _mm256_sub_ps(_mm256_loadu_ps(p), dc);
+        acc = _mm256_add_ps(acc, v);
+        _mm256_storeu_ps(p, v);
+    }
+
+    acc4 = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    acc4 = _mm_add_ps(acc4, _mm_movehl_ps(acc4, acc4));
+    _mm_storeu_ps(sum, acc4);
+    _mm256_zeroupper();
+
+    for (; n < num_samples; n++)
+    {
+        samples[n].i -= state->i;
+        samples[n].q -= state->q;
+        sum[0] += samples[n].i;
+        sum[1] += samples[n].q;
+    }
+
+    state->i += state->alpha * sum[0];
+    state->q += state->alpha * sum[1];
+}
+
+void sdrio_iq_init(sdrio_iq_state *state)
+{
+    state->estimate = 0;
+    state->alpha = SDRIO_IQ_ALPHA;
+    state->ii = 0.0f;
+    state->qq = 0.0f;
+    state->iq = 0.0f;
+    sdrio_iq_set(state, 1.0f, 0.0f);
+}
+
+void sdrio_iq_set(sdrio_iq_state *state, sdrio_float32 gain, sdrio_float32 phase)
+{
+    if (gain <= 0.0f)
+    {
+        gain = 1.0f;
+    }
+
+    state->gain = gain;
+    state->phase = phase;
+
+    state->a = 1.0f;
+    state->b = 0.0f;
+    state->c = -tanf(phase);
+    state->d = 1.0f / (gain * cosf(phase));
+}
+
+// Smooths the moments of the last call and derives gain and phase from
+// them: gain = sqrt(E[Q'Q'] / E[I'I']), sin(phase) = E[I'Q'] / sqrt(E[I'I'] E[Q'Q']).
+static void update_estimate(sdrio_iq_state *state, sdrio_float32 ii, sdrio_float32 qq, sdrio_float32 iq, sdrio_uint32 num_samples)
+{
+    sdrio_float32 scale;
+    sdrio_float32 s;
+
+    if (!num_samples)
+    {
+        return;
+    }
+
+    scale = 1.0f / num_samples;
+    state->ii += state->alpha * (ii * scale - state->ii);
+    state->qq += state->alpha * (qq * scale - state->qq);
+    state->iq += state->alpha * (iq * scale - state->iq);
+
+    if ((state->ii > 0.0f) && (state->qq > 0.0f))
+    {
+        s = state->iq / sqrtf(state->ii * state->qq);
+        if (s > 0.5f) s = 0.5f;
+        if (s < -0.5f) s = -0.5f;
+
+        sdrio_iq_set(state, sqrtf(state->qq / state->ii), asinf(s));
+    }
+}
+
+sdrio_iq_correct_t sdrio_get_iq_correct()
+{
+    sdrio_uint32 features = sdrio_get_cpu_features();
+
+    if (features & SDRIO_CPU_AVX2)
+    {
+        return sdrio_iq_correct_avx2;
+    }
+    else if (features & SDRIO_CPU_SSE2)
+    {
+        return sdrio_iq_correct_sse2;
+    }
+    else
+    {
+        return sdrio_iq_correct_scalar;
+    }
+}
+
+void sdrio_iq_correct_scalar(sdrio_iq_state *state, sdrio_iq *samples, sdrio_uint32 num_samples)
+{
+    sdrio_float32 ii = 0.0f, qq = 0.0f, iq = 0.0f;
+    sdrio_float32 i, q;
+    sdrio_uint32 n;
+
+    for (n=0; n<num_samples; n++)
+    {
+        i = samples[n].i;
+        q = samples[n].q;
+        ii += i * i;
+        qq += q * q;
+        iq += i * q;
+        samples[n].i = state->a * i + state->b * q;
+        samples[n].q = state->c * i + state->d * q;
+    }
+
+    if (state->estimate)
+    {
+        update_estimate(state, ii, qq, iq, num_samples);
+    }
+}
+
+void sdrio_iq_correct_sse2(sdrio_iq_state *state, sdrio_iq *samples, sdrio_uint32 num_samples)
+{
+    // out = v * [a d a d] + swap(v) * [b c b c]
+    __m128 m0 = _mm_setr_ps(state->a, state->d, state->a, state->d);
+    __m128 m1 = _mm_setr_ps(state->b, state->c, state->b, state->c);
+    __m128 sq = _mm_setzero_ps();
+    __m128 cross = _mm_setzero_ps();
+    float *p = (float *)samples;
+    float sum_sq[4], sum_cross[4];
+    sdrio_float32 i, q;
+    sdrio_uint32 n = 0;
+
+    for (; n + 2 <= num_samples; n += 2, p += 4)
+    {
+        __m128 v = _mm_loadu_ps(p);
+        __m128 s = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+        sq = _mm_add_ps(sq, _mm_mul_ps(v, v));
+        cross = _mm_add_ps(cross, _mm_mul_ps(v, s));
+        _mm_storeu_ps(p, _mm_add_ps(_mm_mul_ps(v, m0), _mm_mul_ps(s, m1)));
+    }
+
+    sq = _mm_add_ps(sq, _mm_movehl_ps(sq, sq));
+    cross = _mm_add_ps(cross, _mm_movehl_ps(cross, cross));
+    _mm_storeu_ps(sum_sq, sq);
+    _mm_storeu_ps(sum_cross, cross);
+
+    for (; n < num_samples; n++)
+    {
+        i = samples[n].i;
+        q = samples[n].q;
+        sum_sq[0] += i * i;
+        sum_sq[1] += q * q;
+        sum_cross[0] += i * q;
+        samples[n].i = state->a * i + state->b * q;
+        samples[n].q = state->c * i + state->d * q;
+    }
+
+    if (state->estimate)
+    {
+        update_estimate(state, sum_sq[0], sum_sq[1], sum_cross[0], num_samples);
+    }
+}
+
+SDRIO_TARGET_AVX2 void sdrio_iq_correct_avx2(sdrio_iq_state *state, sdrio_iq *samples, sdrio_uint32 num_samples)
+{
+    __m256 m0 = _mm256_setr_ps(state->a, state->d, state->a, state->d, state->a, state->d, state->a, state->d);
+    __m256 m1 = _mm256_setr_ps(state->b, state->c, state->b, state->c, state->b, state->c, state->b, state->c);
+    __m256 sq = _mm256_setzero_ps();
+    __m256 cross = _mm256_setzero_ps();
+    __m128 sq4, cross4;
+    float *p = (float *)samples;
+    float sum_sq[4], sum_cross[4];
+    sdrio_float32 i, q;
+    sdrio_uint32 n = 0;
+
+    for (; n + 4 <= num_samples; n += 4, p += 8)
+    {
+        __m256 v = _mm256_loadu_ps(p);
+        __m256 s = _mm256_permute_ps(v, _MM_SHUFFLE(2, 3, 0, 1));
+        sq = _mm256_add_ps(sq, _mm256_mul_ps(v, v));
+        cross = _mm256_add_ps(cross, _mm256_mul_ps(v, s));
+        _mm256_storeu_ps(p, _mm256_add_ps(_mm256_mul_ps(v, m0), _mm256_mul_ps(s, m1)));
+    }
+
+    sq4 = _mm_add_ps(_mm256_castps256_ps128(sq), _mm256_extractf128_ps(sq, 1));
+    cross4 = _mm_add_ps(_mm256_castps256_ps128(cross), _mm256_extractf128_ps(cross, 1));
+    sq4 = _mm_add_ps(sq4, _mm_movehl_ps(sq4, sq4));
+    cross4 = _mm_add_ps(cross4, _mm_movehl_ps(cross4, cross4));
+    _mm_storeu_ps(sum_sq, sq4);
+    _mm_storeu_ps(sum_cross, cross4);
+    _mm256_zeroupper();
+
+    for (; n < num_samples; n++)
+    {
+        i = samples[n].i;
+        q = samples[n].q;
+        sum_sq[0] += i * i;
+        sum_sq[1] += q * q;
+        sum_cross[0] += i * q;
+        samples[n].i = state->a * i + state->b * q;
+        samples[n].q = state->c * i + state->d * q;
+    }
+
+    if (state->estimate)
+    {
+        update_estimate(state, sum_sq[0], sum_sq[1], sum_cross[0], num_samples);
+    }
+}
@@ -0,0 +1,75 @@
+// Copyright Scott Cutler
+// This source file is licensed under the GNU Lesser General Public License (LGPL)
+
+#ifndef SDRIO_CORRECT_H
+#define SDRIO_CORRECT_H
+
+#include "sdrio_ext.h"
+
+// The stream converts and corrects in chunks of this many pairs so the
+// corrections run on data that is still in L1.
+#define SDRIO_CORRECT_CHUNK 64
+
+#define SDRIO_DC_ALPHA 0.0001f
+
+// Single-pole DC blocker, one per channel.  The estimate is held for the
+// duration of a call and then moved by alpha times the sum of the corrected
+// samples, which is the per-sample IIR decimated to the chunk rate.
+typedef struct sdrio_dc_state_t
+{
+    sdrio_float32 i;
+    sdrio_float32 q;
+    sdrio_float32 alpha;
+} sdrio_dc_state;
+
+typedef void (*sdrio_dc_correct_t)(sdrio_dc_state *state, sdrio_iq *samples, sdrio_uint32 num_samples);
+
+#define SDRIO_IQ_ALPHA 0.01f
+
+// IQ imbalance modelled as Q' = gain * (Q cos(phase) + I sin(phase)),
+// undone with the matrix [a b; c d] applied to (I', Q').  The kernels also
+// collect the second moments of their input; with estimate set these are
+// smoothed once per call (alpha) and the matrix is recomputed from them.
+typedef struct sdrio_iq_state_t
+{
+    sdrio_float32 a, b, c, d;
+
+    sdrio_float32 gain;
+    sdrio_float32 phase;
+
+    sdrio_uint8 estimate;
+    sdrio_float32 alpha;
+    sdrio_float32 ii, qq, iq;
+} sdrio_iq_state;
+
+typedef void (*sdrio_iq_correct_t)(sdrio_iq_state *state, sdrio_iq *samples, sdrio_uint32 num_samples);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    void sdrio_dc_init(sdrio_dc_state *state);
+
+    // Best kernel for this CPU.
+    sdrio_dc_correct_t sdrio_get_dc_correct();
+
+    void sdrio_dc_correct_scalar(sdrio_dc_state *state, sdrio_iq *samples, sdrio_uint32 num_samples);
+    void sdrio_dc_correct_sse2(sdrio_dc_state *state, sdrio_iq *samples, sdrio_uint32 num_samples);
+    void sdrio_dc_correct_avx2(sdrio_dc_state *state, sdrio_iq *samples, sdrio_uint32 num_samples);
+
+    void sdrio_iq_init(sdrio_iq_state *state);
+
+    // phase in radians.  gain 1, phase 0 is the identity.
+    void sdrio_iq_set(sdrio_iq_state *state, sdrio_float32 gain, sdrio_float32 phase);
+
+    sdrio_iq_correct_t sdrio_get_iq_correct();
+
+    void sdrio_iq_correct_scalar(sdrio_iq_state *state, sdrio_iq *samples, sdrio_uint32 num_samples);
+    void sdrio_iq_correct_sse2(sdrio_iq_state *state, sdrio_iq *samples, sdrio_uint32 num_samples);
+    void sdrio_iq_correct_avx2(sdrio_iq_state *state, sdrio_iq *samples, sdrio_uint32 num_samples);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SDRIO_CORRECT_H
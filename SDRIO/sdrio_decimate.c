@@ -0,0 +1,480 @@
+// Copyright Scott Cutler
+// This source file is licensed under the GNU Lesser General Public License (LGPL)
+
+#include <math.h>
+#include <string.h>
+
+#include <emmintrin.h>
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#define SDRIO_TARGET_AVX2
+#else
+#define SDRIO_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+#include "sdrio_decimate.h"
+#include "sdrio_convert.h"
+
+#define PI 3.14159265358979323846
+
+// Fraction of the output rate up to which the CIC droop is flattened.
+#define SDRIO_DECIMATE_PASSBAND 0.35
+
+sdrio_int32 sdrio_decimate_split(sdrio_uint32 factor, sdrio_uint32 *cic, sdrio_uint32 *halfbands)
+{
+    sdrio_uint32 h = 0;
+
+    if (!factor)
+    {
+        return 0;
+    }
+
+    // Two half-bands keep the CIC droop small; beyond that the CIC is
+    // cheaper per input sample, until it gets too long.
+    while (!(factor & 1) && ((h < 2) || (factor > SDRIO_CIC_MAX_FACTOR)))
+    {
+        factor >>= 1;
+        h++;
+    }
+
+    if ((factor > 1) && !h)
+    {
+        return 0;
+    }
+
+    if ((factor > SDRIO_CIC_MAX_FACTOR) || (h + (factor > 1) > SDRIO_DECIMATE_MAX_STAGES))
+    {
+        return 0;
+    }
+
+    *cic = factor;
+    *halfbands = h;
+    return 1;
+}
+
+static sdrio_uint8 rate_supported(sdrio_uint64 rate, const sdrio_uint32 *rates, sdrio_uint32 num_rates, sdrio_uint64 min_rate, sdrio_uint64 max_rate)
+{
+    sdrio_uint32 i;
+
+    for (i=0; i<num_rates; i++)
+    {
+        if (rates[i] == rate)
+        {
+            return 1;
+        }
+    }
+
+    return max_rate && (rate >= min_rate) && (rate <= max_rate);
+}
+
+sdrio_int32 sdrio_decimate_plan(sdrio_uint64 sample_rate, const sdrio_uint32 *rates, sdrio_uint32 num_rates, sdrio_uint64 min_rate, sdrio_uint64 max_rate, sdrio_uint64 *hw_rate, sdrio_uint32 *factor)
+{
+    sdrio_uint32 f, cic, halfbands;
+
+    if (!sample_rate)
+    {
+        return 0;
+    }
+
+    for (f=1; f<=SDRIO_DECIMATE_MAX_FACTOR; f++)
+    {
+        if (sdrio_decimate_split(f, &cic, &halfbands) && rate_supported(sample_rate * f, rates, num_rates, min_rate, max_rate))
+        {
+            *hw_rate = sample_rate * f;
+            *factor = f;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+// Generic layout: each tap duplicated for I and Q, zero padded to a multiple
+// of four samples.
+static sdrio_uint32 fir_padded(sdrio_uint32 span)
+{
+    return (span + 3) & ~3;
+}
+
+static void fir_taps(sdrio_fir_stage *stage, const double *h, sdrio_uint32 span)
+{
+    sdrio_uint32 k;
+
+    stage->span = span;
+    stage->num_taps = fir_padded(span);
+
+    memset(stage->taps, 0, stage->num_taps * 2 * sizeof(sdrio_float32));
+    for (k=0; k<span; k++)
+    {
+        stage->taps[2*k] = (sdrio_float32)h[k];
+        stage->taps[2*k + 1] = (sdrio_float32)h[k];
+    }
+}
+
+// Half-band layout: the even taps duplicated for I and Q, then the centre tap.
+// Every other tap of a half-band is zero and the kernel skips them.
+static void halfband_taps(sdrio_fir_stage *stage, const double *h, sdrio_uint32 span)
+{
+    sdrio_uint32 k;
+
+    stage->span = span;
+    stage->num_taps = span;
+
+    for (k=0; k<(span + 1) / 2; k++)
+    {
+        stage->taps[2*k] = (sdrio_float32)h[2*k];
+        stage->taps[2*k + 1] = (sdrio_float32)h[2*k];
+    }
+    stage->taps[span + 1] = (sdrio_float32)h[(span - 1) / 2];
+}
+
+static void design_cic(double *h, sdrio_uint32 factor)
+{
+    sdrio_uint32 len = 1;
+    sdrio_uint32 i, j, k;
+    double scale = 1.0;
+
+    h[0] = 1.0;
+    for (i=0; i<SDRIO_CIC_ORDER; i++)
+    {
+        // h = h * boxcar(factor), in place from the top
+        for (j=len + factor - 1; j-- > 0; )
+        {
+            double sum = 0.0;
+            for (k=0; k<factor; k++)
+            {
+                if ((j >= k) && (j - k < len))
+                {
+                    sum += h[j - k];
+                }
+            }
+            h[j] = sum;
+        }
+        len += factor - 1;
+        scale *= factor;
+    }
+
+    for (j=0; j<len; j++)
+    {
+        h[j] /= scale;
+    }
+}
+
+// Blackman windowed sinc with cutoff at a quarter of the input rate.
+static void design_halfband(double *h, sdrio_uint32 span)
+{
+    sdrio_int32 c = (span - 1) / 2;
+    sdrio_int32 n, m;
+    double sum = 0.0;
+
+    for (n=0; n<(sdrio_int32)span; n++)
+    {
+        m = n - c;
+        if (m == 0)
+        {
+            h[n] = 0.5;
+        }
+        else if (m & 1)
+        {
+            h[n] = sin(PI * m / 2) / (PI * m) * (0.42 - 0.5 * cos(2 * PI * n / (span - 1)) + 0.08 * cos(4 * PI * n / (span - 1)));
+        }
+        else
+        {
+            h[n] = 0.0;
+        }
+        sum += h[n];
+    }
+
+    for (n=0; n<(sdrio_int32)span; n++)
+    {
+        h[n] /= sum;
+    }
+}
+
+// Convolves the half-band with [-a, 1 + 2a, -a], with a chosen so the
+// product is flat at the passband edge.  The half-band runs at twice the
+// output rate; the CIC at factor times it.
+static void compensate(double *h, sdrio_uint32 span, sdrio_uint32 cic, sdrio_uint32 factor)
+{
+    double x = SDRIO_DECIMATE_PASSBAND / factor;
+    double droop = pow(fabs(sin(PI * x * cic) / (cic * sin(PI * x))), SDRIO_CIC_ORDER);
+    double a = (1.0 / droop - 1.0) / (2.0 * (1.0 - cos(PI * SDRIO_DECIMATE_PASSBAND)));
+    double p1 = 0.0, p2 = 0.0, cur;
+    sdrio_uint32 n;
+
+    h[span] = 0.0;
+    h[span + 1] = 0.0;
+
+    for (n=0; n<span + 2; n++)
+    {
+        cur = h[n];
+        h[n] = -a * cur + (1.0 + 2.0 * a) * p1 - a * p2;
+        p2 = p1;
+        p1 = cur;
+    }
+}
+
+static sdrio_uint32 stage_bytes(sdrio_uint32 span)
+{
+    sdrio_uint32 taps = (fir_padded(span) * 2 + 4) * sizeof(sdrio_float32);
+    sdrio_uint32 buffer = (SDRIO_DECIMATE_BUFFER + span + 4) * sizeof(sdrio_iq);
+
+    return ((taps + SDRIO_POOL_ALIGNMENT - 1) & ~(SDRIO_POOL_ALIGNMENT - 1)) + ((buffer + SDRIO_POOL_ALIGNMENT - 1) & ~(SDRIO_POOL_ALIGNMENT - 1));
+}
+
+static void stage_init(sdrio_fir_stage *stage, sdrio_uint8 **mem, sdrio_uint32 span, sdrio_uint32 factor)
+{
+    sdrio_uint32 taps = (fir_padded(span) * 2 + 4) * sizeof(sdrio_float32);
+
+    stage->taps = (sdrio_float32 *)*mem;
+    *mem += (taps + SDRIO_POOL_ALIGNMENT - 1) & ~(SDRIO_POOL_ALIGNMENT - 1);
+    stage->buffer = (sdrio_iq *)*mem;
+    *mem += ((SDRIO_DECIMATE_BUFFER + span + 4) * sizeof(sdrio_iq) + SDRIO_POOL_ALIGNMENT - 1) & ~(SDRIO_POOL_ALIGNMENT - 1);
+
+    stage->capacity = SDRIO_DECIMATE_BUFFER + span;
+    stage->factor = factor;
+    stage->fill = span - 1;
+    stage->next = span - 1;
+}
+
+sdrio_int32 sdrio_decimator_init(sdrio_decimator *dec, sdrio_uint32 factor)
+{
+    sdrio_uint32 features = sdrio_get_cpu_features();
+    sdrio_fir_kernel_t fir = (features & SDRIO_CPU_AVX2) ? sdrio_fir_avx2 : ((features & SDRIO_CPU_SSE2) ? sdrio_fir_sse2 : sdrio_fir_scalar);
+    sdrio_fir_kernel_t halfband = (features & SDRIO_CPU_SSE2) ? sdrio_halfband_sse2 : sdrio_halfband_scalar;
+    double h[SDRIO_CIC_ORDER * SDRIO_CIC_MAX_FACTOR + SDRIO_HALFBAND_TAPS];
+    sdrio_uint32 cic, halfbands, cic_span = 0;
+    sdrio_uint32 bytes, i;
+    sdrio_uint8 *mem;
+    sdrio_fir_stage *stage;
+
+    memset(dec, 0, sizeof(sdrio_decimator));
+
+    if (!sdrio_decimate_split(factor, &cic, &halfbands))
+    {
+        return 0;
+    }
+
+    dec->factor = 1;
+    if (factor == 1)
+    {
+        return 1;
+    }
+
+    bytes = halfbands * stage_bytes(SDRIO_HALFBAND_TAPS + 2);
+    if (cic > 1)
+    {
+        cic_span = SDRIO_CIC_ORDER * (cic - 1) + 1;
+        bytes += stage_bytes(cic_span);
+    }
+
+    if (!sdrio_pool_init(&dec->pool, 1, bytes, 0))
+    {
+        return 0;
+    }
+
+    mem = (sdrio_uint8 *)sdrio_pool_block(&dec->pool, 0);
+    memset(mem, 0, bytes);
+
+    if (cic > 1)
+    {
+        stage = &dec->stages[dec->num_stages++];
+        stage_init(stage, &mem, cic_span, cic);
+        design_cic(h, cic);
+        fir_taps(stage, h, cic_span);
+        stage->kernel = fir;
+    }
+
+    for (i=0; i<halfbands; i++)
+    {
+        stage = &dec->stages[dec->num_stages++];
+        design_halfband(h, SDRIO_HALFBAND_TAPS);
+
+        if ((i == halfbands - 1) && (cic > 1))
+        {
+            compensate(h, SDRIO_HALFBAND_TAPS, cic, factor);
+            stage_init(stage, &mem, SDRIO_HALFBAND_TAPS + 2, 2);
+            fir_taps(stage, h, SDRIO_HALFBAND_TAPS + 2);
+            stage->kernel = fir;
+        }
+        else
+        {
+            stage_init(stage, &mem, SDRIO_HALFBAND_TAPS, 2);
+            halfband_taps(stage, h, SDRIO_HALFBAND_TAPS);
+            stage->kernel = halfband;
+        }
+    }
+
+    dec->factor = factor;
+    return 1;
+}
+
+void sdrio_decimator_free(sdrio_decimator *dec)
+{
+    sdrio_pool_free(&dec->pool);
+    dec->num_stages = 0;
+    dec->factor = 1;
+}
+
+// Makes room for SDRIO_DECIMATE_MAX_INPUT more samples by dropping the ones
+// no future window needs.
+static sdrio_iq * stage_input(sdrio_fir_stage *stage)
+{
+    sdrio_uint32 shift;
+
+    if (stage->capacity - stage->fill < SDRIO_DECIMATE_MAX_INPUT)
+    {
+        shift = stage->next - (stage->span - 1);
+        memmove(stage->buffer, stage->buffer + shift, (stage->fill - shift) * sizeof(sdrio_iq));
+        stage->fill -= shift;
+        stage->next -= shift;
+    }
+
+    return stage->buffer + stage->fill;
+}
+
+static sdrio_uint32 stage_run(sdrio_fir_stage *stage, sdrio_iq *out)
+{
+    sdrio_uint32 num_out;
+
+    if (stage->next >= stage->fill)
+    {
+        return 0;
+    }
+
+    num_out = (stage->fill - 1 - stage->next) / stage->factor + 1;
+    stage->kernel(stage->taps, stage->num_taps, stage->buffer + stage->next - (stage->span - 1), stage->factor, num_out, out);
+    stage->next += num_out * stage->factor;
+
+    return num_out;
+}
+
+sdrio_iq * sdrio_decimator_input(sdrio_decimator *dec)
+{
+    return stage_input(&dec->stages[0]);
+}
+
+sdrio_uint32 sdrio_decimator_process(sdrio_decimator *dec, sdrio_uint32 num_samples, sdrio_iq *out)
+{
+    sdrio_uint32 i;
+    sdrio_iq *dst;
+
+    for (i=0; i<dec->num_stages; i++)
+    {
+        dec->stages[i].fill += num_samples;
+        dst = (i + 1 < dec->num_stages) ? stage_input(&dec->stages[i + 1]) : out;
+        num_samples = stage_run(&dec->stages[i], dst);
+    }
+
+    return num_samples;
+}
+
+void sdrio_fir_scalar(const sdrio_float32 *taps, sdrio_uint32 num_taps, const sdrio_iq *in, sdrio_uint32 step, sdrio_uint32 num_out, sdrio_iq *out)
+{
+    sdrio_float32 i, q;
+    sdrio_uint32 j, k;
+
+    for (j=0; j<num_out; j++, in += step)
+    {
+        i = 0.0f;
+        q = 0.0f;
+        for (k=0; k<num_taps; k++)
+        {
+            i += taps[2*k] * in[k].i;
+            q += taps[2*k] * in[k].q;
+        }
+        out[j].i = i;
+        out[j].q = q;
+    }
+}
+
+void sdrio_fir_sse2(const sdrio_float32 *taps, sdrio_uint32 num_taps, const sdrio_iq *in, sdrio_uint32 step, sdrio_uint32 num_out, sdrio_iq *out)
+{
+    sdrio_uint32 j, k;
+
+    for (j=0; j<num_out; j++, in += step)
+    {
+        const float *x = (const float *)in;
+        __m128 acc0 = _mm_setzero_ps();
+        __m128 acc1 = _mm_setzero_ps();
+
+        for (k=0; k<num_taps*2; k+=8)
+        {
+            acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(x + k), _mm_load_ps(taps + k)));
+            acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(x + k + 4), _mm_load_ps(taps + k + 4)));
+        }
+
+        acc0 = _mm_add_ps(acc0, acc1);
+        acc0 = _mm_add_ps(acc0, _mm_movehl_ps(acc0, acc0));
+        _mm_storel_pi((__m64 *)&out[j], acc0);
+    }
+}
+
+SDRIO_TARGET_AVX2 void sdrio_fir_avx2(const sdrio_float32 *taps, sdrio_uint32 num_taps, const sdrio_iq *in, sdrio_uint32 step, sdrio_uint32 num_out, sdrio_iq *out)
+{
+    sdrio_uint32 j, k;
+
+    for (j=0; j<num_out; j++, in += step)
+    {
+        const float *x = (const float *)in;
+        __m256 acc = _mm256_setzero_ps();
+        __m128 sum;
+
+        for (k=0; k<num_taps*2; k+=8)
+        {
+            acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(x + k), _mm256_load_ps(taps + k)));
+        }
+
+        sum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+        sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+        _mm_storel_pi((__m64 *)&out[j], sum);
+    }
+
+    _mm256_zeroupper();
+}
+
+void sdrio_halfband_scalar(const sdrio_float32 *taps, sdrio_uint32 num_taps, const sdrio_iq *in, sdrio_uint32 step, sdrio_uint32 num_out, sdrio_iq *out)
+{
+    sdrio_uint32 even = (num_taps + 1) / 2;
+    sdrio_uint32 centre = (num_taps - 1) / 2;
+    sdrio_float32 i, q;
+    sdrio_uint32 j, k;
+
+    for (j=0; j<num_out; j++, in += step)
+    {
+        i = taps[2*even] * in[centre].i;
+        q = taps[2*even] * in[centre].q;
+        for (k=0; k<even; k++)
+        {
+            i += taps[2*k] * in[2*k].i;
+            q += taps[2*k] * in[2*k].q;
+        }
+        out[j].i = i;
+        out[j].q = q;
+    }
+}
+
+void sdrio_halfband_sse2(const sdrio_float32 *taps, sdrio_uint32 num_taps, const sdrio_iq *in, sdrio_uint32 step, sdrio_uint32 num_out, sdrio_iq *out)
+{
+    sdrio_uint32 even = (num_taps + 1) / 2;
+    sdrio_uint32 centre = (num_taps - 1) / 2;
+    __m128 c = _mm_set1_ps(taps[2*even]);
+    sdrio_uint32 j, k;
+
+    for (j=0; j<num_out; j++, in += step)
+    {
+        // Pairs samples 2k and 2k+2, which share a vector of taps.
+        __m128 acc = _mm_mul_ps(c, _mm_loadl_pi(_mm_setzero_ps(), (const __m64 *)&in[centre]));
+
+        for (k=0; k<even; k+=2)
+        {
+            __m128 v = _mm_loadl_pi(_mm_setzero_ps(), (const __m64 *)&in[2*k]);
+            v = _mm_loadh_pi(v, (const __m64 *)&in[2*k + 2]);
+            acc = _mm_add_ps(acc, _mm_mul_ps(v, _mm_load_ps(taps + 2*k)));
+        }
+
+        acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+        _mm_storel_pi((__m64 *)&out[j], acc);
+    }
+}
@@ -0,0 +1,84 @@
+// Copyright Scott Cutler
+// This source file is licensed under the GNU Lesser General Public License (LGPL)
+
+#ifndef SDRIO_DECIMATE_H
+#define SDRIO_DECIMATE_H
+
+#include "sdrio_ext.h"
+#include "sdrio_pool.h"
+
+#define SDRIO_CIC_ORDER 4
+#define SDRIO_CIC_MAX_FACTOR 64
+#define SDRIO_HALFBAND_TAPS 47              // 4k+3, so the even taps pair up
+#define SDRIO_DECIMATE_MAX_STAGES 8
+#define SDRIO_DECIMATE_MAX_FACTOR (SDRIO_CIC_MAX_FACTOR << (SDRIO_DECIMATE_MAX_STAGES - 1))
+#define SDRIO_DECIMATE_MAX_INPUT 256        // most samples fed to one process call
+#define SDRIO_DECIMATE_BUFFER 4096
+
+// Computes num_out outputs; output j uses the window starting at in + j * step.
+typedef void (*sdrio_fir_kernel_t)(const sdrio_float32 *taps, sdrio_uint32 num_taps, const sdrio_iq *in, sdrio_uint32 step, sdrio_uint32 num_out, sdrio_iq *out);
+
+// One decimating FIR.  Input is appended to buffer; windows ending at next,
+// next + factor, ... are filtered once their last sample has arrived.
+typedef struct sdrio_fir_stage_t
+{
+    sdrio_fir_kernel_t kernel;
+    sdrio_float32 *taps;        // layout depends on the kernel
+    sdrio_uint32 num_taps;      // as passed to the kernel
+    sdrio_uint32 span;          // window length in samples
+    sdrio_uint32 factor;
+
+    sdrio_iq *buffer;
+    sdrio_uint32 capacity;
+    sdrio_uint32 fill;
+    sdrio_uint32 next;
+} sdrio_fir_stage;
+
+// Integer decimation as an order SDRIO_CIC_ORDER CIC followed by a chain of
+// half-band filters, the last of which also flattens the CIC droop.  The CIC
+// runs in its non-recursive form, an FIR whose taps are a boxcar convolved
+// with itself, because float integrators drift.
+typedef struct sdrio_decimator_t
+{
+    sdrio_uint32 factor;
+    sdrio_uint32 num_stages;
+    sdrio_fir_stage stages[SDRIO_DECIMATE_MAX_STAGES];
+    sdrio_pool pool;
+} sdrio_decimator;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    // Splits factor into a CIC factor and a number of half-band stages.
+    // Valid factors are 1 and cic << halfbands with halfbands >= 1.
+    sdrio_int32 sdrio_decimate_split(sdrio_uint32 factor, sdrio_uint32 *cic, sdrio_uint32 *halfbands);
+
+    // Picks the lowest hardware rate the decimator can turn into sample_rate
+    // exactly.  rates are the discrete rates the hardware supports and
+    // min_rate..max_rate a continuous range it also accepts (both 0 if none).
+    sdrio_int32 sdrio_decimate_plan(sdrio_uint64 sample_rate, const sdrio_uint32 *rates, sdrio_uint32 num_rates, sdrio_uint64 min_rate, sdrio_uint64 max_rate, sdrio_uint64 *hw_rate, sdrio_uint32 *factor);
+
+    // On failure, and after free, factor is 1 and there are no stages.
+    sdrio_int32 sdrio_decimator_init(sdrio_decimator *dec, sdrio_uint32 factor);
+    void sdrio_decimator_free(sdrio_decimator *dec);
+
+    // Where to write the next (at most SDRIO_DECIMATE_MAX_INPUT) samples.
+    sdrio_iq * sdrio_decimator_input(sdrio_decimator *dec);
+
+    // Filters num_samples just written at sdrio_decimator_input and returns
+    // the number of outputs stored to out.
+    sdrio_uint32 sdrio_decimator_process(sdrio_decimator *dec, sdrio_uint32 num_samples, sdrio_iq *out);
+
+    void sdrio_fir_scalar(const sdrio_float32 *taps, sdrio_uint32 num_taps, const sdrio_iq *in, sdrio_uint32 step, sdrio_uint32 num_out, sdrio_iq *out);
+    void sdrio_fir_sse2(const sdrio_float32 *taps, sdrio_uint32 num_taps, const sdrio_iq *in, sdrio_uint32 step, sdrio_uint32 num_out, sdrio_iq *out);
+    void sdrio_fir_avx2(const sdrio_float32 *taps, sdrio_uint32 num_taps, const sdrio_iq *in, sdrio_uint32 step, sdrio_uint32 num_out, sdrio_iq *out);
+
+    void sdrio_halfband_scalar(const sdrio_float32 *taps, sdrio_uint32 num_taps, const sdrio_iq *in, sdrio_uint32 step, sdrio_uint32 num_out, sdrio_iq *out);
+    void sdrio_halfband_sse2(const sdrio_float32 *taps, sdrio_uint32 num_taps, const sdrio_iq *in, sdrio_uint32 step, sdrio_uint32 num_out, sdrio_iq *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SDRIO_DECIMATE_H
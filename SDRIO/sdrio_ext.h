@@ -1,6 +1,9 @@
 // Copyright Scott Cutler
 // This source file is licensed under the GNU Lesser General Public License (LGPL)
 
+#ifndef SDRIO_EXT_H
+#define SDRIO_EXT_H
+
 typedef unsigned char sdrio_uint8;
 typedef char sdrio_int8;
 
@@ -32,15 +35,128 @@ typedef enum
     sdrio_caps_agc
 } sdrio_caps;
 
+typedef enum
+{
+    sdrio_sample_format_cu8,        // unsigned 8 bit I/Q, offset binary (RTL-SDR)
+    sdrio_sample_format_cs8,        // signed 8 bit I/Q (hackRF)
+    sdrio_sample_format_cs16,       // signed 16 bit I/Q (Mirics, FUNcube)
+    sdrio_sample_format_sc16q12,    // signed 12 bit I/Q in 16 bit containers, sign extend from bit 11 (bladeRF)
+    sdrio_sample_format_cf32        // 32 bit float I/Q, same layout as sdrio_iq
+} sdrio_sample_format;
+
+// Describes a buffer of raw samples.  To get the same values as the
+// float32 API, compute (x - offset) * scale for each I and Q component.
+typedef struct sdrio_format_desc_t
+{
+    sdrio_sample_format format;
+    sdrio_uint32 bytes_per_sample;  // size of one I/Q pair
+    sdrio_float32 offset;
+    sdrio_float32 scale;
+} sdrio_format_desc;
+
 typedef struct sdrio_iq_t
 {
     sdrio_float32 i;
     sdrio_float32 q;
 } sdrio_iq;
 
+typedef enum
+{
+    sdrio_window_rectangular,
+    sdrio_window_hann,
+    sdrio_window_blackman_harris,   // 4 term, -92 dB sidelobes
+    sdrio_window_flattop            // for reading tone levels off the bins
+} sdrio_window;
+
+// Flags in sdrio_rx_meta.
+#define SDRIO_RX_META_OVERRUN        0x1    // blocks were dropped because the callback fell behind
+#define SDRIO_RX_META_DISCONTINUITY  0x2    // the hardware or its driver lost samples
+
+// Describes the block being delivered to a receive callback.
+//
+// sample_counter is only approximate while decimating or resampling: it is
+// where the hardware chunk the block was filtered out of starts, so it runs
+// ahead of the block's first sample by the filters' delay plus whatever they
+// held over from earlier chunks.
+typedef struct sdrio_rx_meta_t
+{
+    sdrio_uint64 sample_counter;    // hardware rate samples since start, up to this block's first
+    sdrio_float64 timestamp;        // sdrio_clock_now when the driver handed the block over
+    sdrio_uint32 flags;             // SDRIO_RX_META_*, for the gap just before this block
+    sdrio_uint32 lost;              // hardware rate samples missing in that gap
+    sdrio_uint64 frequency;         // RF the block was captured at, 0 if unknown
+    sdrio_float32 gain;             // last gain set with sdrio_set_rx_gain
+} sdrio_rx_meta;
+
+// Receive statistics since the last start.
+typedef struct sdrio_stats_t
+{
+    sdrio_uint64 samples_delivered;     // to the callback, at the delivered rate
+    sdrio_uint64 transfers_completed;   // blocks handed over by the driver
+    sdrio_uint64 transfers_failed;      // where the driver reports them
+    sdrio_uint64 samples_lost;          // hardware rate samples that never reached the callback
+    sdrio_uint64 overruns;              // blocks dropped because the callback fell behind
+    sdrio_uint32 queue_high_water;      // most blocks waiting for the callback at once
+    sdrio_uint32 queue_depth;
+    sdrio_uint64 callbacks;
+    sdrio_float64 callback_min;         // seconds spent in the callback
+    sdrio_float64 callback_avg;
+    sdrio_float64 callback_max;
+} sdrio_stats;
+
+typedef enum
+{
+    sdrio_histogram_latency,        // driver handing a block over to the callback starting on it
+    sdrio_histogram_duration,       // time spent in the callback
+    sdrio_histogram_interval        // callback start to the next callback start
+} sdrio_histogram_kind;
+
+// Log bucketed times in nanoseconds: exact below 8, then 8 buckets per
+// power of two, so any value is within 12.5% of its bucket's lower bound.
+// The last bucket also counts everything above about a minute.
+#define SDRIO_HISTOGRAM_BUCKETS 272
+#define SDRIO_HISTOGRAM_BUCKET_LOW(b) ((b) < 8 ? (sdrio_uint64)(b) : (sdrio_uint64)(8 + ((b) & 7)) << ((b) / 8 - 1))
+
+typedef struct sdrio_histogram_t
+{
+    sdrio_uint64 count;
+    sdrio_uint64 min;               // nanoseconds
+    sdrio_uint64 max;
+    sdrio_uint64 total;
+    sdrio_uint32 buckets[SDRIO_HISTOGRAM_BUCKETS];
+} sdrio_histogram;
+
+// Since the last sdrio_start_rx_recording.
+typedef struct sdrio_recording_stats_t
+{
+    sdrio_uint64 samples_written;   // to the data file
+    sdrio_uint64 samples_dropped;   // arrived while both buffers were waiting on the disk
+    sdrio_uint32 captures;          // segments in the metadata, one per retune, gain change or gap
+    sdrio_uint8 recording;
+    sdrio_uint8 unbuffered;         // written around the OS cache (O_DIRECT, FILE_FLAG_NO_BUFFERING)
+    sdrio_uint8 failed;             // a write failed and the recording stopped
+} sdrio_recording_stats;
+
+// Since the last sdrio_start_rx_pretrigger.
+typedef struct sdrio_pretrigger_stats_t
+{
+    sdrio_uint32 triggers;          // taken, each one a capture
+    sdrio_uint32 missed;            // came while a capture was still being written
+    sdrio_uint32 written;           // captures on disk
+    sdrio_uint32 failed;            // captures that couldn't be written
+    sdrio_uint64 samples_held;      // history in memory now
+    sdrio_uint8 armed;
+    sdrio_uint8 writing;            // a capture is being written; the history is frozen
+} sdrio_pretrigger_stats;
+
 typedef sdrio_int32 (*sdrio_rx_async_callback)(void *context, sdrio_iq *samples, sdrio_uint32 length);
+typedef sdrio_int32 (*sdrio_rx_native_callback)(void *context, const void *samples, sdrio_uint32 length, const sdrio_format_desc *format);
 typedef sdrio_int32 (*sdrio_tx_async_callback)(void *context, sdrio_iq *samples, sdrio_uint32 length);
 
+// power is size bins in dB relative to a full scale tone, negative
+// frequencies first, so bin size / 2 is the centre frequency.
+typedef sdrio_int32 (*sdrio_rx_spectrum_callback)(void *context, const sdrio_float32 *power, sdrio_uint32 size);
+
 #define SDRIOEXPORT __declspec(dllexport)
 
 typedef sdrio_int32 (*sdrio_init_t)();
@@ -52,6 +168,10 @@ typedef sdrio_int32 (*sdrio_close_device_t)(sdrio_device *dev);
 
 typedef const char * (*sdrio_get_device_string_t)(sdrio_device *dev);
 
+// Rates the hardware can't run at directly are reached by running it at an
+// integer multiple and decimating, or failing that by decimating and then
+// resampling by a rational factor; both need float32 output.
+// sdrio_get_rx_samplerate returns the rate delivered to the callback.
 typedef sdrio_int32 (*sdrio_set_rx_samplerate_t)(sdrio_device *dev, sdrio_uint64 sample_rate);
 typedef sdrio_int32 (*sdrio_set_rx_frequency_t)(sdrio_device *dev, sdrio_uint64 frequency);
 
@@ -61,6 +181,90 @@ typedef sdrio_int32 (*sdrio_set_tx_frequency_t)(sdrio_device *dev, sdrio_uint64
 typedef sdrio_int32 (*sdrio_start_rx_t)(sdrio_device *dev, sdrio_rx_async_callback callback, void *context);
 typedef sdrio_int32 (*sdrio_stop_rx_t)(sdrio_device *dev);
 
+// Optional: delivers the hardware's own sample buffers without conversion.
+// Stop with sdrio_stop_rx.
+typedef sdrio_int32 (*sdrio_start_rx_native_t)(sdrio_device *dev, sdrio_rx_native_callback callback, void *context);
+
+// Optional: converts to cf32, cs16 or cs8 (or leaves the hardware format
+// alone) before delivery.  The callback's format describes the converted
+// samples.  Stop with sdrio_stop_rx.
+typedef sdrio_int32 (*sdrio_start_rx_format_t)(sdrio_device *dev, sdrio_sample_format format, sdrio_rx_native_callback callback, void *context);
+
+// Optional: number of blocks buffered between the driver and the callback,
+// which then runs on its own thread.  0 calls back on the driver's thread.
+// Takes effect on the next start.
+typedef sdrio_int32 (*sdrio_set_rx_queue_depth_t)(sdrio_device *dev, sdrio_uint32 depth);
+
+// Optional: back the receive buffers with large pages when the OS allows.
+// Takes effect on the next start.
+typedef sdrio_int32 (*sdrio_set_rx_huge_pages_t)(sdrio_device *dev, sdrio_uint8 enable);
+
+// Optional: removes the DC offset (LO leakage) from float32 receive data as
+// part of the conversion.  Can be changed while running.
+typedef sdrio_int32 (*sdrio_set_rx_dc_correction_t)(sdrio_device *dev, sdrio_uint8 enable);
+
+// Optional: corrects IQ gain and phase (radians) imbalance in float32 receive
+// data, modelled as Q' = gain * (Q cos(phase) + I sin(phase)).  Gain 1 and
+// phase 0 turn it off.  Can be changed while running.
+typedef sdrio_int32 (*sdrio_set_rx_iq_correction_t)(sdrio_device *dev, sdrio_float32 gain, sdrio_float32 phase);
+
+// Optional: estimates the IQ correction blindly from the signal statistics.
+// sdrio_get_rx_iq_correction returns the current estimate.
+typedef sdrio_int32 (*sdrio_set_rx_iq_auto_correction_t)(sdrio_device *dev, sdrio_uint8 enable);
+typedef sdrio_int32 (*sdrio_get_rx_iq_correction_t)(sdrio_device *dev, sdrio_float32 *gain, sdrio_float32 *phase);
+
+// Optional: averaged power spectra of the float32 receive stream, computed on
+// a thread of their own and delivered to a separate callback, one per
+// averages FFTs.  size is a power of two; consecutive FFTs share overlap
+// samples.  FFTs the thread can't keep up with are skipped.  Size 0 turns it
+// off.  Takes effect on the next start.
+typedef sdrio_int32 (*sdrio_set_rx_spectrum_t)(sdrio_device *dev, sdrio_uint32 size, sdrio_window window, sdrio_uint32 overlap, sdrio_uint32 averages, sdrio_rx_spectrum_callback callback, void *context);
+
+// Optional: can be called from any thread while receiving, and costs the
+// receive path nothing but a few counter updates per block.
+typedef sdrio_int32 (*sdrio_get_stats_t)(sdrio_device *dev, sdrio_stats *stats);
+
+// Optional: histograms of callback latency, duration and interval, for
+// showing the callback is reached within a bound.  Off by default; turning
+// them on costs a few integer operations per block on top of the stats.
+// Cleared on each start.  sdrio_write_rx_histograms writes all three to a
+// text file, with percentiles, for plotting.
+typedef sdrio_int32 (*sdrio_set_rx_histograms_t)(sdrio_device *dev, sdrio_uint8 enable);
+typedef sdrio_int32 (*sdrio_get_rx_histogram_t)(sdrio_device *dev, sdrio_histogram_kind kind, sdrio_histogram *histogram);
+typedef sdrio_int32 (*sdrio_write_rx_histograms_t)(sdrio_device *dev, const char *path);
+
+// Optional: records the receive stream to path.sigmf-data, with SigMF
+// metadata in path.sigmf-meta giving the sample rate, and the frequency and
+// gain from each retune or gain change on.  native records blocks as the
+// hardware delivered them, otherwise whatever reaches the callback.  A
+// writer thread does the disk I/O in large aligned writes; the receive path
+// only copies into one of two buffers, and samples that arrive while both
+// are waiting on the disk are dropped rather than held up.  Only while
+// receiving: sdrio_stop_rx stops the recording too.
+typedef sdrio_int32 (*sdrio_start_rx_recording_t)(sdrio_device *dev, const char *path, sdrio_uint8 native);
+typedef sdrio_int32 (*sdrio_stop_rx_recording_t)(sdrio_device *dev);
+typedef sdrio_int32 (*sdrio_get_rx_recording_stats_t)(sdrio_device *dev, sdrio_recording_stats *stats);
+
+// Optional: pre-trigger capture for burst monitoring.  Keeps the last
+// pre_seconds of the receive stream in memory, as the hardware delivered it,
+// and when triggered writes those and the following post_seconds to
+// path_NNNN.sigmf-data and .sigmf-meta, numbered from 1, with the trigger
+// annotated.  The history is frozen while a capture is written out on a
+// background thread and builds up again afterwards; sdrio_trigger_rx calls
+// in the meantime are counted as missed.  Only while receiving: sdrio_stop_rx
+// finishes any capture under way and disarms.
+//
+// sdrio_trigger_rx can be called from any thread, a spectrum callback
+// matching what it is looking for included: it only raises a flag the
+// driver thread picks up at the next block.  The power trigger fires on the
+// first window samples long whose mean power reaches threshold dBFS;
+// window 0 turns it off.  Both can be changed while armed.
+typedef sdrio_int32 (*sdrio_start_rx_pretrigger_t)(sdrio_device *dev, const char *path, sdrio_float64 pre_seconds, sdrio_float64 post_seconds);
+typedef sdrio_int32 (*sdrio_stop_rx_pretrigger_t)(sdrio_device *dev);
+typedef sdrio_int32 (*sdrio_set_rx_trigger_power_t)(sdrio_device *dev, sdrio_float32 threshold, sdrio_uint32 window);
+typedef sdrio_int32 (*sdrio_trigger_rx_t)(sdrio_device *dev);
+typedef sdrio_int32 (*sdrio_get_rx_pretrigger_stats_t)(sdrio_device *dev, sdrio_pretrigger_stats *stats);
+
 typedef sdrio_int32 (*sdrio_start_tx_t)(sdrio_device *dev, sdrio_tx_async_callback callback, void *context);
 typedef sdrio_int32 (*sdrio_stop_tx_t)(sdrio_device *dev);
 
@@ -70,6 +274,18 @@ typedef void        (*sdrio_get_samplerates_t)(sdrio_device *dev, sdrio_uint32 *
 typedef sdrio_int64 (*sdrio_get_rx_frequency_t)(sdrio_device *dev);
 typedef sdrio_int64 (*sdrio_get_rx_samplerate_t)(sdrio_device *dev);
 
+// Optional: only valid inside the receive callback.  Returns the frequency
+// the block being delivered was captured at (0 if unknown), which lags
+// sdrio_get_rx_frequency while blocks from before a retune drain.
+typedef sdrio_int64 (*sdrio_get_rx_block_frequency_t)(sdrio_device *dev);
+
+// Optional: only valid inside the receive callback.  Fills in meta for the
+// block being delivered.  sample_counter counts at the hardware rate
+// whatever the delivered rate, and keeps counting through gaps, so the
+// difference between two blocks is the time between them in hardware
+// samples.
+typedef sdrio_int32 (*sdrio_get_rx_block_meta_t)(sdrio_device *dev, sdrio_rx_meta *meta);
+
 typedef sdrio_int64 (*sdrio_get_tx_frequency_t)(sdrio_device *dev);
 typedef sdrio_int64 (*sdrio_get_tx_samplerate_t)(sdrio_device *dev);
 
@@ -105,6 +321,28 @@ extern "C" {
     SDRIOEXPORT sdrio_int32 sdrio_start_rx(sdrio_device *dev, sdrio_rx_async_callback callback, void *context);
     SDRIOEXPORT sdrio_int32 sdrio_stop_rx(sdrio_device *dev);
 
+    SDRIOEXPORT sdrio_int32 sdrio_start_rx_native(sdrio_device *dev, sdrio_rx_native_callback callback, void *context);
+    SDRIOEXPORT sdrio_int32 sdrio_start_rx_format(sdrio_device *dev, sdrio_sample_format format, sdrio_rx_native_callback callback, void *context);
+    SDRIOEXPORT sdrio_int32 sdrio_set_rx_queue_depth(sdrio_device *dev, sdrio_uint32 depth);
+    SDRIOEXPORT sdrio_int32 sdrio_set_rx_huge_pages(sdrio_device *dev, sdrio_uint8 enable);
+    SDRIOEXPORT sdrio_int32 sdrio_set_rx_dc_correction(sdrio_device *dev, sdrio_uint8 enable);
+    SDRIOEXPORT sdrio_int32 sdrio_set_rx_iq_correction(sdrio_device *dev, sdrio_float32 gain, sdrio_float32 phase);
+    SDRIOEXPORT sdrio_int32 sdrio_set_rx_iq_auto_correction(sdrio_device *dev, sdrio_uint8 enable);
+    SDRIOEXPORT sdrio_int32 sdrio_get_rx_iq_correction(sdrio_device *dev, sdrio_float32 *gain, sdrio_float32 *phase);
+    SDRIOEXPORT sdrio_int32 sdrio_set_rx_spectrum(sdrio_device *dev, sdrio_uint32 size, sdrio_window window, sdrio_uint32 overlap, sdrio_uint32 averages, sdrio_rx_spectrum_callback callback, void *context);
+    SDRIOEXPORT sdrio_int32 sdrio_get_stats(sdrio_device *dev, sdrio_stats *stats);
+    SDRIOEXPORT sdrio_int32 sdrio_set_rx_histograms(sdrio_device *dev, sdrio_uint8 enable);
+    SDRIOEXPORT sdrio_int32 sdrio_get_rx_histogram(sdrio_device *dev, sdrio_histogram_kind kind, sdrio_histogram *histogram);
+    SDRIOEXPORT sdrio_int32 sdrio_write_rx_histograms(sdrio_device *dev, const char *path);
+    SDRIOEXPORT sdrio_int32 sdrio_start_rx_recording(sdrio_device *dev, const char *path, sdrio_uint8 native);
+    SDRIOEXPORT sdrio_int32 sdrio_stop_rx_recording(sdrio_device *dev);
+    SDRIOEXPORT sdrio_int32 sdrio_get_rx_recording_stats(sdrio_device *dev, sdrio_recording_stats *stats);
+    SDRIOEXPORT sdrio_int32 sdrio_start_rx_pretrigger(sdrio_device *dev, const char *path, sdrio_float64 pre_seconds, sdrio_float64 post_seconds);
+    SDRIOEXPORT sdrio_int32 sdrio_stop_rx_pretrigger(sdrio_device *dev);
+    SDRIOEXPORT sdrio_int32 sdrio_set_rx_trigger_power(sdrio_device *dev, sdrio_float32 threshold, sdrio_uint32 window);
+    SDRIOEXPORT sdrio_int32 sdrio_trigger_rx(sdrio_device *dev);
+    SDRIOEXPORT sdrio_int32 sdrio_get_rx_pretrigger_stats(sdrio_device *dev, sdrio_pretrigger_stats *stats);
+
     SDRIOEXPORT sdrio_int32 sdrio_start_tx(sdrio_device *dev, sdrio_tx_async_callback callback, void *context);
     SDRIOEXPORT sdrio_int32 sdrio_stop_tx(sdrio_device *dev);
 
@@ -113,6 +351,8 @@ extern "C" {
 
     SDRIOEXPORT sdrio_int64 sdrio_get_rx_frequency(sdrio_device *dev);
     SDRIOEXPORT sdrio_int64 sdrio_get_rx_samplerate(sdrio_device *dev);
+    SDRIOEXPORT sdrio_int64 sdrio_get_rx_block_frequency(sdrio_device *dev);
+    SDRIOEXPORT sdrio_int32 sdrio_get_rx_block_meta(sdrio_device *dev, sdrio_rx_meta *meta);
 
     SDRIOEXPORT sdrio_int64 sdrio_get_tx_frequency(sdrio_device *dev);
     SDRIOEXPORT sdrio_int64 sdrio_get_tx_samplerate(sdrio_device *dev);
@@ -130,3 +370,5 @@ extern "C" {
 #ifdef __cplusplus
 }
 #endif
+
+#endif // SDRIO_EXT_H
@@ -0,0 +1,165 @@
+// Copyright Scott Cutler
+// This source file is licensed under the GNU Lesser General Public License (LGPL)
+
+#include <math.h>
+#include <string.h>
+
+#include <emmintrin.h>
+
+#include "sdrio_fft.h"
+#include "sdrio_convert.h"
+
+#define PI 3.14159265358979323846
+
+sdrio_int32 sdrio_fft_init(sdrio_fft *fft, sdrio_uint32 size)
+{
+    sdrio_uint32 twiddle_bytes, bits = 0;
+    sdrio_uint32 half, i, j, r;
+    sdrio_iq *w;
+
+    memset(fft, 0, sizeof(sdrio_fft));
+
+    if ((size < 2) || (size & (size - 1)))
+    {
+        return 0;
+    }
+
+    while ((1UL << bits) < size)
+    {
+        bits++;
+    }
+
+    twiddle_bytes = (size * sizeof(sdrio_iq) + SDRIO_POOL_ALIGNMENT - 1) & ~(SDRIO_POOL_ALIGNMENT - 1);
+    if (!sdrio_pool_init(&fft->pool, 1, twiddle_bytes + size * sizeof(sdrio_uint32), 0))
+    {
+        return 0;
+    }
+
+    fft->size = size;
+    fft->twiddle = (sdrio_iq *)sdrio_pool_block(&fft->pool, 0);
+    fft->bitrev = (sdrio_uint32 *)((sdrio_uint8 *)fft->twiddle + twiddle_bytes);
+
+    for (half=1; half<size; half<<=1)
+    {
+        w = fft->twiddle + half - 1;
+        for (j=0; j<half; j++)
+        {
+            w[j].i = (sdrio_float32)cos(-PI * j / half);
+            w[j].q = (sdrio_float32)sin(-PI * j / half);
+        }
+    }
+
+    for (i=0; i<size; i++)
+    {
+        r = 0;
+        for (j=0; j<bits; j++)
+        {
+            r |= ((i >> j) & 1) << (bits - 1 - j);
+        }
+        fft->bitrev[i] = r;
+    }
+
+    fft->kernel = (sdrio_get_cpu_features() & SDRIO_CPU_SSE2) ? sdrio_fft_sse2 : sdrio_fft_scalar;
+
+    return 1;
+}
+
+void sdrio_fft_free(sdrio_fft *fft)
+{
+    sdrio_pool_free(&fft->pool);
+    fft->size = 0;
+}
+
+void sdrio_fft_forward(const sdrio_fft *fft, sdrio_iq *data)
+{
+    fft->kernel(fft, data);
+}
+
+static void permute(const sdrio_fft *fft, sdrio_iq *data)
+{
+    sdrio_uint32 i, j;
+    sdrio_iq t;
+
+    for (i=0; i<fft->size; i++)
+    {
+        j = fft->bitrev[i];
+        if (i < j)
+        {
+            t = data[i];
+            data[i] = data[j];
+            data[j] = t;
+        }
+    }
+}
+
+void sdrio_fft_scalar(const sdrio_fft *fft, sdrio_iq *data)
+{
+    sdrio_uint32 half, start, j;
+    const sdrio_iq *w;
+    sdrio_iq *a, *b;
+    sdrio_float32 ti, tq;
+
+    permute(fft, data);
+
+    for (half=1; half<fft->size; half<<=1)
+    {
+        w = fft->twiddle + half - 1;
+        for (start=0; start<fft->size; start+=2*half)
+        {
+            a = data + start;
+            b = a + half;
+            for (j=0; j<half; j++)
+            {
+                ti = b[j].i * w[j].i - b[j].q * w[j].q;
+                tq = b[j].i * w[j].q + b[j].q * w[j].i;
+                b[j].i = a[j].i - ti;
+                b[j].q = a[j].q - tq;
+                a[j].i += ti;
+                a[j].q += tq;
+            }
+        }
+    }
+}
+
+void sdrio_fft_sse2(const sdrio_fft *fft, sdrio_iq *data)
+{
+    const __m128 sign = _mm_setr_ps(-1.0f, 1.0f, -1.0f, 1.0f);
+    sdrio_uint32 half, start, j;
+    const float *w;
+    float *a, *b;
+
+    permute(fft, data);
+
+    // First stage: twiddle is 1, two butterflies per pair of vectors.
+    for (start=0; start<fft->size; start+=2)
+    {
+        __m128 v = _mm_loadu_ps((float *)(data + start));
+        __m128 s = _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2));
+        // [b, a] + [a, -b] = [a + b, a - b]
+        v = _mm_add_ps(s, _mm_mul_ps(v, _mm_setr_ps(1.0f, 1.0f, -1.0f, -1.0f)));
+        _mm_storeu_ps((float *)(data + start), v);
+    }
+
+    for (half=2; half<fft->size; half<<=1)
+    {
+        w = (const float *)(fft->twiddle + half - 1);
+        for (start=0; start<fft->size; start+=2*half)
+        {
+            a = (float *)(data + start);
+            b = (float *)(data + start + half);
+            for (j=0; j<half*2; j+=4)
+            {
+                __m128 wv = _mm_loadu_ps(w + j);
+                __m128 bv = _mm_loadu_ps(b + j);
+                __m128 av = _mm_loadu_ps(a + j);
+                __m128 wr = _mm_shuffle_ps(wv, wv, _MM_SHUFFLE(2, 2, 0, 0));
+                __m128 wi = _mm_shuffle_ps(wv, wv, _MM_SHUFFLE(3, 3, 1, 1));
+                __m128 bs = _mm_shuffle_ps(bv, bv, _MM_SHUFFLE(2, 3, 0, 1));
+                __m128 t = _mm_add_ps(_mm_mul_ps(bv, wr), _mm_mul_ps(_mm_mul_ps(bs, wi), sign));
+
+                _mm_storeu_ps(a + j, _mm_add_ps(av, t));
+                _mm_storeu_ps(b + j, _mm_sub_ps(av, t));
+            }
+        }
+    }
+}
@@ -0,0 +1,41 @@
+// Copyright Scott Cutler
+// This source file is licensed under the GNU Lesser General Public License (LGPL)
+
+#ifndef SDRIO_FFT_H
+#define SDRIO_FFT_H
+
+#include "sdrio_ext.h"
+#include "sdrio_pool.h"
+
+struct sdrio_fft_t;
+typedef void (*sdrio_fft_kernel_t)(const struct sdrio_fft_t *fft, sdrio_iq *data);
+
+// In-place radix-2 FFT, X[k] = sum x[n] e^(-2 pi i k n / N).  Twiddles are
+// stored stage by stage so each butterfly pass reads them contiguously.
+typedef struct sdrio_fft_t
+{
+    sdrio_uint32 size;
+    sdrio_iq *twiddle;          // size - 1 entries: 1 for the first stage, 2 for the next, ...
+    sdrio_uint32 *bitrev;
+    sdrio_fft_kernel_t kernel;
+    sdrio_pool pool;
+} sdrio_fft;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    // size must be a power of two.
+    sdrio_int32 sdrio_fft_init(sdrio_fft *fft, sdrio_uint32 size);
+    void sdrio_fft_free(sdrio_fft *fft);
+
+    void sdrio_fft_forward(const sdrio_fft *fft, sdrio_iq *data);
+
+    void sdrio_fft_scalar(const sdrio_fft *fft, sdrio_iq *data);
+    void sdrio_fft_sse2(const sdrio_fft *fft, sdrio_iq *data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SDRIO_FFT_H
@@ -0,0 +1,132 @@
+// Copyright Scott Cutler
+// This source file is licensed under the GNU Lesser General Public License (LGPL)
+
+#include "sdrio_histogram.h"
+#include "sdrio_stats.h"
+
+static sdrio_uint32 highest_bit(sdrio_uint64 v)
+{
+    sdrio_uint32 n = 0;
+
+    while (v >>= 1)
+    {
+        n++;
+    }
+
+    return n;
+}
+
+void sdrio_histogram_reset(sdrio_histogram_state *state)
+{
+    sdrio_uint32 b;
+
+    sdrio_stats_store(&state->count, 0);
+    sdrio_stats_store(&state->min, 0);
+    sdrio_stats_store(&state->max, 0);
+    sdrio_stats_store(&state->total, 0);
+
+    for (b=0; b<SDRIO_HISTOGRAM_BUCKETS; b++)
+    {
+        state->buckets[b] = 0;
+    }
+}
+
+sdrio_uint32 sdrio_histogram_bucket(sdrio_uint64 ns)
+{
+    sdrio_uint32 e, b;
+
+    if (ns < 8)
+    {
+        return (sdrio_uint32)ns;
+    }
+
+    // The top three bits below the leading one pick the sub-bucket.
+    e = highest_bit(ns);
+    b = (e - 2) * 8 + (sdrio_uint32)((ns >> (e - 3)) & 7);
+
+    return (b < SDRIO_HISTOGRAM_BUCKETS) ? b : SDRIO_HISTOGRAM_BUCKETS - 1;
+}
+
+void sdrio_histogram_record(sdrio_histogram_state *state, sdrio_float64 seconds)
+{
+    sdrio_int64 ns = (seconds > 0.0) ? (sdrio_int64)(seconds * 1e9) : 0;
+
+    if (!sdrio_stats_load(&state->count) || (ns < sdrio_stats_load(&state->min)))
+    {
+        sdrio_stats_store(&state->min, ns);
+    }
+
+    sdrio_stats_raise(&state->max, ns);
+    sdrio_stats_add(&state->total, ns);
+    state->buckets[sdrio_histogram_bucket((sdrio_uint64)ns)]++;
+    sdrio_stats_add(&state->count, 1);
+}
+
+void sdrio_histogram_read(sdrio_histogram_state *state, sdrio_histogram *histogram)
+{
+    sdrio_uint32 b;
+
+    histogram->count = (sdrio_uint64)sdrio_stats_load(&state->count);
+    histogram->min = (sdrio_uint64)sdrio_stats_load(&state->min);
+    histogram->max = (sdrio_uint64)sdrio_stats_load(&state->max);
+    histogram->total = (sdrio_uint64)sdrio_stats_load(&state->total);
+
+    for (b=0; b<SDRIO_HISTOGRAM_BUCKETS; b++)
+    {
+        histogram->buckets[b] = state->buckets[b];
+    }
+}
+
+sdrio_uint64 sdrio_histogram_percentile(const sdrio_histogram *histogram, sdrio_float64 p)
+{
+    sdrio_uint64 total = 0, seen = 0, target;
+    sdrio_uint32 b;
+
+    for (b=0; b<SDRIO_HISTOGRAM_BUCKETS; b++)
+    {
+        total += histogram->buckets[b];
+    }
+
+    if (!total)
+    {
+        return 0;
+    }
+
+    target = (sdrio_uint64)(p * total + 0.5);
+    target = target ? target : 1;
+
+    for (b=0; b<SDRIO_HISTOGRAM_BUCKETS; b++)
+    {
+        seen += histogram->buckets[b];
+        if (seen >= target)
+        {
+            break;
+        }
+    }
+
+    return SDRIO_HISTOGRAM_BUCKET_LOW(b);
+}
+
+void sdrio_histogram_write(FILE *file, const char *name, const sdrio_histogram *histogram)
+{
+    sdrio_uint32 b;
+
+    fprintf(file, "# %s: count %llu min %llu mean %llu p50 %llu p99 %llu p99.9 %llu max %llu ns\n", name,
+            (unsigned long long)histogram->count,
+            (unsigned long long)histogram->min,
+            (unsigned long long)(histogram->count ? histogram->total / histogram->count : 0),
+            (unsigned long long)sdrio_histogram_percentile(histogram, 0.5),
+            (unsigned long long)sdrio_histogram_percentile(histogram, 0.99),
+            (unsigned long long)sdrio_histogram_percentile(histogram, 0.999),
+            (unsigned long long)histogram->max);
+
+    for (b=0; b<SDRIO_HISTOGRAM_BUCKETS; b++)
+    {
+        if (histogram->buckets[b])
+        {
+            fprintf(file, "%llu %lu\n", (unsigned long long)SDRIO_HISTOGRAM_BUCKET_LOW(b), (unsigned long)histogram->buckets[b]);
+        }
+    }
+
+    fprintf(file, "\n");
+}
@@ -0,0 +1,47 @@
+// Copyright Scott Cutler
+// This source file is licensed under the GNU Lesser General Public License (LGPL)
+
+#ifndef SDRIO_HISTOGRAM_H
+#define SDRIO_HISTOGRAM_H
+
+#include <stdio.h>
+
+#include "sdrio_ext.h"
+
+// A log bucketed histogram with one writer.  Buckets are only ever
+// incremented by the writer, so a reader copying them on another thread
+// sees each one either before or after an update, never torn; the totals go
+// through the stats atomics because they are 64 bit.
+typedef struct sdrio_histogram_state_t
+{
+    volatile sdrio_int64 count;
+    volatile sdrio_int64 min;
+    volatile sdrio_int64 max;
+    volatile sdrio_int64 total;
+    volatile sdrio_uint32 buckets[SDRIO_HISTOGRAM_BUCKETS];
+} sdrio_histogram_state;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    void sdrio_histogram_reset(sdrio_histogram_state *state);
+
+    sdrio_uint32 sdrio_histogram_bucket(sdrio_uint64 ns);
+    void sdrio_histogram_record(sdrio_histogram_state *state, sdrio_float64 seconds);
+
+    void sdrio_histogram_read(sdrio_histogram_state *state, sdrio_histogram *histogram);
+
+    // The lower bound, in nanoseconds, of the bucket holding fraction p of
+    // the samples at or below it.
+    sdrio_uint64 sdrio_histogram_percentile(const sdrio_histogram *histogram, sdrio_float64 p);
+
+    // A commented summary line, then one "low_ns count" line per non-empty
+    // bucket.
+    void sdrio_histogram_write(FILE *file, const char *name, const sdrio_histogram *histogram);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SDRIO_HISTOGRAM_H
@@ -0,0 +1,177 @@
+// Copyright Scott Cutler
+// This source file is licensed under the GNU Lesser General Public License (LGPL)
+
+#include <math.h>
+
+#include <emmintrin.h>
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#define SDRIO_TARGET_AVX2
+#else
+#define SDRIO_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+#include "sdrio_nco.h"
+#include "sdrio_convert.h"
+
+#define PI 3.14159265358979323846
+
+static sdrio_iq phasor(double cycles)
+{
+    sdrio_iq p;
+
+    p.i = (sdrio_float32)cos(2 * PI * cycles);
+    p.q = (sdrio_float32)sin(2 * PI * cycles);
+    return p;
+}
+
+void sdrio_nco_init(sdrio_nco_state *state)
+{
+    state->phase = 0.0;
+    sdrio_nco_set_step(state, 0.0);
+}
+
+void sdrio_nco_set_step(sdrio_nco_state *state, double step)
+{
+    state->step = step - floor(step);
+    state->w1 = phasor(state->step);
+    state->w2 = phasor(2 * state->step);
+    state->w4 = phasor(4 * state->step);
+}
+
+static void advance(sdrio_nco_state *state, sdrio_uint32 num_samples)
+{
+    state->phase += num_samples * state->step;
+    state->phase -= floor(state->phase);
+}
+
+sdrio_nco_mix_t sdrio_get_nco_mix()
+{
+    sdrio_uint32 features = sdrio_get_cpu_features();
+
+    if (features & SDRIO_CPU_AVX2)
+    {
+        return sdrio_nco_mix_avx2;
+    }
+    else if (features & SDRIO_CPU_SSE2)
+    {
+        return sdrio_nco_mix_sse2;
+    }
+    else
+    {
+        return sdrio_nco_mix_scalar;
+    }
+}
+
+void sdrio_nco_mix_scalar(sdrio_nco_state *state, sdrio_iq *samples, sdrio_uint32 num_samples)
+{
+    sdrio_iq p = phasor(state->phase);
+    sdrio_iq w = state->w1;
+    sdrio_float32 i, q;
+    sdrio_uint32 n;
+
+    for (n=0; n<num_samples; n++)
+    {
+        i = samples[n].i;
+        q = samples[n].q;
+        samples[n].i = i * p.i - q * p.q;
+        samples[n].q = i * p.q + q * p.i;
+
+        i = p.i;
+        p.i = i * w.i - p.q * w.q;
+        p.q = i * w.q + p.q * w.i;
+    }
+
+    advance(state, num_samples);
+}
+
+// a * b for two interleaved complex pairs.
+static __inline __m128 cmul_sse2(__m128 a, __m128 b)
+{
+    __m128 br = _mm_shuffle_ps(b, b, _MM_SHUFFLE(2, 2, 0, 0));
+    __m128 bi = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 3, 1, 1));
+    __m128 as = _mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1));
+
+    return _mm_add_ps(_mm_mul_ps(a, br), _mm_mul_ps(_mm_mul_ps(as, bi), _mm_setr_ps(-1.0f, 1.0f, -1.0f, 1.0f)));
+}
+
+void sdrio_nco_mix_sse2(sdrio_nco_state *state, sdrio_iq *samples, sdrio_uint32 num_samples)
+{
+    sdrio_iq p0 = phasor(state->phase);
+    __m128 p = _mm_setr_ps(p0.i, p0.q, p0.i * state->w1.i - p0.q * state->w1.q, p0.i * state->w1.q + p0.q * state->w1.i);
+    __m128 w = _mm_setr_ps(state->w2.i, state->w2.q, state->w2.i, state->w2.q);
+    float *x = (float *)samples;
+    float tail[4];
+    sdrio_float32 i, q;
+    sdrio_uint32 n = 0;
+
+    for (; n + 2 <= num_samples; n += 2, x += 4)
+    {
+        _mm_storeu_ps(x, cmul_sse2(_mm_loadu_ps(x), p));
+        p = cmul_sse2(p, w);
+    }
+
+    if (n < num_samples)
+    {
+        _mm_storeu_ps(tail, p);
+        i = samples[n].i;
+        q = samples[n].q;
+        samples[n].i = i * tail[0] - q * tail[1];
+        samples[n].q = i * tail[1] + q * tail[0];
+    }
+
+    advance(state, num_samples);
+}
+
+SDRIO_TARGET_AVX2 void sdrio_nco_mix_avx2(sdrio_nco_state *state, sdrio_iq *samples, sdrio_uint32 num_samples)
+{
+    const __m256 sign = _mm256_setr_ps(-1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 1.0f);
+    sdrio_iq p0 = phasor(state->phase);
+    sdrio_iq p1, p2, p3;
+    __m256 p, w;
+    float *x = (float *)samples;
+    sdrio_uint32 n = 0;
+
+    p1.i = p0.i * state->w1.i - p0.q * state->w1.q;
+    p1.q = p0.i * state->w1.q + p0.q * state->w1.i;
+    p2.i = p0.i * state->w2.i - p0.q * state->w2.q;
+    p2.q = p0.i * state->w2.q + p0.q * state->w2.i;
+    p3.i = p2.i * state->w1.i - p2.q * state->w1.q;
+    p3.q = p2.i * state->w1.q + p2.q * state->w1.i;
+
+    p = _mm256_setr_ps(p0.i, p0.q, p1.i, p1.q, p2.i, p2.q, p3.i, p3.q);
+    w = _mm256_setr_ps(state->w4.i, state->w4.q, state->w4.i, state->w4.q, state->w4.i, state->w4.q, state->w4.i, state->w4.q);
+
+    for (; n + 4 <= num_samples; n += 4, x += 8)
+    {
+        __m256 v = _mm256_loadu_ps(x);
+        __m256 pr = _mm256_permute_ps(p, _MM_SHUFFLE(2, 2, 0, 0));
+        __m256 pi = _mm256_permute_ps(p, _MM_SHUFFLE(3, 3, 1, 1));
+        __m256 vs = _mm256_permute_ps(v, _MM_SHUFFLE(2, 3, 0, 1));
+        __m256 wr = _mm256_permute_ps(w, _MM_SHUFFLE(2, 2, 0, 0));
+        __m256 wi = _mm256_permute_ps(w, _MM_SHUFFLE(3, 3, 1, 1));
+        __m256 ps = _mm256_permute_ps(p, _MM_SHUFFLE(2, 3, 0, 1));
+
+        _mm256_storeu_ps(x, _mm256_add_ps(_mm256_mul_ps(v, pr), _mm256_mul_ps(_mm256_mul_ps(vs, pi), sign)));
+        p = _mm256_add_ps(_mm256_mul_ps(p, wr), _mm256_mul_ps(_mm256_mul_ps(ps, wi), sign));
+    }
+
+    if (n < num_samples)
+    {
+        float rest[8];
+        sdrio_uint32 k;
+
+        _mm256_storeu_ps(rest, p);
+        for (k=0; n<num_samples; n++, k++)
+        {
+            sdrio_float32 i = samples[n].i;
+            sdrio_float32 q = samples[n].q;
+            samples[n].i = i * rest[2*k] - q * rest[2*k + 1];
+            samples[n].q = i * rest[2*k + 1] + q * rest[2*k];
+        }
+    }
+
+    _mm256_zeroupper();
+    advance(state, num_samples);
+}
@@ -0,0 +1,42 @@
+// Copyright Scott Cutler
+// This source file is licensed under the GNU Lesser General Public License (LGPL)
+
+#ifndef SDRIO_NCO_H
+#define SDRIO_NCO_H
+
+#include "sdrio_ext.h"
+
+// Complex rotator.  The phase is kept in double precision and the float
+// phasor is regenerated from it on every call, so error can't build up over
+// a long stream while each call still runs a cheap recurrence.
+typedef struct sdrio_nco_state_t
+{
+    double phase;               // cycles, [0, 1)
+    double step;                // cycles per sample
+
+    // e^(2 pi i step) raised to 1, 2 and 4 for the scalar, SSE2 and AVX lanes
+    sdrio_iq w1, w2, w4;
+} sdrio_nco_state;
+
+typedef void (*sdrio_nco_mix_t)(sdrio_nco_state *state, sdrio_iq *samples, sdrio_uint32 num_samples);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    void sdrio_nco_init(sdrio_nco_state *state);
+
+    // Keeps the current phase, so changing frequency is phase continuous.
+    void sdrio_nco_set_step(sdrio_nco_state *state, double step);
+
+    sdrio_nco_mix_t sdrio_get_nco_mix();
+
+    void sdrio_nco_mix_scalar(sdrio_nco_state *state, sdrio_iq *samples, sdrio_uint32 num_samples);
+    void sdrio_nco_mix_sse2(sdrio_nco_state *state, sdrio_iq *samples, sdrio_uint32 num_samples);
+    void sdrio_nco_mix_avx2(sdrio_nco_state *state, sdrio_iq *samples, sdrio_uint32 num_samples);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SDRIO_NCO_H
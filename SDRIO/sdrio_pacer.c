@@ -0,0 +1,137 @@
+// Copyright Scott Cutler
+// This source file is licensed under the GNU Lesser General Public License (LGPL)
+
+#include <math.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#pragma comment(lib, "winmm.lib")
+#else
+#include <errno.h>
+#include <time.h>
+#endif
+
+#include "sdrio_pacer.h"
+#include "sdrio_clock.h"
+
+void sdrio_pacer_init(sdrio_pacer *pacer)
+{
+    memset(pacer, 0, sizeof(sdrio_pacer));
+    pacer->rng = 0x2545f491;
+
+#if defined(_WIN32)
+    pacer->timer = (void *)CreateWaitableTimer(0, TRUE, 0);
+#endif
+}
+
+void sdrio_pacer_free(sdrio_pacer *pacer)
+{
+    sdrio_pacer_stop(pacer);
+
+#if defined(_WIN32)
+    if (pacer->timer)
+    {
+        CloseHandle((HANDLE)pacer->timer);
+        pacer->timer = 0;
+    }
+#endif
+}
+
+void sdrio_pacer_start(sdrio_pacer *pacer, sdrio_float64 rate, sdrio_float64 jitter)
+{
+#if defined(_WIN32)
+    // The default 15.6 ms tick is longer than a block at most rates.
+    if (!pacer->running)
+    {
+        timeBeginPeriod(1);
+    }
+#endif
+
+    pacer->running = 1;
+    pacer->rate = rate;
+    pacer->jitter = jitter;
+    pacer->origin = sdrio_clock_now();
+    pacer->samples = 0;
+}
+
+void sdrio_pacer_stop(sdrio_pacer *pacer)
+{
+    if (pacer->running)
+    {
+        pacer->running = 0;
+
+#if defined(_WIN32)
+        timeEndPeriod(1);
+#endif
+    }
+}
+
+static void sleep_until(sdrio_pacer *pacer, sdrio_float64 deadline)
+{
+#if defined(_WIN32)
+    sdrio_float64 remaining = deadline - sdrio_clock_now();
+    LARGE_INTEGER due;
+
+    if (remaining <= 0.0)
+    {
+        return;
+    }
+
+    // Waitable timers only take absolute times on the system clock, which
+    // can be stepped, so the deadline goes in as a relative time computed
+    // from the performance counter just now.
+    due.QuadPart = -(LONGLONG)(remaining * 1e7);
+    if (pacer->timer && SetWaitableTimer((HANDLE)pacer->timer, &due, 0, 0, 0, FALSE))
+    {
+        WaitForSingleObject((HANDLE)pacer->timer, INFINITE);
+    }
+    else
+    {
+        Sleep((DWORD)(remaining * 1000));
+    }
+#else
+    struct timespec when;
+    sdrio_float64 seconds = floor(deadline);
+
+    (void)pacer;
+
+    when.tv_sec = (time_t)seconds;
+    when.tv_nsec = (long)((deadline - seconds) * 1e9);
+
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &when, 0) == EINTR)
+    {
+    }
+#endif
+}
+
+void sdrio_pacer_wait(sdrio_pacer *pacer, sdrio_uint32 num_samples)
+{
+    sdrio_float64 deadline, now;
+
+    if (!pacer->running || (pacer->rate <= 0.0))
+    {
+        return;
+    }
+
+    pacer->samples += num_samples;
+    deadline = pacer->origin + pacer->samples / pacer->rate;
+
+    now = sdrio_clock_now();
+    if (now - deadline > SDRIO_PACER_MAX_LAG)
+    {
+        pacer->origin += now - deadline;
+        deadline = now;
+    }
+
+    if (pacer->jitter > 0.0)
+    {
+        // xorshift32
+        pacer->rng ^= pacer->rng << 13;
+        pacer->rng ^= pacer->rng >> 17;
+        pacer->rng ^= pacer->rng << 5;
+        deadline += pacer->jitter * ((pacer->rng & 0xffffff) * (1.0 / 0x1000000));
+    }
+
+    sleep_until(pacer, deadline);
+}
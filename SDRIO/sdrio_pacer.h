@@ -0,0 +1,54 @@
+// Copyright Scott Cutler
+// This source file is licensed under the GNU Lesser General Public License (LGPL)
+
+#ifndef SDRIO_PACER_H
+#define SDRIO_PACER_H
+
+#include "sdrio_ext.h"
+
+// A producer that falls further behind than this gives up on catching up
+// and carries on from now, the way hardware drops what nobody collected.
+#define SDRIO_PACER_MAX_LAG 0.25
+
+// Releases blocks on a fixed schedule for sources with no hardware clock
+// behind them.  Each block's deadline comes from the sample count and the
+// time the schedule started, not from when the last wait returned, so
+// oversleeping never adds up into drift.  It sleeps until the deadline as
+// an absolute time (clock_nanosleep, or a waitable timer on Windows with
+// the timer resolution raised while running) instead of polling.
+//
+// With jitter, each block is released up to that many seconds late while
+// the schedule stays put, so late blocks are followed by a burst the way
+// USB transfers arrive.
+typedef struct sdrio_pacer_t
+{
+    sdrio_float64 rate;         // 0 runs unthrottled
+    sdrio_float64 jitter;       // seconds
+    sdrio_float64 origin;       // clock time of sample 0
+    sdrio_uint64 samples;       // released so far
+    unsigned int rng;
+    sdrio_uint8 running;
+    void *timer;                // Windows waitable timer
+} sdrio_pacer;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    void sdrio_pacer_init(sdrio_pacer *pacer);
+    void sdrio_pacer_free(sdrio_pacer *pacer);
+
+    // Starts the schedule from now.  Calling it again while running
+    // replans with the new rate and jitter.
+    void sdrio_pacer_start(sdrio_pacer *pacer, sdrio_float64 rate, sdrio_float64 jitter);
+
+    // Blocks until num_samples more are due.
+    void sdrio_pacer_wait(sdrio_pacer *pacer, sdrio_uint32 num_samples);
+
+    void sdrio_pacer_stop(sdrio_pacer *pacer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SDRIO_PACER_H
@@ -0,0 +1,126 @@
+// Copyright Scott Cutler
+// This source file is licensed under the GNU Lesser General Public License (LGPL)
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#include "sdrio_pool.h"
+
+static void * alloc_huge(size_t *size)
+{
+#if defined(_WIN32)
+    SIZE_T page = GetLargePageMinimum();
+    void *p;
+
+    if (!page)
+    {
+        return 0;
+    }
+
+    *size = (*size + page - 1) & ~(page - 1);
+    p = VirtualAlloc(0, *size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+
+    return p;
+#elif defined(MAP_HUGETLB)
+    const size_t page = 2 * 1024 * 1024;
+    void *p;
+
+    *size = (*size + page - 1) & ~(page - 1);
+    p = mmap(0, *size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+    return (p == MAP_FAILED) ? 0 : p;
+#else
+    return 0;
+#endif
+}
+
+static void free_huge(void *p, size_t size)
+{
+#if defined(_WIN32)
+    VirtualFree(p, 0, MEM_RELEASE);
+#elif defined(MAP_HUGETLB)
+    munmap(p, size);
+#endif
+}
+
+static void * alloc_aligned(size_t size)
+{
+#if defined(_WIN32)
+    return _aligned_malloc(size, SDRIO_POOL_ALIGNMENT);
+#else
+    void *p = 0;
+    return (posix_memalign(&p, SDRIO_POOL_ALIGNMENT, size) == 0) ? p : 0;
+#endif
+}
+
+static void free_aligned(void *p)
+{
+#if defined(_WIN32)
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+sdrio_int32 sdrio_pool_init(sdrio_pool *pool, sdrio_uint32 num_blocks, sdrio_uint32 block_bytes, sdrio_uint8 huge_pages)
+{
+    memset(pool, 0, sizeof(sdrio_pool));
+
+    if (!num_blocks || !block_bytes)
+    {
+        return 1;
+    }
+
+    pool->block_bytes = (block_bytes + SDRIO_POOL_ALIGNMENT - 1) & ~(SDRIO_POOL_ALIGNMENT - 1);
+    pool->num_blocks = num_blocks;
+    pool->size = (size_t)pool->block_bytes * num_blocks;
+
+    if (huge_pages)
+    {
+        pool->base = (sdrio_uint8 *)alloc_huge(&pool->size);
+        pool->huge = (pool->base != 0);
+    }
+
+    if (!pool->base)
+    {
+        pool->size = (size_t)pool->block_bytes * num_blocks;
+        pool->base = (sdrio_uint8 *)alloc_aligned(pool->size);
+    }
+
+    if (!pool->base)
+    {
+        memset(pool, 0, sizeof(sdrio_pool));
+        return 0;
+    }
+
+    return 1;
+}
+
+void sdrio_pool_free(sdrio_pool *pool)
+{
+    if (pool->base)
+    {
+        if (pool->huge)
+        {
+            free_huge(pool->base, pool->size);
+        }
+        else
+        {
+            free_aligned(pool->base);
+        }
+    }
+
+    memset(pool, 0, sizeof(sdrio_pool));
+}
+
+void * sdrio_pool_block(sdrio_pool *pool, sdrio_uint32 index)
+{
+    return pool->base + (size_t)pool->block_bytes * index;
+}
@@ -0,0 +1,39 @@
+// Copyright Scott Cutler
+// This source file is licensed under the GNU Lesser General Public License (LGPL)
+
+#ifndef SDRIO_POOL_H
+#define SDRIO_POOL_H
+
+#include <stddef.h>
+
+#include "sdrio_ext.h"
+
+#define SDRIO_POOL_ALIGNMENT 64
+
+// A fixed set of equally sized, cache-line aligned blocks carved out of one
+// allocation made up front, so the receive path never calls the allocator.
+typedef struct sdrio_pool_t
+{
+    sdrio_uint8 *base;
+    sdrio_uint32 block_bytes;   // stride between blocks, multiple of SDRIO_POOL_ALIGNMENT
+    sdrio_uint32 num_blocks;
+    size_t size;
+    sdrio_uint8 huge;           // base came from the large page allocator
+} sdrio_pool;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    // With huge_pages set, large pages are tried first and ordinary pages are
+    // used if the OS refuses (on Windows that needs SeLockMemoryPrivilege).
+    sdrio_int32 sdrio_pool_init(sdrio_pool *pool, sdrio_uint32 num_blocks, sdrio_uint32 block_bytes, sdrio_uint8 huge_pages);
+    void sdrio_pool_free(sdrio_pool *pool);
+
+    void * sdrio_pool_block(sdrio_pool *pool, sdrio_uint32 index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SDRIO_POOL_H
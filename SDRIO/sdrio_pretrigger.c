@@ -0,0 +1,520 @@
+// Copyright Scott Cutler
+// This source file is licensed under the GNU Lesser General Public License (LGPL)
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#if !defined(_WIN32)
+#define _FILE_OFFSET_BITS 64
+#endif
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "sdrio_pretrigger.h"
+#include "sdrio_stats.h"
+
+static const char trigger_requested[] = "trigger: sdrio_trigger_rx";
+static const char trigger_power[] = "trigger: power threshold";
+
+void sdrio_pretrigger_init(sdrio_pretrigger *pre)
+{
+    memset(pre, 0, sizeof(sdrio_pretrigger));
+    pthread_mutex_init(&pre->lock, 0);
+}
+
+void sdrio_pretrigger_free(sdrio_pretrigger *pre)
+{
+    sdrio_pretrigger_stop(pre);
+    pthread_mutex_destroy(&pre->lock);
+}
+
+// Sum of I*I + Q*Q over samples, before scaling.
+static sdrio_float64 sum_power(const sdrio_format_desc *format, const void *samples, sdrio_uint32 num_samples)
+{
+    sdrio_float64 sum = 0.0;
+    sdrio_float32 i, q;
+    sdrio_uint32 n;
+
+    switch (format->format)
+    {
+    case sdrio_sample_format_cu8:
+        {
+            const sdrio_uint8 *in = (const sdrio_uint8 *)samples;
+            for (n = 0; n < num_samples; n++)
+            {
+                i = in[2*n] - format->offset;
+                q = in[2*n+1] - format->offset;
+                sum += i * i + q * q;
+            }
+        }
+        break;
+
+    case sdrio_sample_format_cs8:
+        {
+            const signed char *in = (const signed char *)samples;
+            for (n = 0; n < num_samples; n++)
+            {
+                i = in[2*n];
+                q = in[2*n+1];
+                sum += i * i + q * q;
+            }
+        }
+        break;
+
+    case sdrio_sample_format_cs16:
+    case sdrio_sample_format_sc16q12:
+        {
+            const sdrio_int16 *in = (const sdrio_int16 *)samples;
+            sdrio_uint8 shift = (format->format == sdrio_sample_format_sc16q12) ? 4 : 0;
+            for (n = 0; n < num_samples; n++)
+            {
+                i = (sdrio_float32)((sdrio_int16)(in[2*n] << shift) >> shift);
+                q = (sdrio_float32)((sdrio_int16)(in[2*n+1] << shift) >> shift);
+                sum += i * i + q * q;
+            }
+        }
+        break;
+
+    case sdrio_sample_format_cf32:
+        {
+            const sdrio_iq *in = (const sdrio_iq *)samples;
+            for (n = 0; n < num_samples; n++)
+            {
+                sum += in[n].i * in[n].i + in[n].q * in[n].q;
+            }
+        }
+        break;
+    }
+
+    return sum;
+}
+
+// Starts a new capture segment at the next sample stored if the block being
+// fed is at a new frequency or gain, or follows a gap.
+static void tag(sdrio_pretrigger *pre, sdrio_uint64 frequency, sdrio_float32 gain)
+{
+    sdrio_record_capture *last = &pre->tags[(pre->num_tags - 1) % SDRIO_PRETRIGGER_MAX_TAGS];
+
+    if (!pre->gap && (frequency == last->frequency) && (gain == last->gain))
+    {
+        return;
+    }
+
+    // Segments that never got a sample are replaced rather than kept.
+    if (last->sample_start != pre->stored)
+    {
+        last = &pre->tags[pre->num_tags % SDRIO_PRETRIGGER_MAX_TAGS];
+        pre->num_tags++;
+    }
+
+    last->sample_start = pre->stored;
+    last->frequency = frequency;
+    last->gain = gain;
+    pre->gap = 0;
+}
+
+static void trigger(sdrio_pretrigger *pre, sdrio_uint64 at, const char *reason)
+{
+    pre->triggered = 1;
+    pre->trigger_at = (at > pre->base) ? at : pre->base;
+    pre->reason = reason;
+    pre->power = 0.0;
+    pre->power_count = 0;
+    sdrio_stats_add(&pre->triggers, 1);
+}
+
+// Returns 1, with the history counter of the window's first sample in at, if
+// the power trigger fires in this block.  Windows carry on across blocks, so
+// one can start before the block it ends in.
+static sdrio_int32 scan_power(sdrio_pretrigger *pre, const void *samples, sdrio_uint32 num_samples, sdrio_uint64 *at)
+{
+    const sdrio_uint8 *in = (const sdrio_uint8 *)samples;
+    sdrio_uint32 window = pre->window, offset = 0, n;
+    sdrio_float64 limit = (sdrio_float64)pre->threshold / ((sdrio_float64)pre->format.scale * pre->format.scale);
+
+    while (window && (offset < num_samples))
+    {
+        n = (pre->power_count < window) ? window - pre->power_count : 0;
+        if (n > num_samples - offset)
+        {
+            n = num_samples - offset;
+        }
+
+        pre->power += sum_power(&pre->format, in + offset * pre->format.bytes_per_sample, n);
+        pre->power_count += n;
+        offset += n;
+
+        if (pre->power_count >= window)
+        {
+            if (pre->power >= limit * pre->power_count)
+            {
+                *at = pre->stored + offset - ((pre->power_count < pre->stored + offset) ? pre->power_count : pre->stored + offset);
+                return 1;
+            }
+
+            pre->power = 0.0;
+            pre->power_count = 0;
+        }
+    }
+
+    return 0;
+}
+
+// Hands the window ending at the last sample stored to the writer.  Called
+// with the lock held.
+static void hand_off(sdrio_pretrigger *pre)
+{
+    sdrio_pretrigger_job *job = &pre->job;
+    sdrio_uint64 first, end = pre->stored;
+    sdrio_uint32 oldest, i;
+    const sdrio_record_capture *tag;
+
+    pre->triggered = 0;
+
+    first = (end - pre->base > pre->capacity) ? end - pre->capacity : pre->base;
+    if (first == end)
+    {
+        return;
+    }
+
+    job->first = first;
+    job->count = end - first;
+    job->trigger = (pre->trigger_at > first) ? pre->trigger_at - first : 0;
+    job->reason = pre->reason;
+    job->number = (sdrio_uint32)sdrio_stats_load(&pre->triggers);
+    job->end_time = time(0);
+
+    // From the segment the window starts in, or the oldest one remembered.
+    oldest = (pre->num_tags > SDRIO_PRETRIGGER_MAX_TAGS) ? pre->num_tags - SDRIO_PRETRIGGER_MAX_TAGS : 0;
+    for (i = pre->num_tags - 1; i > oldest; i--)
+    {
+        if (pre->tags[i % SDRIO_PRETRIGGER_MAX_TAGS].sample_start <= first)
+        {
+            break;
+        }
+    }
+
+    job->num_captures = 0;
+    for (; i < pre->num_tags; i++)
+    {
+        tag = &pre->tags[i % SDRIO_PRETRIGGER_MAX_TAGS];
+        if (tag->sample_start >= end)
+        {
+            break;
+        }
+
+        job->captures[job->num_captures] = *tag;
+        job->captures[job->num_captures].sample_start = (tag->sample_start > first) ? tag->sample_start - first : 0;
+        job->num_captures++;
+    }
+
+    pre->writing = 1;
+    sem_post(&pre->ready);
+}
+
+static sdrio_int32 write_job(sdrio_pretrigger *pre, const sdrio_pretrigger_job *job)
+{
+    char path[SDRIO_RECORD_MAX_PATH + 16], datetime[32];
+    sdrio_uint32 bytes_per_sample = pre->format.bytes_per_sample;
+    sdrio_uint64 position = job->first % pre->capacity, n;
+    time_t start;
+    struct tm *utc;
+    FILE *file;
+    sdrio_int32 ok;
+
+    sprintf(path, "%s_%04lu.sigmf-data", pre->path, (unsigned long)job->number);
+    file = fopen(path, "wb");
+    if (!file)
+    {
+        return 0;
+    }
+
+    // The window wraps around the end of the ring at most once.
+    n = pre->capacity - position;
+    if (n > job->count)
+    {
+        n = job->count;
+    }
+
+    ok = (fwrite(pre->ring + position * bytes_per_sample, bytes_per_sample, (size_t)n, file) == (size_t)n);
+    if (ok && (n < job->count))
+    {
+        ok = (fwrite(pre->ring, bytes_per_sample, (size_t)(job->count - n), file) == (size_t)(job->count - n));
+    }
+
+    if (fclose(file) != 0)
+    {
+        ok = 0;
+    }
+
+    start = job->end_time - (time_t)(job->count / pre->sample_rate);
+    utc = gmtime(&start);
+    strftime(datetime, sizeof(datetime), "%Y-%m-%dT%H:%M:%SZ", utc);
+
+    sprintf(path, "%s_%04lu", pre->path, (unsigned long)job->number);
+    return ok && sdrio_record_write_meta(path, &pre->format, pre->sample_rate, pre->hw, datetime, job->captures, job->num_captures, job->reason, job->trigger);
+}
+
+static void * writer_routine(void *ctx)
+{
+    sdrio_pretrigger *pre = (sdrio_pretrigger *)ctx;
+
+    for (;;)
+    {
+        sem_wait(&pre->ready);
+
+        // Stop hands over a triggered capture before it posts to end the
+        // thread, so a job always comes first.
+        if (pre->writing)
+        {
+            sdrio_stats_add(write_job(pre, &pre->job) ? &pre->written : &pre->failed, 1);
+
+            // The history starts over from here.
+            pthread_mutex_lock(&pre->lock);
+            pre->base = pre->stored;
+            pre->power = 0.0;
+            pre->power_count = 0;
+            pre->requested = 0;
+            pre->writing = 0;
+            pthread_mutex_unlock(&pre->lock);
+        }
+        else if (!pre->running)
+        {
+            break;
+        }
+    }
+
+    return 0;
+}
+
+sdrio_int32 sdrio_pretrigger_start(sdrio_pretrigger *pre, const char *path, sdrio_float64 pre_seconds, sdrio_float64 post_seconds,
+                                   const sdrio_format_desc *format, sdrio_uint64 sample_rate, sdrio_uint64 frequency, sdrio_float32 gain, const char *hw)
+{
+    sdrio_uint64 capacity;
+
+    if (pre->running || !sdrio_record_datatype(format->format) || !sample_rate || (pre_seconds < 0.0) || (post_seconds < 0.0) ||
+        (strlen(path) >= SDRIO_RECORD_MAX_PATH - 16))
+    {
+        return 0;
+    }
+
+    capacity = (sdrio_uint64)((pre_seconds + post_seconds) * sample_rate + 0.5);
+    if (!capacity || (capacity > SDRIO_PRETRIGGER_MAX_BYTES / format->bytes_per_sample))
+    {
+        return 0;
+    }
+
+    if (!sdrio_pool_init(&pre->pool, 1, (sdrio_uint32)(capacity * format->bytes_per_sample), 0))
+    {
+        return 0;
+    }
+
+    strcpy(pre->path, path);
+    pre->hw[0] = 0;
+    if (hw)
+    {
+        strncpy(pre->hw, hw, sizeof(pre->hw) - 1);
+        pre->hw[sizeof(pre->hw) - 1] = 0;
+    }
+
+    pre->format = *format;
+    pre->sample_rate = sample_rate;
+    pre->ring = (sdrio_uint8 *)sdrio_pool_block(&pre->pool, 0);
+    pre->capacity = capacity;
+    pre->post_samples = (sdrio_uint64)(post_seconds * sample_rate + 0.5);
+    if (pre->post_samples > capacity)
+    {
+        pre->post_samples = capacity;
+    }
+
+    pre->stored = 0;
+    pre->base = 0;
+    pre->triggered = 0;
+    pre->writing = 0;
+    pre->requested = 0;
+    pre->gap = 0;
+    pre->power = 0.0;
+    pre->power_count = 0;
+
+    pre->tags[0].sample_start = 0;
+    pre->tags[0].frequency = frequency;
+    pre->tags[0].gain = gain;
+    pre->num_tags = 1;
+
+    sdrio_stats_store(&pre->triggers, 0);
+    sdrio_stats_store(&pre->missed, 0);
+    sdrio_stats_store(&pre->written, 0);
+    sdrio_stats_store(&pre->failed, 0);
+
+    pre->running = 1;
+    sem_init(&pre->ready, 0, 0);
+    if (pthread_create(&pre->tid, 0, writer_routine, (void *)pre) != 0)
+    {
+        pre->running = 0;
+        sem_destroy(&pre->ready);
+        sdrio_pool_free(&pre->pool);
+        return 0;
+    }
+
+    pthread_mutex_lock(&pre->lock);
+    pre->armed = 1;
+    pthread_mutex_unlock(&pre->lock);
+    return 1;
+}
+
+void sdrio_pretrigger_set_power(sdrio_pretrigger *pre, sdrio_float32 threshold, sdrio_uint32 window)
+{
+    pre->threshold = (sdrio_float32)pow(10.0, threshold / 10.0);
+    pre->window = window;
+}
+
+sdrio_int32 sdrio_pretrigger_request(sdrio_pretrigger *pre)
+{
+    if (!pre->armed)
+    {
+        return 0;
+    }
+
+    if (pre->writing)
+    {
+        sdrio_stats_add(&pre->missed, 1);
+        return 0;
+    }
+
+    pre->requested = 1;
+    return 1;
+}
+
+void sdrio_pretrigger_feed(sdrio_pretrigger *pre, const void *samples, sdrio_uint32 num_samples, sdrio_uint64 frequency, sdrio_float32 gain)
+{
+    const sdrio_uint8 *in = (const sdrio_uint8 *)samples;
+    sdrio_uint32 bytes_per_sample;
+    sdrio_uint64 at, end, position, n;
+
+    if (!pre->armed)
+    {
+        return;
+    }
+
+    // Only start, stop and the writer finishing take the lock, and only
+    // briefly, but even that isn't worth waiting for here.
+    if (pthread_mutex_trylock(&pre->lock) != 0)
+    {
+        pre->gap = 1;
+        return;
+    }
+
+    if (!pre->armed)
+    {
+        pthread_mutex_unlock(&pre->lock);
+        return;
+    }
+
+    tag(pre, frequency, gain);
+
+    if (pre->writing)
+    {
+        pthread_mutex_unlock(&pre->lock);
+        return;
+    }
+
+    // A request that comes while the post trigger samples are being filled
+    // is part of the same event.
+    if (pre->requested)
+    {
+        pre->requested = 0;
+        if (!pre->triggered)
+        {
+            trigger(pre, pre->stored, trigger_requested);
+        }
+    }
+
+    if (!pre->triggered && pre->window && scan_power(pre, samples, num_samples, &at))
+    {
+        trigger(pre, at, trigger_power);
+    }
+
+    // A power window that started a block or more back can put the end of
+    // a short capture behind what is already stored.
+    end = pre->trigger_at + pre->post_samples;
+    if (pre->triggered)
+    {
+        if (end <= pre->stored)
+        {
+            num_samples = 0;
+        }
+        else if (num_samples > end - pre->stored)
+        {
+            num_samples = (sdrio_uint32)(end - pre->stored);
+        }
+    }
+
+    bytes_per_sample = pre->format.bytes_per_sample;
+    while (num_samples)
+    {
+        position = pre->stored % pre->capacity;
+        n = pre->capacity - position;
+        if (n > num_samples)
+        {
+            n = num_samples;
+        }
+
+        memcpy(pre->ring + position * bytes_per_sample, in, (size_t)(n * bytes_per_sample));
+        pre->stored += n;
+        in += n * bytes_per_sample;
+        num_samples -= (sdrio_uint32)n;
+    }
+
+    if (pre->triggered && (pre->stored >= end))
+    {
+        hand_off(pre);
+    }
+
+    pthread_mutex_unlock(&pre->lock);
+}
+
+void sdrio_pretrigger_mark_gap(sdrio_pretrigger *pre)
+{
+    if (pre->armed)
+    {
+        pre->gap = 1;
+    }
+}
+
+void sdrio_pretrigger_stop(sdrio_pretrigger *pre)
+{
+    if (!pre->running)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&pre->lock);
+    pre->armed = 0;
+    if (pre->triggered)
+    {
+        hand_off(pre);
+    }
+    pthread_mutex_unlock(&pre->lock);
+
+    pre->running = 0;
+    sem_post(&pre->ready);
+    pthread_join(pre->tid, 0);
+    sem_destroy(&pre->ready);
+
+    sdrio_pool_free(&pre->pool);
+    pre->ring = 0;
+}
+
+void sdrio_pretrigger_get_stats(sdrio_pretrigger *pre, sdrio_pretrigger_stats *stats)
+{
+    sdrio_uint64 held = pre->stored - pre->base;
+
+    stats->triggers = (sdrio_uint32)sdrio_stats_load(&pre->triggers);
+    stats->missed = (sdrio_uint32)sdrio_stats_load(&pre->missed);
+    stats->written = (sdrio_uint32)sdrio_stats_load(&pre->written);
+    stats->failed = (sdrio_uint32)sdrio_stats_load(&pre->failed);
+    stats->samples_held = (held < pre->capacity) ? held : pre->capacity;
+    stats->armed = pre->armed;
+    stats->writing = pre->writing;
+}
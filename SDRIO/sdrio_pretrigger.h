@@ -0,0 +1,124 @@
+// Copyright Scott Cutler
+// This source file is licensed under the GNU Lesser General Public License (LGPL)
+
+#ifndef SDRIO_PRETRIGGER_H
+#define SDRIO_PRETRIGGER_H
+
+#include <time.h>
+
+#include "sdrio_ext.h"
+#include "sdrio_pool.h"
+#include "sdrio_record.h"
+
+#include "pthread.h"
+#include "semaphore.h"
+
+// Retunes, gain changes and gaps remembered for the captures' metadata.  A
+// capture spanning more than this many starts from the oldest one kept.
+#define SDRIO_PRETRIGGER_MAX_TAGS 256
+
+// Pool blocks are sized in 32 bits, and a 32 bit process has little more
+// address space than this to spare anyway.
+#define SDRIO_PRETRIGGER_MAX_BYTES (1024*1024*1024)
+
+// A capture handed to the writer thread.
+typedef struct sdrio_pretrigger_job_t
+{
+    sdrio_uint64 first;                 // history counter of its first sample
+    sdrio_uint64 count;
+    sdrio_uint64 trigger;               // samples in that the trigger came
+    const char *reason;                 // annotation label
+    sdrio_uint32 number;                // in the file name
+    time_t end_time;                    // when the last sample came in
+    sdrio_record_capture captures[SDRIO_PRETRIGGER_MAX_TAGS];
+    sdrio_uint32 num_captures;          // sample_start relative to first
+} sdrio_pretrigger_job;
+
+// Keeps a ring of the most recent pre + post seconds of native samples and,
+// when a trigger comes, keeps filling it for post more seconds and then
+// hands the whole window to a writer thread as one capture.  The producer
+// only copies samples into the ring (and sums power while the power trigger
+// is on); it doesn't store anything while the writer has the ring, so it
+// never waits on the disk.
+//
+// Samples are counted from arming with a history counter that stops while
+// the ring is frozen, so a sample's place in the ring is its count modulo
+// the capacity.
+typedef struct sdrio_pretrigger_t
+{
+    char path[SDRIO_RECORD_MAX_PATH];   // without the number and extension
+    char hw[256];
+    sdrio_format_desc format;
+    sdrio_uint64 sample_rate;
+
+    sdrio_pool pool;
+    sdrio_uint8 *ring;
+    sdrio_uint64 capacity;              // samples
+    sdrio_uint64 post_samples;
+
+    sdrio_uint64 stored;                // history counter
+    sdrio_uint64 base;                  // history from here on is in the ring
+    sdrio_uint64 trigger_at;
+    const char *reason;
+    volatile sdrio_uint8 armed;
+    sdrio_uint8 triggered;              // filling the post trigger samples
+    volatile sdrio_uint8 writing;
+    volatile sdrio_uint8 requested;     // sdrio_pretrigger_request since the last block
+    sdrio_uint8 gap;
+
+    sdrio_record_capture tags[SDRIO_PRETRIGGER_MAX_TAGS];
+    sdrio_uint32 num_tags;              // ever, tags[num_tags % MAX] is the next
+
+    volatile sdrio_float32 threshold;   // linear mean power
+    volatile sdrio_uint32 window;       // samples, 0 when off
+    sdrio_float64 power;                // of the window being summed
+    sdrio_uint32 power_count;
+
+    pthread_mutex_t lock;               // the producer against start, stop and the writer
+    sem_t ready;
+    pthread_t tid;
+    volatile sdrio_uint8 running;
+    sdrio_pretrigger_job job;
+
+    volatile sdrio_int64 triggers;
+    volatile sdrio_int64 missed;
+    volatile sdrio_int64 written;
+    volatile sdrio_int64 failed;
+} sdrio_pretrigger;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    void sdrio_pretrigger_init(sdrio_pretrigger *pre);
+    void sdrio_pretrigger_free(sdrio_pretrigger *pre);
+
+    // Allocates the ring for format at sample_rate and arms.  frequency and
+    // gain are where the stream is now; hw can be null.
+    sdrio_int32 sdrio_pretrigger_start(sdrio_pretrigger *pre, const char *path, sdrio_float64 pre_seconds, sdrio_float64 post_seconds,
+                                       const sdrio_format_desc *format, sdrio_uint64 sample_rate, sdrio_uint64 frequency, sdrio_float32 gain, const char *hw);
+
+    // Power in dBFS, as the spectrum reports it.  Any time.
+    void sdrio_pretrigger_set_power(sdrio_pretrigger *pre, sdrio_float32 threshold, sdrio_uint32 window);
+
+    // Any thread.  Returns 0 if not armed, or the trigger is missed because
+    // a capture is still being written.
+    sdrio_int32 sdrio_pretrigger_request(sdrio_pretrigger *pre);
+
+    // Producer side; does nothing unless started.
+    void sdrio_pretrigger_feed(sdrio_pretrigger *pre, const void *samples, sdrio_uint32 num_samples, sdrio_uint64 frequency, sdrio_float32 gain);
+
+    // Samples went missing before the next block fed.
+    void sdrio_pretrigger_mark_gap(sdrio_pretrigger *pre);
+
+    // Writes out a capture that has been triggered, waits for the writer and
+    // frees the ring.
+    void sdrio_pretrigger_stop(sdrio_pretrigger *pre);
+
+    void sdrio_pretrigger_get_stats(sdrio_pretrigger *pre, sdrio_pretrigger_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SDRIO_PRETRIGGER_H
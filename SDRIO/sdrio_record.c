@@ -0,0 +1,544 @@
+// Copyright Scott Cutler
+// This source file is licensed under the GNU Lesser General Public License (LGPL)
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#if !defined(_WIN32)
+#define _GNU_SOURCE             // O_DIRECT
+#define _FILE_OFFSET_BITS 64
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "sdrio_record.h"
+#include "sdrio_stats.h"
+
+const char * sdrio_record_datatype(sdrio_sample_format format)
+{
+    switch (format)
+    {
+    case sdrio_sample_format_cu8:     return "cu8";
+    case sdrio_sample_format_cs8:     return "ci8";
+    case sdrio_sample_format_cs16:    return "ci16_le";
+    case sdrio_sample_format_sc16q12: return "ci16_le";     // 12 bit values in 16 bit containers
+    case sdrio_sample_format_cf32:    return "cf32_le";
+    default:                          return 0;
+    }
+}
+
+void sdrio_recorder_init(sdrio_recorder *rec)
+{
+    memset(rec, 0, sizeof(sdrio_recorder));
+    rec->fd = -1;
+    pthread_mutex_init(&rec->lock, 0);
+}
+
+void sdrio_recorder_free(sdrio_recorder *rec)
+{
+    sdrio_recorder_stop(rec);
+    pthread_mutex_destroy(&rec->lock);
+}
+
+static void write_string(FILE *file, const char *s)
+{
+    fputc('"', file);
+    for (; *s; s++)
+    {
+        if ((*s == '"') || (*s == '\\'))
+        {
+            fprintf(file, "\\%c", *s);
+        }
+        else if ((unsigned char)*s < 0x20)
+        {
+            fprintf(file, "\\u%04x", (unsigned char)*s);
+        }
+        else
+        {
+            fputc(*s, file);
+        }
+    }
+    fputc('"', file);
+}
+
+sdrio_int32 sdrio_record_write_meta(const char *path, const sdrio_format_desc *format, sdrio_uint64 sample_rate, const char *hw, const char *datetime,
+                                    const sdrio_record_capture *captures, sdrio_uint32 num_captures, const char *annotation, sdrio_uint64 annotation_start)
+{
+    char meta_path[SDRIO_RECORD_MAX_PATH + 16];
+    sdrio_uint32 i;
+    const sdrio_record_capture *capture;
+    FILE *file;
+
+    sprintf(meta_path, "%s.sigmf-meta", path);
+    file = fopen(meta_path, "w");
+    if (!file)
+    {
+        return 0;
+    }
+
+    fprintf(file, "{\n    \"global\": {\n");
+    fprintf(file, "        \"core:datatype\": \"%s\",\n", sdrio_record_datatype(format->format));
+    fprintf(file, "        \"core:sample_rate\": %llu,\n", (unsigned long long)sample_rate);
+    fprintf(file, "        \"core:version\": \"1.0.0\",\n");
+    fprintf(file, "        \"core:recorder\": \"SDRIO\",\n");
+    if (hw && hw[0])
+    {
+        fprintf(file, "        \"core:hw\": ");
+        write_string(file, hw);
+        fprintf(file, ",\n");
+    }
+    fprintf(file, "        \"core:extensions\": [{\"name\": \"sdrio\", \"version\": \"1.0.0\", \"optional\": true}]\n");
+    fprintf(file, "    },\n    \"captures\": [\n");
+
+    for (i = 0; i < num_captures; i++)
+    {
+        capture = &captures[i];
+        fprintf(file, "        {\n            \"core:sample_start\": %llu,\n", (unsigned long long)capture->sample_start);
+        if (capture->frequency)
+        {
+            fprintf(file, "            \"core:frequency\": %llu,\n", (unsigned long long)capture->frequency);
+        }
+        if (!i)
+        {
+            fprintf(file, "            \"core:datetime\": \"%s\",\n", datetime);
+        }
+        fprintf(file, "            \"sdrio:gain\": %g\n        }%s\n", capture->gain, (i + 1 < num_captures) ? "," : "");
+    }
+
+    fprintf(file, "    ],\n    \"annotations\": [");
+    if (annotation)
+    {
+        fprintf(file, "\n        {\n            \"core:sample_start\": %llu,\n            \"core:label\": ", (unsigned long long)annotation_start);
+        write_string(file, annotation);
+        fprintf(file, "\n        }\n    ");
+    }
+    fprintf(file, "]\n}\n");
+    return fclose(file) == 0;
+}
+
+static sdrio_int32 write_meta(sdrio_recorder *rec)
+{
+    return sdrio_record_write_meta(rec->path, &rec->format, rec->sample_rate, rec->hw, rec->datetime, rec->captures, rec->num_captures, 0, 0);
+}
+
+static sdrio_int32 open_data(sdrio_recorder *rec)
+{
+    char path[SDRIO_RECORD_MAX_PATH + 16];
+#if defined(_WIN32)
+    HANDLE file;
+
+    sprintf(path, "%s.sigmf-data", rec->path);
+
+    file = CreateFileA(path, GENERIC_WRITE, FILE_SHARE_READ, 0, CREATE_ALWAYS, FILE_FLAG_NO_BUFFERING | FILE_FLAG_SEQUENTIAL_SCAN, 0);
+    rec->unbuffered = (file != INVALID_HANDLE_VALUE);
+    if (!rec->unbuffered)
+    {
+        file = CreateFileA(path, GENERIC_WRITE, FILE_SHARE_READ, 0, CREATE_ALWAYS, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+    }
+
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return 0;
+    }
+
+    rec->file = (void *)file;
+#else
+    int fd = -1;
+
+    sprintf(path, "%s.sigmf-data", rec->path);
+
+    // Some file systems (tmpfs among them) refuse O_DIRECT.
+#if defined(O_DIRECT)
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+#endif
+    rec->unbuffered = (fd >= 0);
+    if (!rec->unbuffered)
+    {
+        fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+
+    if (fd < 0)
+    {
+        return 0;
+    }
+
+    rec->fd = fd;
+#endif
+
+    return 1;
+}
+
+// Trims the padding off the last unbuffered write.
+static void close_data(sdrio_recorder *rec)
+{
+#if defined(_WIN32)
+    char path[SDRIO_RECORD_MAX_PATH + 16];
+    LARGE_INTEGER size;
+    HANDLE file;
+
+    if (!rec->file)
+    {
+        return;
+    }
+
+    CloseHandle((HANDLE)rec->file);
+    rec->file = 0;
+
+    if (rec->unbuffered && (rec->file_bytes % SDRIO_RECORD_ALIGNMENT))
+    {
+        // Unbuffered handles can only move the end of file to a sector
+        // boundary, so trim through an ordinary one.
+        sprintf(path, "%s.sigmf-data", rec->path);
+        file = CreateFileA(path, GENERIC_WRITE, FILE_SHARE_READ, 0, OPEN_EXISTING, 0, 0);
+        if (file != INVALID_HANDLE_VALUE)
+        {
+            size.QuadPart = (LONGLONG)rec->file_bytes;
+            if (SetFilePointerEx(file, size, 0, FILE_BEGIN))
+            {
+                SetEndOfFile(file);
+            }
+            CloseHandle(file);
+        }
+    }
+#else
+    if (rec->fd < 0)
+    {
+        return;
+    }
+
+    if (rec->unbuffered && ftruncate(rec->fd, (off_t)rec->file_bytes))
+    {
+        rec->failed = 1;
+    }
+
+    close(rec->fd);
+    rec->fd = -1;
+#endif
+}
+
+static sdrio_int32 write_all(sdrio_recorder *rec, const sdrio_uint8 *data, sdrio_uint32 bytes)
+{
+#if defined(_WIN32)
+    DWORD written;
+
+    while (bytes)
+    {
+        if (!WriteFile((HANDLE)rec->file, data, bytes, &written, 0) || !written)
+        {
+            return 0;
+        }
+
+        data += written;
+        bytes -= written;
+    }
+#else
+    ssize_t written;
+
+    while (bytes)
+    {
+        written = write(rec->fd, data, bytes);
+        if ((written < 0) && (errno == EINTR))
+        {
+            continue;
+        }
+
+        if (written <= 0)
+        {
+            return 0;
+        }
+
+        data += written;
+        bytes -= (sdrio_uint32)written;
+    }
+#endif
+
+    return 1;
+}
+
+static void * writer_routine(void *ctx)
+{
+    sdrio_recorder *rec = (sdrio_recorder *)ctx;
+    sdrio_uint32 next = 0, length, padded;
+
+    for (;;)
+    {
+        sem_wait(&rec->ready);
+
+        // Buffers are posted in turn, and stop posts once more after the
+        // last one, which finds nothing waiting.
+        length = rec->lengths[next];
+        if (!length)
+        {
+            break;
+        }
+
+        // Only the last buffer can be part full.
+        padded = length;
+        if (rec->unbuffered)
+        {
+            padded = (length + SDRIO_RECORD_ALIGNMENT - 1) & ~(SDRIO_RECORD_ALIGNMENT - 1);
+            memset(rec->buffers[next] + length, 0, padded - length);
+        }
+
+        if (!rec->failed && !write_all(rec, rec->buffers[next], padded))
+        {
+            rec->failed = 1;
+        }
+
+        if (rec->failed)
+        {
+            sdrio_stats_add(&rec->samples_dropped, length / rec->format.bytes_per_sample);
+        }
+        else
+        {
+            rec->file_bytes += length;
+            sdrio_stats_add(&rec->samples_written, length / rec->format.bytes_per_sample);
+        }
+
+        rec->lengths[next] = 0;
+        next ^= 1;
+    }
+
+    return 0;
+}
+
+sdrio_int32 sdrio_recorder_start(sdrio_recorder *rec, const char *path, const sdrio_format_desc *format, sdrio_uint8 native, sdrio_uint64 sample_rate, sdrio_uint64 frequency, sdrio_float32 gain, const char *hw)
+{
+    sdrio_uint64 bytes;
+    sdrio_uint8 *base;
+    time_t now;
+    struct tm *utc;
+
+    if (rec->recording || !sdrio_record_datatype(format->format) || !sample_rate || (strlen(path) >= SDRIO_RECORD_MAX_PATH))
+    {
+        return 0;
+    }
+
+    bytes = (sdrio_uint64)(sample_rate * format->bytes_per_sample * SDRIO_RECORD_BUFFER_SECONDS);
+    if (bytes < SDRIO_RECORD_MIN_BUFFER)
+    {
+        bytes = SDRIO_RECORD_MIN_BUFFER;
+    }
+    else if (bytes > SDRIO_RECORD_MAX_BUFFER)
+    {
+        bytes = SDRIO_RECORD_MAX_BUFFER;
+    }
+
+    // A whole number of pages, which every sample size divides.
+    rec->buffer_bytes = (sdrio_uint32)((bytes + SDRIO_RECORD_ALIGNMENT - 1) & ~(sdrio_uint64)(SDRIO_RECORD_ALIGNMENT - 1));
+    if (!sdrio_pool_init(&rec->pool, 1, 2 * rec->buffer_bytes + SDRIO_RECORD_ALIGNMENT, 0))
+    {
+        return 0;
+    }
+
+    base = (sdrio_uint8 *)sdrio_pool_block(&rec->pool, 0);
+    rec->buffers[0] = base + ((SDRIO_RECORD_ALIGNMENT - ((size_t)base & (SDRIO_RECORD_ALIGNMENT - 1))) & (SDRIO_RECORD_ALIGNMENT - 1));
+    rec->buffers[1] = rec->buffers[0] + rec->buffer_bytes;
+
+    strcpy(rec->path, path);
+    rec->hw[0] = 0;
+    if (hw)
+    {
+        strncpy(rec->hw, hw, sizeof(rec->hw) - 1);
+        rec->hw[sizeof(rec->hw) - 1] = 0;
+    }
+
+    now = time(0);
+    utc = gmtime(&now);
+    strftime(rec->datetime, sizeof(rec->datetime), "%Y-%m-%dT%H:%M:%SZ", utc);
+
+    rec->format = *format;
+    rec->native = native;
+    rec->sample_rate = sample_rate;
+    rec->file_bytes = 0;
+    rec->lengths[0] = rec->lengths[1] = 0;
+    rec->current = 0;
+    rec->fill = 0;
+    rec->failed = 0;
+    rec->gap = 0;
+    rec->samples_queued = 0;
+    sdrio_stats_store(&rec->samples_written, 0);
+    sdrio_stats_store(&rec->samples_dropped, 0);
+
+    rec->captures[0].sample_start = 0;
+    rec->captures[0].frequency = frequency;
+    rec->captures[0].gain = gain;
+    rec->num_captures = 1;
+
+    if (!open_data(rec))
+    {
+        sdrio_pool_free(&rec->pool);
+        return 0;
+    }
+
+    if (!write_meta(rec))
+    {
+        close_data(rec);
+        sdrio_pool_free(&rec->pool);
+        return 0;
+    }
+
+    sem_init(&rec->ready, 0, 0);
+    if (pthread_create(&rec->tid, 0, writer_routine, (void *)rec) != 0)
+    {
+        sem_destroy(&rec->ready);
+        close_data(rec);
+        sdrio_pool_free(&rec->pool);
+        return 0;
+    }
+
+    pthread_mutex_lock(&rec->lock);
+    rec->recording = 1;
+    pthread_mutex_unlock(&rec->lock);
+    return 1;
+}
+
+static void drop(sdrio_recorder *rec, sdrio_uint32 num_samples)
+{
+    sdrio_stats_add(&rec->samples_dropped, num_samples);
+    rec->gap = 1;
+}
+
+void sdrio_recorder_feed(sdrio_recorder *rec, const void *samples, sdrio_uint32 num_samples, sdrio_uint64 frequency, sdrio_float32 gain)
+{
+    const sdrio_uint8 *in = (const sdrio_uint8 *)samples;
+    sdrio_uint32 bytes_per_sample, bytes, n;
+    sdrio_record_capture *last;
+
+    if (!rec->recording)
+    {
+        return;
+    }
+
+    // Only start and stop take the lock, and only briefly, but even that
+    // isn't worth waiting for here.
+    if (pthread_mutex_trylock(&rec->lock) != 0)
+    {
+        drop(rec, num_samples);
+        return;
+    }
+
+    if (!rec->recording)
+    {
+        pthread_mutex_unlock(&rec->lock);
+        return;
+    }
+
+    if (rec->failed)
+    {
+        drop(rec, num_samples);
+        pthread_mutex_unlock(&rec->lock);
+        return;
+    }
+
+    last = &rec->captures[rec->num_captures - 1];
+    if (rec->gap || (frequency != last->frequency) || (gain != last->gain))
+    {
+        // Segments that never got a sample are replaced rather than kept.
+        if ((last->sample_start != rec->samples_queued) && (rec->num_captures < SDRIO_RECORD_MAX_CAPTURES))
+        {
+            last = &rec->captures[rec->num_captures];
+            rec->num_captures++;
+        }
+
+        last->sample_start = rec->samples_queued;
+        last->frequency = frequency;
+        last->gain = gain;
+        rec->gap = 0;
+    }
+
+    bytes_per_sample = rec->format.bytes_per_sample;
+    bytes = num_samples * bytes_per_sample;
+
+    while (bytes)
+    {
+        if (rec->lengths[rec->current])
+        {
+            // Both buffers are waiting on the disk.
+            drop(rec, bytes / bytes_per_sample);
+            break;
+        }
+
+        n = rec->buffer_bytes - rec->fill;
+        if (n > bytes)
+        {
+            n = bytes;
+        }
+
+        memcpy(rec->buffers[rec->current] + rec->fill, in, n);
+        rec->fill += n;
+        rec->samples_queued += n / bytes_per_sample;
+        in += n;
+        bytes -= n;
+
+        if (rec->fill == rec->buffer_bytes)
+        {
+            rec->lengths[rec->current] = rec->fill;
+            sem_post(&rec->ready);
+            rec->current ^= 1;
+            rec->fill = 0;
+        }
+    }
+
+    pthread_mutex_unlock(&rec->lock);
+}
+
+void sdrio_recorder_mark_gap(sdrio_recorder *rec)
+{
+    if (rec->recording)
+    {
+        rec->gap = 1;
+    }
+}
+
+sdrio_int32 sdrio_recorder_stop(sdrio_recorder *rec)
+{
+    sdrio_int32 ok;
+
+    if (!rec->recording)
+    {
+        return 1;
+    }
+
+    pthread_mutex_lock(&rec->lock);
+    rec->recording = 0;
+
+    // The buffer being filled is never one the writer still has.
+    if (rec->fill)
+    {
+        rec->lengths[rec->current] = rec->fill;
+        sem_post(&rec->ready);
+        rec->current ^= 1;
+        rec->fill = 0;
+    }
+    pthread_mutex_unlock(&rec->lock);
+
+    sem_post(&rec->ready);
+    pthread_join(rec->tid, 0);
+    sem_destroy(&rec->ready);
+
+    close_data(rec);
+    ok = !rec->failed && write_meta(rec);
+    sdrio_pool_free(&rec->pool);
+    return ok;
+}
+
+void sdrio_recorder_get_stats(sdrio_recorder *rec, sdrio_recording_stats *stats)
+{
+    stats->samples_written = sdrio_stats_load(&rec->samples_written);
+    stats->samples_dropped = sdrio_stats_load(&rec->samples_dropped);
+    stats->captures = rec->num_captures;
+    stats->recording = rec->recording;
+    stats->unbuffered = rec->unbuffered;
+    stats->failed = rec->failed;
+}
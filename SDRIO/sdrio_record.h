@@ -0,0 +1,123 @@
+// Copyright Scott Cutler
+// This source file is licensed under the GNU Lesser General Public License (LGPL)
+
+#ifndef SDRIO_RECORD_H
+#define SDRIO_RECORD_H
+
+#include "sdrio_ext.h"
+#include "sdrio_pool.h"
+
+#include "pthread.h"
+#include "semaphore.h"
+
+#define SDRIO_RECORD_MAX_PATH 260
+#define SDRIO_RECORD_MAX_CAPTURES 1024
+
+// Unbuffered writes have to start, end and sit in memory on sector
+// boundaries; a page covers every sector size in use.
+#define SDRIO_RECORD_ALIGNMENT 4096
+
+// Each buffer holds this long at the recorded rate, within the limits, so
+// the disk can stall for about that long before anything is dropped.
+#define SDRIO_RECORD_BUFFER_SECONDS 0.5
+#define SDRIO_RECORD_MIN_BUFFER (1024*1024)
+#define SDRIO_RECORD_MAX_BUFFER (64*1024*1024)
+
+// A SigMF capture segment: where the frequency or gain changed, or where
+// samples went missing.
+typedef struct sdrio_record_capture_t
+{
+    sdrio_uint64 sample_start;
+    sdrio_uint64 frequency;
+    sdrio_float32 gain;
+} sdrio_record_capture;
+
+// Writes a sample stream to a SigMF recording.  The producer copies each
+// block into the buffer being filled and, when it is full, hands it to a
+// writer thread and carries on in the other one.  If the other one is
+// still being written the block is dropped and a new capture segment
+// starts after the gap, so the producer never waits on the disk.
+//
+// The data file is opened unbuffered where the OS and file system allow
+// (O_DIRECT, or FILE_FLAG_NO_BUFFERING on Windows), so tens of MB/s of
+// samples don't churn the page cache; the last buffer is padded to the
+// alignment and the file trimmed back when the recording stops.
+//
+// Metadata is written when the recording starts and rewritten with every
+// capture segment when it stops.
+typedef struct sdrio_recorder_t
+{
+    char path[SDRIO_RECORD_MAX_PATH];   // without the extension
+    char hw[256];
+    char datetime[32];
+    sdrio_format_desc format;
+    sdrio_uint64 sample_rate;
+    sdrio_uint8 native;                 // fed with hardware blocks rather than delivered ones
+
+    void *file;                         // Windows HANDLE
+    int fd;
+    sdrio_uint8 unbuffered;
+    sdrio_uint64 file_bytes;            // written, without padding
+
+    sdrio_pool pool;
+    sdrio_uint8 *buffers[2];
+    sdrio_uint32 buffer_bytes;
+    volatile sdrio_uint32 lengths[2];   // bytes handed to the writer, 0 once written
+    sdrio_uint32 current;               // buffer the producer is filling
+    sdrio_uint32 fill;
+
+    pthread_mutex_t lock;               // the producer against start and stop
+    sem_t ready;
+    pthread_t tid;
+    volatile sdrio_uint8 recording;
+    volatile sdrio_uint8 failed;
+    volatile sdrio_uint8 gap;           // samples were lost since the last block fed
+
+    sdrio_record_capture captures[SDRIO_RECORD_MAX_CAPTURES];
+    volatile sdrio_uint32 num_captures;
+    sdrio_uint64 samples_queued;        // producer's count, where the next segment starts
+
+    volatile sdrio_int64 samples_written;
+    volatile sdrio_int64 samples_dropped;
+} sdrio_recorder;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    void sdrio_recorder_init(sdrio_recorder *rec);
+    void sdrio_recorder_free(sdrio_recorder *rec);
+
+    // Opens path.sigmf-data and writes path.sigmf-meta.  format is what will
+    // be fed, sample_rate its rate and frequency and gain where it starts.
+    // hw describes the device, for the metadata; it can be null.
+    sdrio_int32 sdrio_recorder_start(sdrio_recorder *rec, const char *path, const sdrio_format_desc *format, sdrio_uint8 native, sdrio_uint64 sample_rate, sdrio_uint64 frequency, sdrio_float32 gain, const char *hw);
+
+    // Producer side; does nothing unless started.  A block that starts after
+    // lost samples (see sdrio_recorder_mark_gap) or at a new frequency or gain
+    // starts a new capture segment.
+    void sdrio_recorder_feed(sdrio_recorder *rec, const void *samples, sdrio_uint32 num_samples, sdrio_uint64 frequency, sdrio_float32 gain);
+
+    // Samples went missing before the next block fed.
+    void sdrio_recorder_mark_gap(sdrio_recorder *rec);
+
+    // Writes out what is buffered, closes the data file and rewrites the
+    // metadata.  Returns 0 if a write failed along the way.
+    sdrio_int32 sdrio_recorder_stop(sdrio_recorder *rec);
+
+    void sdrio_recorder_get_stats(sdrio_recorder *rec, sdrio_recording_stats *stats);
+
+    // The SigMF core:datatype for format, or null if it has none.
+    const char * sdrio_record_datatype(sdrio_sample_format format);
+
+    // Writes path.sigmf-meta for a recording of format at sample_rate that
+    // started at datetime (ISO 8601 UTC).  hw can be null.  annotation, if
+    // not null, labels the sample at annotation_start.
+    sdrio_int32 sdrio_record_write_meta(const char *path, const sdrio_format_desc *format, sdrio_uint64 sample_rate, const char *hw, const char *datetime,
+                                        const sdrio_record_capture *captures, sdrio_uint32 num_captures, const char *annotation, sdrio_uint64 annotation_start);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SDRIO_RECORD_H
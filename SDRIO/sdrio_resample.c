@@ -0,0 +1,337 @@
+// Copyright Scott Cutler
+// This source file is licensed under the GNU Lesser General Public License (LGPL)
+
+#include <math.h>
+#include <string.h>
+
+#include "sdrio_resample.h"
+#include "sdrio_convert.h"
+
+#include "pthread.h"
+
+#define PI 3.14159265358979323846
+
+// Passband edge and stopband start as fractions of the output rate, matching
+// the decimator: anything that aliases lands above the passband.
+#define SDRIO_RESAMPLE_PASSBAND 0.4
+#define SDRIO_RESAMPLE_STOPBAND 0.6
+#define SDRIO_RESAMPLE_ATTENUATION 60.0     // dB
+
+static sdrio_resample_bank banks[SDRIO_RESAMPLE_CACHE];
+static sdrio_uint32 bank_clock;
+static pthread_mutex_t bank_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static sdrio_uint64 gcd(sdrio_uint64 a, sdrio_uint64 b)
+{
+    sdrio_uint64 t;
+
+    while (b)
+    {
+        t = a % b;
+        a = b;
+        b = t;
+    }
+
+    return a;
+}
+
+// Reduces sample_rate * factor / hw_rate; fails if the result is too fine
+// grained for the bank.
+static sdrio_int32 reduce(sdrio_uint64 sample_rate, sdrio_uint32 factor, sdrio_uint64 hw_rate, sdrio_uint32 *interp, sdrio_uint32 *decim)
+{
+    sdrio_uint64 num = sample_rate * factor;
+    sdrio_uint64 g = gcd(num, hw_rate);
+
+    if ((num >= hw_rate) || (num / g > SDRIO_RESAMPLE_MAX_PHASES) || (hw_rate / g > 0xffffffff))
+    {
+        return 0;
+    }
+
+    *interp = (sdrio_uint32)(num / g);
+    *decim = (sdrio_uint32)(hw_rate / g);
+    return 1;
+}
+
+// The largest decimation that leaves hw_rate at or above sample_rate, then a
+// resampler for the remaining ratio, which is between 1/2 and 1.
+static sdrio_int32 plan_from(sdrio_uint64 sample_rate, sdrio_uint64 hw_rate, sdrio_uint32 *factor, sdrio_uint32 *interp, sdrio_uint32 *decim)
+{
+    sdrio_uint32 f, cic, halfbands;
+
+    for (f=SDRIO_DECIMATE_MAX_FACTOR; f>=1; f--)
+    {
+        if ((sample_rate * f <= hw_rate) && sdrio_decimate_split(f, &cic, &halfbands))
+        {
+            if (reduce(sample_rate, f, hw_rate, interp, decim))
+            {
+                *factor = f;
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+sdrio_int32 sdrio_resample_plan(sdrio_uint64 sample_rate, const sdrio_uint32 *rates, sdrio_uint32 num_rates, sdrio_uint64 min_rate, sdrio_uint64 max_rate, sdrio_uint64 *hw_rate, sdrio_uint32 *factor, sdrio_uint32 *interp, sdrio_uint32 *decim)
+{
+    sdrio_uint64 candidate, best = 0;
+    sdrio_uint32 f, l, m, i;
+
+    if (sdrio_decimate_plan(sample_rate, rates, num_rates, min_rate, max_rate, hw_rate, factor))
+    {
+        *interp = 1;
+        *decim = 1;
+        return 1;
+    }
+
+    // Lowest hardware rate that works, to keep the USB load down.  Of a
+    // continuous range only the ends are worth trying: anything inside it
+    // that worked would have been an exact decimation.
+    for (i=0; i<num_rates + 2; i++)
+    {
+        candidate = (i < num_rates) ? rates[i] : ((i == num_rates) ? min_rate : max_rate);
+
+        if (candidate && (!best || (candidate < best)) && plan_from(sample_rate, candidate, &f, &l, &m))
+        {
+            best = candidate;
+            *hw_rate = candidate;
+            *factor = f;
+            *interp = l;
+            *decim = m;
+        }
+    }
+
+    return (best != 0);
+}
+
+static double bessel_i0(double x)
+{
+    double sum = 1.0, term = 1.0;
+    sdrio_uint32 k;
+
+    for (k=1; k<32; k++)
+    {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+    }
+
+    return sum;
+}
+
+// Kaiser windowed sinc at interp times the input rate, cut off halfway
+// between passband and stopband, scaled by interp to make up for the zeros
+// the polyphase form skips.
+static void design_bank(sdrio_resample_bank *bank)
+{
+    sdrio_uint32 l = bank->interp;
+    sdrio_uint32 t = bank->num_taps;
+    sdrio_uint32 span = l * t;
+    double c = (span - 1) / 2.0;
+    double fc = (SDRIO_RESAMPLE_PASSBAND + SDRIO_RESAMPLE_STOPBAND) / 2 / bank->decim;
+    double beta = 0.1102 * (SDRIO_RESAMPLE_ATTENUATION - 8.7);
+    double i0_beta = bessel_i0(beta);
+    double sum = 0.0, x, r, h;
+    sdrio_uint32 n, p, j;
+
+    for (n=0; n<span; n++)
+    {
+        x = n - c;
+        r = 2 * x / (span - 1);
+        h = (x == 0.0) ? 2 * fc : sin(2 * PI * fc * x) / (PI * x);
+        sum += h * bessel_i0(beta * sqrt(1 - r * r)) / i0_beta;
+    }
+
+    // Phase p, lane j holds h[(t - 1 - j) l + p], so the kernel walks the
+    // window forwards.
+    for (p=0; p<l; p++)
+    {
+        for (j=0; j<t; j++)
+        {
+            n = (t - 1 - j) * l + p;
+            x = n - c;
+            r = 2 * x / (span - 1);
+            h = (x == 0.0) ? 2 * fc : sin(2 * PI * fc * x) / (PI * x);
+            h *= bessel_i0(beta * sqrt(1 - r * r)) / i0_beta * l / sum;
+            bank->taps[2 * (p * t + j)] = (sdrio_float32)h;
+            bank->taps[2 * (p * t + j) + 1] = (sdrio_float32)h;
+        }
+    }
+}
+
+// Kaiser's estimate of the length for the transition band, spread over the
+// phases and rounded up to what the fir kernels take.
+static sdrio_uint32 taps_per_phase(sdrio_uint32 interp, sdrio_uint32 decim)
+{
+    double width = (SDRIO_RESAMPLE_STOPBAND - SDRIO_RESAMPLE_PASSBAND) / decim;
+    double span = (SDRIO_RESAMPLE_ATTENUATION - 8.0) / (2.285 * 2 * PI * width);
+    sdrio_uint32 t = (sdrio_uint32)ceil(span / interp);
+
+    t = (t + 3) & ~3;
+    return (t > SDRIO_RESAMPLE_MAX_TAPS) ? SDRIO_RESAMPLE_MAX_TAPS : t;
+}
+
+// Finds or builds the bank for interp / decim.  A free slot, or else the
+// least recently used bank nobody holds, is reused for a new ratio.
+static sdrio_resample_bank * acquire_bank(sdrio_uint32 interp, sdrio_uint32 decim)
+{
+    sdrio_resample_bank *bank = 0;
+    sdrio_uint32 i;
+
+    pthread_mutex_lock(&bank_lock);
+
+    for (i=0; i<SDRIO_RESAMPLE_CACHE; i++)
+    {
+        if (banks[i].taps && (banks[i].interp == interp) && (banks[i].decim == decim))
+        {
+            bank = &banks[i];
+            break;
+        }
+    }
+
+    if (!bank)
+    {
+        for (i=0; i<SDRIO_RESAMPLE_CACHE; i++)
+        {
+            if (!banks[i].refs && (!bank || !banks[i].taps || (bank->taps && (banks[i].last_used < bank->last_used))))
+            {
+                bank = &banks[i];
+            }
+        }
+
+        if (bank)
+        {
+            sdrio_pool_free(&bank->pool);
+            memset(bank, 0, sizeof(sdrio_resample_bank));
+
+            bank->interp = interp;
+            bank->decim = decim;
+            bank->num_taps = taps_per_phase(interp, decim);
+
+            if (sdrio_pool_init(&bank->pool, 1, interp * bank->num_taps * 2 * sizeof(sdrio_float32), 0))
+            {
+                bank->taps = (sdrio_float32 *)sdrio_pool_block(&bank->pool, 0);
+                design_bank(bank);
+            }
+            else
+            {
+                bank = 0;
+            }
+        }
+    }
+
+    if (bank)
+    {
+        bank->refs++;
+        bank->last_used = ++bank_clock;
+    }
+
+    pthread_mutex_unlock(&bank_lock);
+    return bank;
+}
+
+static void release_bank(sdrio_resample_bank *bank)
+{
+    pthread_mutex_lock(&bank_lock);
+    bank->refs--;
+    pthread_mutex_unlock(&bank_lock);
+}
+
+sdrio_int32 sdrio_resampler_init(sdrio_resampler *rs, sdrio_uint32 interp, sdrio_uint32 decim)
+{
+    sdrio_uint32 features = sdrio_get_cpu_features();
+    sdrio_uint32 span;
+
+    memset(rs, 0, sizeof(sdrio_resampler));
+    rs->interp = 1;
+    rs->decim = 1;
+
+    if ((interp == decim) && (interp == 1))
+    {
+        return 1;
+    }
+
+    if (!interp || (interp >= decim) || (interp > SDRIO_RESAMPLE_MAX_PHASES) || (gcd(interp, decim) != 1))
+    {
+        return 0;
+    }
+
+    rs->bank = acquire_bank(interp, decim);
+    if (!rs->bank)
+    {
+        return 0;
+    }
+
+    span = rs->bank->num_taps;
+    rs->capacity = SDRIO_RESAMPLE_BUFFER + span;
+
+    if (!sdrio_pool_init(&rs->pool, 1, rs->capacity * sizeof(sdrio_iq), 0))
+    {
+        release_bank(rs->bank);
+        rs->bank = 0;
+        return 0;
+    }
+
+    rs->buffer = (sdrio_iq *)sdrio_pool_block(&rs->pool, 0);
+    memset(rs->buffer, 0, rs->capacity * sizeof(sdrio_iq));
+
+    rs->kernel = (features & SDRIO_CPU_AVX2) ? sdrio_fir_avx2 : ((features & SDRIO_CPU_SSE2) ? sdrio_fir_sse2 : sdrio_fir_scalar);
+    rs->fill = span - 1;
+    rs->next = span - 1;
+    rs->phase = 0;
+    rs->interp = interp;
+    rs->decim = decim;
+    return 1;
+}
+
+void sdrio_resampler_free(sdrio_resampler *rs)
+{
+    if (rs->bank)
+    {
+        release_bank(rs->bank);
+        rs->bank = 0;
+    }
+
+    sdrio_pool_free(&rs->pool);
+    rs->buffer = 0;
+    rs->interp = 1;
+    rs->decim = 1;
+}
+
+// Makes room for SDRIO_RESAMPLE_MAX_INPUT more samples by dropping the ones
+// no future window needs.
+sdrio_iq * sdrio_resampler_input(sdrio_resampler *rs)
+{
+    sdrio_uint32 shift;
+
+    if (rs->capacity - rs->fill < SDRIO_RESAMPLE_MAX_INPUT)
+    {
+        shift = rs->next - (rs->bank->num_taps - 1);
+        memmove(rs->buffer, rs->buffer + shift, (rs->fill - shift) * sizeof(sdrio_iq));
+        rs->fill -= shift;
+        rs->next -= shift;
+    }
+
+    return rs->buffer + rs->fill;
+}
+
+sdrio_uint32 sdrio_resampler_process(sdrio_resampler *rs, sdrio_uint32 num_samples, sdrio_iq *out)
+{
+    const sdrio_resample_bank *bank = rs->bank;
+    sdrio_uint32 t = bank->num_taps;
+    sdrio_uint32 num_out = 0;
+
+    rs->fill += num_samples;
+
+    while (rs->next < rs->fill)
+    {
+        rs->kernel(bank->taps + 2 * rs->phase * t, t, rs->buffer + rs->next - (t - 1), 1, 1, out + num_out);
+        num_out++;
+
+        rs->phase += rs->decim;
+        rs->next += rs->phase / rs->interp;
+        rs->phase %= rs->interp;
+    }
+
+    return num_out;
+}
@@ -0,0 +1,76 @@
+// Copyright Scott Cutler
+// This source file is licensed under the GNU Lesser General Public License (LGPL)
+
+#ifndef SDRIO_RESAMPLE_H
+#define SDRIO_RESAMPLE_H
+
+#include "sdrio_ext.h"
+#include "sdrio_pool.h"
+#include "sdrio_decimate.h"
+
+#define SDRIO_RESAMPLE_MAX_PHASES 2048      // largest interpolation factor
+#define SDRIO_RESAMPLE_MAX_TAPS 64          // prototype taps per phase
+#define SDRIO_RESAMPLE_CACHE 4              // filter banks kept after their last user goes
+#define SDRIO_RESAMPLE_MAX_INPUT 256        // most samples fed to one process call
+#define SDRIO_RESAMPLE_BUFFER 4096
+
+// The prototype filter for one interp / decim ratio, split into interp
+// phases.  Designing it is the expensive part of changing rate, so banks are
+// shared and kept in a small cache.
+typedef struct sdrio_resample_bank_t
+{
+    sdrio_uint32 interp;
+    sdrio_uint32 decim;
+    sdrio_uint32 num_taps;      // per phase, a multiple of four
+    sdrio_float32 *taps;        // phase p at 2 * p * num_taps, fir kernel layout
+    sdrio_uint32 refs;
+    sdrio_uint32 last_used;
+    sdrio_pool pool;
+} sdrio_resample_bank;
+
+// Rational resampler: output rate is interp / decim times the input rate,
+// with interp < decim.  Output n is phase (n decim) mod interp of the bank
+// applied to the window ending at input (n decim) / interp, so only the taps
+// that meet a real input sample are ever multiplied.
+typedef struct sdrio_resampler_t
+{
+    sdrio_uint32 interp;
+    sdrio_uint32 decim;
+    sdrio_resample_bank *bank;
+    sdrio_fir_kernel_t kernel;
+
+    sdrio_uint32 phase;
+    sdrio_iq *buffer;
+    sdrio_uint32 capacity;
+    sdrio_uint32 fill;
+    sdrio_uint32 next;          // last sample of the next window
+    sdrio_pool pool;
+} sdrio_resampler;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    // Like sdrio_decimate_plan, but when no hardware rate divides down to
+    // sample_rate exactly it decimates to just above it and resamples the
+    // rest.  hw_rate * interp / (factor * decim) is always exactly
+    // sample_rate; interp and decim are both 1 when no resampling is needed.
+    sdrio_int32 sdrio_resample_plan(sdrio_uint64 sample_rate, const sdrio_uint32 *rates, sdrio_uint32 num_rates, sdrio_uint64 min_rate, sdrio_uint64 max_rate, sdrio_uint64 *hw_rate, sdrio_uint32 *factor, sdrio_uint32 *interp, sdrio_uint32 *decim);
+
+    // interp / decim must be in lowest terms.  1 / 1 passes samples through.
+    // On failure, and after free, the ratio is 1 / 1.
+    sdrio_int32 sdrio_resampler_init(sdrio_resampler *rs, sdrio_uint32 interp, sdrio_uint32 decim);
+    void sdrio_resampler_free(sdrio_resampler *rs);
+
+    // Where to write the next (at most SDRIO_RESAMPLE_MAX_INPUT) samples.
+    sdrio_iq * sdrio_resampler_input(sdrio_resampler *rs);
+
+    // Filters num_samples just written at sdrio_resampler_input and returns
+    // the number of outputs stored to out, never more than num_samples.
+    sdrio_uint32 sdrio_resampler_process(sdrio_resampler *rs, sdrio_uint32 num_samples, sdrio_iq *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SDRIO_RESAMPLE_H
@@ -0,0 +1,69 @@
+// Copyright Scott Cutler
+// This source file is licensed under the GNU Lesser General Public License (LGPL)
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "sdrio_ring.h"
+
+sdrio_int32 sdrio_ring_init(sdrio_ring *ring, sdrio_uint32 depth)
+{
+    sdrio_uint32 size = 1;
+
+    while (size < depth)
+    {
+        size <<= 1;
+    }
+
+    ring->head = 0;
+    ring->tail = 0;
+    ring->slots = (sdrio_ring_slot *)calloc(size, sizeof(sdrio_ring_slot));
+    ring->size = ring->slots ? size : 0;
+    ring->mask = ring->size - 1;
+
+    return ring->slots != 0;
+}
+
+void sdrio_ring_free(sdrio_ring *ring)
+{
+    free(ring->slots);
+    memset(ring, 0, sizeof(sdrio_ring));
+}
+
+sdrio_ring_slot * sdrio_ring_write_slot(sdrio_ring *ring)
+{
+    if (ring->head - ring->tail >= ring->size)
+    {
+        return 0;
+    }
+
+    return &ring->slots[ring->head & ring->mask];
+}
+
+void sdrio_ring_commit(sdrio_ring *ring)
+{
+    // The slot contents must be visible before the new head.
+    sdrio_ring_barrier();
+    ring->head = ring->head + 1;
+}
+
+sdrio_ring_slot * sdrio_ring_read_slot(sdrio_ring *ring)
+{
+    sdrio_ring_slot *slot;
+
+    if (ring->tail == ring->head)
+    {
+        return 0;
+    }
+
+    slot = &ring->slots[ring->tail & ring->mask];
+    sdrio_ring_barrier();
+
+    return slot;
+}
+
+void sdrio_ring_release(sdrio_ring *ring)
+{
+    sdrio_ring_barrier();
+    ring->tail = ring->tail + 1;
+}
@@ -0,0 +1,64 @@
+// Copyright Scott Cutler
+// This source file is licensed under the GNU Lesser General Public License (LGPL)
+
+#ifndef SDRIO_RING_H
+#define SDRIO_RING_H
+
+#include "sdrio_ext.h"
+
+#define SDRIO_CACHE_LINE 64
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+// x86 keeps stores in order, so only the compiler needs fencing.
+#define sdrio_ring_barrier() _ReadWriteBarrier()
+#else
+#define sdrio_ring_barrier() __sync_synchronize()
+#endif
+
+// data is owned by whoever filled in the slots, not the ring.
+typedef struct sdrio_ring_slot_t
+{
+    void *data;
+    sdrio_uint32 capacity;      // in samples
+    sdrio_uint32 num_samples;
+    sdrio_rx_meta meta;
+} sdrio_ring_slot;
+
+// Single producer / single consumer queue of sample blocks.  head is only
+// written by the producer and tail only by the consumer; each sits on its
+// own cache line so the two threads don't share one.
+typedef struct sdrio_ring_t
+{
+    volatile sdrio_uint32 head;
+    char pad0[SDRIO_CACHE_LINE - sizeof(sdrio_uint32)];
+
+    volatile sdrio_uint32 tail;
+    char pad1[SDRIO_CACHE_LINE - sizeof(sdrio_uint32)];
+
+    sdrio_ring_slot *slots;
+    sdrio_uint32 size;          // power of two
+    sdrio_uint32 mask;
+} sdrio_ring;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    // depth is rounded up to a power of two.
+    sdrio_int32 sdrio_ring_init(sdrio_ring *ring, sdrio_uint32 depth);
+    void sdrio_ring_free(sdrio_ring *ring);
+
+    // Producer: returns 0 when the ring is full.
+    sdrio_ring_slot * sdrio_ring_write_slot(sdrio_ring *ring);
+    void sdrio_ring_commit(sdrio_ring *ring);
+
+    // Consumer: returns 0 when the ring is empty.
+    sdrio_ring_slot * sdrio_ring_read_slot(sdrio_ring *ring);
+    void sdrio_ring_release(sdrio_ring *ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SDRIO_RING_H
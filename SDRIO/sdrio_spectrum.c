@@ -0,0 +1,318 @@
+// Copyright Scott Cutler
+// This source file is licensed under the GNU Lesser General Public License (LGPL)
+
+#include <math.h>
+#include <string.h>
+
+#include "sdrio_spectrum.h"
+
+#define PI 3.14159265358979323846
+
+static void * carve(sdrio_uint8 **mem, size_t bytes)
+{
+    void *p = *mem;
+    *mem += (bytes + SDRIO_POOL_ALIGNMENT - 1) & ~(size_t)(SDRIO_POOL_ALIGNMENT - 1);
+    return p;
+}
+
+static size_t carved(size_t bytes)
+{
+    return (bytes + SDRIO_POOL_ALIGNMENT - 1) & ~(size_t)(SDRIO_POOL_ALIGNMENT - 1);
+}
+
+// Periodic form, so overlapped frames tile evenly.
+static double window_value(sdrio_window window, sdrio_uint32 n, sdrio_uint32 size)
+{
+    double x = 2 * PI * n / size;
+
+    switch (window)
+    {
+    case sdrio_window_hann:
+        return 0.5 - 0.5 * cos(x);
+    case sdrio_window_blackman_harris:
+        return 0.35875 - 0.48829 * cos(x) + 0.14128 * cos(2 * x) - 0.01168 * cos(3 * x);
+    case sdrio_window_flattop:
+        return 0.21557895 - 0.41663158 * cos(x) + 0.277263158 * cos(2 * x) - 0.083578947 * cos(3 * x) + 0.006947368 * cos(4 * x);
+    default:
+        return 1.0;
+    }
+}
+
+void sdrio_spectrum_init(sdrio_spectrum *spec)
+{
+    memset(spec, 0, sizeof(sdrio_spectrum));
+}
+
+void sdrio_spectrum_free(sdrio_spectrum *spec)
+{
+    sdrio_spectrum_stop(spec);
+    sdrio_fft_free(&spec->fft);
+    sdrio_pool_free(&spec->plan_pool);
+    spec->coefficients = 0;
+}
+
+sdrio_int32 sdrio_spectrum_configure(sdrio_spectrum *spec, sdrio_uint32 size, sdrio_window window, sdrio_uint32 overlap, sdrio_uint32 averages, sdrio_rx_spectrum_callback callback, void *context)
+{
+    if (size && ((size < 2) || (size > SDRIO_SPECTRUM_MAX_SIZE) || (size & (size - 1)) || (overlap >= size) || !averages || !callback))
+    {
+        return 0;
+    }
+
+    spec->next.size = size;
+    spec->next.window = window;
+    spec->next.overlap = overlap;
+    spec->next.averages = averages;
+    spec->next.callback = callback;
+    spec->next.context = context;
+    return 1;
+}
+
+// Rebuilds the FFT, the window and everything sized by them, unless the last
+// start already built them for this size and window.
+static sdrio_int32 build_plan(sdrio_spectrum *spec)
+{
+    sdrio_uint32 size = spec->size;
+    sdrio_uint32 n;
+    size_t bytes;
+    sdrio_uint8 *mem;
+    double sum = 0.0;
+
+    if (spec->coefficients && (spec->fft.size == size) && (spec->plan_window == spec->window))
+    {
+        return 1;
+    }
+
+    sdrio_fft_free(&spec->fft);
+    sdrio_pool_free(&spec->plan_pool);
+    spec->coefficients = 0;
+
+    if (!sdrio_fft_init(&spec->fft, size))
+    {
+        return 0;
+    }
+
+    bytes = carved(size * sizeof(sdrio_float32))
+          + carved(size * sizeof(sdrio_iq))
+          + carved(size * sizeof(sdrio_float32))
+          + carved(size * sizeof(sdrio_float32))
+          + carved(size * sizeof(sdrio_iq));
+
+    if (!sdrio_pool_init(&spec->plan_pool, 1, (sdrio_uint32)bytes, 0))
+    {
+        sdrio_fft_free(&spec->fft);
+        return 0;
+    }
+
+    mem = (sdrio_uint8 *)sdrio_pool_block(&spec->plan_pool, 0);
+    spec->coefficients = (sdrio_float32 *)carve(&mem, size * sizeof(sdrio_float32));
+    spec->work = (sdrio_iq *)carve(&mem, size * sizeof(sdrio_iq));
+    spec->acc = (sdrio_float32 *)carve(&mem, size * sizeof(sdrio_float32));
+    spec->power = (sdrio_float32 *)carve(&mem, size * sizeof(sdrio_float32));
+    spec->pending = (sdrio_iq *)carve(&mem, size * sizeof(sdrio_iq));
+
+    for (n=0; n<size; n++)
+    {
+        sum += window_value(spec->window, n, size);
+    }
+
+    // Dividing by the coherent gain puts a full scale tone at 0 dB.
+    for (n=0; n<size; n++)
+    {
+        spec->coefficients[n] = (sdrio_float32)(window_value(spec->window, n, size) / sum);
+    }
+
+    spec->plan_window = spec->window;
+    return 1;
+}
+
+static void transform(sdrio_spectrum *spec, const sdrio_iq *frame)
+{
+    sdrio_uint32 size = spec->size;
+    const sdrio_float32 *c = spec->coefficients;
+    sdrio_iq *x = spec->work;
+    sdrio_float32 *acc = spec->acc;
+    sdrio_uint32 n;
+
+    for (n=0; n<size; n++)
+    {
+        x[n].i = frame[n].i * c[n];
+        x[n].q = frame[n].q * c[n];
+    }
+
+    sdrio_fft_forward(&spec->fft, x);
+
+    for (n=0; n<size; n++)
+    {
+        acc[n] += x[n].i * x[n].i + x[n].q * x[n].q;
+    }
+}
+
+// Converts to dB with DC moved to the middle, and clears the accumulator.
+static void emit(sdrio_spectrum *spec)
+{
+    sdrio_uint32 size = spec->size;
+    sdrio_uint32 half = size / 2;
+    sdrio_float32 scale = 1.0f / spec->averages;
+    sdrio_uint32 k;
+
+    for (k=0; k<size; k++)
+    {
+        spec->power[k] = (sdrio_float32)(10.0 * log10(spec->acc[(k + half) & (size - 1)] * scale + 1e-20));
+    }
+
+    memset(spec->acc, 0, size * sizeof(sdrio_float32));
+    spec->callback(spec->context, spec->power, size);
+}
+
+static void * spectrum_routine(void *ctx)
+{
+    sdrio_spectrum *spec = (sdrio_spectrum *)ctx;
+    sdrio_ring_slot *slot;
+    sdrio_uint32 count = 0;
+
+    for (;;)
+    {
+        sem_wait(&spec->ready);
+
+        slot = sdrio_ring_read_slot(&spec->ring);
+        if (slot)
+        {
+            transform(spec, (const sdrio_iq *)slot->data);
+            sdrio_ring_release(&spec->ring);
+
+            if (++count == spec->averages)
+            {
+                emit(spec);
+                count = 0;
+            }
+        }
+        else if (!spec->running)
+        {
+            break;
+        }
+    }
+
+    return 0;
+}
+
+sdrio_int32 sdrio_spectrum_start(sdrio_spectrum *spec)
+{
+    sdrio_uint32 i;
+
+    if (spec->running)
+    {
+        return 1;
+    }
+
+    spec->size = spec->next.size;
+    spec->window = spec->next.window;
+    spec->overlap = spec->next.overlap;
+    spec->averages = spec->next.averages;
+    spec->callback = spec->next.callback;
+    spec->context = spec->next.context;
+
+    if (!spec->size)
+    {
+        return 1;
+    }
+
+    if (!build_plan(spec))
+    {
+        return 0;
+    }
+
+    if (!sdrio_ring_init(&spec->ring, SDRIO_SPECTRUM_QUEUE_DEPTH))
+    {
+        return 0;
+    }
+
+    if (!sdrio_pool_init(&spec->frame_pool, spec->ring.size, spec->size * sizeof(sdrio_iq), 0))
+    {
+        sdrio_ring_free(&spec->ring);
+        return 0;
+    }
+
+    for (i=0; i<spec->ring.size; i++)
+    {
+        spec->ring.slots[i].data = sdrio_pool_block(&spec->frame_pool, i);
+        spec->ring.slots[i].capacity = spec->size;
+    }
+
+    memset(spec->acc, 0, spec->size * sizeof(sdrio_float32));
+    spec->fill = 0;
+    spec->dropped = 0;
+
+    sem_init(&spec->ready, 0, 0);
+    spec->running = 1;
+
+    if (pthread_create(&spec->tid, 0, spectrum_routine, (void *)spec) != 0)
+    {
+        spec->running = 0;
+        sem_destroy(&spec->ready);
+        sdrio_pool_free(&spec->frame_pool);
+        sdrio_ring_free(&spec->ring);
+        return 0;
+    }
+
+    return 1;
+}
+
+void sdrio_spectrum_feed(sdrio_spectrum *spec, const sdrio_iq *samples, sdrio_uint32 num_samples)
+{
+    sdrio_uint32 size = spec->size;
+    sdrio_ring_slot *slot;
+    sdrio_uint32 n;
+
+    if (!spec->running)
+    {
+        return;
+    }
+
+    while (num_samples)
+    {
+        n = size - spec->fill;
+        if (n > num_samples)
+        {
+            n = num_samples;
+        }
+
+        memcpy(spec->pending + spec->fill, samples, n * sizeof(sdrio_iq));
+        spec->fill += n;
+        samples += n;
+        num_samples -= n;
+
+        if (spec->fill == size)
+        {
+            slot = sdrio_ring_write_slot(&spec->ring);
+            if (slot)
+            {
+                memcpy(slot->data, spec->pending, size * sizeof(sdrio_iq));
+                slot->num_samples = size;
+                sdrio_ring_commit(&spec->ring);
+                sem_post(&spec->ready);
+            }
+            else
+            {
+                spec->dropped++;
+            }
+
+            // The next frame starts with the tail of this one.
+            memmove(spec->pending, spec->pending + size - spec->overlap, spec->overlap * sizeof(sdrio_iq));
+            spec->fill = spec->overlap;
+        }
+    }
+}
+
+void sdrio_spectrum_stop(sdrio_spectrum *spec)
+{
+    if (spec->running)
+    {
+        spec->running = 0;
+        sem_post(&spec->ready);
+        pthread_join(spec->tid, 0);
+        sem_destroy(&spec->ready);
+
+        sdrio_pool_free(&spec->frame_pool);
+        sdrio_ring_free(&spec->ring);
+    }
+}
@@ -0,0 +1,91 @@
+// Copyright Scott Cutler
+// This source file is licensed under the GNU Lesser General Public License (LGPL)
+
+#ifndef SDRIO_SPECTRUM_H
+#define SDRIO_SPECTRUM_H
+
+#include "sdrio_ext.h"
+#include "sdrio_pool.h"
+#include "sdrio_ring.h"
+#include "sdrio_fft.h"
+
+#include "pthread.h"
+#include "semaphore.h"
+
+#define SDRIO_SPECTRUM_QUEUE_DEPTH 8        // frames waiting for the worker
+#define SDRIO_SPECTRUM_MAX_SIZE 65536
+
+typedef struct sdrio_spectrum_config_t
+{
+    sdrio_uint32 size;
+    sdrio_window window;
+    sdrio_uint32 overlap;
+    sdrio_uint32 averages;
+    sdrio_rx_spectrum_callback callback;
+    void *context;
+} sdrio_spectrum_config;
+
+// Averaged power spectrum of a sample stream.  The producer only copies
+// samples into whole frames and queues them; a worker thread windows,
+// transforms and accumulates, and calls back once per averages frames.
+// Frames that arrive while the queue is full are dropped, so a slow UI never
+// holds up the stream, it just sees fewer frames per average.
+//
+// The FFT plan and window are kept across stop and start, and only rebuilt
+// when the size or window changes.
+typedef struct sdrio_spectrum_t
+{
+    sdrio_spectrum_config next;     // applied by the next start
+
+    sdrio_uint32 size;
+    sdrio_window window;
+    sdrio_uint32 overlap;
+    sdrio_uint32 averages;
+    sdrio_rx_spectrum_callback callback;
+    void *context;
+
+    sdrio_fft fft;
+    sdrio_window plan_window;
+    sdrio_pool plan_pool;
+    sdrio_float32 *coefficients;    // window, scaled so a full scale tone is 0 dB
+    sdrio_iq *work;
+    sdrio_float32 *acc;
+    sdrio_float32 *power;
+
+    sdrio_iq *pending;              // frame being assembled by the producer
+    sdrio_uint32 fill;
+
+    sdrio_pool frame_pool;
+    sdrio_ring ring;
+    sem_t ready;
+    pthread_t tid;
+    volatile sdrio_uint8 running;
+
+    volatile sdrio_uint32 dropped;
+} sdrio_spectrum;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    void sdrio_spectrum_init(sdrio_spectrum *spec);
+    void sdrio_spectrum_free(sdrio_spectrum *spec);
+
+    // Checked here, applied by the next sdrio_spectrum_start.  Size 0 (or no
+    // callback) turns the spectrum off.
+    sdrio_int32 sdrio_spectrum_configure(sdrio_spectrum *spec, sdrio_uint32 size, sdrio_window window, sdrio_uint32 overlap, sdrio_uint32 averages, sdrio_rx_spectrum_callback callback, void *context);
+
+    // Starts the worker if configured.  Returns 0 only on failure.
+    sdrio_int32 sdrio_spectrum_start(sdrio_spectrum *spec);
+
+    // Producer side; does nothing unless started.
+    void sdrio_spectrum_feed(sdrio_spectrum *spec, const sdrio_iq *samples, sdrio_uint32 num_samples);
+
+    // Finishes the frames already queued, but not a partial average.
+    void sdrio_spectrum_stop(sdrio_spectrum *spec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SDRIO_SPECTRUM_H
@@ -0,0 +1,116 @@
+// Copyright Scott Cutler
+// This source file is licensed under the GNU Lesser General Public License (LGPL)
+
+#include "sdrio_stats.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#pragma intrinsic(_InterlockedCompareExchange64)
+
+// Only the compare-exchange is an intrinsic on 32 bit x86, and a plain 64
+// bit load or store there can tear, so everything goes through it.
+static sdrio_int64 atomic_load(volatile sdrio_int64 *p)
+{
+    return _InterlockedCompareExchange64(p, 0, 0);
+}
+
+static sdrio_int64 atomic_cas(volatile sdrio_int64 *p, sdrio_int64 expected, sdrio_int64 value)
+{
+    return _InterlockedCompareExchange64(p, value, expected);
+}
+#else
+static sdrio_int64 atomic_load(volatile sdrio_int64 *p)
+{
+    return __atomic_load_n(p, __ATOMIC_RELAXED);
+}
+
+static sdrio_int64 atomic_cas(volatile sdrio_int64 *p, sdrio_int64 expected, sdrio_int64 value)
+{
+    __atomic_compare_exchange_n(p, &expected, value, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+    return expected;
+}
+#endif
+
+sdrio_int64 sdrio_stats_load(volatile sdrio_int64 *counter)
+{
+    return atomic_load(counter);
+}
+
+void sdrio_stats_store(volatile sdrio_int64 *counter, sdrio_int64 value)
+{
+    sdrio_int64 old = *counter;
+    sdrio_int64 seen;
+
+    while ((seen = atomic_cas(counter, old, value)) != old)
+    {
+        old = seen;
+    }
+}
+
+void sdrio_stats_reset(sdrio_stats_state *state)
+{
+    sdrio_stats_store(&state->samples_delivered, 0);
+    sdrio_stats_store(&state->transfers_completed, 0);
+    sdrio_stats_store(&state->transfers_failed, 0);
+    sdrio_stats_store(&state->samples_lost, 0);
+    sdrio_stats_store(&state->overruns, 0);
+    sdrio_stats_store(&state->queue_high_water, 0);
+    sdrio_stats_store(&state->callbacks, 0);
+    sdrio_stats_store(&state->callback_total, 0);
+    sdrio_stats_store(&state->callback_min, 0);
+    sdrio_stats_store(&state->callback_max, 0);
+}
+
+void sdrio_stats_add(volatile sdrio_int64 *counter, sdrio_int64 n)
+{
+    sdrio_int64 old = *counter;
+    sdrio_int64 seen;
+
+    while ((seen = atomic_cas(counter, old, old + n)) != old)
+    {
+        old = seen;
+    }
+}
+
+void sdrio_stats_raise(volatile sdrio_int64 *counter, sdrio_int64 value)
+{
+    sdrio_int64 old = *counter;
+    sdrio_int64 seen;
+
+    while ((old < value) && ((seen = atomic_cas(counter, old, value)) != old))
+    {
+        old = seen;
+    }
+}
+
+// Only the delivery side calls this, so min can be read and then written.
+void sdrio_stats_callback(sdrio_stats_state *state, sdrio_float64 seconds)
+{
+    sdrio_int64 ns = (sdrio_int64)(seconds * 1e9);
+    sdrio_int64 min = atomic_load(&state->callback_min);
+
+    if (!atomic_load(&state->callbacks) || (ns < min))
+    {
+        sdrio_stats_store(&state->callback_min, ns);
+    }
+
+    sdrio_stats_raise(&state->callback_max, ns);
+    sdrio_stats_add(&state->callback_total, ns);
+    sdrio_stats_add(&state->callbacks, 1);
+}
+
+void sdrio_stats_read(sdrio_stats_state *state, sdrio_stats *stats)
+{
+    sdrio_int64 callbacks = atomic_load(&state->callbacks);
+
+    stats->samples_delivered = (sdrio_uint64)atomic_load(&state->samples_delivered);
+    stats->transfers_completed = (sdrio_uint64)atomic_load(&state->transfers_completed);
+    stats->transfers_failed = (sdrio_uint64)atomic_load(&state->transfers_failed);
+    stats->samples_lost = (sdrio_uint64)atomic_load(&state->samples_lost);
+    stats->overruns = (sdrio_uint64)atomic_load(&state->overruns);
+    stats->queue_high_water = (sdrio_uint32)atomic_load(&state->queue_high_water);
+    stats->callbacks = (sdrio_uint64)callbacks;
+    stats->callback_min = atomic_load(&state->callback_min) * 1e-9;
+    stats->callback_avg = callbacks ? atomic_load(&state->callback_total) * 1e-9 / callbacks : 0.0;
+    stats->callback_max = atomic_load(&state->callback_max) * 1e-9;
+}
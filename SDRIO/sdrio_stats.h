@@ -0,0 +1,49 @@
+// Copyright Scott Cutler
+// This source file is licensed under the GNU Lesser General Public License (LGPL)
+
+#ifndef SDRIO_STATS_H
+#define SDRIO_STATS_H
+
+#include "sdrio_ext.h"
+
+// Counters behind sdrio_get_stats.  Each is updated atomically with no
+// ordering, so the driver and delivery threads never wait on each other or
+// on a reader; a snapshot may mix values from either side of a block.
+// Durations are kept in nanoseconds so they fit the same 64 bit atomics.
+typedef struct sdrio_stats_state_t
+{
+    volatile sdrio_int64 samples_delivered;
+    volatile sdrio_int64 transfers_completed;
+    volatile sdrio_int64 transfers_failed;
+    volatile sdrio_int64 samples_lost;
+    volatile sdrio_int64 overruns;
+    volatile sdrio_int64 queue_high_water;
+    volatile sdrio_int64 callbacks;
+    volatile sdrio_int64 callback_total;
+    volatile sdrio_int64 callback_min;
+    volatile sdrio_int64 callback_max;
+} sdrio_stats_state;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    void sdrio_stats_reset(sdrio_stats_state *state);
+
+    sdrio_int64 sdrio_stats_load(volatile sdrio_int64 *counter);
+    void sdrio_stats_store(volatile sdrio_int64 *counter, sdrio_int64 value);
+    void sdrio_stats_add(volatile sdrio_int64 *counter, sdrio_int64 n);
+
+    // Raises counter to value if it is lower.
+    void sdrio_stats_raise(volatile sdrio_int64 *counter, sdrio_int64 value);
+
+    void sdrio_stats_callback(sdrio_stats_state *state, sdrio_float64 seconds);
+
+    // queue_depth is filled in by the caller.
+    void sdrio_stats_read(sdrio_stats_state *state, sdrio_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SDRIO_STATS_H
@@ -0,0 +1,855 @@
+// Copyright Scott Cutler
+// This source file is licensed under the GNU Lesser General Public License (LGPL)
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "sdrio_stream.h"
+
+static void deliver(sdrio_stream *stream, const void *samples, sdrio_uint32 num_samples, const sdrio_rx_meta *meta)
+{
+    sdrio_float64 start, elapsed;
+
+    stream->meta = *meta;
+    start = sdrio_clock_now();
+
+    if (stream->histograms)
+    {
+        sdrio_histogram_record(&stream->latency, start - meta->timestamp);
+
+        if (stream->last_callback != 0.0)
+        {
+            sdrio_histogram_record(&stream->interval, start - stream->last_callback);
+        }
+    }
+
+    stream->last_callback = start;
+
+    if (stream->native_callback)
+    {
+        stream->native_callback(stream->context, samples, num_samples, &stream->format);
+    }
+    else if (stream->callback)
+    {
+        stream->callback(stream->context, (sdrio_iq *)samples, num_samples);
+    }
+
+    elapsed = sdrio_clock_now() - start;
+    sdrio_stats_callback(&stream->stats, elapsed);
+
+    if (stream->histograms)
+    {
+        sdrio_histogram_record(&stream->duration, elapsed);
+    }
+    sdrio_stats_add(&stream->stats.samples_delivered, num_samples);
+
+    if (!stream->recorder.native)
+    {
+        if (meta->flags)
+        {
+            sdrio_recorder_mark_gap(&stream->recorder);
+        }
+        sdrio_recorder_feed(&stream->recorder, samples, num_samples, meta->frequency, meta->gain);
+    }
+}
+
+static void * delivery_routine(void *ctx)
+{
+    sdrio_stream *stream = (sdrio_stream *)ctx;
+    sdrio_ring_slot *slot;
+
+    for (;;)
+    {
+        sem_wait(&stream->ready);
+
+        slot = sdrio_ring_read_slot(&stream->ring);
+        if (slot)
+        {
+            deliver(stream, slot->data, slot->num_samples, &slot->meta);
+            sdrio_ring_release(&stream->ring);
+        }
+        else if (!stream->running)
+        {
+            break;
+        }
+    }
+
+    return 0;
+}
+
+void sdrio_stream_init(sdrio_stream *stream)
+{
+    memset(stream, 0, sizeof(sdrio_stream));
+    stream->queue_depth = SDRIO_STREAM_DEFAULT_QUEUE_DEPTH;
+    stream->dc_correct = sdrio_get_dc_correct();
+    sdrio_dc_init(&stream->dc);
+    stream->iq_correct = sdrio_get_iq_correct();
+    sdrio_iq_init(&stream->iq);
+    stream->iq_gain = 1.0f;
+    stream->nco_mix = sdrio_get_nco_mix();
+    sdrio_nco_init(&stream->nco);
+    sdrio_decimator_init(&stream->decimator, 1);
+    stream->decimation = 1;
+    sdrio_resampler_init(&stream->resampler, 1, 1);
+    stream->resample_interp = 1;
+    stream->resample_decim = 1;
+    sdrio_spectrum_init(&stream->spectrum);
+    sdrio_recorder_init(&stream->recorder);
+    sdrio_pretrigger_init(&stream->pretrigger);
+}
+
+sdrio_int32 sdrio_stream_set_queue_depth(sdrio_stream *stream, sdrio_uint32 depth)
+{
+    stream->queue_depth = depth;
+    return 1;
+}
+
+sdrio_int32 sdrio_stream_set_huge_pages(sdrio_stream *stream, sdrio_uint8 enable)
+{
+    stream->huge_pages = enable;
+    return 1;
+}
+
+sdrio_int32 sdrio_stream_set_dc_correction(sdrio_stream *stream, sdrio_uint8 enable)
+{
+    stream->dc_correction = enable;
+    return 1;
+}
+
+sdrio_int32 sdrio_stream_set_iq_correction(sdrio_stream *stream, sdrio_float32 gain, sdrio_float32 phase)
+{
+    if (gain <= 0.0f)
+    {
+        return 0;
+    }
+
+    stream->iq_gain = gain;
+    stream->iq_phase = phase;
+    stream->iq_correction = stream->iq_auto || (gain != 1.0f) || (phase != 0.0f);
+    stream->iq_serial++;
+    return 1;
+}
+
+sdrio_int32 sdrio_stream_set_iq_auto_correction(sdrio_stream *stream, sdrio_uint8 enable)
+{
+    stream->iq_auto = enable;
+    stream->iq_correction = enable || (stream->iq_gain != 1.0f) || (stream->iq_phase != 0.0f);
+    stream->iq_serial++;
+    return 1;
+}
+
+sdrio_int32 sdrio_stream_get_iq_correction(sdrio_stream *stream, sdrio_float32 *gain, sdrio_float32 *phase)
+{
+    if (!gain || !phase)
+    {
+        return 0;
+    }
+
+    *gain = stream->iq.gain;
+    *phase = stream->iq.phase;
+    return 1;
+}
+
+// Called on the driver thread, so the kernel never sees a half-written matrix.
+static void apply_iq_settings(sdrio_stream *stream)
+{
+    sdrio_uint32 serial = stream->iq_serial;
+
+    if (serial != stream->iq_applied)
+    {
+        sdrio_iq_set(&stream->iq, stream->iq_gain, stream->iq_phase);
+        stream->iq.estimate = stream->iq_auto;
+        stream->iq_applied = serial;
+    }
+}
+
+static sdrio_uint8 streaming(sdrio_stream *stream)
+{
+    return (stream->callback || stream->native_callback);
+}
+
+sdrio_int32 sdrio_stream_check_rate(sdrio_stream *stream, sdrio_uint32 decimation, sdrio_uint32 interp, sdrio_uint32 decim)
+{
+    sdrio_uint32 cic, halfbands;
+
+    if (!sdrio_decimate_split(decimation, &cic, &halfbands))
+    {
+        return 0;
+    }
+
+    if (!((interp == 1) && (decim == 1)) && (!interp || (interp >= decim) || (interp > SDRIO_RESAMPLE_MAX_PHASES)))
+    {
+        return 0;
+    }
+
+    // Only float32 can be decimated or resampled, as sdrio_stream_start checks.
+    if (((decimation > 1) || (decim > 1)) && streaming(stream) && (stream->format.format != sdrio_sample_format_cf32))
+    {
+        return 0;
+    }
+
+    return 1;
+}
+
+// The serial is odd while the settings are being written; see apply_rate.
+sdrio_int32 sdrio_stream_set_rate(sdrio_stream *stream, sdrio_uint32 decimation, sdrio_uint32 interp, sdrio_uint32 decim)
+{
+    if (!sdrio_stream_check_rate(stream, decimation, interp, decim))
+    {
+        return 0;
+    }
+
+    stream->rate_serial++;
+    stream->decimation = decimation;
+    stream->resample_interp = interp;
+    stream->resample_decim = decim;
+    stream->rate_serial++;
+    return 1;
+}
+
+sdrio_uint32 sdrio_stream_get_decimation(sdrio_stream *stream)
+{
+    return stream->decimation;
+}
+
+sdrio_uint64 sdrio_stream_get_rate(sdrio_stream *stream, sdrio_uint64 hw_rate)
+{
+    return hw_rate * stream->resample_interp / ((sdrio_uint64)stream->decimation * stream->resample_decim);
+}
+
+sdrio_int32 sdrio_stream_set_spectrum(sdrio_stream *stream, sdrio_uint32 size, sdrio_window window, sdrio_uint32 overlap, sdrio_uint32 averages, sdrio_rx_spectrum_callback callback, void *context)
+{
+    return sdrio_spectrum_configure(&stream->spectrum, size, window, overlap, averages, callback, context);
+}
+
+sdrio_int32 sdrio_stream_fine_tune(sdrio_stream *stream, sdrio_uint64 frequency, sdrio_uint64 hw_rate)
+{
+    sdrio_uint64 limit;
+    double offset;
+
+    if (!(stream->callback || stream->native_callback) || (stream->format.format != sdrio_sample_format_cf32) || !stream->hw_frequency || !hw_rate)
+    {
+        return 0;
+    }
+
+    // Keep the whole output band inside the captured one when decimating.
+    limit = hw_rate / 2;
+    if (stream->decimation > 1)
+    {
+        limit -= hw_rate / stream->decimation / 2;
+    }
+
+    offset = (double)frequency - (double)stream->hw_frequency;
+    if (fabs(offset) >= (double)limit)
+    {
+        return 0;
+    }
+
+    stream->nco_serial++;
+    stream->offset = (sdrio_int64)offset;
+    stream->nco_step = -offset / (double)hw_rate;
+    stream->nco_serial++;
+    stream->shifting = (offset != 0.0);
+    return 1;
+}
+
+void sdrio_stream_set_hw_frequency(sdrio_stream *stream, sdrio_uint64 frequency)
+{
+    stream->nco_serial++;
+    stream->hw_frequency = frequency;
+    stream->offset = 0;
+    stream->nco_step = 0.0;
+    stream->nco_serial++;
+    stream->shifting = 0;
+}
+
+sdrio_int64 sdrio_stream_get_offset(sdrio_stream *stream)
+{
+    return stream->offset;
+}
+
+sdrio_uint64 sdrio_stream_get_block_frequency(sdrio_stream *stream)
+{
+    return stream->meta.frequency;
+}
+
+void sdrio_stream_get_block_meta(sdrio_stream *stream, sdrio_rx_meta *meta)
+{
+    *meta = stream->meta;
+}
+
+void sdrio_stream_set_gain(sdrio_stream *stream, sdrio_float32 gain)
+{
+    stream->gain = gain;
+}
+
+void sdrio_stream_mark_discontinuity(sdrio_stream *stream, sdrio_uint32 lost)
+{
+    stream->pending_flags |= SDRIO_RX_META_DISCONTINUITY;
+    stream->pending_lost += lost;
+    stream->sample_counter += lost;
+
+    if (stream->recorder.native)
+    {
+        sdrio_recorder_mark_gap(&stream->recorder);
+    }
+    sdrio_pretrigger_mark_gap(&stream->pretrigger);
+    sdrio_stats_add(&stream->stats.samples_lost, lost);
+}
+
+void sdrio_stream_transfer_failed(sdrio_stream *stream)
+{
+    sdrio_stats_add(&stream->stats.transfers_failed, 1);
+}
+
+void sdrio_stream_get_stats(sdrio_stream *stream, sdrio_stats *stats)
+{
+    sdrio_stats_read(&stream->stats, stats);
+    stats->queue_depth = stream->queue_depth;
+}
+
+sdrio_int32 sdrio_stream_set_histograms(sdrio_stream *stream, sdrio_uint8 enable)
+{
+    stream->histograms = enable;
+    return 1;
+}
+
+sdrio_int32 sdrio_stream_get_histogram(sdrio_stream *stream, sdrio_histogram_kind kind, sdrio_histogram *histogram)
+{
+    switch (kind)
+    {
+    case sdrio_histogram_latency:
+        sdrio_histogram_read(&stream->latency, histogram);
+        return 1;
+    case sdrio_histogram_duration:
+        sdrio_histogram_read(&stream->duration, histogram);
+        return 1;
+    case sdrio_histogram_interval:
+        sdrio_histogram_read(&stream->interval, histogram);
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+sdrio_int32 sdrio_stream_write_histograms(sdrio_stream *stream, const char *path)
+{
+    static const char *names[] = {"latency", "duration", "interval"};
+    sdrio_histogram histogram;
+    FILE *file = fopen(path, "w");
+    sdrio_uint32 kind;
+
+    if (!file)
+    {
+        return 0;
+    }
+
+    for (kind=0; kind<3; kind++)
+    {
+        sdrio_stream_get_histogram(stream, (sdrio_histogram_kind)kind, &histogram);
+        sdrio_histogram_write(file, names[kind], &histogram);
+    }
+
+    return fclose(file) == 0;
+}
+
+// What the samples converted now were captured at, NCO offset included.
+// For the API thread, which is the one that changes it.
+static sdrio_uint64 tuned_frequency(sdrio_stream *stream)
+{
+    return stream->hw_frequency ? stream->hw_frequency + stream->offset : 0;
+}
+
+// Tags a block that is about to reach the callback with the current chunk's
+// position and hands it any gaps since the last one.
+static void stamp(sdrio_stream *stream, sdrio_rx_meta *meta)
+{
+    meta->sample_counter = stream->sample_counter;
+    meta->timestamp = stream->block_time;
+    meta->flags = stream->pending_flags;
+    meta->lost = stream->pending_lost;
+    meta->frequency = stream->block_frequency;
+    meta->gain = stream->gain;
+
+    stream->pending_flags = 0;
+    stream->pending_lost = 0;
+}
+
+sdrio_int32 sdrio_stream_start_recording(sdrio_stream *stream, const char *path, sdrio_uint8 native, sdrio_uint64 hw_rate, const char *hw)
+{
+    if (!(stream->callback || stream->native_callback))
+    {
+        return 0;
+    }
+
+    if (native)
+    {
+        return sdrio_recorder_start(&stream->recorder, path, &stream->native, 1, hw_rate, stream->hw_frequency, stream->gain, hw);
+    }
+    else
+    {
+        return sdrio_recorder_start(&stream->recorder, path, &stream->format, 0, sdrio_stream_get_rate(stream, hw_rate), tuned_frequency(stream), stream->gain, hw);
+    }
+}
+
+sdrio_int32 sdrio_stream_stop_recording(sdrio_stream *stream)
+{
+    return sdrio_recorder_stop(&stream->recorder);
+}
+
+void sdrio_stream_get_recording_stats(sdrio_stream *stream, sdrio_recording_stats *stats)
+{
+    sdrio_recorder_get_stats(&stream->recorder, stats);
+}
+
+sdrio_int32 sdrio_stream_start_pretrigger(sdrio_stream *stream, const char *path, sdrio_float64 pre_seconds, sdrio_float64 post_seconds, sdrio_uint64 hw_rate, const char *hw)
+{
+    if (!(stream->callback || stream->native_callback))
+    {
+        return 0;
+    }
+
+    return sdrio_pretrigger_start(&stream->pretrigger, path, pre_seconds, post_seconds, &stream->native, hw_rate, stream->hw_frequency, stream->gain, hw);
+}
+
+void sdrio_stream_stop_pretrigger(sdrio_stream *stream)
+{
+    sdrio_pretrigger_stop(&stream->pretrigger);
+}
+
+void sdrio_stream_set_trigger_power(sdrio_stream *stream, sdrio_float32 threshold, sdrio_uint32 window)
+{
+    sdrio_pretrigger_set_power(&stream->pretrigger, threshold, window);
+}
+
+sdrio_int32 sdrio_stream_trigger(sdrio_stream *stream)
+{
+    return sdrio_pretrigger_request(&stream->pretrigger);
+}
+
+void sdrio_stream_get_pretrigger_stats(sdrio_stream *stream, sdrio_pretrigger_stats *stats)
+{
+    sdrio_pretrigger_get_stats(&stream->pretrigger, stats);
+}
+
+// Called on the driver thread at the start of each hardware block; only the
+// step changes, so the phase carries on across retunes.  The 64 bit settings
+// can tear on a 32 bit build, so they are only taken if the serial was even
+// and unchanged across reading them, as with the rate, and the blocks are
+// tagged from the copies.
+static void apply_nco_settings(sdrio_stream *stream)
+{
+    sdrio_uint32 serial = stream->nco_serial;
+    sdrio_uint64 hw_frequency;
+    sdrio_int64 offset;
+    double step;
+
+    if ((serial == stream->nco_applied) || (serial & 1))
+    {
+        return;
+    }
+
+    hw_frequency = stream->hw_frequency;
+    offset = stream->offset;
+    step = stream->nco_step;
+    if (stream->nco_serial != serial)
+    {
+        return;
+    }
+
+    sdrio_nco_set_step(&stream->nco, step);
+    stream->block_hw_frequency = hw_frequency;
+    stream->block_frequency = hw_frequency ? hw_frequency + offset : 0;
+    stream->nco_applied = serial;
+}
+
+// Called on the driver thread.  Rebuilding allocates, but only happens when
+// the rate is changed while streaming; the filter bank usually comes from the
+// cache.  The settings are only taken if the serial was even and unchanged
+// across reading them, so the filters are never rebuilt from a half-written
+// set; one caught mid-write is picked up at the next block.
+static void apply_rate(sdrio_stream *stream)
+{
+    sdrio_uint32 serial = stream->rate_serial;
+    sdrio_uint32 factor, interp, decim;
+
+    if ((serial == stream->rate_applied) || (serial & 1) || (stream->format.format != sdrio_sample_format_cf32))
+    {
+        return;
+    }
+
+    factor = stream->decimation;
+    interp = stream->resample_interp;
+    decim = stream->resample_decim;
+    if (stream->rate_serial != serial)
+    {
+        return;
+    }
+
+    if (factor != stream->decimator.factor)
+    {
+        sdrio_decimator_free(&stream->decimator);
+        sdrio_decimator_init(&stream->decimator, factor);
+    }
+
+    if ((interp != stream->resampler.interp) || (decim != stream->resampler.decim))
+    {
+        sdrio_resampler_free(&stream->resampler);
+        sdrio_resampler_init(&stream->resampler, interp, decim);
+    }
+
+    stream->rate_applied = serial;
+}
+
+static sdrio_uint8 correcting(sdrio_stream *stream)
+{
+    return (stream->format.format == sdrio_sample_format_cf32) && (stream->dc_correction || stream->iq_correction || stream->shifting);
+}
+
+// Decimation or resampling is in effect, or has been asked for and will be
+// applied by the next convert_block.
+static sdrio_uint8 rate_changing(sdrio_stream *stream)
+{
+    if ((stream->decimator.factor > 1) || stream->resampler.bank)
+    {
+        return 1;
+    }
+
+    return (stream->format.format == sdrio_sample_format_cf32) && ((stream->decimation > 1) || (stream->resample_decim > 1));
+}
+
+// Converts (or copies) src into dst, applying any enabled corrections and
+// decimation and resampling.  Returns the number of samples stored to dst.
+static sdrio_uint32 convert_block(sdrio_stream *stream, void *dst, const void *src, sdrio_uint32 num_samples)
+{
+    const sdrio_uint8 *in = (const sdrio_uint8 *)src;
+    sdrio_iq *out = (sdrio_iq *)dst;
+    sdrio_iq *chunk;
+    sdrio_uint32 n, m, num_out = 0;
+    sdrio_uint8 dc = stream->dc_correction;
+    sdrio_uint8 iq = stream->iq_correction;
+    sdrio_uint8 shift = stream->shifting;
+    sdrio_uint8 decimating, resampling;
+
+    apply_rate(stream);
+    decimating = (stream->decimator.factor > 1);
+    resampling = (stream->resampler.bank != 0);
+
+    if (!decimating && !resampling && ((stream->format.format != sdrio_sample_format_cf32) || !(dc || iq || shift)))
+    {
+        if (stream->convert)
+        {
+            stream->convert(dst, src, num_samples);
+        }
+        else
+        {
+            memcpy(dst, src, num_samples * stream->format.bytes_per_sample);
+        }
+        return num_samples;
+    }
+
+    if (iq)
+    {
+        apply_iq_settings(stream);
+    }
+
+    while (num_samples)
+    {
+        n = (num_samples < SDRIO_CORRECT_CHUNK) ? num_samples : SDRIO_CORRECT_CHUNK;
+
+        if (decimating)
+        {
+            chunk = sdrio_decimator_input(&stream->decimator);
+        }
+        else
+        {
+            chunk = resampling ? sdrio_resampler_input(&stream->resampler) : out + num_out;
+        }
+
+        if (stream->convert)
+        {
+            stream->convert(chunk, in, n);
+        }
+        else
+        {
+            memcpy(chunk, in, n * sizeof(sdrio_iq));
+        }
+
+        if (dc)
+        {
+            stream->dc_correct(&stream->dc, chunk, n);
+        }
+
+        if (iq)
+        {
+            stream->iq_correct(&stream->iq, chunk, n);
+        }
+
+        if (shift)
+        {
+            stream->nco_mix(&stream->nco, chunk, n);
+        }
+
+        m = n;
+        if (decimating)
+        {
+            m = sdrio_decimator_process(&stream->decimator, n, resampling ? sdrio_resampler_input(&stream->resampler) : out + num_out);
+        }
+
+        if (resampling)
+        {
+            m = sdrio_resampler_process(&stream->resampler, m, out + num_out);
+        }
+
+        num_out += m;
+
+        in += n * stream->native.bytes_per_sample;
+        num_samples -= n;
+    }
+
+    return num_out;
+}
+
+static sdrio_int32 alloc_buffers(sdrio_stream *stream)
+{
+    sdrio_uint32 block_bytes = stream->block_samples * stream->format.bytes_per_sample;
+    sdrio_uint32 i;
+
+    if (stream->queue_depth)
+    {
+        if (!sdrio_ring_init(&stream->ring, stream->queue_depth))
+        {
+            return 0;
+        }
+
+        if (!sdrio_pool_init(&stream->pool, stream->ring.size, block_bytes, stream->huge_pages))
+        {
+            sdrio_ring_free(&stream->ring);
+            return 0;
+        }
+
+        for (i=0; i<stream->ring.size; i++)
+        {
+            stream->ring.slots[i].data = sdrio_pool_block(&stream->pool, i);
+            stream->ring.slots[i].capacity = stream->block_samples;
+        }
+    }
+    else if (stream->convert || (stream->format.format == sdrio_sample_format_cf32))
+    {
+        if (!sdrio_pool_init(&stream->pool, 1, block_bytes, stream->huge_pages))
+        {
+            return 0;
+        }
+
+        stream->buffer = sdrio_pool_block(&stream->pool, 0);
+    }
+
+    return 1;
+}
+
+static void free_buffers(sdrio_stream *stream)
+{
+    sdrio_ring_free(&stream->ring);
+    sdrio_pool_free(&stream->pool);
+    stream->buffer = 0;
+}
+
+sdrio_int32 sdrio_stream_start(sdrio_stream *stream, const sdrio_format_desc *native, sdrio_sample_format format, sdrio_uint32 block_samples, sdrio_rx_async_callback callback, sdrio_rx_native_callback native_callback, void *context)
+{
+    if ((callback || (stream->decimation > 1) || (stream->resample_decim > 1)) && (format != sdrio_sample_format_cf32))
+    {
+        return 0;
+    }
+
+    if (!block_samples || !sdrio_get_converter(native, format, &stream->convert, &stream->format))
+    {
+        return 0;
+    }
+
+    stream->native = *native;
+    stream->block_samples = block_samples;
+    sdrio_stats_reset(&stream->stats);
+    sdrio_histogram_reset(&stream->latency);
+    sdrio_histogram_reset(&stream->duration);
+    sdrio_histogram_reset(&stream->interval);
+    stream->last_callback = 0.0;
+    stream->sample_counter = 0;
+    stream->pending_flags = 0;
+    stream->pending_lost = 0;
+    memset(&stream->meta, 0, sizeof(sdrio_rx_meta));
+    sdrio_dc_init(&stream->dc);
+    sdrio_iq_init(&stream->iq);
+    stream->iq_applied = stream->iq_serial - 1;
+    stream->nco_applied = stream->nco_serial - 1;
+    stream->block_hw_frequency = stream->hw_frequency;
+    stream->block_frequency = tuned_frequency(stream);
+    stream->rate_applied = stream->rate_serial;
+
+    sdrio_decimator_free(&stream->decimator);
+    if (!sdrio_decimator_init(&stream->decimator, stream->decimation))
+    {
+        return 0;
+    }
+
+    sdrio_resampler_free(&stream->resampler);
+    if (!sdrio_resampler_init(&stream->resampler, stream->resample_interp, stream->resample_decim))
+    {
+        sdrio_decimator_free(&stream->decimator);
+        return 0;
+    }
+
+    if (!alloc_buffers(stream))
+    {
+        sdrio_decimator_free(&stream->decimator);
+        sdrio_resampler_free(&stream->resampler);
+        return 0;
+    }
+
+    if ((format == sdrio_sample_format_cf32) && !sdrio_spectrum_start(&stream->spectrum))
+    {
+        free_buffers(stream);
+        sdrio_decimator_free(&stream->decimator);
+        sdrio_resampler_free(&stream->resampler);
+        return 0;
+    }
+
+    if (stream->queue_depth)
+    {
+        sem_init(&stream->ready, 0, 0);
+        stream->running = 1;
+
+        if (pthread_create(&stream->tid, 0, delivery_routine, (void *)stream) != 0)
+        {
+            stream->running = 0;
+            sem_destroy(&stream->ready);
+            sdrio_spectrum_stop(&stream->spectrum);
+            free_buffers(stream);
+            sdrio_decimator_free(&stream->decimator);
+            sdrio_resampler_free(&stream->resampler);
+            return 0;
+        }
+    }
+
+    // Only now, as a stream with a callback set counts as started.  The
+    // delivery thread doesn't look at them until the first block is queued.
+    stream->callback = callback;
+    stream->native_callback = native_callback;
+    stream->context = context;
+    return 1;
+}
+
+static void enqueue(sdrio_stream *stream, const void *samples, sdrio_uint32 num_samples)
+{
+    sdrio_ring_slot *slot = sdrio_ring_write_slot(&stream->ring);
+    sdrio_uint32 num_out;
+
+    if (!slot)
+    {
+        stream->pending_flags |= SDRIO_RX_META_OVERRUN;
+        stream->pending_lost += num_samples;
+        sdrio_stats_add(&stream->stats.overruns, 1);
+        sdrio_stats_add(&stream->stats.samples_lost, num_samples);
+        return;
+    }
+
+    // The driver reuses its buffer as soon as we return, so even the
+    // pass-through case has to copy.
+    num_out = convert_block(stream, slot->data, samples, num_samples);
+    if (!num_out)
+    {
+        return;
+    }
+
+    if (stream->format.format == sdrio_sample_format_cf32)
+    {
+        sdrio_spectrum_feed(&stream->spectrum, (const sdrio_iq *)slot->data, num_out);
+    }
+
+    slot->num_samples = num_out;
+    stamp(stream, &slot->meta);
+    sdrio_ring_commit(&stream->ring);
+    sdrio_stats_raise(&stream->stats.queue_high_water, stream->ring.head - stream->ring.tail);
+    sem_post(&stream->ready);
+}
+
+void sdrio_stream_process(sdrio_stream *stream, const void *samples, sdrio_uint32 num_samples)
+{
+    const sdrio_uint8 *in = (const sdrio_uint8 *)samples;
+    sdrio_uint32 n, num_out;
+    sdrio_rx_meta meta;
+
+    stream->block_time = sdrio_clock_now();
+    sdrio_stats_add(&stream->stats.transfers_completed, 1);
+    apply_nco_settings(stream);
+
+    if (stream->recorder.native)
+    {
+        sdrio_recorder_feed(&stream->recorder, samples, num_samples, stream->block_hw_frequency, stream->gain);
+    }
+    sdrio_pretrigger_feed(&stream->pretrigger, samples, num_samples, stream->block_hw_frequency, stream->gain);
+
+    if (!stream->running && !stream->convert && !correcting(stream) && !rate_changing(stream))
+    {
+        if (stream->format.format == sdrio_sample_format_cf32)
+        {
+            sdrio_spectrum_feed(&stream->spectrum, (const sdrio_iq *)samples, num_samples);
+        }
+
+        stamp(stream, &meta);
+        deliver(stream, samples, num_samples, &meta);
+        stream->sample_counter += num_samples;
+        return;
+    }
+
+    while (num_samples)
+    {
+        n = (num_samples < stream->block_samples) ? num_samples : stream->block_samples;
+
+        if (stream->running)
+        {
+            enqueue(stream, in, n);
+        }
+        else
+        {
+            num_out = convert_block(stream, stream->buffer, in, n);
+            if (num_out)
+            {
+                if (stream->format.format == sdrio_sample_format_cf32)
+                {
+                    sdrio_spectrum_feed(&stream->spectrum, (const sdrio_iq *)stream->buffer, num_out);
+                }
+
+                stamp(stream, &meta);
+                deliver(stream, stream->buffer, num_out, &meta);
+            }
+        }
+
+        stream->sample_counter += n;
+        in += n * stream->native.bytes_per_sample;
+        num_samples -= n;
+    }
+}
+
+void sdrio_stream_stop(sdrio_stream *stream)
+{
+    if (stream->running)
+    {
+        stream->running = 0;
+        sem_post(&stream->ready);
+        pthread_join(stream->tid, 0);
+        sem_destroy(&stream->ready);
+    }
+
+    sdrio_recorder_stop(&stream->recorder);
+    sdrio_pretrigger_stop(&stream->pretrigger);
+    sdrio_spectrum_stop(&stream->spectrum);
+    free_buffers(stream);
+    sdrio_decimator_free(&stream->decimator);
+    sdrio_resampler_free(&stream->resampler);
+    stream->callback = 0;
+    stream->native_callback = 0;
+}
@@ -0,0 +1,257 @@
+// Copyright Scott Cutler
+// This source file is licensed under the GNU Lesser General Public License (LGPL)
+
+#ifndef SDRIO_STREAM_H
+#define SDRIO_STREAM_H
+
+#include "sdrio_ext.h"
+#include "sdrio_convert.h"
+#include "sdrio_ring.h"
+#include "sdrio_pool.h"
+#include "sdrio_correct.h"
+#include "sdrio_decimate.h"
+#include "sdrio_resample.h"
+#include "sdrio_spectrum.h"
+#include "sdrio_nco.h"
+#include "sdrio_clock.h"
+#include "sdrio_stats.h"
+#include "sdrio_histogram.h"
+#include "sdrio_record.h"
+#include "sdrio_pretrigger.h"
+
+#include "pthread.h"
+#include "semaphore.h"
+
+#define SDRIO_STREAM_DEFAULT_QUEUE_DEPTH 16
+
+// Receive path shared by the plugins: converts each hardware block into the
+// format requested at start time and hands it to the user's callback.
+//
+// With a queue depth above zero the driver thread only converts into the
+// ring and a delivery thread calls the user, so a slow consumer doesn't
+// hold up USB transfer resubmission.  Blocks that arrive while the ring is
+// full are dropped and counted in the stats.
+//
+// All conversion buffers come from a pool sized from the driver's transfer
+// size at start time.  Longer blocks are split rather than reallocated.
+//
+// Float output can be DC and IQ imbalance corrected as part of the
+// conversion: each chunk is corrected right after it is converted, while it
+// is still in cache.  IQ settings are posted by the caller and picked up by
+// the driver thread at the next block.
+//
+// Float output can also be frequency shifted and decimated: corrected chunks
+// are mixed by the NCO, then written straight into the decimator's input,
+// and only its output reaches the callback.  The NCO lets a plugin fine
+// tune without touching the hardware while the target stays in band.  The
+// decimator's output can go through a rational resampler on its way out, for
+// rates no hardware rate divides down to.
+//
+// Whatever float32 reaches the callback can also be copied to a spectrum
+// engine, which averages power spectra on its own thread.
+//
+// Every delivered block carries an sdrio_rx_meta, stamped by the driver
+// thread as the block is converted.  The frequencies it is tagged with are
+// the driver thread's own copies, taken under the NCO serial at the start of
+// each hardware block, so a retune never reaches a tag half written.  Gaps, whether from overruns here or
+// samples the plugin knows the hardware lost, advance the sample counter and
+// are flagged on the next block that reaches the callback.  Blocks the
+// decimator swallows whole pass their flags on too.
+//
+// The stream can also be recorded, either as the driver hands it over or as
+// it reaches the callback.  The recorder only copies into a buffer on the
+// thread it is fed from; a writer thread of its own does the disk I/O.  The
+// pre-trigger capture keeps recent history, as the driver hands it over, in
+// memory and writes a window around each trigger the same way.
+typedef struct sdrio_stream_t
+{
+    sdrio_format_desc native;
+    sdrio_format_desc format;
+    sdrio_convert_t convert;
+
+    sdrio_dc_correct_t dc_correct;
+    sdrio_dc_state dc;
+    volatile sdrio_uint8 dc_correction;
+
+    sdrio_iq_correct_t iq_correct;
+    sdrio_iq_state iq;
+    volatile sdrio_uint8 iq_correction;
+    volatile sdrio_uint8 iq_auto;
+    volatile sdrio_float32 iq_gain;
+    volatile sdrio_float32 iq_phase;
+    volatile sdrio_uint32 iq_serial;
+    sdrio_uint32 iq_applied;
+
+    sdrio_nco_mix_t nco_mix;
+    sdrio_nco_state nco;
+    volatile sdrio_uint64 hw_frequency;
+    volatile sdrio_int64 offset;
+    volatile double nco_step;
+    volatile sdrio_uint32 nco_serial;   // odd while the three above are written
+    sdrio_uint32 nco_applied;
+    sdrio_uint64 block_hw_frequency;    // the driver thread's copies of them
+    sdrio_uint64 block_frequency;       // hardware plus offset, or 0 if unknown
+    volatile sdrio_uint8 shifting;
+
+    sdrio_decimator decimator;
+    volatile sdrio_uint32 decimation;
+
+    sdrio_resampler resampler;
+    volatile sdrio_uint32 resample_interp;
+    volatile sdrio_uint32 resample_decim;
+    volatile sdrio_uint32 rate_serial;
+    sdrio_uint32 rate_applied;
+
+    sdrio_spectrum spectrum;
+
+    sdrio_rx_meta meta;             // of the block being delivered
+    sdrio_uint64 sample_counter;    // hardware samples since start
+    sdrio_float64 block_time;       // when the driver handed over the current block
+    sdrio_uint32 pending_flags;     // for the next block that reaches the callback
+    sdrio_uint32 pending_lost;
+    volatile sdrio_float32 gain;
+
+    sdrio_rx_async_callback callback;
+    sdrio_rx_native_callback native_callback;
+    void *context;
+
+    sdrio_pool pool;
+    void *buffer;
+    sdrio_uint32 block_samples;
+    sdrio_uint8 huge_pages;
+
+    sdrio_uint32 queue_depth;
+    sdrio_ring ring;
+    sem_t ready;
+    pthread_t tid;
+    volatile sdrio_uint8 running;
+
+    sdrio_stats_state stats;
+
+    volatile sdrio_uint8 histograms;
+    sdrio_histogram_state latency;
+    sdrio_histogram_state duration;
+    sdrio_histogram_state interval;
+    sdrio_float64 last_callback;
+
+    sdrio_recorder recorder;
+    sdrio_pretrigger pretrigger;
+} sdrio_stream;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    void sdrio_stream_init(sdrio_stream *stream);
+
+    // Takes effect on the next start.  0 delivers on the driver's thread.
+    sdrio_int32 sdrio_stream_set_queue_depth(sdrio_stream *stream, sdrio_uint32 depth);
+
+    // Takes effect on the next start.
+    sdrio_int32 sdrio_stream_set_huge_pages(sdrio_stream *stream, sdrio_uint8 enable);
+
+    // Can be changed while running.  Only float32 output is corrected.
+    sdrio_int32 sdrio_stream_set_dc_correction(sdrio_stream *stream, sdrio_uint8 enable);
+
+    // Can be changed while running.  Only float32 output is corrected.
+    // phase in radians; gain 1, phase 0 turns manual correction off.
+    sdrio_int32 sdrio_stream_set_iq_correction(sdrio_stream *stream, sdrio_float32 gain, sdrio_float32 phase);
+
+    // Estimates gain and phase from the signal, starting from the values
+    // last set.  Can be changed while running.
+    sdrio_int32 sdrio_stream_set_iq_auto_correction(sdrio_stream *stream, sdrio_uint8 enable);
+
+    // Returns the gain and phase in use, which track the estimate in auto mode.
+    sdrio_int32 sdrio_stream_get_iq_correction(sdrio_stream *stream, sdrio_float32 *gain, sdrio_float32 *phase);
+
+    // Decimation, then resampling by interp / decim, as sdrio_resample_plan
+    // chooses them.  Can be changed while running (the driver thread rebuilds
+    // the filters).  Only float32 output can be decimated or resampled, so a
+    // plan that needs either is refused while streaming any other format;
+    // see sdrio_decimate_split.  Plugins check the plan before retuning the
+    // hardware, so a refused one leaves the rate as it was.
+    sdrio_int32 sdrio_stream_check_rate(sdrio_stream *stream, sdrio_uint32 decimation, sdrio_uint32 interp, sdrio_uint32 decim);
+    sdrio_int32 sdrio_stream_set_rate(sdrio_stream *stream, sdrio_uint32 decimation, sdrio_uint32 interp, sdrio_uint32 decim);
+    sdrio_uint32 sdrio_stream_get_decimation(sdrio_stream *stream);
+
+    // The rate delivered to the callback for a given hardware rate, after
+    // decimation and resampling.
+    sdrio_uint64 sdrio_stream_get_rate(sdrio_stream *stream, sdrio_uint64 hw_rate);
+
+    // Takes effect on the next start, and only for float32 output; see
+    // sdrio_spectrum_configure.
+    sdrio_int32 sdrio_stream_set_spectrum(sdrio_stream *stream, sdrio_uint32 size, sdrio_window window, sdrio_uint32 overlap, sdrio_uint32 averages, sdrio_rx_spectrum_callback callback, void *context);
+
+    // Fine tuning for the plugins' sdrio_set_rx_frequency.  While float32 is
+    // being delivered and frequency is within the band captured at hw_rate
+    // (less the decimated output band), sets the NCO to cover the offset and
+    // returns 1.  Otherwise returns 0: the plugin retunes and then calls
+    // sdrio_stream_set_hw_frequency, which also clears the offset.
+    sdrio_int32 sdrio_stream_fine_tune(sdrio_stream *stream, sdrio_uint64 frequency, sdrio_uint64 hw_rate);
+    void sdrio_stream_set_hw_frequency(sdrio_stream *stream, sdrio_uint64 frequency);
+
+    // Target minus hardware frequency while the NCO is covering an offset.
+    // Plugins retune to the target on stop so other formats see the right
+    // frequency.
+    sdrio_int64 sdrio_stream_get_offset(sdrio_stream *stream);
+
+    // Only meaningful inside the callback: the frequency the block being
+    // delivered was captured at.  Blocks are tagged as the driver thread
+    // converts them, so ones still queued when the frequency changes keep
+    // the old tag.
+    sdrio_uint64 sdrio_stream_get_block_frequency(sdrio_stream *stream);
+
+    // Only meaningful inside the callback, like the block frequency.
+    void sdrio_stream_get_block_meta(sdrio_stream *stream, sdrio_rx_meta *meta);
+
+    // For the plugins' sdrio_set_rx_gain, so blocks are tagged with it.
+    void sdrio_stream_set_gain(sdrio_stream *stream, sdrio_float32 gain);
+
+    // Driver thread, before the sdrio_stream_process call that follows the
+    // gap: lost samples the plugin knows the hardware dropped.
+    void sdrio_stream_mark_discontinuity(sdrio_stream *stream, sdrio_uint32 lost);
+
+    // For transfers the driver reports as failed, rather than handing them
+    // to sdrio_stream_process.  Any thread.
+    void sdrio_stream_transfer_failed(sdrio_stream *stream);
+
+    // Any thread.
+    void sdrio_stream_get_stats(sdrio_stream *stream, sdrio_stats *stats);
+
+    // Can be changed while running; the histograms are cleared on start.
+    // Latency runs from the driver calling sdrio_stream_process to the
+    // callback starting on the first block converted from it.
+    sdrio_int32 sdrio_stream_set_histograms(sdrio_stream *stream, sdrio_uint8 enable);
+    sdrio_int32 sdrio_stream_get_histogram(sdrio_stream *stream, sdrio_histogram_kind kind, sdrio_histogram *histogram);
+    sdrio_int32 sdrio_stream_write_histograms(sdrio_stream *stream, const char *path);
+
+    // Only while started, and stopped along with the stream.  hw_rate is the
+    // rate the driver delivers at and hw describes the device, both for the
+    // metadata.  Native recordings are fed on the driver thread, before
+    // anything can be dropped for a slow callback.
+    sdrio_int32 sdrio_stream_start_recording(sdrio_stream *stream, const char *path, sdrio_uint8 native, sdrio_uint64 hw_rate, const char *hw);
+    sdrio_int32 sdrio_stream_stop_recording(sdrio_stream *stream);
+    void sdrio_stream_get_recording_stats(sdrio_stream *stream, sdrio_recording_stats *stats);
+
+    // Only while started, and stopped along with the stream, like recording.
+    // The history is kept in the hardware's format at hw_rate.
+    sdrio_int32 sdrio_stream_start_pretrigger(sdrio_stream *stream, const char *path, sdrio_float64 pre_seconds, sdrio_float64 post_seconds, sdrio_uint64 hw_rate, const char *hw);
+    void sdrio_stream_stop_pretrigger(sdrio_stream *stream);
+    void sdrio_stream_set_trigger_power(sdrio_stream *stream, sdrio_float32 threshold, sdrio_uint32 window);
+    sdrio_int32 sdrio_stream_trigger(sdrio_stream *stream);
+    void sdrio_stream_get_pretrigger_stats(sdrio_stream *stream, sdrio_pretrigger_stats *stats);
+
+    // Exactly one of callback (float32 only) or native_callback must be set.
+    // block_samples is the largest block the driver normally delivers.
+    sdrio_int32 sdrio_stream_start(sdrio_stream *stream, const sdrio_format_desc *native, sdrio_sample_format format, sdrio_uint32 block_samples, sdrio_rx_async_callback callback, sdrio_rx_native_callback native_callback, void *context);
+    void sdrio_stream_process(sdrio_stream *stream, const void *samples, sdrio_uint32 num_samples);
+
+    // Call once the driver has stopped calling sdrio_stream_process.  Blocks
+    // already queued are delivered before this returns.
+    void sdrio_stream_stop(sdrio_stream *stream);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SDRIO_STREAM_H
@@ -0,0 +1,285 @@
+// Copyright Scott Cutler
+// This source file is licensed under the GNU Lesser General Public License (LGPL)
+
+#include <math.h>
+#include <string.h>
+
+#include "sdrio_sweep.h"
+
+#define PI 3.14159265358979323846
+
+// Panorama bins no step has reached yet.
+#define SDRIO_SWEEP_FLOOR -200.0f
+
+static void * carve(sdrio_uint8 **mem, size_t bytes)
+{
+    void *p = *mem;
+    *mem += (bytes + SDRIO_POOL_ALIGNMENT - 1) & ~(size_t)(SDRIO_POOL_ALIGNMENT - 1);
+    return p;
+}
+
+static size_t carved(size_t bytes)
+{
+    return (bytes + SDRIO_POOL_ALIGNMENT - 1) & ~(size_t)(SDRIO_POOL_ALIGNMENT - 1);
+}
+
+sdrio_int32 sdrio_sweep_init(sdrio_sweep *sweep, sdrio_device *dev, sdrio_set_rx_frequency_t set_rx_frequency, sdrio_get_rx_block_frequency_t get_rx_block_frequency,
+                             const sdrio_uint64 *frequencies, sdrio_uint32 num_steps, sdrio_uint64 sample_rate,
+                             sdrio_uint32 size, sdrio_uint32 frames_per_step, sdrio_uint32 settle_samples)
+{
+    sdrio_uint64 lowest, highest;
+    sdrio_uint32 n;
+    size_t bytes;
+    sdrio_uint8 *mem;
+    double sum = 0.0, w;
+
+    memset(sweep, 0, sizeof(sdrio_sweep));
+
+    if (!set_rx_frequency || !get_rx_block_frequency || !frequencies || !num_steps || (num_steps > SDRIO_SWEEP_MAX_STEPS) || !sample_rate || !frames_per_step)
+    {
+        return 0;
+    }
+
+    if (!sdrio_fft_init(&sweep->fft, size))
+    {
+        return 0;
+    }
+
+    lowest = highest = frequencies[0];
+    for (n=1; n<num_steps; n++)
+    {
+        lowest = (frequencies[n] < lowest) ? frequencies[n] : lowest;
+        highest = (frequencies[n] > highest) ? frequencies[n] : highest;
+    }
+
+    sweep->dev = dev;
+    sweep->set_rx_frequency = set_rx_frequency;
+    sweep->get_rx_block_frequency = get_rx_block_frequency;
+    sweep->num_steps = num_steps;
+    sweep->sample_rate = (sdrio_float64)sample_rate;
+    sweep->size = size;
+    sweep->frames_per_step = frames_per_step;
+    sweep->settle_samples = settle_samples;
+
+    sweep->bin_width = sweep->sample_rate / size;
+    sweep->start_frequency = lowest - sweep->sample_rate / 2;
+    sweep->num_bins = (sdrio_uint32)floor((highest - lowest) / sweep->bin_width + 0.5) + size;
+
+    bytes = carved(num_steps * sizeof(sdrio_uint64))
+          + carved(size * sizeof(sdrio_float32))
+          + carved(size * sizeof(sdrio_iq))
+          + carved(size * sizeof(sdrio_float32))
+          + carved(sweep->num_bins * sizeof(sdrio_float32))
+          + carved(sweep->num_bins * sizeof(sdrio_uint32));
+
+    if (!sdrio_pool_init(&sweep->pool, 1, (sdrio_uint32)bytes, 0))
+    {
+        sdrio_fft_free(&sweep->fft);
+        return 0;
+    }
+
+    mem = (sdrio_uint8 *)sdrio_pool_block(&sweep->pool, 0);
+    sweep->frequencies = (sdrio_uint64 *)carve(&mem, num_steps * sizeof(sdrio_uint64));
+    sweep->window = (sdrio_float32 *)carve(&mem, size * sizeof(sdrio_float32));
+    sweep->frame = (sdrio_iq *)carve(&mem, size * sizeof(sdrio_iq));
+    sweep->acc = (sdrio_float32 *)carve(&mem, size * sizeof(sdrio_float32));
+    sweep->panorama = (sdrio_float32 *)carve(&mem, sweep->num_bins * sizeof(sdrio_float32));
+    sweep->distance = (sdrio_uint32 *)carve(&mem, sweep->num_bins * sizeof(sdrio_uint32));
+
+    memcpy(sweep->frequencies, frequencies, num_steps * sizeof(sdrio_uint64));
+
+    // Blackman-Harris, scaled so a full scale tone reads 0 dB.
+    for (n=0; n<size; n++)
+    {
+        w = 0.35875 - 0.48829 * cos(2 * PI * n / size) + 0.14128 * cos(4 * PI * n / size) - 0.01168 * cos(6 * PI * n / size);
+        sweep->window[n] = (sdrio_float32)w;
+        sum += w;
+    }
+
+    for (n=0; n<size; n++)
+    {
+        sweep->window[n] = (sdrio_float32)(sweep->window[n] / sum);
+    }
+
+    for (n=0; n<sweep->num_bins; n++)
+    {
+        sweep->panorama[n] = SDRIO_SWEEP_FLOOR;
+    }
+
+    return 1;
+}
+
+void sdrio_sweep_free(sdrio_sweep *sweep)
+{
+    sdrio_fft_free(&sweep->fft);
+    sdrio_pool_free(&sweep->pool);
+    sweep->num_steps = 0;
+}
+
+void sdrio_sweep_set_callback(sdrio_sweep *sweep, sdrio_sweep_callback_t callback, sdrio_sweep_block_callback_t block_callback, void *context)
+{
+    sweep->callback = callback;
+    sweep->block_callback = block_callback;
+    sweep->context = context;
+}
+
+static void reset_pass(sdrio_sweep *sweep)
+{
+    sdrio_uint32 n;
+
+    for (n=0; n<sweep->num_bins; n++)
+    {
+        sweep->distance[n] = sweep->size + 1;
+    }
+}
+
+// Retunes to the current step, skipping any the plugin refuses.  Returns 0
+// if it refuses them all.
+static sdrio_int32 tune(sdrio_sweep *sweep)
+{
+    sdrio_uint32 tries;
+
+    sweep->fill = 0;
+    sweep->frames = 0;
+    sweep->settled = 0;
+    memset(sweep->acc, 0, sweep->size * sizeof(sdrio_float32));
+
+    for (tries=0; tries<sweep->num_steps; tries++)
+    {
+        if (sweep->set_rx_frequency(sweep->dev, sweep->frequencies[sweep->step]))
+        {
+            return 1;
+        }
+
+        sweep->step = (sweep->step + 1) % sweep->num_steps;
+    }
+
+    return 0;
+}
+
+sdrio_int32 sdrio_sweep_begin(sdrio_sweep *sweep)
+{
+    sweep->step = 0;
+    reset_pass(sweep);
+    return tune(sweep);
+}
+
+static void transform(sdrio_sweep *sweep)
+{
+    sdrio_uint32 size = sweep->size;
+    sdrio_iq *x = sweep->frame;
+    sdrio_uint32 n;
+
+    for (n=0; n<size; n++)
+    {
+        x[n].i *= sweep->window[n];
+        x[n].q *= sweep->window[n];
+    }
+
+    sdrio_fft_forward(&sweep->fft, x);
+
+    for (n=0; n<size; n++)
+    {
+        sweep->acc[n] += x[n].i * x[n].i + x[n].q * x[n].q;
+    }
+}
+
+// Writes this step's bins into the panorama wherever it is the nearest
+// step so far.  The DC bin only counts as being at the edge.
+static void stitch(sdrio_sweep *sweep)
+{
+    sdrio_uint32 size = sweep->size;
+    sdrio_uint32 half = size / 2;
+    double centre = (double)sweep->frequencies[sweep->step];
+    sdrio_uint32 base = (sdrio_uint32)floor((centre - sweep->sample_rate / 2 - sweep->start_frequency) / sweep->bin_width + 0.5);
+    sdrio_float32 scale = 1.0f / sweep->frames;
+    sdrio_uint32 j, p, d;
+
+    for (j=0; j<size; j++)
+    {
+        p = base + j;
+        d = (j == half) ? half : ((j > half) ? j - half : half - j);
+
+        if ((p < sweep->num_bins) && (d < sweep->distance[p]))
+        {
+            sweep->panorama[p] = (sdrio_float32)(10.0 * log10(sweep->acc[(j + half) & (size - 1)] * scale + 1e-20));
+            sweep->distance[p] = d;
+        }
+    }
+}
+
+static void advance(sdrio_sweep *sweep)
+{
+    stitch(sweep);
+
+    if (++sweep->step == sweep->num_steps)
+    {
+        if (sweep->callback)
+        {
+            sweep->callback(sweep->context, sweep->panorama, sweep->num_bins, sweep->start_frequency, sweep->bin_width);
+        }
+
+        sweep->step = 0;
+        reset_pass(sweep);
+    }
+
+    tune(sweep);
+}
+
+sdrio_int32 sdrio_sweep_callback(void *context, sdrio_iq *samples, sdrio_uint32 length)
+{
+    sdrio_sweep *sweep = (sdrio_sweep *)context;
+    sdrio_uint64 tag = (sdrio_uint64)sweep->get_rx_block_frequency(sweep->dev);
+    sdrio_uint32 n;
+
+    // Still draining blocks from before the retune.
+    if (tag && (tag != sweep->frequencies[sweep->step]))
+    {
+        return 0;
+    }
+
+    if (!sweep->settled)
+    {
+        sweep->settled = 1;
+        sweep->discard = sweep->settle_samples;
+    }
+
+    n = (sweep->discard < length) ? sweep->discard : length;
+    sweep->discard -= n;
+    samples += n;
+    length -= n;
+
+    if (length && sweep->block_callback)
+    {
+        sweep->block_callback(sweep->context, samples, length, sweep->frequencies[sweep->step]);
+    }
+
+    while (length)
+    {
+        n = sweep->size - sweep->fill;
+        if (n > length)
+        {
+            n = length;
+        }
+
+        memcpy(sweep->frame + sweep->fill, samples, n * sizeof(sdrio_iq));
+        sweep->fill += n;
+        samples += n;
+        length -= n;
+
+        if (sweep->fill == sweep->size)
+        {
+            transform(sweep);
+            sweep->fill = 0;
+
+            // The rest of the block predates the retune, so it goes.
+            if (++sweep->frames == sweep->frames_per_step)
+            {
+                advance(sweep);
+                break;
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,94 @@
+// Copyright Scott Cutler
+// This source file is licensed under the GNU Lesser General Public License (LGPL)
+
+#ifndef SDRIO_SWEEP_H
+#define SDRIO_SWEEP_H
+
+#include "sdrio_ext.h"
+#include "sdrio_pool.h"
+#include "sdrio_fft.h"
+
+#define SDRIO_SWEEP_MAX_STEPS 4096
+
+// Once per pass over the frequency list.  Bin n of power (in dB relative to
+// a full scale tone) is centred on start_frequency + n * bin_width.
+typedef sdrio_int32 (*sdrio_sweep_callback_t)(void *context, const sdrio_float32 *power, sdrio_uint32 num_bins, sdrio_float64 start_frequency, sdrio_float64 bin_width);
+
+// Optional: every block kept for analysis, with the frequency it was
+// captured at.
+typedef sdrio_int32 (*sdrio_sweep_block_callback_t)(void *context, const sdrio_iq *samples, sdrio_uint32 length, sdrio_uint64 frequency);
+
+// Steps the receiver through a list of frequencies and stitches the power
+// spectra into one panorama.  Works with any plugin through its exports:
+// pass sdrio_sweep_callback with the sweep as context to sdrio_start_rx, and
+// the sweep retunes from inside the callback.
+//
+// Each block is checked against the frequency the plugin says it was
+// captured at, so blocks still queued from the previous step are dropped
+// whole and only settle_samples after the first good block are thrown away
+// for the PLL and any transfers in flight.  Each panorama bin comes from the
+// step whose centre is nearest, which keeps the filter edges and the DC
+// spike out where steps overlap.
+typedef struct sdrio_sweep_t
+{
+    sdrio_device *dev;
+    sdrio_set_rx_frequency_t set_rx_frequency;
+    sdrio_get_rx_block_frequency_t get_rx_block_frequency;
+
+    sdrio_uint64 *frequencies;
+    sdrio_uint32 num_steps;
+    sdrio_uint32 step;
+    sdrio_float64 sample_rate;
+
+    sdrio_uint32 size;              // FFT size
+    sdrio_uint32 frames_per_step;
+    sdrio_uint32 settle_samples;
+
+    sdrio_uint32 discard;           // settling samples still to drop
+    sdrio_uint8 settled;            // seen a block at the new frequency
+    sdrio_uint32 fill;
+    sdrio_uint32 frames;
+
+    sdrio_fft fft;
+    sdrio_float32 *window;
+    sdrio_iq *frame;
+    sdrio_float32 *acc;
+
+    sdrio_float32 *panorama;
+    sdrio_uint32 *distance;         // of each panorama bin from its step's centre
+    sdrio_uint32 num_bins;
+    sdrio_float64 start_frequency;
+    sdrio_float64 bin_width;
+
+    sdrio_sweep_callback_t callback;
+    sdrio_sweep_block_callback_t block_callback;
+    void *context;
+
+    sdrio_pool pool;
+} sdrio_sweep;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    // sample_rate is what sdrio_get_rx_samplerate reports; size is a power
+    // of two.  Steps closer than half the sample rate may be taken by the
+    // plugin's NCO instead of the hardware, which is fine but gains little.
+    sdrio_int32 sdrio_sweep_init(sdrio_sweep *sweep, sdrio_device *dev, sdrio_set_rx_frequency_t set_rx_frequency, sdrio_get_rx_block_frequency_t get_rx_block_frequency,
+                                 const sdrio_uint64 *frequencies, sdrio_uint32 num_steps, sdrio_uint64 sample_rate,
+                                 sdrio_uint32 size, sdrio_uint32 frames_per_step, sdrio_uint32 settle_samples);
+    void sdrio_sweep_free(sdrio_sweep *sweep);
+
+    void sdrio_sweep_set_callback(sdrio_sweep *sweep, sdrio_sweep_callback_t callback, sdrio_sweep_block_callback_t block_callback, void *context);
+
+    // Tunes to the first step; call before starting the receiver.
+    sdrio_int32 sdrio_sweep_begin(sdrio_sweep *sweep);
+
+    // An sdrio_rx_async_callback; context is the sweep.
+    sdrio_int32 sdrio_sweep_callback(void *context, sdrio_iq *samples, sdrio_uint32 length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SDRIO_SWEEP_H
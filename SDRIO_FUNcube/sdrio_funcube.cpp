@@ -12,6 +12,7 @@
 #pragma comment(lib, "setupapi.lib")
 
 #include "sdrio_ext.h"
+#include "sdrio_stream.h"
 #include "pthread.h"
 
 #define CT_ASSERT(e) typedef char __CT_ASSERT__[(e)?1:-1]
@@ -107,8 +108,7 @@ struct sdrio_device_t
 
     sdrio_uint32 rx_current_buffer;
 
-    sdrio_rx_async_callback rx_callback;
-    void                   *rx_context;
+    sdrio_stream rx_stream;
 
     HANDLE hidRead;
     HANDLE hidWrite;
@@ -201,6 +201,8 @@ typedef struct sdrio_iqu8_t
     sdrio_int16 q;
 } sdrio_iqi16;
 
+static const sdrio_format_desc native_format = {sdrio_sample_format_cs16, sizeof(sdrio_iqi16), 0.0f, 1.0f / 32767.0f};
+
 SDRIOEXPORT sdrio_int32 sdrio_init()
 {
     sdrio_uint32 num_wave_devices = waveInGetNumDevs();
@@ -236,6 +238,7 @@ SDRIOEXPORT sdrio_device * sdrio_open_device(sdrio_uint32 device_index)
     {
         dev = new sdrio_device_t;
         memset(dev, 0, sizeof(sdrio_device_t));
+        sdrio_stream_init(&dev->rx_stream);
 
         if (!funcube_hidopen(dev))
         {
@@ -318,17 +321,16 @@ SDRIOEXPORT sdrio_int32 sdrio_set_rx_samplerate(sdrio_device *dev, sdrio_uint64
 {
     if (dev)
     {
-        sdrio_uint32 num_sample_rates = sdrio_get_num_samplerates(dev);
-        sdrio_uint32 i = 0;
-        for (i=0; i<num_sample_rates; i++)
+        // The FCD only runs at 192 kHz; lower rates are decimated from it.
+        sdrio_uint64 hw_rate;
+        sdrio_uint32 decimation, interp, decim;
+
+        if (!sdrio_resample_plan(sample_rate, sample_rates, sdrio_get_num_samplerates(dev), 0, 0, &hw_rate, &decimation, &interp, &decim))
         {
-            if (sample_rates[i] == sample_rate)
-            {
-                break;
-            }
+            return 0;
         }
 
-        return (i < num_sample_rates);
+        return sdrio_stream_set_rate(&dev->rx_stream, decimation, interp, decim);
     }
     else
     {
@@ -342,6 +344,13 @@ SDRIOEXPORT sdrio_int32 sdrio_set_rx_frequency(sdrio_device *dev, sdrio_uint64 f
     {
         dev->rx_freq = frequency;
 
+        // Retuning is a blocking HID round trip that glitches the stream, so
+        // offsets within the band are done in software.
+        if (sdrio_stream_fine_tune(&dev->rx_stream, frequency, 192000))
+        {
+            return 1;
+        }
+
         funcube_hid_set_freq_packet setFreq((sdrio_uint32)frequency);
         sdrio_uint32 bytesWritten = 0;
         WriteFile(dev->hidWrite, &setFreq, sizeof(funcube_hid_set_freq_packet), &bytesWritten, 0);
@@ -350,6 +359,11 @@ SDRIOEXPORT sdrio_int32 sdrio_set_rx_frequency(sdrio_device *dev, sdrio_uint64 f
         sdrio_uint32 bytesRead = 0;
         ReadFile(dev->hidRead, &response, sizeof(response), &bytesRead, 0);
 
+        if (response.success)
+        {
+            sdrio_stream_set_hw_frequency(&dev->rx_stream, frequency);
+        }
+
         return response.success;
     }
     else
@@ -382,18 +396,14 @@ SDRIOEXPORT void * start_rx_routine(void *ctx)
         {
             if (waveInUnprepareHeader(dev->hWaveIn, &dev->waveInHdr[dev->rx_current_buffer], sizeof(WAVEHDR)) != WAVERR_STILLPLAYING)
             {
-                static sdrio_iq samples[SAMPLES_PER_BUFFER];
-
-                sdrio_iqi16 *iq = (sdrio_iqi16 *)dev->waveInHdr[dev->rx_current_buffer].lpData;
-                for (sdrio_uint32 i=0; i<SAMPLES_PER_BUFFER; i++)
-                {
-                    samples[i].i = float(iq[i].i) * (1.0f / 32767.0f);
-                    samples[i].q = float(iq[i].q) * (1.0f / 32767.0f);
-                }
-                dev->rx_callback(dev->rx_context, samples, SAMPLES_PER_BUFFER);
+                sdrio_stream_process(&dev->rx_stream, dev->waveInHdr[dev->rx_current_buffer].lpData, SAMPLES_PER_BUFFER);
 
                 waveInPrepareHeader(dev->hWaveIn, &dev->waveInHdr[dev->rx_current_buffer], sizeof(WAVEHDR));
                 result = waveInAddBuffer(dev->hWaveIn, &dev->waveInHdr[dev->rx_current_buffer], sizeof(WAVEHDR));
+                if (result != MMSYSERR_NOERROR)
+                {
+                    sdrio_stream_transfer_failed(&dev->rx_stream);
+                }
 
                 dev->rx_current_buffer = (dev->rx_current_buffer + 1) % NUM_BUFFERS;
             }
@@ -407,13 +417,265 @@ SDRIOEXPORT void * start_rx_routine(void *ctx)
     return 0;
 }
 
+static sdrio_int32 start_rx(sdrio_device *dev, sdrio_sample_format format, sdrio_rx_async_callback callback, sdrio_rx_native_callback native_callback, void *context)
+{
+    if (dev && sdrio_stream_start(&dev->rx_stream, &native_format, format, SAMPLES_PER_BUFFER, callback, native_callback, context))
+    {
+        if (pthread_create(&dev->rx_tid, 0, start_rx_routine, (void *)dev) != 0)
+        {
+            sdrio_stream_stop(&dev->rx_stream);
+            return 0;
+        }
+
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
 SDRIOEXPORT sdrio_int32 sdrio_start_rx(sdrio_device *dev, sdrio_rx_async_callback callback, void *context)
+{
+    return start_rx(dev, sdrio_sample_format_cf32, callback, 0, context);
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_start_rx_native(sdrio_device *dev, sdrio_rx_native_callback callback, void *context)
+{
+    return start_rx(dev, native_format.format, 0, callback, context);
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_start_rx_format(sdrio_device *dev, sdrio_sample_format format, sdrio_rx_native_callback callback, void *context)
+{
+    return start_rx(dev, format, 0, callback, context);
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_queue_depth(sdrio_device *dev, sdrio_uint32 depth)
+{
+    if (dev)
+    {
+        return sdrio_stream_set_queue_depth(&dev->rx_stream, depth);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_huge_pages(sdrio_device *dev, sdrio_uint8 enable)
+{
+    if (dev)
+    {
+        return sdrio_stream_set_huge_pages(&dev->rx_stream, enable);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_dc_correction(sdrio_device *dev, sdrio_uint8 enable)
+{
+    if (dev)
+    {
+        return sdrio_stream_set_dc_correction(&dev->rx_stream, enable);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_iq_correction(sdrio_device *dev, sdrio_float32 gain, sdrio_float32 phase)
 {
     if (dev)
     {
-        dev->rx_callback = callback;
-        dev->rx_context = context;
-        return pthread_create(&dev->rx_tid, 0, start_rx_routine, (void *)dev) == 0;
+        return sdrio_stream_set_iq_correction(&dev->rx_stream, gain, phase);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_iq_auto_correction(sdrio_device *dev, sdrio_uint8 enable)
+{
+    if (dev)
+    {
+        return sdrio_stream_set_iq_auto_correction(&dev->rx_stream, enable);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_get_rx_iq_correction(sdrio_device *dev, sdrio_float32 *gain, sdrio_float32 *phase)
+{
+    if (dev)
+    {
+        return sdrio_stream_get_iq_correction(&dev->rx_stream, gain, phase);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_spectrum(sdrio_device *dev, sdrio_uint32 size, sdrio_window window, sdrio_uint32 overlap, sdrio_uint32 averages, sdrio_rx_spectrum_callback callback, void *context)
+{
+    if (dev)
+    {
+        return sdrio_stream_set_spectrum(&dev->rx_stream, size, window, overlap, averages, callback, context);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_get_stats(sdrio_device *dev, sdrio_stats *stats)
+{
+    if (dev && stats)
+    {
+        sdrio_stream_get_stats(&dev->rx_stream, stats);
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_histograms(sdrio_device *dev, sdrio_uint8 enable)
+{
+    if (dev)
+    {
+        return sdrio_stream_set_histograms(&dev->rx_stream, enable);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_get_rx_histogram(sdrio_device *dev, sdrio_histogram_kind kind, sdrio_histogram *histogram)
+{
+    if (dev && histogram)
+    {
+        return sdrio_stream_get_histogram(&dev->rx_stream, kind, histogram);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_write_rx_histograms(sdrio_device *dev, const char *path)
+{
+    if (dev && path)
+    {
+        return sdrio_stream_write_histograms(&dev->rx_stream, path);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_start_rx_recording(sdrio_device *dev, const char *path, sdrio_uint8 native)
+{
+    if (dev && path)
+    {
+        return sdrio_stream_start_recording(&dev->rx_stream, path, native, 192000, sdrio_get_device_string(dev));
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_stop_rx_recording(sdrio_device *dev)
+{
+    if (dev)
+    {
+        return sdrio_stream_stop_recording(&dev->rx_stream);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_get_rx_recording_stats(sdrio_device *dev, sdrio_recording_stats *stats)
+{
+    if (dev && stats)
+    {
+        sdrio_stream_get_recording_stats(&dev->rx_stream, stats);
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_start_rx_pretrigger(sdrio_device *dev, const char *path, sdrio_float64 pre_seconds, sdrio_float64 post_seconds)
+{
+    if (dev && path)
+    {
+        return sdrio_stream_start_pretrigger(&dev->rx_stream, path, pre_seconds, post_seconds, 192000, sdrio_get_device_string(dev));
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_stop_rx_pretrigger(sdrio_device *dev)
+{
+    if (dev)
+    {
+        sdrio_stream_stop_pretrigger(&dev->rx_stream);
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_trigger_power(sdrio_device *dev, sdrio_float32 threshold, sdrio_uint32 window)
+{
+    if (dev)
+    {
+        sdrio_stream_set_trigger_power(&dev->rx_stream, threshold, window);
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_trigger_rx(sdrio_device *dev)
+{
+    if (dev)
+    {
+        return sdrio_stream_trigger(&dev->rx_stream);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_get_rx_pretrigger_stats(sdrio_device *dev, sdrio_pretrigger_stats *stats)
+{
+    if (dev && stats)
+    {
+        sdrio_stream_get_pretrigger_stats(&dev->rx_stream, stats);
+        return 1;
     }
     else
     {
@@ -427,6 +689,14 @@ SDRIOEXPORT sdrio_int32 sdrio_stop_rx(sdrio_device *dev)
     {
         dev->rx_done = 1;
         pthread_join(dev->rx_tid, 0);
+        sdrio_stream_stop(&dev->rx_stream);
+
+        // The NCO only runs while streaming float32, so put the hardware on
+        // the target now.
+        if (sdrio_stream_get_offset(&dev->rx_stream))
+        {
+            sdrio_set_rx_frequency(dev, sdrio_get_rx_frequency(dev));
+        }
         return 1;
     }
     else
@@ -471,7 +741,32 @@ SDRIOEXPORT sdrio_int64 sdrio_get_rx_samplerate(sdrio_device *dev)
 {
     if (dev)
     {
-        return 192000;
+        return sdrio_stream_get_rate(&dev->rx_stream, 192000);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int64 sdrio_get_rx_block_frequency(sdrio_device *dev)
+{
+    if (dev)
+    {
+        return sdrio_stream_get_block_frequency(&dev->rx_stream);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_get_rx_block_meta(sdrio_device *dev, sdrio_rx_meta *meta)
+{
+    if (dev && meta)
+    {
+        sdrio_stream_get_block_meta(&dev->rx_stream, meta);
+        return 1;
     }
     else
     {
@@ -540,6 +835,11 @@ SDRIOEXPORT sdrio_int32 sdrio_set_rx_gain(sdrio_device *dev, float gain)
         sdrio_uint32 bytesRead = 0;
         ReadFile(dev->hidRead, &response, sizeof(response), &bytesRead, 0);
 
+        if (response.success)
+        {
+            sdrio_stream_set_gain(&dev->rx_stream, gain);
+        }
+
         return response.success;
     }
     else
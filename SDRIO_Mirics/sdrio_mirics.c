@@ -5,6 +5,7 @@
 #include <string.h>
 
 #include "sdrio_ext.h"
+#include "sdrio_stream.h"
 
 #define mirisdr_STATIC
 #include "mirisdr.h"
@@ -16,18 +17,17 @@
 void usleep(unsigned long us) { Sleep(us / 1000); }
 #endif
 
+#define RX_BUFFER_LENGTH 262144
+
 typedef struct sdrio_device_t
 {
     sdrio_uint32 device_index;
 
     mirisdr_dev_t *mirics_device;
 
-    sdrio_rx_async_callback callback;
-    void *callback_context;
+    sdrio_stream rx_stream;
     pthread_t tid;
-
-    sdrio_iq *samples;
-    sdrio_uint32 num_samples;
+    sdrio_uint8 rx_synced;      // packet addresses have been seen since start
 
     sdrio_uint64 min_freq;
     sdrio_uint64 max_freq;
@@ -39,6 +39,8 @@ typedef struct sdrio_iqi16_t
     sdrio_int16 q;
 } sdrio_iqi16;
 
+static const sdrio_format_desc native_format = {sdrio_sample_format_cs16, 4, 0.0f, 0.000030518509476f};
+
 
 SDRIOEXPORT sdrio_int32 sdrio_init()
 {
@@ -57,6 +59,7 @@ SDRIOEXPORT sdrio_device * sdrio_open_device(sdrio_uint32 device_index)
     if (dev)
     {
         memset(dev, 0, sizeof(sdrio_device));
+        sdrio_stream_init(&dev->rx_stream);
         dev->device_index = device_index;
 
         mirisdr_open (&dev->mirics_device, dev->device_index);
@@ -108,11 +111,29 @@ SDRIOEXPORT const char * sdrio_get_device_string(sdrio_device *dev)
     }
 }
 
+static const sdrio_uint32 sample_rates[] = {3*512*1024, 2*1024*1024, 4*1024*1024, 23*256*1024, 123*64*1024, 35*256*1024, 23*512*1024};
+
 SDRIOEXPORT sdrio_int32 sdrio_set_rx_samplerate(sdrio_device *dev, sdrio_uint64 sample_rate)
 {
     if (dev)
     {
-        return (mirisdr_set_sample_rate(dev->mirics_device, (uint32_t)sample_rate) == 0);
+        sdrio_uint64 hw_rate;
+        sdrio_uint32 decimation, interp, decim;
+
+        // Other rates are reached by decimating, and resampling if no table
+        // rate divides down exactly, from one of the table rates.
+        if (!sdrio_resample_plan(sample_rate, sample_rates, sizeof(sample_rates) / sizeof(sample_rates[0]), 0, 0, &hw_rate, &decimation, &interp, &decim) ||
+            !sdrio_stream_check_rate(&dev->rx_stream, decimation, interp, decim))
+        {
+            return 0;
+        }
+
+        if (mirisdr_set_sample_rate(dev->mirics_device, (uint32_t)hw_rate) != 0)
+        {
+            return 0;
+        }
+
+        return sdrio_stream_set_rate(&dev->rx_stream, decimation, interp, decim);
     }
     else
     {
@@ -124,7 +145,18 @@ SDRIOEXPORT sdrio_int32 sdrio_set_rx_frequency(sdrio_device *dev, sdrio_uint64 f
 {
     if (dev)
     {
-        return (mirisdr_set_center_freq(dev->mirics_device, (uint32_t)frequency) == 0);
+        if (sdrio_stream_fine_tune(&dev->rx_stream, frequency, mirisdr_get_sample_rate(dev->mirics_device)))
+        {
+            return 1;
+        }
+
+        if (mirisdr_set_center_freq(dev->mirics_device, (uint32_t)frequency) != 0)
+        {
+            return 0;
+        }
+
+        sdrio_stream_set_hw_frequency(&dev->rx_stream, frequency);
+        return 1;
     }
     else
     {
@@ -145,59 +177,296 @@ SDRIOEXPORT sdrio_int32 sdrio_set_tx_frequency(sdrio_device *dev, sdrio_uint64 f
 void mirics_read_async_cb(unsigned char *buf, uint32_t len, void *ctx)
 {
     sdrio_device *dev = (sdrio_device *)ctx;
+    sdrio_uint32 lost = mirisdr_get_samples_lost(dev->mirics_device);
 
-    if (dev->callback)
+    // The first packet is checked against wherever the last run stopped.
+    if (lost && dev->rx_synced)
     {
-        sdrio_uint32 num_samples = len / sizeof(sdrio_iqi16); // 4 bytes per sample
+        sdrio_stream_mark_discontinuity(&dev->rx_stream, lost);
+    }
 
-        if (dev->num_samples != num_samples)
-        {
-            dev->num_samples = num_samples;
+    dev->rx_synced = 1;
+    sdrio_stream_process(&dev->rx_stream, buf, len / native_format.bytes_per_sample);
+}
 
-            if (dev->samples)
-            {
-                free(dev->samples);
-            }
+SDRIOEXPORT void * start_rx_routine(void *ctx)
+{
+    sdrio_device *dev = (sdrio_device *)ctx;
 
-            dev->samples = (sdrio_iq *)malloc(dev->num_samples * sizeof(sdrio_iq));
+    if (dev)
+    {
+        mirisdr_reset_buffer(dev->mirics_device);
+        // A failed transfer ends the whole read.
+        if (mirisdr_read_async(dev->mirics_device, mirics_read_async_cb, dev, 32, RX_BUFFER_LENGTH) < 0)
+        {
+            sdrio_stream_transfer_failed(&dev->rx_stream);
         }
+        pthread_exit(0);
+    }
 
-        if (dev->samples)
+    return 0;
+}
+
+static sdrio_int32 start_rx(sdrio_device *dev, sdrio_sample_format format, sdrio_rx_async_callback callback, sdrio_rx_native_callback native_callback, void *context)
+{
+    if (dev && sdrio_stream_start(&dev->rx_stream, &native_format, format, RX_BUFFER_LENGTH / 4, callback, native_callback, context))
+    {
+        dev->rx_synced = 0;
+        if (pthread_create(&dev->tid, 0, start_rx_routine, (void *)dev) != 0)
         {
-            sdrio_iqi16 *iqbuf = (sdrio_iqi16 *)buf;
-            sdrio_uint32 i;
-            for (i=0; i<dev->num_samples; i++)
-            {
-                dev->samples[i].i = (float)iqbuf[i].i * 0.000030518509476f;
-                dev->samples[i].q = (float)iqbuf[i].q * 0.000030518509476f;
-            }
-
-            dev->callback(dev->callback_context, dev->samples, dev->num_samples);
+            sdrio_stream_stop(&dev->rx_stream);
+            return 0;
         }
+
+        return 1;
+    }
+    else
+    {
+        return 0;
     }
 }
 
-SDRIOEXPORT void * start_rx_routine(void *ctx)
+SDRIOEXPORT sdrio_int32 sdrio_start_rx(sdrio_device *dev, sdrio_rx_async_callback callback, void *context)
 {
-    sdrio_device *dev = (sdrio_device *)ctx;
+    return start_rx(dev, sdrio_sample_format_cf32, callback, 0, context);
+}
 
+SDRIOEXPORT sdrio_int32 sdrio_start_rx_native(sdrio_device *dev, sdrio_rx_native_callback callback, void *context)
+{
+    return start_rx(dev, native_format.format, 0, callback, context);
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_start_rx_format(sdrio_device *dev, sdrio_sample_format format, sdrio_rx_native_callback callback, void *context)
+{
+    return start_rx(dev, format, 0, callback, context);
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_queue_depth(sdrio_device *dev, sdrio_uint32 depth)
+{
     if (dev)
     {
-        mirisdr_reset_buffer(dev->mirics_device);
-        mirisdr_read_async(dev->mirics_device, mirics_read_async_cb, dev, 32, 262144);
-        pthread_exit(0);
+        return sdrio_stream_set_queue_depth(&dev->rx_stream, depth);
+    }
+    else
+    {
+        return 0;
     }
+}
 
-    return 0;
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_huge_pages(sdrio_device *dev, sdrio_uint8 enable)
+{
+    if (dev)
+    {
+        return sdrio_stream_set_huge_pages(&dev->rx_stream, enable);
+    }
+    else
+    {
+        return 0;
+    }
 }
 
-SDRIOEXPORT sdrio_int32 sdrio_start_rx(sdrio_device *dev, sdrio_rx_async_callback callback, void *context)
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_dc_correction(sdrio_device *dev, sdrio_uint8 enable)
 {
     if (dev)
     {
-        dev->callback = callback;
-        dev->callback_context = context;
-        return pthread_create(&dev->tid, 0, start_rx_routine, (void *)dev) == 0;
+        return sdrio_stream_set_dc_correction(&dev->rx_stream, enable);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_iq_correction(sdrio_device *dev, sdrio_float32 gain, sdrio_float32 phase)
+{
+    if (dev)
+    {
+        return sdrio_stream_set_iq_correction(&dev->rx_stream, gain, phase);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_iq_auto_correction(sdrio_device *dev, sdrio_uint8 enable)
+{
+    if (dev)
+    {
+        return sdrio_stream_set_iq_auto_correction(&dev->rx_stream, enable);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_get_rx_iq_correction(sdrio_device *dev, sdrio_float32 *gain, sdrio_float32 *phase)
+{
+    if (dev)
+    {
+        return sdrio_stream_get_iq_correction(&dev->rx_stream, gain, phase);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_spectrum(sdrio_device *dev, sdrio_uint32 size, sdrio_window window, sdrio_uint32 overlap, sdrio_uint32 averages, sdrio_rx_spectrum_callback callback, void *context)
+{
+    if (dev)
+    {
+        return sdrio_stream_set_spectrum(&dev->rx_stream, size, window, overlap, averages, callback, context);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_get_stats(sdrio_device *dev, sdrio_stats *stats)
+{
+    if (dev && stats)
+    {
+        sdrio_stream_get_stats(&dev->rx_stream, stats);
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_histograms(sdrio_device *dev, sdrio_uint8 enable)
+{
+    if (dev)
+    {
+        return sdrio_stream_set_histograms(&dev->rx_stream, enable);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_get_rx_histogram(sdrio_device *dev, sdrio_histogram_kind kind, sdrio_histogram *histogram)
+{
+    if (dev && histogram)
+    {
+        return sdrio_stream_get_histogram(&dev->rx_stream, kind, histogram);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_write_rx_histograms(sdrio_device *dev, const char *path)
+{
+    if (dev && path)
+    {
+        return sdrio_stream_write_histograms(&dev->rx_stream, path);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_start_rx_recording(sdrio_device *dev, const char *path, sdrio_uint8 native)
+{
+    if (dev && path)
+    {
+        return sdrio_stream_start_recording(&dev->rx_stream, path, native, mirisdr_get_sample_rate(dev->mirics_device), sdrio_get_device_string(dev));
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_stop_rx_recording(sdrio_device *dev)
+{
+    if (dev)
+    {
+        return sdrio_stream_stop_recording(&dev->rx_stream);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_get_rx_recording_stats(sdrio_device *dev, sdrio_recording_stats *stats)
+{
+    if (dev && stats)
+    {
+        sdrio_stream_get_recording_stats(&dev->rx_stream, stats);
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_start_rx_pretrigger(sdrio_device *dev, const char *path, sdrio_float64 pre_seconds, sdrio_float64 post_seconds)
+{
+    if (dev && path)
+    {
+        return sdrio_stream_start_pretrigger(&dev->rx_stream, path, pre_seconds, post_seconds, mirisdr_get_sample_rate(dev->mirics_device), sdrio_get_device_string(dev));
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_stop_rx_pretrigger(sdrio_device *dev)
+{
+    if (dev)
+    {
+        sdrio_stream_stop_pretrigger(&dev->rx_stream);
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_trigger_power(sdrio_device *dev, sdrio_float32 threshold, sdrio_uint32 window)
+{
+    if (dev)
+    {
+        sdrio_stream_set_trigger_power(&dev->rx_stream, threshold, window);
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_trigger_rx(sdrio_device *dev)
+{
+    if (dev)
+    {
+        return sdrio_stream_trigger(&dev->rx_stream);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_get_rx_pretrigger_stats(sdrio_device *dev, sdrio_pretrigger_stats *stats)
+{
+    if (dev && stats)
+    {
+        sdrio_stream_get_pretrigger_stats(&dev->rx_stream, stats);
+        return 1;
     }
     else
     {
@@ -212,6 +481,14 @@ SDRIOEXPORT sdrio_int32 sdrio_stop_rx(sdrio_device *dev)
         mirisdr_cancel_async(dev->mirics_device);
         mirisdr_stop_async(dev->mirics_device);
         pthread_join(dev->tid, 0);
+        sdrio_stream_stop(&dev->rx_stream);
+
+        // The NCO only runs while streaming float32, so put the hardware on
+        // the target now.
+        if (sdrio_stream_get_offset(&dev->rx_stream))
+        {
+            sdrio_set_rx_frequency(dev, sdrio_get_rx_frequency(dev));
+        }
         return 1;
     }
     else
@@ -235,7 +512,7 @@ SDRIOEXPORT sdrio_int64 sdrio_get_rx_frequency(sdrio_device *dev)
 {
     if (dev)
     {
-        return mirisdr_get_center_freq(dev->mirics_device);
+        return mirisdr_get_center_freq(dev->mirics_device) + sdrio_stream_get_offset(&dev->rx_stream);
     }
     else
     {
@@ -243,8 +520,6 @@ SDRIOEXPORT sdrio_int64 sdrio_get_rx_frequency(sdrio_device *dev)
     }
 }
 
-static const sdrio_uint32 sample_rates[] = {3*512*1024, 2*1024*1024, 4*1024*1024, 23*256*1024, 123*64*1024, 35*256*1024, 23*512*1024};
-
 SDRIOEXPORT sdrio_int32 sdrio_get_num_samplerates(sdrio_device *dev)
 {
     return sizeof(sample_rates) / sizeof(sample_rates[0]);
@@ -259,7 +534,32 @@ SDRIOEXPORT sdrio_int64 sdrio_get_rx_samplerate(sdrio_device *dev)
 {
     if (dev)
     {
-        return mirisdr_get_sample_rate(dev->mirics_device);
+        return sdrio_stream_get_rate(&dev->rx_stream, mirisdr_get_sample_rate(dev->mirics_device));
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int64 sdrio_get_rx_block_frequency(sdrio_device *dev)
+{
+    if (dev)
+    {
+        return sdrio_stream_get_block_frequency(&dev->rx_stream);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_get_rx_block_meta(sdrio_device *dev, sdrio_rx_meta *meta)
+{
+    if (dev && meta)
+    {
+        sdrio_stream_get_block_meta(&dev->rx_stream, meta);
+        return 1;
     }
     else
     {
@@ -314,7 +614,13 @@ SDRIOEXPORT sdrio_int32 sdrio_set_rx_gain(sdrio_device *dev, sdrio_float32 gain)
 {
     if (dev)
     {
-        return (mirisdr_set_tuner_gain(dev->mirics_device, (int)gain) == 0);
+        if (mirisdr_set_tuner_gain(dev->mirics_device, (int)gain) == 0)
+        {
+            sdrio_stream_set_gain(&dev->rx_stream, gain);
+            return 1;
+        }
+
+        return 0;
     }
     else
     {
@@ -5,12 +5,19 @@
 #include <string.h>
 
 #include "sdrio_ext.h"
+#include "sdrio_stream.h"
 
 #define rtlsdr_STATIC
 #include "rtl-sdr.h"
 
 #include "pthread.h"
 
+#define RX_BUFFER_LENGTH 65536
+
+// Lower rates are reached by decimating from within this range.
+#define MIN_SAMPLERATE 900001
+#define MAX_SAMPLERATE 3200000
+
 typedef struct sdrio_device_t
 {
     sdrio_uint32 device_index;
@@ -21,23 +28,14 @@ typedef struct sdrio_device_t
     sdrio_int32 num_gains;
     sdrio_int32 *gains;
 
-    sdrio_rx_async_callback callback;
-    void *callback_context;
+    sdrio_stream rx_stream;
     pthread_t tid;
 
-    sdrio_iq *samples;
-    sdrio_uint32 num_samples;
-
     sdrio_uint64 min_freq;
     sdrio_uint64 max_freq;
 };
 
-typedef struct sdrio_iqu8_t
-{
-    sdrio_uint8 i;
-    sdrio_uint8 q;
-} sdrio_iqu8;
-
+static const sdrio_format_desc native_format = {sdrio_sample_format_cu8, 2, 127.5f, 0.0078431373f};
 
 SDRIOEXPORT sdrio_int32 sdrio_init()
 {
@@ -56,6 +54,7 @@ SDRIOEXPORT sdrio_device * sdrio_open_device(sdrio_uint32 device_index)
     if (dev)
     {
         memset(dev, 0, sizeof(sdrio_device));
+        sdrio_stream_init(&dev->rx_stream);
         dev->device_index = device_index;
 
         rtlsdr_open(&dev->rtl_device, dev->device_index);
@@ -130,7 +129,21 @@ SDRIOEXPORT sdrio_int32 sdrio_set_rx_samplerate(sdrio_device *dev, sdrio_uint64
 {
     if (dev)
     {
-        return rtlsdr_set_sample_rate(dev->rtl_device, (uint32_t)sample_rate);
+        sdrio_uint64 hw_rate;
+        sdrio_uint32 decimation, interp, decim;
+
+        if (!sdrio_resample_plan(sample_rate, 0, 0, MIN_SAMPLERATE, MAX_SAMPLERATE, &hw_rate, &decimation, &interp, &decim) ||
+            !sdrio_stream_check_rate(&dev->rx_stream, decimation, interp, decim))
+        {
+            return 0;
+        }
+
+        if (rtlsdr_set_sample_rate(dev->rtl_device, (uint32_t)hw_rate) != 0)
+        {
+            return 0;
+        }
+
+        return sdrio_stream_set_rate(&dev->rx_stream, decimation, interp, decim);
     }
     else
     {
@@ -142,7 +155,18 @@ SDRIOEXPORT sdrio_int32 sdrio_set_rx_frequency(sdrio_device *dev, sdrio_uint64 f
 {
     if (dev)
     {
-        return rtlsdr_set_center_freq(dev->rtl_device, (uint32_t)frequency);
+        if (sdrio_stream_fine_tune(&dev->rx_stream, frequency, rtlsdr_get_sample_rate(dev->rtl_device)))
+        {
+            return 1;
+        }
+
+        if (rtlsdr_set_center_freq(dev->rtl_device, (uint32_t)frequency) != 0)
+        {
+            return 0;
+        }
+
+        sdrio_stream_set_hw_frequency(&dev->rx_stream, frequency);
+        return 1;
     }
     else
     {
@@ -164,58 +188,286 @@ void rtlsdr_read_async_cb(unsigned char *buf, uint32_t len, void *ctx)
 {
     sdrio_device *dev = (sdrio_device *)ctx;
 
-    if (dev->callback)
-    {
-        sdrio_uint32 num_samples = len / 2; // 2 bytes per sample
+    sdrio_stream_process(&dev->rx_stream, buf, len / native_format.bytes_per_sample);
+}
 
-        if (dev->num_samples != num_samples)
+SDRIOEXPORT void * start_rx_routine(void *ctx)
+{
+    sdrio_device *dev = (sdrio_device *)ctx;
+
+    if (dev)
+    {
+        rtlsdr_reset_buffer(dev->rtl_device);
+        // A failed transfer ends the whole read.
+        if (rtlsdr_read_async(dev->rtl_device, rtlsdr_read_async_cb, (void *)dev, 0, RX_BUFFER_LENGTH) < 0)
         {
-            dev->num_samples = num_samples;
+            sdrio_stream_transfer_failed(&dev->rx_stream);
+        }
+        pthread_exit(0);
+    }
 
-            if (dev->samples)
-            {
-                free(dev->samples);
-            }
+    return 0;
+}
 
-            dev->samples = (sdrio_iq *)malloc(dev->num_samples * sizeof(sdrio_iq));
+static sdrio_int32 start_rx(sdrio_device *dev, sdrio_sample_format format, sdrio_rx_async_callback callback, sdrio_rx_native_callback native_callback, void *context)
+{
+    if (dev && sdrio_stream_start(&dev->rx_stream, &native_format, format, RX_BUFFER_LENGTH / 2, callback, native_callback, context))
+    {
+        if (pthread_create(&dev->tid, 0, start_rx_routine, (void *)dev) != 0)
+        {
+            sdrio_stream_stop(&dev->rx_stream);
+            return 0;
         }
 
-        if (dev->samples)
-        {
-            sdrio_iqu8 *iqbuf = (sdrio_iqu8 *)buf;
-            sdrio_uint32 i;
-            for (i=0; i<dev->num_samples; i++)
-            {
-                dev->samples[i].i = ((float)iqbuf[i].i - 127.5f) * 0.0078431373f;
-                dev->samples[i].q = ((float)iqbuf[i].q - 127.5f) * 0.0078431373f;
-            }
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
 
-            dev->callback(dev->callback_context, dev->samples, dev->num_samples);
-        }
+SDRIOEXPORT sdrio_int32 sdrio_start_rx(sdrio_device *dev, sdrio_rx_async_callback callback, void *context)
+{
+    return start_rx(dev, sdrio_sample_format_cf32, callback, 0, context);
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_start_rx_native(sdrio_device *dev, sdrio_rx_native_callback callback, void *context)
+{
+    return start_rx(dev, native_format.format, 0, callback, context);
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_start_rx_format(sdrio_device *dev, sdrio_sample_format format, sdrio_rx_native_callback callback, void *context)
+{
+    return start_rx(dev, format, 0, callback, context);
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_queue_depth(sdrio_device *dev, sdrio_uint32 depth)
+{
+    if (dev)
+    {
+        return sdrio_stream_set_queue_depth(&dev->rx_stream, depth);
+    }
+    else
+    {
+        return 0;
     }
 }
 
-SDRIOEXPORT void * start_rx_routine(void *ctx)
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_huge_pages(sdrio_device *dev, sdrio_uint8 enable)
 {
-    sdrio_device *dev = (sdrio_device *)ctx;
+    if (dev)
+    {
+        return sdrio_stream_set_huge_pages(&dev->rx_stream, enable);
+    }
+    else
+    {
+        return 0;
+    }
+}
 
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_dc_correction(sdrio_device *dev, sdrio_uint8 enable)
+{
     if (dev)
     {
-        rtlsdr_reset_buffer(dev->rtl_device);
-        rtlsdr_read_async(dev->rtl_device, rtlsdr_read_async_cb, (void *)dev, 0, 65536);
-        pthread_exit(0);
+        return sdrio_stream_set_dc_correction(&dev->rx_stream, enable);
+    }
+    else
+    {
+        return 0;
     }
+}
 
-    return 0;
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_iq_correction(sdrio_device *dev, sdrio_float32 gain, sdrio_float32 phase)
+{
+    if (dev)
+    {
+        return sdrio_stream_set_iq_correction(&dev->rx_stream, gain, phase);
+    }
+    else
+    {
+        return 0;
+    }
 }
 
-SDRIOEXPORT sdrio_int32 sdrio_start_rx(sdrio_device *dev, sdrio_rx_async_callback callback, void *context)
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_iq_auto_correction(sdrio_device *dev, sdrio_uint8 enable)
+{
+    if (dev)
+    {
+        return sdrio_stream_set_iq_auto_correction(&dev->rx_stream, enable);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_get_rx_iq_correction(sdrio_device *dev, sdrio_float32 *gain, sdrio_float32 *phase)
+{
+    if (dev)
+    {
+        return sdrio_stream_get_iq_correction(&dev->rx_stream, gain, phase);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_spectrum(sdrio_device *dev, sdrio_uint32 size, sdrio_window window, sdrio_uint32 overlap, sdrio_uint32 averages, sdrio_rx_spectrum_callback callback, void *context)
+{
+    if (dev)
+    {
+        return sdrio_stream_set_spectrum(&dev->rx_stream, size, window, overlap, averages, callback, context);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_get_stats(sdrio_device *dev, sdrio_stats *stats)
+{
+    if (dev && stats)
+    {
+        sdrio_stream_get_stats(&dev->rx_stream, stats);
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_histograms(sdrio_device *dev, sdrio_uint8 enable)
+{
+    if (dev)
+    {
+        return sdrio_stream_set_histograms(&dev->rx_stream, enable);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_get_rx_histogram(sdrio_device *dev, sdrio_histogram_kind kind, sdrio_histogram *histogram)
+{
+    if (dev && histogram)
+    {
+        return sdrio_stream_get_histogram(&dev->rx_stream, kind, histogram);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_write_rx_histograms(sdrio_device *dev, const char *path)
+{
+    if (dev && path)
+    {
+        return sdrio_stream_write_histograms(&dev->rx_stream, path);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_start_rx_recording(sdrio_device *dev, const char *path, sdrio_uint8 native)
+{
+    if (dev && path)
+    {
+        return sdrio_stream_start_recording(&dev->rx_stream, path, native, rtlsdr_get_sample_rate(dev->rtl_device), sdrio_get_device_string(dev));
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_stop_rx_recording(sdrio_device *dev)
+{
+    if (dev)
+    {
+        return sdrio_stream_stop_recording(&dev->rx_stream);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_get_rx_recording_stats(sdrio_device *dev, sdrio_recording_stats *stats)
+{
+    if (dev && stats)
+    {
+        sdrio_stream_get_recording_stats(&dev->rx_stream, stats);
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_start_rx_pretrigger(sdrio_device *dev, const char *path, sdrio_float64 pre_seconds, sdrio_float64 post_seconds)
+{
+    if (dev && path)
+    {
+        return sdrio_stream_start_pretrigger(&dev->rx_stream, path, pre_seconds, post_seconds, rtlsdr_get_sample_rate(dev->rtl_device), sdrio_get_device_string(dev));
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_stop_rx_pretrigger(sdrio_device *dev)
 {
     if (dev)
     {
-        dev->callback = callback;
-        dev->callback_context = context;
-        return pthread_create(&dev->tid, 0, start_rx_routine, (void *)dev) == 0;
+        sdrio_stream_stop_pretrigger(&dev->rx_stream);
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_trigger_power(sdrio_device *dev, sdrio_float32 threshold, sdrio_uint32 window)
+{
+    if (dev)
+    {
+        sdrio_stream_set_trigger_power(&dev->rx_stream, threshold, window);
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_trigger_rx(sdrio_device *dev)
+{
+    if (dev)
+    {
+        return sdrio_stream_trigger(&dev->rx_stream);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_get_rx_pretrigger_stats(sdrio_device *dev, sdrio_pretrigger_stats *stats)
+{
+    if (dev && stats)
+    {
+        sdrio_stream_get_pretrigger_stats(&dev->rx_stream, stats);
+        return 1;
     }
     else
     {
@@ -229,6 +481,14 @@ SDRIOEXPORT sdrio_int32 sdrio_stop_rx(sdrio_device *dev)
     {
         rtlsdr_cancel_async(dev->rtl_device);
         pthread_join(dev->tid, 0);
+        sdrio_stream_stop(&dev->rx_stream);
+
+        // The NCO only runs while streaming float32, so put the hardware on
+        // the target now.
+        if (sdrio_stream_get_offset(&dev->rx_stream))
+        {
+            sdrio_set_rx_frequency(dev, sdrio_get_rx_frequency(dev));
+        }
         return 1;
     }
     else
@@ -252,7 +512,7 @@ SDRIOEXPORT sdrio_int64 sdrio_get_rx_frequency(sdrio_device *dev)
 {
     if (dev)
     {
-        return rtlsdr_get_center_freq(dev->rtl_device);
+        return rtlsdr_get_center_freq(dev->rtl_device) + sdrio_stream_get_offset(&dev->rx_stream);
     }
     else
     {
@@ -276,7 +536,32 @@ SDRIOEXPORT sdrio_int64 sdrio_get_rx_samplerate(sdrio_device *dev)
 {
     if (dev)
     {
-        return rtlsdr_get_sample_rate(dev->rtl_device);
+        return sdrio_stream_get_rate(&dev->rx_stream, rtlsdr_get_sample_rate(dev->rtl_device));
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int64 sdrio_get_rx_block_frequency(sdrio_device *dev)
+{
+    if (dev)
+    {
+        return sdrio_stream_get_block_frequency(&dev->rx_stream);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_get_rx_block_meta(sdrio_device *dev, sdrio_rx_meta *meta)
+{
+    if (dev && meta)
+    {
+        sdrio_stream_get_block_meta(&dev->rx_stream, meta);
+        return 1;
     }
     else
     {
@@ -347,6 +632,7 @@ SDRIOEXPORT sdrio_int32 sdrio_set_rx_gain(sdrio_device *dev, sdrio_float32 gain)
             if ((sdrio_int32)(gain * 10.0f) >= dev->gains[i])
             {
                 rtlsdr_set_tuner_gain(dev->rtl_device, dev->gains[i]);
+                sdrio_stream_set_gain(&dev->rx_stream, 0.1f * (float)dev->gains[i]);
                 return 1;
             }
         }
@@ -354,6 +640,7 @@ SDRIOEXPORT sdrio_int32 sdrio_set_rx_gain(sdrio_device *dev, sdrio_float32 gain)
         if (dev->num_gains)
         {
             rtlsdr_set_tuner_gain(dev->rtl_device, dev->gains[0]);
+            sdrio_stream_set_gain(&dev->rx_stream, 0.1f * (float)dev->gains[0]);
             return 1;
         }
         else
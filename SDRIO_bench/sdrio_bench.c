@@ -0,0 +1,452 @@
+// Copyright Scott Cutler
+// This source file is licensed under the GNU Lesser General Public License (LGPL)
+
+// End to end receive benchmark.  Loads a plugin the way an application
+// does, through the typedefs in sdrio_ext.h, and for each sample rate runs
+// open / set rate / start / stop / close while counting what reaches the
+// callback.  Against SDRIO_null in unthrottled mode this measures the
+// framework's own overhead with no hardware attached.  Against SDRIO_file,
+// with recordings named in SDRIO_FILE, it measures replay of real captures.
+//
+//   sdrio_bench [-p plugin] [-t seconds] [-q queue_depth] [-f cf32|cs16|cs8|native] [-u] [-b block] [-j jitter_ms] [rate ...]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <dlfcn.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#endif
+
+#include "sdrio_ext.h"
+#include "sdrio_null.h"
+#include "sdrio_file.h"
+#include "sdrio_clock.h"
+
+#if defined(_WIN32)
+#define DEFAULT_PLUGIN "SDRIO_null.dll"
+#else
+#define DEFAULT_PLUGIN "./SDRIO_null.so"
+#endif
+
+#define MAX_RATES 32
+
+typedef struct bench_plugin_t
+{
+    sdrio_init_t init;
+    sdrio_get_num_devices_t get_num_devices;
+    sdrio_open_device_t open_device;
+    sdrio_close_device_t close_device;
+    sdrio_get_device_string_t get_device_string;
+    sdrio_set_rx_samplerate_t set_rx_samplerate;
+    sdrio_get_rx_samplerate_t get_rx_samplerate;
+    sdrio_start_rx_t start_rx;
+    sdrio_stop_rx_t stop_rx;
+
+    // Optional
+    sdrio_start_rx_native_t start_rx_native;
+    sdrio_start_rx_format_t start_rx_format;
+    sdrio_set_rx_queue_depth_t set_rx_queue_depth;
+    sdrio_get_stats_t get_stats;
+    sdrio_set_null_pacing_t set_null_pacing;
+    sdrio_set_null_cadence_t set_null_cadence;
+    sdrio_set_file_pacing_t set_file_pacing;
+    sdrio_set_file_block_samples_t set_file_block_samples;
+    sdrio_start_rx_recording_t start_rx_recording;
+    sdrio_get_rx_recording_stats_t get_rx_recording_stats;
+} bench_plugin;
+
+typedef struct bench_counts_t
+{
+    volatile sdrio_uint64 samples;
+    volatile sdrio_uint64 first_samples;    // in the first block
+    volatile sdrio_float64 first;   // clock at the first callback
+    volatile sdrio_float64 last;    // and at the latest
+    sdrio_float32 sink;             // keeps the sample reads from being optimized out
+} bench_counts;
+
+static void * load_symbol(void *lib, const char *name)
+{
+#if defined(_WIN32)
+    return (void *)GetProcAddress((HMODULE)lib, name);
+#else
+    return dlsym(lib, name);
+#endif
+}
+
+static sdrio_int32 load_plugin(const char *path, bench_plugin *plugin)
+{
+#if defined(_WIN32)
+    void *lib = (void *)LoadLibraryA(path);
+#else
+    void *lib = dlopen(path, RTLD_NOW);
+#endif
+
+    if (!lib)
+    {
+        return 0;
+    }
+
+    memset(plugin, 0, sizeof(bench_plugin));
+    plugin->init = (sdrio_init_t)load_symbol(lib, "sdrio_init");
+    plugin->get_num_devices = (sdrio_get_num_devices_t)load_symbol(lib, "sdrio_get_num_devices");
+    plugin->open_device = (sdrio_open_device_t)load_symbol(lib, "sdrio_open_device");
+    plugin->close_device = (sdrio_close_device_t)load_symbol(lib, "sdrio_close_device");
+    plugin->get_device_string = (sdrio_get_device_string_t)load_symbol(lib, "sdrio_get_device_string");
+    plugin->set_rx_samplerate = (sdrio_set_rx_samplerate_t)load_symbol(lib, "sdrio_set_rx_samplerate");
+    plugin->get_rx_samplerate = (sdrio_get_rx_samplerate_t)load_symbol(lib, "sdrio_get_rx_samplerate");
+    plugin->start_rx = (sdrio_start_rx_t)load_symbol(lib, "sdrio_start_rx");
+    plugin->stop_rx = (sdrio_stop_rx_t)load_symbol(lib, "sdrio_stop_rx");
+
+    plugin->start_rx_native = (sdrio_start_rx_native_t)load_symbol(lib, "sdrio_start_rx_native");
+    plugin->start_rx_format = (sdrio_start_rx_format_t)load_symbol(lib, "sdrio_start_rx_format");
+    plugin->set_rx_queue_depth = (sdrio_set_rx_queue_depth_t)load_symbol(lib, "sdrio_set_rx_queue_depth");
+    plugin->get_stats = (sdrio_get_stats_t)load_symbol(lib, "sdrio_get_stats");
+    plugin->set_null_pacing = (sdrio_set_null_pacing_t)load_symbol(lib, "sdrio_set_null_pacing");
+    plugin->set_null_cadence = (sdrio_set_null_cadence_t)load_symbol(lib, "sdrio_set_null_cadence");
+    plugin->set_file_pacing = (sdrio_set_file_pacing_t)load_symbol(lib, "sdrio_set_file_pacing");
+    plugin->set_file_block_samples = (sdrio_set_file_block_samples_t)load_symbol(lib, "sdrio_set_file_block_samples");
+    plugin->start_rx_recording = (sdrio_start_rx_recording_t)load_symbol(lib, "sdrio_start_rx_recording");
+    plugin->get_rx_recording_stats = (sdrio_get_rx_recording_stats_t)load_symbol(lib, "sdrio_get_rx_recording_stats");
+
+    return plugin->init && plugin->get_num_devices && plugin->open_device && plugin->close_device && plugin->get_device_string &&
+           plugin->set_rx_samplerate && plugin->get_rx_samplerate && plugin->start_rx && plugin->stop_rx;
+}
+
+// User plus kernel time of the whole process, in seconds.
+static sdrio_float64 cpu_time()
+{
+#if defined(_WIN32)
+    FILETIME creation, exit, kernel, user;
+    ULARGE_INTEGER k, u;
+
+    GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user);
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    return (k.QuadPart + u.QuadPart) * 1e-7;
+#else
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+#endif
+}
+
+static void sleep_seconds(sdrio_float64 seconds)
+{
+#if defined(_WIN32)
+    Sleep((DWORD)(seconds * 1000));
+#else
+    usleep((useconds_t)(seconds * 1e6));
+#endif
+}
+
+static void count_block(bench_counts *counts, sdrio_uint32 length)
+{
+    sdrio_float64 now = sdrio_clock_now();
+
+    if (!counts->samples)
+    {
+        counts->first = now;
+        counts->first_samples = length;
+    }
+
+    counts->last = now;
+    counts->samples += length;
+}
+
+static sdrio_int32 float_callback(void *context, sdrio_iq *samples, sdrio_uint32 length)
+{
+    bench_counts *counts = (bench_counts *)context;
+
+    counts->sink += samples[0].i + samples[length - 1].q;
+    count_block(counts, length);
+    return 0;
+}
+
+static sdrio_int32 format_callback(void *context, const void *samples, sdrio_uint32 length, const sdrio_format_desc *format)
+{
+    bench_counts *counts = (bench_counts *)context;
+
+    counts->sink += ((const sdrio_uint8 *)samples)[length * format->bytes_per_sample - 1];
+    count_block(counts, length);
+    return 0;
+}
+
+static sdrio_int32 parse_format(const char *name, sdrio_sample_format *format, sdrio_uint8 *native)
+{
+    *native = 0;
+
+    if (!strcmp(name, "cf32"))
+    {
+        *format = sdrio_sample_format_cf32;
+    }
+    else if (!strcmp(name, "cs16"))
+    {
+        *format = sdrio_sample_format_cs16;
+    }
+    else if (!strcmp(name, "cs8"))
+    {
+        *format = sdrio_sample_format_cs8;
+    }
+    else if (!strcmp(name, "native"))
+    {
+        *native = 1;
+    }
+    else
+    {
+        return 0;
+    }
+
+    return 1;
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: sdrio_bench [-p plugin] [-t seconds] [-q queue_depth] [-f cf32|cs16|cs8|native] [-u] [-b block] [-j jitter_ms] [-r path] [rate ...]\n");
+    fprintf(stderr, "  -u  unthrottled: the null or file device delivers as fast as it is consumed\n");
+    fprintf(stderr, "  -b  null or file device samples per block\n");
+    fprintf(stderr, "  -j  null device delays each block by up to this many ms\n");
+    fprintf(stderr, "  -r  records each rate, as the hardware delivers it, to path.sigmf-data\n");
+}
+
+static sdrio_int32 run(bench_plugin *plugin, sdrio_uint64 rate, sdrio_float64 seconds, sdrio_int32 queue_depth,
+                       sdrio_sample_format format, sdrio_uint8 native, sdrio_uint8 unthrottled, sdrio_uint32 block, sdrio_float64 jitter, const char *record)
+{
+    sdrio_device *dev = plugin->open_device(0);
+    bench_counts counts;
+    sdrio_stats stats;
+    sdrio_recording_stats recording;
+    sdrio_int64 reported;
+    sdrio_int32 started;
+    sdrio_float64 cpu_start, cpu_used, wall, delivered;
+
+    if (!dev)
+    {
+        fprintf(stderr, "can't open device 0\n");
+        return 0;
+    }
+
+    if (!plugin->set_rx_samplerate(dev, rate))
+    {
+        printf("%12.0f  rate refused\n", (double)rate);
+        plugin->close_device(dev);
+        return 1;
+    }
+
+    if ((queue_depth >= 0) && plugin->set_rx_queue_depth)
+    {
+        plugin->set_rx_queue_depth(dev, (sdrio_uint32)queue_depth);
+    }
+
+    if (plugin->set_null_pacing)
+    {
+        plugin->set_null_pacing(dev, unthrottled ? sdrio_null_pacing_unthrottled : ((jitter > 0.0) ? sdrio_null_pacing_jitter : sdrio_null_pacing_realtime));
+    }
+
+    if (block && plugin->set_null_cadence)
+    {
+        plugin->set_null_cadence(dev, block, jitter);
+    }
+
+    if (plugin->set_file_pacing)
+    {
+        plugin->set_file_pacing(dev, unthrottled ? sdrio_file_pacing_unthrottled : sdrio_file_pacing_realtime);
+    }
+
+    if (block && plugin->set_file_block_samples)
+    {
+        plugin->set_file_block_samples(dev, block);
+    }
+
+    reported = plugin->get_rx_samplerate(dev);
+    memset(&counts, 0, sizeof(bench_counts));
+    cpu_start = cpu_time();
+
+    if (native)
+    {
+        started = plugin->start_rx_native && plugin->start_rx_native(dev, format_callback, &counts);
+    }
+    else if (format != sdrio_sample_format_cf32)
+    {
+        started = plugin->start_rx_format && plugin->start_rx_format(dev, format, format_callback, &counts);
+    }
+    else
+    {
+        started = plugin->start_rx(dev, float_callback, &counts);
+    }
+
+    if (!started)
+    {
+        printf("%12.0f  start refused\n", (double)rate);
+        plugin->close_device(dev);
+        return 1;
+    }
+
+    memset(&recording, 0, sizeof(sdrio_recording_stats));
+    if (record && !(plugin->start_rx_recording && plugin->start_rx_recording(dev, record, 1)))
+    {
+        fprintf(stderr, "can't record to %s\n", record);
+        record = 0;
+    }
+
+    sleep_seconds(seconds);
+
+    memset(&stats, 0, sizeof(sdrio_stats));
+    if (plugin->get_stats)
+    {
+        plugin->get_stats(dev, &stats);
+    }
+
+    plugin->stop_rx(dev);
+    cpu_used = cpu_time() - cpu_start;
+
+    // Stopping writes out what the recorder still had buffered.
+    if (record && plugin->get_rx_recording_stats)
+    {
+        plugin->get_rx_recording_stats(dev, &recording);
+    }
+    plugin->close_device(dev);
+
+    // Rate over the span between the first and last callbacks, so start up
+    // latency doesn't count against it.  The first block arrived at the
+    // start of that span, so only the blocks after it fill it.
+    wall = counts.last - counts.first;
+    delivered = (wall > 0.0) ? (counts.samples - counts.first_samples) / wall : 0.0;
+
+    printf("%12.0f %12.0f %12.0f %8.3f %7.1f %10.2f %8llu %10llu %10.1f\n",
+           (double)rate, (double)reported, delivered, delivered / rate,
+           100.0 * cpu_used / seconds,
+           (delivered > 0.0) ? 100.0 * cpu_used / seconds / (delivered * 1e-6) : 0.0,
+           (unsigned long long)stats.overruns, (unsigned long long)stats.samples_lost,
+           stats.callback_max * 1e6);
+
+    if (record)
+    {
+        printf("%12s recorded %llu, dropped %llu%s%s\n", "",
+               (unsigned long long)recording.samples_written, (unsigned long long)recording.samples_dropped,
+               recording.unbuffered ? ", unbuffered" : "", recording.failed ? ", write failed" : "");
+    }
+
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    static const sdrio_uint64 default_rates[] = {250000, 1024000, 2048000, 2400000, 8000000, 20000000};
+    const char *path = DEFAULT_PLUGIN;
+    sdrio_float64 seconds = 2.0;
+    sdrio_int32 queue_depth = -1;
+    sdrio_sample_format format = sdrio_sample_format_cf32;
+    sdrio_uint8 native = 0, unthrottled = 0;
+    sdrio_uint32 block = 0;
+    sdrio_float64 jitter = 0.0;
+    const char *record = 0;
+    sdrio_uint64 rates[MAX_RATES];
+    sdrio_uint32 num_rates = 0, n;
+    bench_plugin plugin;
+    int i;
+
+    for (i=1; i<argc; i++)
+    {
+        if (!strcmp(argv[i], "-p") && (i + 1 < argc))
+        {
+            path = argv[++i];
+        }
+        else if (!strcmp(argv[i], "-t") && (i + 1 < argc))
+        {
+            seconds = atof(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "-q") && (i + 1 < argc))
+        {
+            queue_depth = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "-f") && (i + 1 < argc))
+        {
+            if (!parse_format(argv[++i], &format, &native))
+            {
+                usage();
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-u"))
+        {
+            unthrottled = 1;
+        }
+        else if (!strcmp(argv[i], "-b") && (i + 1 < argc))
+        {
+            block = (sdrio_uint32)atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "-j") && (i + 1 < argc))
+        {
+            jitter = atof(argv[++i]) * 1e-3;
+        }
+        else if (!strcmp(argv[i], "-r") && (i + 1 < argc))
+        {
+            record = argv[++i];
+        }
+        else if ((argv[i][0] != '-') && (num_rates < MAX_RATES))
+        {
+            rates[num_rates++] = (sdrio_uint64)atof(argv[i]);
+        }
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    if (!num_rates)
+    {
+        num_rates = sizeof(default_rates) / sizeof(default_rates[0]);
+        memcpy(rates, default_rates, sizeof(default_rates));
+    }
+
+    if (!load_plugin(path, &plugin))
+    {
+        fprintf(stderr, "can't load %s, or it is missing a required export\n", path);
+        return 1;
+    }
+
+    if (!plugin.init() || (plugin.get_num_devices() < 1))
+    {
+        fprintf(stderr, "%s has no devices\n", path);
+        return 1;
+    }
+
+    if ((unthrottled || block) && !plugin.set_null_pacing && !plugin.set_file_pacing)
+    {
+        fprintf(stderr, "-u and -b need the null or file device; running in real time\n");
+    }
+
+    if ((jitter > 0.0) && !plugin.set_null_pacing)
+    {
+        fprintf(stderr, "-j needs the null device\n");
+    }
+
+    // The jitter goes in with the block size, so it needs one.
+    if ((jitter > 0.0) && !block)
+    {
+        block = 16384;
+    }
+
+    printf("%s, %.1f s per rate%s\n", path, seconds, (unthrottled && (plugin.set_null_pacing || plugin.set_file_pacing)) ? ", unthrottled" : "");
+    printf("%12s %12s %12s %8s %7s %10s %8s %10s %10s\n",
+           "requested", "reported", "delivered", "ratio", "cpu %", "cpu%/MSps", "overruns", "lost", "cb max us");
+
+    for (n=0; n<num_rates; n++)
+    {
+        if (!run(&plugin, rates[n], seconds, queue_depth, format, native, unthrottled, block, jitter, record))
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
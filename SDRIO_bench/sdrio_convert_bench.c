@@ -0,0 +1,276 @@
+// Copyright Scott Cutler
+// This source file is licensed under the GNU Lesser General Public License (LGPL)
+
+// Micro-benchmark of the sample conversion kernels in sdrio_convert.c, one
+// line per kernel, variant and block size.  Blocks are taken one after the
+// other from a buffer larger than the caches, the way a stream walks its
+// transfer buffers, so small blocks show the per-call overhead and large
+// ones the memory bandwidth.  GB/s counts bytes read plus bytes written.
+//
+// Each SIMD variant is checked against the scalar one; "max diff" is in the
+// units of the converted samples (1/32767 for cf32, LSBs otherwise).  A '*'
+// marks the variant sdrio_get_convert picks on this CPU.  The Mirics packed
+// formats are unpacked inside libmirisdr, see miri_bench there.
+//
+//   sdrio_convert_bench [-n million_samples] [-s span_MB] [-k kernel] [block ...]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "sdrio_ext.h"
+#include "sdrio_convert.h"
+#include "sdrio_pool.h"
+#include "sdrio_clock.h"
+
+#define MAX_BLOCKS 16
+
+typedef struct bench_kernel_t
+{
+    const char *name;
+    sdrio_sample_format src;
+    sdrio_sample_format dst;
+    sdrio_convert_t scalar;
+    sdrio_convert_t sse2;
+    sdrio_convert_t avx2;
+} bench_kernel;
+
+static const bench_kernel kernels[] =
+{
+    {"u8_f32",  sdrio_sample_format_cu8,     sdrio_sample_format_cf32, sdrio_convert_u8_f32_scalar,  sdrio_convert_u8_f32_sse2,  sdrio_convert_u8_f32_avx2},
+    {"u8_s16",  sdrio_sample_format_cu8,     sdrio_sample_format_cs16, sdrio_convert_u8_s16_scalar,  sdrio_convert_u8_s16_sse2,  0},
+    {"u8_s8",   sdrio_sample_format_cu8,     sdrio_sample_format_cs8,  sdrio_convert_u8_s8_scalar,   sdrio_convert_u8_s8_sse2,   0},
+    {"s8_f32",  sdrio_sample_format_cs8,     sdrio_sample_format_cf32, sdrio_convert_s8_f32_scalar,  sdrio_convert_s8_f32_sse2,  sdrio_convert_s8_f32_avx2},
+    {"s8_s16",  sdrio_sample_format_cs8,     sdrio_sample_format_cs16, sdrio_convert_s8_s16_scalar,  sdrio_convert_s8_s16_sse2,  0},
+    {"s16_f32", sdrio_sample_format_cs16,    sdrio_sample_format_cf32, sdrio_convert_s16_f32_scalar, sdrio_convert_s16_f32_sse2, sdrio_convert_s16_f32_avx2},
+    {"s16_s8",  sdrio_sample_format_cs16,    sdrio_sample_format_cs8,  sdrio_convert_s16_s8_scalar,  sdrio_convert_s16_s8_sse2,  0},
+    {"q12_f32", sdrio_sample_format_sc16q12, sdrio_sample_format_cf32, sdrio_convert_q12_f32_scalar, sdrio_convert_q12_f32_sse2, sdrio_convert_q12_f32_avx2},
+    {"q12_s16", sdrio_sample_format_sc16q12, sdrio_sample_format_cs16, sdrio_convert_q12_s16_scalar, sdrio_convert_q12_s16_sse2, 0},
+    {"q12_s8",  sdrio_sample_format_sc16q12, sdrio_sample_format_cs8,  sdrio_convert_q12_s8_scalar,  sdrio_convert_q12_s8_sse2,  0},
+    {"f32_s16", sdrio_sample_format_cf32,    sdrio_sample_format_cs16, sdrio_convert_f32_s16_scalar, sdrio_convert_f32_s16_sse2, 0},
+    {"f32_s8",  sdrio_sample_format_cf32,    sdrio_sample_format_cs8,  sdrio_convert_f32_s8_scalar,  sdrio_convert_f32_s8_sse2,  0},
+};
+
+#define NUM_KERNELS (sizeof(kernels) / sizeof(kernels[0]))
+
+// Full scale noise in the source format.  bladeRF only fills the low 12
+// bits, sign extended, which the kernels' << 4 relies on.
+static void generate(void *buf, sdrio_sample_format format, sdrio_uint32 num_samples)
+{
+    sdrio_uint32 i;
+
+    for (i=0; i<num_samples*2; i++)
+    {
+        switch (format)
+        {
+        case sdrio_sample_format_cu8:
+        case sdrio_sample_format_cs8:
+            ((sdrio_uint8 *)buf)[i] = (sdrio_uint8)rand();
+            break;
+        case sdrio_sample_format_cs16:
+            ((sdrio_int16 *)buf)[i] = (sdrio_int16)((rand() << 8) ^ rand());
+            break;
+        case sdrio_sample_format_sc16q12:
+            ((sdrio_int16 *)buf)[i] = (sdrio_int16)((rand() & 0xfff) - 2048);
+            break;
+        case sdrio_sample_format_cf32:
+            ((sdrio_float32 *)buf)[i] = (sdrio_float32)rand() / RAND_MAX * 2.0f - 1.0f;
+            break;
+        }
+    }
+}
+
+static double component(const void *buf, sdrio_sample_format format, sdrio_uint32 i)
+{
+    switch (format)
+    {
+    case sdrio_sample_format_cs8:
+        return ((const sdrio_int8 *)buf)[i];
+    case sdrio_sample_format_cs16:
+        return ((const sdrio_int16 *)buf)[i];
+    case sdrio_sample_format_cf32:
+        return ((const sdrio_float32 *)buf)[i] * 32767.0;
+    default:
+        return ((const sdrio_uint8 *)buf)[i];
+    }
+}
+
+static double max_diff(const void *a, const void *b, sdrio_sample_format format, sdrio_uint32 num_samples)
+{
+    double worst = 0.0, d;
+    sdrio_uint32 i;
+
+    for (i=0; i<num_samples*2; i++)
+    {
+        d = fabs(component(a, format, i) - component(b, format, i));
+        worst = (d > worst) ? d : worst;
+    }
+
+    return worst;
+}
+
+// Seconds to convert total samples, block samples at a time, walking the
+// span and wrapping at its end.
+static double run(sdrio_convert_t convert, void *dst, const void *src, sdrio_uint32 src_size, sdrio_uint32 dst_size,
+                  sdrio_uint32 span, sdrio_uint32 block, sdrio_uint64 total)
+{
+    sdrio_uint32 offset = 0;
+    sdrio_uint64 done;
+    double start = sdrio_clock_now();
+
+    for (done=0; done<total; done+=block)
+    {
+        convert((sdrio_uint8 *)dst + (size_t)offset * dst_size, (const sdrio_uint8 *)src + (size_t)offset * src_size, block);
+
+        offset += block;
+        if (offset + block > span)
+        {
+            offset = 0;
+        }
+    }
+
+    return sdrio_clock_now() - start;
+}
+
+static void bench(const bench_kernel *kernel, const sdrio_uint32 *blocks, sdrio_uint32 num_blocks, sdrio_uint32 span, sdrio_uint64 total,
+                  sdrio_pool *src_pool, sdrio_pool *ref_pool, sdrio_pool *dst_pool)
+{
+    static const char *variant_names[] = {"scalar", "sse2", "avx2"};
+    sdrio_convert_t variants[3];
+    sdrio_convert_t chosen = sdrio_get_convert(kernel->src, kernel->dst);
+    sdrio_uint32 features = sdrio_get_cpu_features();
+    sdrio_uint32 src_size = sdrio_get_format_size(kernel->src);
+    sdrio_uint32 dst_size = sdrio_get_format_size(kernel->dst);
+    void *src = sdrio_pool_block(src_pool, 0);
+    void *ref = sdrio_pool_block(ref_pool, 0);
+    void *dst = sdrio_pool_block(dst_pool, 0);
+    sdrio_uint32 v, b, n;
+    sdrio_uint64 samples;
+    double seconds, diff;
+
+    variants[0] = kernel->scalar;
+    variants[1] = (features & SDRIO_CPU_SSE2) ? kernel->sse2 : 0;
+    variants[2] = (features & SDRIO_CPU_AVX2) ? kernel->avx2 : 0;
+
+    generate(src, kernel->src, span);
+    kernel->scalar(ref, src, span);
+
+    for (v=0; v<3; v++)
+    {
+        if (!variants[v])
+        {
+            continue;
+        }
+
+        // Also warms up the span before it is timed.
+        memset(dst, 0, (size_t)span * dst_size);
+        variants[v](dst, src, span);
+        diff = max_diff(ref, dst, kernel->dst, span);
+
+        for (b=0; b<num_blocks; b++)
+        {
+            n = (blocks[b] < span) ? blocks[b] : span;
+
+            // Whole blocks only, and at least one pass over the span.
+            samples = (total > span) ? total : span;
+            samples -= samples % n;
+
+            seconds = run(variants[v], dst, src, src_size, dst_size, span, n, samples);
+
+            printf("%-8s %-7s%c %8lu %8.3f %8.2f %9g\n",
+                   kernel->name, variant_names[v], (variants[v] == chosen) ? '*' : ' ', (unsigned long)n,
+                   seconds * 1e9 / samples,
+                   samples * (double)(src_size + dst_size) / seconds * 1e-9,
+                   diff);
+        }
+    }
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: sdrio_convert_bench [-n million_samples] [-s span_MB] [-k kernel] [block ...]\n");
+    fprintf(stderr, "  -n  samples converted per measurement (default 32 million)\n");
+    fprintf(stderr, "  -s  size of the source span in MB (default 64, use less than the L2 for hot cache numbers)\n");
+    fprintf(stderr, "  -k  only the named kernel, e.g. u8_f32\n");
+}
+
+int main(int argc, char **argv)
+{
+    static const sdrio_uint32 default_blocks[] = {256, 4096, 65536, 1048576};
+    sdrio_uint32 blocks[MAX_BLOCKS];
+    sdrio_uint32 num_blocks = 0;
+    sdrio_uint64 total = 32000000;
+    double span_mb = 64.0;
+    const char *only = 0;
+    sdrio_uint32 span, features, k;
+    sdrio_pool src_pool, ref_pool, dst_pool;
+    int i;
+
+    for (i=1; i<argc; i++)
+    {
+        if (!strcmp(argv[i], "-n") && (i + 1 < argc))
+        {
+            total = (sdrio_uint64)(atof(argv[++i]) * 1e6);
+        }
+        else if (!strcmp(argv[i], "-s") && (i + 1 < argc))
+        {
+            span_mb = atof(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "-k") && (i + 1 < argc))
+        {
+            only = argv[++i];
+        }
+        else if ((argv[i][0] != '-') && (num_blocks < MAX_BLOCKS) && (atoi(argv[i]) > 0))
+        {
+            blocks[num_blocks++] = (sdrio_uint32)atoi(argv[i]);
+        }
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    if (!num_blocks)
+    {
+        num_blocks = sizeof(default_blocks) / sizeof(default_blocks[0]);
+        memcpy(blocks, default_blocks, sizeof(default_blocks));
+    }
+
+    // The span is sized for the widest format, cf32 at 8 bytes a sample.
+    span = (sdrio_uint32)(span_mb * 1048576 / sizeof(sdrio_iq));
+    span &= ~(sdrio_uint32)63;
+    if (!span)
+    {
+        usage();
+        return 1;
+    }
+
+    if (!sdrio_pool_init(&src_pool, 1, span * sizeof(sdrio_iq), 0) ||
+        !sdrio_pool_init(&ref_pool, 1, span * sizeof(sdrio_iq), 0) ||
+        !sdrio_pool_init(&dst_pool, 1, span * sizeof(sdrio_iq), 0))
+    {
+        fprintf(stderr, "can't allocate %.0f MB buffers\n", span_mb);
+        return 1;
+    }
+
+    features = sdrio_get_cpu_features();
+    printf("cpu:%s%s%s, span %lu samples, %.0f million samples per measurement\n",
+           (features & SDRIO_CPU_SSE2) ? " sse2" : "", (features & SDRIO_CPU_SSSE3) ? " ssse3" : "", (features & SDRIO_CPU_AVX2) ? " avx2" : "",
+           (unsigned long)span, total * 1e-6);
+    printf("%-8s %-8s %8s %8s %8s %9s\n", "kernel", "variant", "block", "ns/samp", "GB/s", "max diff");
+
+    for (k=0; k<NUM_KERNELS; k++)
+    {
+        if (!only || !strcmp(only, kernels[k].name))
+        {
+            bench(&kernels[k], blocks, num_blocks, span, total, &src_pool, &ref_pool, &dst_pool);
+        }
+    }
+
+    sdrio_pool_free(&src_pool);
+    sdrio_pool_free(&ref_pool);
+    sdrio_pool_free(&dst_pool);
+    return 0;
+}
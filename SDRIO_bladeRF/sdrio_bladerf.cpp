@@ -12,11 +12,18 @@
 #include <fstream>
 
 #include "sdrio_ext.h"
+#include "sdrio_stream.h"
 
 #include "pthread.h"
 
 #include "libbladeRF.h"
 
+#define RX_BUFFER_SAMPLES 32768
+
+// Lower rates are reached by decimating from within this range.
+#define MIN_SAMPLERATE 1000000
+#define MAX_SAMPLERATE 40000000
+
 extern "C" {
 
 struct sdrio_device_t
@@ -25,6 +32,8 @@ struct sdrio_device_t
 
     bladerf *bladerf_device;
 
+    sdrio_stream rx_stream;
+
     struct
     {
         sdrio_rx_async_callback callback;
@@ -41,6 +50,8 @@ struct sdrio_device_t
 
         sdrio_uint64 frequency;
         sdrio_uint64 sample_rate;
+
+        sdrio_uint64 timestamp;     // expected on the next block, 0 until the first
     } rx, tx;
 };
 
@@ -79,6 +90,7 @@ SDRIOEXPORT sdrio_device * sdrio_open_device(sdrio_uint32 device_index)
     {
         sdrio_device *dev = (sdrio_device *)malloc(sizeof(sdrio_device));
         memset(dev, 0, sizeof(sdrio_device));
+        sdrio_stream_init(&dev->rx_stream);
 
         if (dev)
         {
@@ -180,14 +192,23 @@ SDRIOEXPORT sdrio_int32 sdrio_set_rx_samplerate(sdrio_device *dev, sdrio_uint64
 {
     if (dev)
     {
+        sdrio_uint64 hw_rate;
+        sdrio_uint32 decimation, interp, decim;
+
+        if (!sdrio_resample_plan(sample_rate, 0, 0, MIN_SAMPLERATE, MAX_SAMPLERATE, &hw_rate, &decimation, &interp, &decim) ||
+            !sdrio_stream_check_rate(&dev->rx_stream, decimation, interp, decim))
+        {
+            return 0;
+        }
+
         unsigned int actual_rate = 0;
-        int ret = bladerf_set_sample_rate(dev->bladerf_device, BLADERF_MODULE_RX, (unsigned int)sample_rate, &actual_rate);
+        int ret = bladerf_set_sample_rate(dev->bladerf_device, BLADERF_MODULE_RX, (unsigned int)hw_rate, &actual_rate);
         dev->rx.sample_rate = (sdrio_uint64)actual_rate;
 
         unsigned int actual_bandwidth = 0;
-        ret = bladerf_set_bandwidth(dev->bladerf_device, BLADERF_MODULE_RX, (unsigned int)sample_rate, &actual_bandwidth);
+        ret = bladerf_set_bandwidth(dev->bladerf_device, BLADERF_MODULE_RX, (unsigned int)hw_rate, &actual_bandwidth);
 
-        return (ret >= 0);
+        return (ret >= 0) && sdrio_stream_set_rate(&dev->rx_stream, decimation, interp, decim);
     }
     else
     {
@@ -200,7 +221,17 @@ SDRIOEXPORT sdrio_int32 sdrio_set_rx_frequency(sdrio_device *dev, sdrio_uint64 f
     if (dev)
     {
         dev->rx.frequency = frequency;
+
+        if (sdrio_stream_fine_tune(&dev->rx_stream, frequency, dev->rx.sample_rate))
+        {
+            return 1;
+        }
+
         int ret = bladerf_set_frequency(dev->bladerf_device, BLADERF_MODULE_RX, (unsigned int)dev->rx.frequency);
+        if (ret >= 0)
+        {
+            sdrio_stream_set_hw_frequency(&dev->rx_stream, frequency);
+        }
         return (ret >= 0);
     }
     else
@@ -248,39 +279,28 @@ typedef struct sdrio_iqi16_t
     int16_t q;
 } sdrio_iqi16;
 
+static const sdrio_format_desc native_format = {sdrio_sample_format_sc16q12, sizeof(sdrio_iqi16), 0.0f, 1.0f / 2048.0f};
+
 void * bladerf_stream_rx_callback(struct bladerf *bladerf_device, struct bladerf_stream *stream, struct bladerf_metadata *meta, void *samples, size_t num_samples, void *user_data)
 {
     sdrio_device *dev = (sdrio_device *)user_data;
 
     if (dev)
     {
-        if (dev->rx.num_samples != num_samples)
+        // The metadata timestamp counts samples where the library fills it
+        // in, so a jump past the last block's end is samples the FPGA or
+        // USB dropped.
+        if (meta && meta->timestamp)
         {
-            dev->rx.num_samples = num_samples;
-
-            if (dev->rx.samples)
+            if (dev->rx.timestamp && (meta->timestamp > dev->rx.timestamp))
             {
-                free(dev->rx.samples);
+                sdrio_stream_mark_discontinuity(&dev->rx_stream, (sdrio_uint32)(meta->timestamp - dev->rx.timestamp));
             }
 
-            dev->rx.samples = (sdrio_iq *)malloc(dev->rx.num_samples * sizeof(sdrio_iq));
+            dev->rx.timestamp = meta->timestamp + num_samples;
         }
 
-        if (dev->rx.samples)
-        {
-            sdrio_iqi16 *iqbuf = (sdrio_iqi16 *)samples;
-            sdrio_uint32 i;
-
-            for (i=0; i<dev->rx.num_samples; i++)
-            {
-                dev->rx.samples[i].i = (float)(int16_t)(iqbuf[i].i << 4) * (0.000030517578125f);
-                dev->rx.samples[i].q = (float)(int16_t)(iqbuf[i].q << 4) * (0.000030517578125f);
-                //dev->rx.samples[i].i = (float)(int16_t)(iqbuf[i].q << 4) * (0.000030517578125f);
-                //dev->rx.samples[i].q = (float)(int16_t)(iqbuf[i].i << 4) * (0.000030517578125f);
-            }
-
-            dev->rx.callback(dev->rx.callback_context, dev->rx.samples, dev->rx.num_samples);
-        }
+        sdrio_stream_process(&dev->rx_stream, samples, (sdrio_uint32)num_samples);
 
         if (!dev->rx.done)
         {
@@ -303,7 +323,7 @@ SDRIOEXPORT void * start_rx_routine(void *ctx)
         dev->rx.buffers = 0;
         dev->rx.num_buffers = 32;
         bladerf_format format = BLADERF_FORMAT_SC16_Q12;
-        size_t num_samples = 32768;
+        size_t num_samples = RX_BUFFER_SAMPLES;
         size_t num_transfers = 16;
         int ret = bladerf_init_stream(
             &stream,
@@ -316,20 +336,277 @@ SDRIOEXPORT void * start_rx_routine(void *ctx)
             num_transfers,
             ctx);
 
-        bladerf_stream(stream, BLADERF_MODULE_RX);
+        if (bladerf_stream(stream, BLADERF_MODULE_RX) < 0)
+        {
+            sdrio_stream_transfer_failed(&dev->rx_stream);
+        }
     }
 
     return 0;
 }
 
+static sdrio_int32 start_rx(sdrio_device *dev, sdrio_sample_format format, sdrio_rx_async_callback callback, sdrio_rx_native_callback native_callback, void *context)
+{
+    if (dev && sdrio_stream_start(&dev->rx_stream, &native_format, format, RX_BUFFER_SAMPLES, callback, native_callback, context))
+    {
+        dev->rx.timestamp = 0;
+        bladerf_enable_module(dev->bladerf_device, BLADERF_MODULE_RX, true);
+        if (pthread_create(&dev->rx.tid, 0, start_rx_routine, (void *)dev) != 0)
+        {
+            bladerf_enable_module(dev->bladerf_device, BLADERF_MODULE_RX, false);
+            sdrio_stream_stop(&dev->rx_stream);
+            return 0;
+        }
+
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
 SDRIOEXPORT sdrio_int32 sdrio_start_rx(sdrio_device *dev, sdrio_rx_async_callback callback, void *context)
+{
+    return start_rx(dev, sdrio_sample_format_cf32, callback, 0, context);
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_start_rx_native(sdrio_device *dev, sdrio_rx_native_callback callback, void *context)
+{
+    return start_rx(dev, native_format.format, 0, callback, context);
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_start_rx_format(sdrio_device *dev, sdrio_sample_format format, sdrio_rx_native_callback callback, void *context)
+{
+    return start_rx(dev, format, 0, callback, context);
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_queue_depth(sdrio_device *dev, sdrio_uint32 depth)
 {
     if (dev)
     {
-        dev->rx.callback = callback;
-        dev->rx.callback_context = context;
-        bladerf_enable_module(dev->bladerf_device, BLADERF_MODULE_RX, true);
-        return pthread_create(&dev->rx.tid, 0, start_rx_routine, (void *)dev) == 0;
+        return sdrio_stream_set_queue_depth(&dev->rx_stream, depth);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_huge_pages(sdrio_device *dev, sdrio_uint8 enable)
+{
+    if (dev)
+    {
+        return sdrio_stream_set_huge_pages(&dev->rx_stream, enable);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_dc_correction(sdrio_device *dev, sdrio_uint8 enable)
+{
+    if (dev)
+    {
+        return sdrio_stream_set_dc_correction(&dev->rx_stream, enable);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_iq_correction(sdrio_device *dev, sdrio_float32 gain, sdrio_float32 phase)
+{
+    if (dev)
+    {
+        return sdrio_stream_set_iq_correction(&dev->rx_stream, gain, phase);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_iq_auto_correction(sdrio_device *dev, sdrio_uint8 enable)
+{
+    if (dev)
+    {
+        return sdrio_stream_set_iq_auto_correction(&dev->rx_stream, enable);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_get_rx_iq_correction(sdrio_device *dev, sdrio_float32 *gain, sdrio_float32 *phase)
+{
+    if (dev)
+    {
+        return sdrio_stream_get_iq_correction(&dev->rx_stream, gain, phase);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_spectrum(sdrio_device *dev, sdrio_uint32 size, sdrio_window window, sdrio_uint32 overlap, sdrio_uint32 averages, sdrio_rx_spectrum_callback callback, void *context)
+{
+    if (dev)
+    {
+        return sdrio_stream_set_spectrum(&dev->rx_stream, size, window, overlap, averages, callback, context);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_get_stats(sdrio_device *dev, sdrio_stats *stats)
+{
+    if (dev && stats)
+    {
+        sdrio_stream_get_stats(&dev->rx_stream, stats);
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_histograms(sdrio_device *dev, sdrio_uint8 enable)
+{
+    if (dev)
+    {
+        return sdrio_stream_set_histograms(&dev->rx_stream, enable);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_get_rx_histogram(sdrio_device *dev, sdrio_histogram_kind kind, sdrio_histogram *histogram)
+{
+    if (dev && histogram)
+    {
+        return sdrio_stream_get_histogram(&dev->rx_stream, kind, histogram);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_write_rx_histograms(sdrio_device *dev, const char *path)
+{
+    if (dev && path)
+    {
+        return sdrio_stream_write_histograms(&dev->rx_stream, path);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_start_rx_recording(sdrio_device *dev, const char *path, sdrio_uint8 native)
+{
+    if (dev && path)
+    {
+        return sdrio_stream_start_recording(&dev->rx_stream, path, native, dev->rx.sample_rate, sdrio_get_device_string(dev));
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_stop_rx_recording(sdrio_device *dev)
+{
+    if (dev)
+    {
+        return sdrio_stream_stop_recording(&dev->rx_stream);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_get_rx_recording_stats(sdrio_device *dev, sdrio_recording_stats *stats)
+{
+    if (dev && stats)
+    {
+        sdrio_stream_get_recording_stats(&dev->rx_stream, stats);
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_start_rx_pretrigger(sdrio_device *dev, const char *path, sdrio_float64 pre_seconds, sdrio_float64 post_seconds)
+{
+    if (dev && path)
+    {
+        return sdrio_stream_start_pretrigger(&dev->rx_stream, path, pre_seconds, post_seconds, dev->rx.sample_rate, sdrio_get_device_string(dev));
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_stop_rx_pretrigger(sdrio_device *dev)
+{
+    if (dev)
+    {
+        sdrio_stream_stop_pretrigger(&dev->rx_stream);
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_trigger_power(sdrio_device *dev, sdrio_float32 threshold, sdrio_uint32 window)
+{
+    if (dev)
+    {
+        sdrio_stream_set_trigger_power(&dev->rx_stream, threshold, window);
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_trigger_rx(sdrio_device *dev)
+{
+    if (dev)
+    {
+        return sdrio_stream_trigger(&dev->rx_stream);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_get_rx_pretrigger_stats(sdrio_device *dev, sdrio_pretrigger_stats *stats)
+{
+    if (dev && stats)
+    {
+        sdrio_stream_get_pretrigger_stats(&dev->rx_stream, stats);
+        return 1;
     }
     else
     {
@@ -344,6 +621,14 @@ SDRIOEXPORT sdrio_int32 sdrio_stop_rx(sdrio_device *dev)
         dev->rx.done = 1;
         pthread_join(dev->rx.tid, 0);
         bladerf_enable_module(dev->bladerf_device, BLADERF_MODULE_RX, false);
+        sdrio_stream_stop(&dev->rx_stream);
+
+        // The NCO only runs while streaming float32, so put the hardware on
+        // the target now.
+        if (sdrio_stream_get_offset(&dev->rx_stream))
+        {
+            sdrio_set_rx_frequency(dev, sdrio_get_rx_frequency(dev));
+        }
         return 1;
     }
     else
@@ -482,7 +767,32 @@ SDRIOEXPORT sdrio_int64 sdrio_get_rx_samplerate(sdrio_device *dev)
 {
     if (dev)
     {
-        return dev->rx.sample_rate;
+        return sdrio_stream_get_rate(&dev->rx_stream, dev->rx.sample_rate);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int64 sdrio_get_rx_block_frequency(sdrio_device *dev)
+{
+    if (dev)
+    {
+        return sdrio_stream_get_block_frequency(&dev->rx_stream);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_get_rx_block_meta(sdrio_device *dev, sdrio_rx_meta *meta)
+{
+    if (dev && meta)
+    {
+        sdrio_stream_get_block_meta(&dev->rx_stream, meta);
+        return 1;
     }
     else
     {
@@ -576,6 +886,7 @@ SDRIOEXPORT sdrio_int32 sdrio_set_rx_gain(sdrio_device *dev, float gain)
             bladerf_set_lpf_mode(dev->bladerf_device, BLADERF_MODULE_RX, BLADERF_LPF_NORMAL);
         }
 
+        sdrio_stream_set_gain(&dev->rx_stream, gain);
         return 1;
     }
     else
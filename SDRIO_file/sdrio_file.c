@@ -0,0 +1,1066 @@
+// Copyright Scott Cutler
+// This source file is licensed under the GNU Lesser General Public License (LGPL)
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sdrio_ext.h"
+#include "sdrio_stream.h"
+#include "sdrio_file.h"
+#include "sdrio_file_source.h"
+#include "sdrio_pacer.h"
+
+#include "pthread.h"
+#include "semaphore.h"
+
+// Only used when a recording doesn't say where it was made.
+#define MIN_FREQ 5000000
+#define MAX_FREQ 4000000000
+
+// A recording's level is whatever it was captured at.
+#define MIN_GAIN 0.0f
+#define MAX_GAIN 0.0f
+
+#define NUM_SAMPLES 16384
+#define MIN_BLOCK_SAMPLES 64
+#define MAX_BLOCK_SAMPLES (1024*1024)
+
+typedef struct sdrio_device_t
+{
+    volatile sdrio_uint8 running;
+    sdrio_uint64 rx_freq;
+
+    sdrio_stream rx_stream;
+    pthread_t tid;
+
+    sdrio_file_source captures[SDRIO_FILE_MAX_CAPTURES];
+    sdrio_uint32 num_captures;
+    sdrio_uint64 requested_rate;        // 0 for the recording's own
+
+    // Requests from the API, applied by the driver thread between blocks
+    // (or at once while stopped), and where replay has got to.
+    pthread_mutex_t lock;
+    sdrio_uint32 target;                // picked by sdrio_set_rx_frequency
+    sdrio_uint32 capture;               // being replayed
+    sdrio_uint64 position;              // next sample of it
+    sdrio_uint64 seek;
+    sdrio_uint8 seeking;
+    volatile sdrio_uint8 loop;
+    sem_t wake;                         // for the driver thread, idle at the end
+
+    sdrio_uint32 block_samples;
+
+    sdrio_pacer pacer;
+    volatile sdrio_file_pacing pacing;
+    volatile sdrio_uint32 pacing_serial;    // bumped when the schedule needs replanning
+    sdrio_uint32 paced_serial;
+};
+
+SDRIOEXPORT sdrio_int32 sdrio_init()
+{
+    return 1;
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_get_num_devices()
+{
+    const char *files = getenv("SDRIO_FILE");
+
+    return (files && *files) ? 1 : 0;
+}
+
+// Picks the recording whose band holds frequency, nearest the centre.  One
+// made at an unknown frequency takes anything no other recording covers.
+static sdrio_int32 find_capture(sdrio_device *dev, sdrio_uint64 frequency)
+{
+    sdrio_int32 best = -1, fallback = -1;
+    sdrio_uint64 distance, best_distance = 0;
+    sdrio_uint32 i;
+
+    for (i = 0; i < dev->num_captures; i++)
+    {
+        if (!dev->captures[i].frequency)
+        {
+            if (fallback < 0)
+            {
+                fallback = i;
+            }
+            continue;
+        }
+
+        distance = (frequency > dev->captures[i].frequency) ? frequency - dev->captures[i].frequency : dev->captures[i].frequency - frequency;
+        if ((distance < dev->captures[i].sample_rate / 2) && ((best < 0) || (distance < best_distance)))
+        {
+            best = i;
+            best_distance = distance;
+        }
+    }
+
+    return (best >= 0) ? best : fallback;
+}
+
+// Decimation and resampling to turn the recording's rate into the one asked
+// for.
+static sdrio_int32 plan_rate(sdrio_device *dev, const sdrio_file_source *source, sdrio_uint64 sample_rate)
+{
+    sdrio_uint32 rate = (sdrio_uint32)source->sample_rate;
+    sdrio_uint64 hw_rate;
+    sdrio_uint32 decimation = 1, interp = 1, decim = 1;
+
+    if (sample_rate && !sdrio_resample_plan(sample_rate, &rate, 1, 0, 0, &hw_rate, &decimation, &interp, &decim))
+    {
+        return 0;
+    }
+
+    // Only float32 output can be decimated or resampled, and a running
+    // stream keeps its format, so native replay stays at the recording's
+    // rate: the stream refuses the plan.
+    return sdrio_stream_set_rate(&dev->rx_stream, decimation, interp, decim);
+}
+
+// With the lock held.  Returns 1 if replay jumped.
+static sdrio_int32 apply_requests(sdrio_device *dev)
+{
+    sdrio_file_source *from = &dev->captures[dev->capture], *to = &dev->captures[dev->target];
+    sdrio_int32 jumped = 0;
+
+    if (dev->capture != dev->target)
+    {
+        // Recordings in a set are usually taken side by side, so keep the
+        // time into the recording rather than the sample count.
+        sdrio_file_source_unmap(from);
+        dev->position = (sdrio_uint64)((double)dev->position * to->sample_rate / from->sample_rate);
+        dev->capture = dev->target;
+        jumped = 1;
+    }
+
+    if (dev->seeking)
+    {
+        dev->position = dev->seek;
+        dev->seeking = 0;
+        jumped = 1;
+    }
+
+    if (dev->position > to->length)
+    {
+        dev->position = dev->loop ? dev->position % to->length : to->length;
+    }
+
+    return jumped;
+}
+
+static sdrio_int32 add_capture(sdrio_device *dev, const char *path, const sdrio_file_capture *capture)
+{
+    sdrio_file_source *source = &dev->captures[dev->num_captures];
+
+    if (dev->running || (dev->num_captures >= SDRIO_FILE_MAX_CAPTURES) || !sdrio_file_source_open(source, path, capture))
+    {
+        return 0;
+    }
+
+    // The stream is started with one native format for the whole set.
+    if (dev->num_captures && (source->format.format != dev->captures[0].format.format))
+    {
+        sdrio_file_source_close(source);
+        return 0;
+    }
+
+    if (!dev->num_captures++)
+    {
+        dev->target = dev->capture = 0;
+        dev->position = 0;
+        dev->seeking = 0;
+        dev->rx_freq = source->frequency;
+        dev->requested_rate = 0;
+        plan_rate(dev, source, 0);
+        sdrio_stream_set_hw_frequency(&dev->rx_stream, source->frequency);
+    }
+
+    return 1;
+}
+
+static sdrio_int32 format_from_name(const char *path, sdrio_sample_format *format)
+{
+    static const char * const extensions[] = {".cu8", ".cs8", ".cs16", ".cf32"};
+    static const sdrio_sample_format extension_formats[] = {sdrio_sample_format_cu8, sdrio_sample_format_cs8, sdrio_sample_format_cs16, sdrio_sample_format_cf32};
+    size_t length = strlen(path), extension_length;
+    sdrio_uint32 i;
+
+    for (i = 0; i < sizeof(extensions) / sizeof(extensions[0]); i++)
+    {
+        extension_length = strlen(extensions[i]);
+        if ((length > extension_length) && !strcmp(path + length - extension_length, extensions[i]))
+        {
+            *format = extension_formats[i];
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+// SDRIO_FILE=a.sigmf-meta;b.cu8,2048000,433920000
+static void add_environment_captures(sdrio_device *dev)
+{
+    const char *files = getenv("SDRIO_FILE");
+    char entry[SDRIO_FILE_MAX_PATH + 64];
+    char *rate, *frequency;
+    sdrio_file_capture capture;
+    size_t length;
+
+    while (files && *files)
+    {
+        length = strcspn(files, ";");
+        if (length && (length < sizeof(entry)))
+        {
+            memcpy(entry, files, length);
+            entry[length] = 0;
+
+            memset(&capture, 0, sizeof(capture));
+            rate = strchr(entry, ',');
+            if (rate)
+            {
+                *rate++ = 0;
+                capture.sample_rate = (sdrio_uint64)strtod(rate, 0);
+
+                frequency = strchr(rate, ',');
+                if (frequency)
+                {
+                    capture.frequency = (sdrio_uint64)strtod(frequency + 1, 0);
+                }
+            }
+
+            if (strstr(entry, ".sigmf-") || format_from_name(entry, &capture.format))
+            {
+                add_capture(dev, entry, &capture);
+            }
+        }
+
+        files += length;
+        if (*files)
+        {
+            files++;
+        }
+    }
+}
+
+SDRIOEXPORT sdrio_device * sdrio_open_device(sdrio_uint32 device_index)
+{
+    sdrio_device *dev = (sdrio_device *)malloc(sizeof(sdrio_device));
+
+    if (dev)
+    {
+        memset(dev, 0, sizeof(sdrio_device));
+
+        pthread_mutex_init(&dev->lock, 0);
+        sem_init(&dev->wake, 0, 0);
+        dev->loop = 1;
+        dev->block_samples = NUM_SAMPLES;
+        sdrio_pacer_init(&dev->pacer);
+
+        // Nothing here can overrun: a slow callback just slows the replay
+        // down, so deliver on the driver thread and keep it zero copy.
+        sdrio_stream_init(&dev->rx_stream);
+        sdrio_stream_set_queue_depth(&dev->rx_stream, 0);
+
+        add_environment_captures(dev);
+    }
+
+    return dev;
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_clear_file_captures(sdrio_device *dev)
+{
+    if (dev && !dev->running)
+    {
+        while (dev->num_captures)
+        {
+            sdrio_file_source_close(&dev->captures[--dev->num_captures]);
+        }
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_close_device(sdrio_device *dev)
+{
+    if (dev)
+    {
+        sdrio_clear_file_captures(dev);
+        sdrio_pacer_free(&dev->pacer);
+        sem_destroy(&dev->wake);
+        pthread_mutex_destroy(&dev->lock);
+        free(dev);
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT const char * sdrio_get_device_string(sdrio_device *dev)
+{
+    static char device_string[SDRIO_FILE_MAX_PATH + 64];
+
+    if (dev)
+    {
+        if (dev->num_captures)
+        {
+            sprintf(device_string, "File replay: %s", dev->captures[dev->target].path);
+        }
+        else
+        {
+            sprintf(device_string, "File replay: no recordings");
+        }
+        return device_string;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_samplerate(sdrio_device *dev, sdrio_uint64 sample_rate)
+{
+    if (dev && dev->num_captures && plan_rate(dev, &dev->captures[dev->target], sample_rate))
+    {
+        dev->requested_rate = sample_rate;
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_frequency(sdrio_device *dev, sdrio_uint64 frequency)
+{
+    sdrio_int32 target;
+    sdrio_file_source *source;
+
+    if (!dev || ((target = find_capture(dev, frequency)) < 0))
+    {
+        return 0;
+    }
+
+    source = &dev->captures[target];
+
+    if ((sdrio_uint32)target != dev->target)
+    {
+        // Retuning to another recording: the rate asked for has to be
+        // reachable from its rate too.
+        if (!plan_rate(dev, source, dev->requested_rate))
+        {
+            return 0;
+        }
+
+        pthread_mutex_lock(&dev->lock);
+        dev->target = target;
+        dev->pacing_serial++;
+        if (!dev->running)
+        {
+            apply_requests(dev);
+        }
+        pthread_mutex_unlock(&dev->lock);
+
+        sdrio_stream_set_hw_frequency(&dev->rx_stream, source->frequency);
+        sem_post(&dev->wake);
+    }
+
+    dev->rx_freq = frequency;
+
+    if (!sdrio_stream_fine_tune(&dev->rx_stream, frequency, source->sample_rate))
+    {
+        sdrio_stream_set_hw_frequency(&dev->rx_stream, source->frequency);
+    }
+    return 1;
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_tx_samplerate(sdrio_device *dev, sdrio_uint64 sample_rate)
+{
+    return 0;
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_tx_frequency(sdrio_device *dev, sdrio_uint64 frequency)
+{
+    return 0;
+}
+
+SDRIOEXPORT void * start_rx_routine(void *ctx)
+{
+    sdrio_device *dev = (sdrio_device *)ctx;
+    sdrio_file_source *source;
+    const void *samples;
+    sdrio_uint64 position;
+    sdrio_uint32 n;
+
+    dev->paced_serial = dev->pacing_serial - 1;
+
+    while (dev->running)
+    {
+        pthread_mutex_lock(&dev->lock);
+        if (apply_requests(dev))
+        {
+            sdrio_stream_mark_discontinuity(&dev->rx_stream, 0);
+        }
+
+        source = &dev->captures[dev->capture];
+        if ((dev->position >= source->length) && dev->loop)
+        {
+            dev->position = 0;
+            sdrio_stream_mark_discontinuity(&dev->rx_stream, 0);
+        }
+        position = dev->position;
+        pthread_mutex_unlock(&dev->lock);
+
+        n = dev->block_samples;
+        samples = sdrio_file_source_map(source, position, &n);
+        if (!samples)
+        {
+            // At the end with loop off, or the view couldn't be mapped: go
+            // quiet until a seek, a retune or stop, then start the schedule
+            // afresh rather than catching up on the idle time.
+            if (position < source->length)
+            {
+                sdrio_stream_transfer_failed(&dev->rx_stream);
+            }
+
+            sem_wait(&dev->wake);
+            dev->paced_serial = dev->pacing_serial - 1;
+            continue;
+        }
+
+        if (dev->paced_serial != dev->pacing_serial)
+        {
+            dev->paced_serial = dev->pacing_serial;
+            sdrio_pacer_start(&dev->pacer, (dev->pacing == sdrio_file_pacing_unthrottled) ? 0.0 : (sdrio_float64)source->sample_rate, 0.0);
+        }
+
+        sdrio_stream_process(&dev->rx_stream, samples, n);
+
+        pthread_mutex_lock(&dev->lock);
+        dev->position += n;
+        pthread_mutex_unlock(&dev->lock);
+
+        sdrio_pacer_wait(&dev->pacer, n);
+    }
+
+    sdrio_pacer_stop(&dev->pacer);
+    return 0;
+}
+
+static sdrio_int32 start_rx(sdrio_device *dev, sdrio_sample_format format, sdrio_rx_async_callback callback, sdrio_rx_native_callback native_callback, void *context)
+{
+    if (dev && dev->num_captures && sdrio_stream_start(&dev->rx_stream, &dev->captures[0].format, format, dev->block_samples, callback, native_callback, context))
+    {
+        // The target may be off the recording's centre from while stopped,
+        // which the NCO can cover now if this is float32.
+        sdrio_stream_fine_tune(&dev->rx_stream, dev->rx_freq, dev->captures[dev->target].sample_rate);
+
+        dev->running = 1;
+        if (pthread_create(&dev->tid, 0, start_rx_routine, (void *)dev) != 0)
+        {
+            dev->running = 0;
+            sdrio_stream_stop(&dev->rx_stream);
+            return 0;
+        }
+
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_start_rx(sdrio_device *dev, sdrio_rx_async_callback callback, void *context)
+{
+    return start_rx(dev, sdrio_sample_format_cf32, callback, 0, context);
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_start_rx_native(sdrio_device *dev, sdrio_rx_native_callback callback, void *context)
+{
+    if (dev && dev->num_captures)
+    {
+        return start_rx(dev, dev->captures[0].format.format, 0, callback, context);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_start_rx_format(sdrio_device *dev, sdrio_sample_format format, sdrio_rx_native_callback callback, void *context)
+{
+    return start_rx(dev, format, 0, callback, context);
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_queue_depth(sdrio_device *dev, sdrio_uint32 depth)
+{
+    if (dev)
+    {
+        return sdrio_stream_set_queue_depth(&dev->rx_stream, depth);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_huge_pages(sdrio_device *dev, sdrio_uint8 enable)
+{
+    if (dev)
+    {
+        return sdrio_stream_set_huge_pages(&dev->rx_stream, enable);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_dc_correction(sdrio_device *dev, sdrio_uint8 enable)
+{
+    if (dev)
+    {
+        return sdrio_stream_set_dc_correction(&dev->rx_stream, enable);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_iq_correction(sdrio_device *dev, sdrio_float32 gain, sdrio_float32 phase)
+{
+    if (dev)
+    {
+        return sdrio_stream_set_iq_correction(&dev->rx_stream, gain, phase);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_iq_auto_correction(sdrio_device *dev, sdrio_uint8 enable)
+{
+    if (dev)
+    {
+        return sdrio_stream_set_iq_auto_correction(&dev->rx_stream, enable);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_get_rx_iq_correction(sdrio_device *dev, sdrio_float32 *gain, sdrio_float32 *phase)
+{
+    if (dev)
+    {
+        return sdrio_stream_get_iq_correction(&dev->rx_stream, gain, phase);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_spectrum(sdrio_device *dev, sdrio_uint32 size, sdrio_window window, sdrio_uint32 overlap, sdrio_uint32 averages, sdrio_rx_spectrum_callback callback, void *context)
+{
+    if (dev)
+    {
+        return sdrio_stream_set_spectrum(&dev->rx_stream, size, window, overlap, averages, callback, context);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_get_stats(sdrio_device *dev, sdrio_stats *stats)
+{
+    if (dev && stats)
+    {
+        sdrio_stream_get_stats(&dev->rx_stream, stats);
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_histograms(sdrio_device *dev, sdrio_uint8 enable)
+{
+    if (dev)
+    {
+        return sdrio_stream_set_histograms(&dev->rx_stream, enable);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_get_rx_histogram(sdrio_device *dev, sdrio_histogram_kind kind, sdrio_histogram *histogram)
+{
+    if (dev && histogram)
+    {
+        return sdrio_stream_get_histogram(&dev->rx_stream, kind, histogram);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_write_rx_histograms(sdrio_device *dev, const char *path)
+{
+    if (dev && path)
+    {
+        return sdrio_stream_write_histograms(&dev->rx_stream, path);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_start_rx_recording(sdrio_device *dev, const char *path, sdrio_uint8 native)
+{
+    if (dev && path && dev->num_captures)
+    {
+        return sdrio_stream_start_recording(&dev->rx_stream, path, native, dev->captures[dev->target].sample_rate, sdrio_get_device_string(dev));
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_stop_rx_recording(sdrio_device *dev)
+{
+    if (dev)
+    {
+        return sdrio_stream_stop_recording(&dev->rx_stream);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_get_rx_recording_stats(sdrio_device *dev, sdrio_recording_stats *stats)
+{
+    if (dev && stats)
+    {
+        sdrio_stream_get_recording_stats(&dev->rx_stream, stats);
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_start_rx_pretrigger(sdrio_device *dev, const char *path, sdrio_float64 pre_seconds, sdrio_float64 post_seconds)
+{
+    if (dev && path && dev->num_captures)
+    {
+        return sdrio_stream_start_pretrigger(&dev->rx_stream, path, pre_seconds, post_seconds, dev->captures[dev->target].sample_rate, sdrio_get_device_string(dev));
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_stop_rx_pretrigger(sdrio_device *dev)
+{
+    if (dev)
+    {
+        sdrio_stream_stop_pretrigger(&dev->rx_stream);
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_trigger_power(sdrio_device *dev, sdrio_float32 threshold, sdrio_uint32 window)
+{
+    if (dev)
+    {
+        sdrio_stream_set_trigger_power(&dev->rx_stream, threshold, window);
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_trigger_rx(sdrio_device *dev)
+{
+    if (dev)
+    {
+        return sdrio_stream_trigger(&dev->rx_stream);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_get_rx_pretrigger_stats(sdrio_device *dev, sdrio_pretrigger_stats *stats)
+{
+    if (dev && stats)
+    {
+        sdrio_stream_get_pretrigger_stats(&dev->rx_stream, stats);
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_add_file_capture(sdrio_device *dev, const char *path, const sdrio_file_capture *capture)
+{
+    if (dev && path)
+    {
+        return add_capture(dev, path, capture);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_file_pacing(sdrio_device *dev, sdrio_file_pacing pacing)
+{
+    if (dev)
+    {
+        dev->pacing = pacing;
+        dev->pacing_serial++;
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_file_block_samples(sdrio_device *dev, sdrio_uint32 block_samples)
+{
+    if (dev && !dev->running && (block_samples >= MIN_BLOCK_SAMPLES) && (block_samples <= MAX_BLOCK_SAMPLES))
+    {
+        dev->block_samples = block_samples;
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_file_loop(sdrio_device *dev, sdrio_uint8 loop)
+{
+    if (dev)
+    {
+        dev->loop = loop;
+        sem_post(&dev->wake);
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_seek_file(sdrio_device *dev, sdrio_uint64 position)
+{
+    if (dev && dev->num_captures && (position <= dev->captures[dev->target].length))
+    {
+        pthread_mutex_lock(&dev->lock);
+        dev->seek = position;
+        dev->seeking = 1;
+        if (!dev->running)
+        {
+            apply_requests(dev);
+        }
+        pthread_mutex_unlock(&dev->lock);
+
+        sem_post(&dev->wake);
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_get_file_position(sdrio_device *dev, sdrio_uint64 *position, sdrio_uint64 *length)
+{
+    if (dev && dev->num_captures)
+    {
+        pthread_mutex_lock(&dev->lock);
+        if (position)
+        {
+            *position = dev->seeking ? dev->seek : dev->position;
+        }
+
+        if (length)
+        {
+            *length = dev->captures[dev->capture].length;
+        }
+        pthread_mutex_unlock(&dev->lock);
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_stop_rx(sdrio_device *dev)
+{
+    if (dev)
+    {
+        dev->running = 0;
+        sem_post(&dev->wake);
+        pthread_join(dev->tid, 0);
+        sdrio_stream_stop(&dev->rx_stream);
+
+        // The NCO only runs while streaming float32, so go back to the
+        // recording's centre now, as a retune would on hardware.
+        if (sdrio_stream_get_offset(&dev->rx_stream))
+        {
+            sdrio_set_rx_frequency(dev, sdrio_get_rx_frequency(dev));
+        }
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_start_tx(sdrio_device *dev, sdrio_tx_async_callback callback, void *context)
+{
+    return 0;
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_stop_tx(sdrio_device *dev)
+{
+    return 0;
+}
+
+SDRIOEXPORT sdrio_int64 sdrio_get_rx_frequency(sdrio_device *dev)
+{
+    if (dev)
+    {
+        return dev->rx_freq;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+// The distinct rates of the recordings in the set.
+static sdrio_uint32 get_rates(sdrio_device *dev, sdrio_uint32 *rates)
+{
+    sdrio_uint32 i, j, num_rates = 0;
+
+    for (i = 0; i < dev->num_captures; i++)
+    {
+        for (j = 0; j < i; j++)
+        {
+            if (dev->captures[j].sample_rate == dev->captures[i].sample_rate)
+            {
+                break;
+            }
+        }
+
+        if (j == i)
+        {
+            if (rates)
+            {
+                rates[num_rates] = (sdrio_uint32)dev->captures[i].sample_rate;
+            }
+            num_rates++;
+        }
+    }
+
+    return num_rates;
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_get_num_samplerates(sdrio_device *dev)
+{
+    if (dev)
+    {
+        return get_rates(dev, 0);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT void sdrio_get_samplerates(sdrio_device *dev, sdrio_uint32 *sample_rates_out)
+{
+    if (dev)
+    {
+        get_rates(dev, sample_rates_out);
+    }
+}
+
+SDRIOEXPORT sdrio_int64 sdrio_get_rx_samplerate(sdrio_device *dev)
+{
+    if (dev && dev->num_captures)
+    {
+        return sdrio_stream_get_rate(&dev->rx_stream, dev->captures[dev->target].sample_rate);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int64 sdrio_get_rx_block_frequency(sdrio_device *dev)
+{
+    if (dev)
+    {
+        return sdrio_stream_get_block_frequency(&dev->rx_stream);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_get_rx_block_meta(sdrio_device *dev, sdrio_rx_meta *meta)
+{
+    if (dev && meta)
+    {
+        sdrio_stream_get_block_meta(&dev->rx_stream, meta);
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int64 sdrio_get_tx_frequency(sdrio_device *dev)
+{
+    return 0;
+}
+
+SDRIOEXPORT sdrio_int64 sdrio_get_tx_samplerate(sdrio_device *dev)
+{
+    return 0;
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_gain_mode(sdrio_device *dev, sdrio_gain_mode gain_mode)
+{
+    return 1;
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_get_rx_gain_range(sdrio_device *dev, sdrio_float32 *min, sdrio_float32 *max)
+{
+    if (dev)
+    {
+        if (min)
+        {
+            *min = MIN_GAIN;
+        }
+
+        if (max)
+        {
+            *max = MAX_GAIN;
+        }
+
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_gain(sdrio_device *dev, sdrio_float32 gain)
+{
+    if (dev && (gain >= MIN_GAIN) && (gain <= MAX_GAIN))
+    {
+        sdrio_stream_set_gain(&dev->rx_stream, gain);
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_get_tx_gain_range(sdrio_device *dev, sdrio_float32 *min, sdrio_float32 *max)
+{
+    return 0;
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_tx_gain(sdrio_device *dev, sdrio_float32 gain)
+{
+    return 0;
+}
+
+// The bands the recordings cover.
+SDRIOEXPORT void sdrio_get_tuning_range(sdrio_device *dev, sdrio_uint64 *min, sdrio_uint64 *max)
+{
+    sdrio_uint64 low = 0, high = 0, band_low, band_high;
+    sdrio_uint32 i;
+    const sdrio_file_source *source;
+
+    if (dev)
+    {
+        for (i = 0; i < dev->num_captures; i++)
+        {
+            source = &dev->captures[i];
+            if (source->frequency)
+            {
+                band_low = (source->frequency > source->sample_rate / 2) ? source->frequency - source->sample_rate / 2 : 0;
+                band_high = source->frequency + source->sample_rate / 2;
+            }
+            else
+            {
+                band_low = MIN_FREQ;
+                band_high = MAX_FREQ;
+            }
+
+            if (!i || (band_low < low)) low = band_low;
+            if (!i || (band_high > high)) high = band_high;
+        }
+
+        if (min) *min = low;
+        if (max) *max = high;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_get_caps(sdrio_device *dev, sdrio_caps caps)
+{
+    switch (caps)
+    {
+    case sdrio_caps_rx:  return  1;
+    case sdrio_caps_tx:  return  0;
+    case sdrio_caps_agc: return  0;
+    default:             return -1;
+    }
+}
@@ -0,0 +1,83 @@
+// Copyright Scott Cutler
+// This source file is licensed under the GNU Lesser General Public License (LGPL)
+
+#ifndef SDRIO_FILE_H
+#define SDRIO_FILE_H
+
+#include "sdrio_ext.h"
+
+// Exports only the file replay device has.  Look them up with GetProcAddress
+// like the optional exports in sdrio_ext.h; other plugins don't have them.
+//
+// The device replays a capture set: one or more recordings of the same
+// sample format, each with its own centre frequency and rate.
+// sdrio_set_rx_frequency picks the recording whose band holds the target,
+// the way a retune would, and the NCO covers the rest of the offset.
+//
+// Hosts that know nothing about these exports get the capture set from the
+// SDRIO_FILE environment variable instead: recordings separated by ';',
+// each either a SigMF file (.sigmf-meta or .sigmf-data) or a raw file
+// named .cu8, .cs8, .cs16 or .cf32 followed by ",rate,frequency" in Hz.
+// Without it the plugin reports no devices, but sdrio_open_device still
+// opens one to add recordings to.
+//
+// Recordings are memory mapped and, with a queue depth of 0 (the default
+// here) and the native format, the callback is handed pointers straight
+// into the mapping.
+
+#define SDRIO_FILE_MAX_CAPTURES 64
+
+typedef enum
+{
+    sdrio_file_pacing_realtime,     // blocks arrive at the recording's sample rate
+    sdrio_file_pacing_unthrottled   // as fast as the stream and the callback take them
+} sdrio_file_pacing;
+
+// Describes a raw recording.  For SigMF the metadata has all of it, and
+// non-zero sample_rate or frequency here override it.
+typedef struct sdrio_file_capture_t
+{
+    sdrio_sample_format format;     // cu8, cs8, cs16 or cf32
+    sdrio_uint64 sample_rate;
+    sdrio_uint64 frequency;         // centre, 0 if unknown
+} sdrio_file_capture;
+
+// Adds a recording to the set while stopped.  capture can be null for SigMF.
+// The first recording added is the one replayed until the frequency is set.
+typedef sdrio_int32 (*sdrio_add_file_capture_t)(sdrio_device *dev, const char *path, const sdrio_file_capture *capture);
+typedef sdrio_int32 (*sdrio_clear_file_captures_t)(sdrio_device *dev);
+
+// Can be changed while running.
+typedef sdrio_int32 (*sdrio_set_file_pacing_t)(sdrio_device *dev, sdrio_file_pacing pacing);
+
+// Samples per block, 64 to 1M (default 16384); takes effect on the next start.
+typedef sdrio_int32 (*sdrio_set_file_block_samples_t)(sdrio_device *dev, sdrio_uint32 block_samples);
+
+// With loop on (the default) replay wraps to the start of the recording;
+// with it off the device goes quiet at the end until a seek.  Either way the
+// block after a wrap or a seek is flagged SDRIO_RX_META_DISCONTINUITY.
+typedef sdrio_int32 (*sdrio_set_file_loop_t)(sdrio_device *dev, sdrio_uint8 loop);
+
+// Positions are in samples of the recording being replayed.  A seek takes
+// effect at the next block.  Switching recordings keeps the time into the
+// recording.
+typedef sdrio_int32 (*sdrio_seek_file_t)(sdrio_device *dev, sdrio_uint64 position);
+typedef sdrio_int32 (*sdrio_get_file_position_t)(sdrio_device *dev, sdrio_uint64 *position, sdrio_uint64 *length);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    SDRIOEXPORT sdrio_int32 sdrio_add_file_capture(sdrio_device *dev, const char *path, const sdrio_file_capture *capture);
+    SDRIOEXPORT sdrio_int32 sdrio_clear_file_captures(sdrio_device *dev);
+    SDRIOEXPORT sdrio_int32 sdrio_set_file_pacing(sdrio_device *dev, sdrio_file_pacing pacing);
+    SDRIOEXPORT sdrio_int32 sdrio_set_file_block_samples(sdrio_device *dev, sdrio_uint32 block_samples);
+    SDRIOEXPORT sdrio_int32 sdrio_set_file_loop(sdrio_device *dev, sdrio_uint8 loop);
+    SDRIOEXPORT sdrio_int32 sdrio_seek_file(sdrio_device *dev, sdrio_uint64 position);
+    SDRIOEXPORT sdrio_int32 sdrio_get_file_position(sdrio_device *dev, sdrio_uint64 *position, sdrio_uint64 *length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SDRIO_FILE_H
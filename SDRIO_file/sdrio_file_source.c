@@ -0,0 +1,377 @@
+// Copyright Scott Cutler
+// This source file is licensed under the GNU Lesser General Public License (LGPL)
+
+#define _CRT_SECURE_NO_WARNINGS
+#define _FILE_OFFSET_BITS 64
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "sdrio_file_source.h"
+
+// The same scaling the hardware plugins use, so a recording replays into the
+// floats the live device gave.
+static const sdrio_format_desc formats[] =
+{
+    {sdrio_sample_format_cu8, 2, 127.5f, 0.0078431373f},
+    {sdrio_sample_format_cs8, 2, 0.0f, 1.0f / 127.0f},
+    {sdrio_sample_format_cs16, 4, 0.0f, 0.000030518509476f},
+    {sdrio_sample_format_cf32, sizeof(sdrio_iq), 0.0f, 1.0f}
+};
+
+static const char * const sigmf_datatypes[] = {"cu8", "ci8", "ci16_le", "cf32_le"};
+
+static sdrio_int32 set_format(sdrio_file_source *source, sdrio_sample_format format)
+{
+    sdrio_uint32 i;
+
+    for (i = 0; i < sizeof(formats) / sizeof(formats[0]); i++)
+    {
+        if (formats[i].format == format)
+        {
+            source->format = formats[i];
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static sdrio_int32 ends_with(const char *s, const char *suffix)
+{
+    size_t length = strlen(s), suffix_length = strlen(suffix);
+
+    return (length >= suffix_length) && !strcmp(s + length - suffix_length, suffix);
+}
+
+// The value of the first "key": in the document.  SigMF metadata is small
+// and flat enough that the first occurrence of a core key is the one wanted:
+// global fields come before the captures, and the first capture is the one
+// at sample 0.
+static const char * find_value(const char *json, const char *key)
+{
+    size_t key_length = strlen(key);
+    const char *p = json;
+
+    while ((p = strchr(p, '"')) != 0)
+    {
+        if (!strncmp(p + 1, key, key_length) && (p[key_length + 1] == '"'))
+        {
+            p += key_length + 2;
+            while ((*p == ' ') || (*p == '\t') || (*p == '\r') || (*p == '\n'))
+            {
+                p++;
+            }
+
+            if (*p != ':')
+            {
+                continue;
+            }
+
+            p++;
+            while ((*p == ' ') || (*p == '\t') || (*p == '\r') || (*p == '\n'))
+            {
+                p++;
+            }
+            return p;
+        }
+
+        p++;
+    }
+
+    return 0;
+}
+
+static sdrio_uint64 find_number(const char *json, const char *key)
+{
+    const char *value = find_value(json, key);
+    double number;
+
+    if (!value)
+    {
+        return 0;
+    }
+
+    number = strtod(value, 0);
+    return (number > 0.0) ? (sdrio_uint64)(number + 0.5) : 0;
+}
+
+static sdrio_int32 read_sigmf(sdrio_file_source *source, const char *meta_path)
+{
+    FILE *file = fopen(meta_path, "rb");
+    char *json;
+    const char *datatype;
+    size_t length, i;
+    sdrio_int32 ok = 0;
+
+    if (!file)
+    {
+        return 0;
+    }
+
+    json = (char *)malloc(SDRIO_FILE_MAX_META + 1);
+    if (json)
+    {
+        length = fread(json, 1, SDRIO_FILE_MAX_META, file);
+        json[length] = 0;
+
+        datatype = find_value(json, "core:datatype");
+        if (datatype && (*datatype == '"'))
+        {
+            datatype++;
+            for (i = 0; i < sizeof(sigmf_datatypes) / sizeof(sigmf_datatypes[0]); i++)
+            {
+                length = strlen(sigmf_datatypes[i]);
+                if (!strncmp(datatype, sigmf_datatypes[i], length) && (datatype[length] == '"'))
+                {
+                    source->format = formats[i];
+                    ok = 1;
+                }
+            }
+        }
+
+        source->sample_rate = find_number(json, "core:sample_rate");
+        source->frequency = find_number(json, "core:frequency");
+        source->data_offset = find_number(json, "core:header_bytes");
+
+        free(json);
+    }
+
+    fclose(file);
+    return ok;
+}
+
+static sdrio_int32 open_file(sdrio_file_source *source)
+{
+#if defined(_WIN32)
+    HANDLE file, mapping;
+    LARGE_INTEGER size;
+    SYSTEM_INFO info;
+
+    file = CreateFileA(source->path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return 0;
+    }
+
+    // Empty files can't be mapped, and have nothing to replay anyway.
+    if (!GetFileSizeEx(file, &size) || ((sdrio_uint64)size.QuadPart <= source->data_offset))
+    {
+        CloseHandle(file);
+        return 0;
+    }
+
+    mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+    if (!mapping)
+    {
+        CloseHandle(file);
+        return 0;
+    }
+
+    GetSystemInfo(&info);
+    source->file = (void *)file;
+    source->mapping = (void *)mapping;
+    source->file_bytes = (sdrio_uint64)size.QuadPart;
+    source->granularity = info.dwAllocationGranularity;
+#else
+    struct stat st;
+    int fd = open(source->path, O_RDONLY);
+
+    if (fd < 0)
+    {
+        return 0;
+    }
+
+    if (fstat(fd, &st) || ((sdrio_uint64)st.st_size <= source->data_offset))
+    {
+        close(fd);
+        return 0;
+    }
+
+    source->fd = fd;
+    source->file_bytes = (sdrio_uint64)st.st_size;
+    source->granularity = (sdrio_uint32)sysconf(_SC_PAGESIZE);
+#endif
+
+    return 1;
+}
+
+sdrio_int32 sdrio_file_source_open(sdrio_file_source *source, const char *path, const sdrio_file_capture *capture)
+{
+    size_t length = strlen(path);
+
+    memset(source, 0, sizeof(sdrio_file_source));
+    source->fd = -1;
+
+    if (length >= SDRIO_FILE_MAX_PATH)
+    {
+        return 0;
+    }
+
+    strcpy(source->path, path);
+
+    if (ends_with(path, ".sigmf-meta") || ends_with(path, ".sigmf-data"))
+    {
+        // Metadata and dataset only differ in the last four letters.
+        memcpy(source->path + length - 4, "meta", 4);
+        if (!read_sigmf(source, source->path))
+        {
+            return 0;
+        }
+        memcpy(source->path + length - 4, "data", 4);
+
+        if (capture && capture->sample_rate)
+        {
+            source->sample_rate = capture->sample_rate;
+        }
+
+        if (capture && capture->frequency)
+        {
+            source->frequency = capture->frequency;
+        }
+    }
+    else
+    {
+        if (!capture || !set_format(source, capture->format))
+        {
+            return 0;
+        }
+
+        source->sample_rate = capture->sample_rate;
+        source->frequency = capture->frequency;
+    }
+
+    if (!source->sample_rate || (source->sample_rate > 0xffffffff) || !open_file(source))
+    {
+        return 0;
+    }
+
+    source->length = (source->file_bytes - source->data_offset) / source->format.bytes_per_sample;
+    if (!source->length)
+    {
+        sdrio_file_source_close(source);
+        return 0;
+    }
+
+    return 1;
+}
+
+void sdrio_file_source_close(sdrio_file_source *source)
+{
+    sdrio_file_source_unmap(source);
+
+#if defined(_WIN32)
+    if (source->mapping)
+    {
+        CloseHandle((HANDLE)source->mapping);
+        source->mapping = 0;
+    }
+
+    if (source->file)
+    {
+        CloseHandle((HANDLE)source->file);
+        source->file = 0;
+    }
+#else
+    if (source->fd >= 0)
+    {
+        close(source->fd);
+        source->fd = -1;
+    }
+#endif
+}
+
+static sdrio_int32 map_view(sdrio_file_source *source, sdrio_uint64 offset, sdrio_uint32 bytes)
+{
+#if defined(_WIN32)
+    void *view = MapViewOfFile((HANDLE)source->mapping, FILE_MAP_READ, (DWORD)(offset >> 32), (DWORD)(offset & 0xffffffff), bytes);
+
+    if (!view)
+    {
+        return 0;
+    }
+#else
+    void *view = mmap(0, bytes, PROT_READ, MAP_SHARED, source->fd, (off_t)offset);
+
+    if (view == MAP_FAILED)
+    {
+        return 0;
+    }
+
+    // Start reading the window in now, so replay at real time doesn't
+    // stall on page faults as it walks into it.
+    madvise(view, bytes, MADV_SEQUENTIAL);
+    madvise(view, bytes, MADV_WILLNEED);
+#endif
+
+    source->view = (const sdrio_uint8 *)view;
+    source->view_offset = offset;
+    source->view_bytes = bytes;
+    return 1;
+}
+
+void sdrio_file_source_unmap(sdrio_file_source *source)
+{
+    if (source->view)
+    {
+#if defined(_WIN32)
+        UnmapViewOfFile((LPCVOID)source->view);
+#else
+        munmap((void *)source->view, source->view_bytes);
+#endif
+        source->view = 0;
+    }
+}
+
+const void * sdrio_file_source_map(sdrio_file_source *source, sdrio_uint64 position, sdrio_uint32 *num_samples)
+{
+    sdrio_uint32 n = *num_samples, bytes_per_sample = source->format.bytes_per_sample;
+    sdrio_uint64 start, end, view_end, base;
+
+    *num_samples = 0;
+
+    if ((position >= source->length) || !n)
+    {
+        return 0;
+    }
+
+    if (n > source->length - position)
+    {
+        n = (sdrio_uint32)(source->length - position);
+    }
+
+    start = source->data_offset + position * bytes_per_sample;
+    end = start + (sdrio_uint64)n * bytes_per_sample;
+
+    // Slide the view so the whole block is in it rather than handing out a
+    // short block at the seam.
+    if (!source->view || (start < source->view_offset) || (end > source->view_offset + source->view_bytes))
+    {
+        sdrio_file_source_unmap(source);
+
+        base = start - start % source->granularity;
+        if (!map_view(source, base, (sdrio_uint32)((source->file_bytes - base < SDRIO_FILE_VIEW_BYTES) ? source->file_bytes - base : SDRIO_FILE_VIEW_BYTES)))
+        {
+            return 0;
+        }
+    }
+
+    view_end = source->view_offset + source->view_bytes;
+    if (end > view_end)
+    {
+        n = (sdrio_uint32)((view_end - start) / bytes_per_sample);
+    }
+
+    *num_samples = n;
+    return source->view + (sdrio_uint32)(start - source->view_offset);
+}
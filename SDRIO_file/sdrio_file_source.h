@@ -0,0 +1,61 @@
+// Copyright Scott Cutler
+// This source file is licensed under the GNU Lesser General Public License (LGPL)
+
+#ifndef SDRIO_FILE_SOURCE_H
+#define SDRIO_FILE_SOURCE_H
+
+#include "sdrio_ext.h"
+#include "sdrio_file.h"
+
+#define SDRIO_FILE_MAX_PATH 260
+#define SDRIO_FILE_MAX_META (1024*1024)
+
+// Bytes mapped at a time.  Recordings can be far bigger than a 32 bit
+// address space, so only a window around the read position is mapped and
+// it slides along as replay moves through the file.  It has to hold the
+// largest block plus the allocation granularity the window is aligned to.
+#define SDRIO_FILE_VIEW_BYTES (64*1024*1024)
+
+// One recording of a capture set, opened for the life of the set.
+typedef struct sdrio_file_source_t
+{
+    char path[SDRIO_FILE_MAX_PATH];     // of the samples
+    sdrio_format_desc format;
+    sdrio_uint64 sample_rate;
+    sdrio_uint64 frequency;
+    sdrio_uint64 data_offset;           // bytes before the first sample
+    sdrio_uint64 length;                // samples
+    sdrio_uint64 file_bytes;
+
+    void *file;                         // Windows: file and file mapping handles
+    void *mapping;
+    int fd;                             // elsewhere, -1 when closed
+    sdrio_uint32 granularity;
+
+    const sdrio_uint8 *view;
+    sdrio_uint64 view_offset;           // file offset view starts at
+    sdrio_uint32 view_bytes;
+} sdrio_file_source;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    // Opens path, which is a SigMF metadata or dataset file, or a raw
+    // recording described by capture.  See sdrio_add_file_capture.
+    sdrio_int32 sdrio_file_source_open(sdrio_file_source *source, const char *path, const sdrio_file_capture *capture);
+    void sdrio_file_source_close(sdrio_file_source *source);
+
+    // Pointer to the samples from position on, sliding the view there if
+    // needed.  num_samples is cut down to what is mapped contiguously, which
+    // is at least one sample unless position is at the end.  Stays valid
+    // until the next call.  Returns 0 past the end or if mapping fails.
+    const void * sdrio_file_source_map(sdrio_file_source *source, sdrio_uint64 position, sdrio_uint32 *num_samples);
+
+    void sdrio_file_source_unmap(sdrio_file_source *source);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SDRIO_FILE_SOURCE_H
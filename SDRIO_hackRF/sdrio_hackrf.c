@@ -7,6 +7,7 @@
 #include <stdio.h>
 
 #include "sdrio_ext.h"
+#include "sdrio_stream.h"
 
 #include "hackrf.h"
 
@@ -18,25 +19,23 @@
 #define MIN_GAIN 0.0f
 #define MAX_GAIN 102.0f
 
+// Lower rates are reached by decimating from within this range.
+#define MIN_SAMPLERATE 8000000
+#define MAX_SAMPLERATE 20000000
+
+#define RX_TRANSFER_SAMPLES 131072 // libhackrf transfers are 256 KB
+
 typedef struct sdrio_device_t
 {
     hackrf_device *hackrf_device;
     sdrio_uint64 rx_freq;
     sdrio_uint32 sample_rate;
 
-    sdrio_rx_async_callback callback;
-    void *callback_context;
+    sdrio_stream rx_stream;
     pthread_t tid;
-
-    sdrio_iq *samples;
-    sdrio_uint32 num_samples;
 };
 
-typedef struct sdrio_iqu8_t
-{
-    sdrio_int8 i;
-    sdrio_int8 q;
-} sdrio_iqi8;
+static const sdrio_format_desc native_format = {sdrio_sample_format_cs8, 2, 0.0f, 1.0f / 127.0f};
 
 SDRIOEXPORT sdrio_int32 sdrio_init()
 {
@@ -55,6 +54,7 @@ SDRIOEXPORT sdrio_device * sdrio_open_device(sdrio_uint32 device_index)
     if (dev)
     {
         memset(dev, 0, sizeof(sdrio_device));
+        sdrio_stream_init(&dev->rx_stream);
         dev->rx_freq = 100000000;
         dev->sample_rate = 8000000;
 
@@ -111,8 +111,22 @@ SDRIOEXPORT sdrio_int32 sdrio_set_rx_samplerate(sdrio_device *dev, sdrio_uint64
 {
     if (dev)
     {
-        dev->sample_rate = (sdrio_uint32)sample_rate;
-        return (hackrf_set_sample_rate(dev->hackrf_device, (double)sample_rate) == HACKRF_SUCCESS);
+        sdrio_uint64 hw_rate;
+        sdrio_uint32 decimation, interp, decim;
+
+        if (!sdrio_resample_plan(sample_rate, 0, 0, MIN_SAMPLERATE, MAX_SAMPLERATE, &hw_rate, &decimation, &interp, &decim) ||
+            !sdrio_stream_check_rate(&dev->rx_stream, decimation, interp, decim))
+        {
+            return 0;
+        }
+
+        dev->sample_rate = (sdrio_uint32)hw_rate;
+        if (hackrf_set_sample_rate(dev->hackrf_device, (double)hw_rate) != HACKRF_SUCCESS)
+        {
+            return 0;
+        }
+
+        return sdrio_stream_set_rate(&dev->rx_stream, decimation, interp, decim);
     }
     else
     {
@@ -125,7 +139,19 @@ SDRIOEXPORT sdrio_int32 sdrio_set_rx_frequency(sdrio_device *dev, sdrio_uint64 f
     if (dev && (frequency >= MIN_FREQ) && (frequency <= MAX_FREQ))
     {
         dev->rx_freq = frequency;
-        return (hackrf_set_freq(dev->hackrf_device, frequency) == HACKRF_SUCCESS);
+
+        if (sdrio_stream_fine_tune(&dev->rx_stream, frequency, dev->sample_rate))
+        {
+            return 1;
+        }
+
+        if (hackrf_set_freq(dev->hackrf_device, frequency) != HACKRF_SUCCESS)
+        {
+            return 0;
+        }
+
+        sdrio_stream_set_hw_frequency(&dev->rx_stream, frequency);
+        return 1;
     }
     else
     {
@@ -149,54 +175,290 @@ int hackrf_sample_block_callback(hackrf_transfer* transfer)
 
     if (dev)
     {
-        sdrio_uint32 num_samples = transfer->buffer_length / 2;
+        sdrio_stream_process(&dev->rx_stream, transfer->buffer, transfer->valid_length / native_format.bytes_per_sample);
+    }
 
-        if (!dev->samples)
-        {
-            dev->samples = (sdrio_iq *)malloc(num_samples * sizeof(sdrio_iq));
-        }
-        else if (dev->num_samples != num_samples)
-        {
-            free(dev->samples);
-            dev->samples = (sdrio_iq *)malloc(num_samples * sizeof(sdrio_iq));
-        }
+    return HACKRF_SUCCESS;
+}
 
-        if (dev->samples)
+static sdrio_int32 start_rx(sdrio_device *dev, sdrio_sample_format format, sdrio_rx_async_callback callback, sdrio_rx_native_callback native_callback, void *context)
+{
+    if (dev && sdrio_stream_start(&dev->rx_stream, &native_format, format, RX_TRANSFER_SAMPLES, callback, native_callback, context))
+    {
+        if (hackrf_start_rx(dev->hackrf_device, hackrf_sample_block_callback, dev) != HACKRF_SUCCESS)
         {
-            sdrio_uint32 i;
-            sdrio_iqi8 *samples = (sdrio_iqi8 *)transfer->buffer;
-            for (i=0; i<num_samples; i++)
-            {
-                dev->samples[i].i = (sdrio_float32)samples[i].i * (1.0f / 127.0f);
-                dev->samples[i].q = (sdrio_float32)samples[i].q * (1.0f / 127.0f);
-            }
-
-            dev->callback(dev->callback_context, dev->samples, dev->num_samples);
+            sdrio_stream_stop(&dev->rx_stream);
+            return 0;
         }
+
+        return 1;
     }
 
-    return HACKRF_SUCCESS;
+    return 0;
 }
 
-
 SDRIOEXPORT sdrio_int32 sdrio_start_rx(sdrio_device *dev, sdrio_rx_async_callback callback, void *context)
+{
+    return start_rx(dev, sdrio_sample_format_cf32, callback, 0, context);
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_start_rx_native(sdrio_device *dev, sdrio_rx_native_callback callback, void *context)
+{
+    return start_rx(dev, native_format.format, 0, callback, context);
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_start_rx_format(sdrio_device *dev, sdrio_sample_format format, sdrio_rx_native_callback callback, void *context)
+{
+    return start_rx(dev, format, 0, callback, context);
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_queue_depth(sdrio_device *dev, sdrio_uint32 depth)
 {
     if (dev)
     {
-        dev->callback = callback;
-        dev->callback_context = context;
+        return sdrio_stream_set_queue_depth(&dev->rx_stream, depth);
+    }
+    else
+    {
+        return 0;
+    }
+}
 
-        return (hackrf_start_rx(dev->hackrf_device, hackrf_sample_block_callback, context) == HACKRF_SUCCESS);
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_huge_pages(sdrio_device *dev, sdrio_uint8 enable)
+{
+    if (dev)
+    {
+        return sdrio_stream_set_huge_pages(&dev->rx_stream, enable);
     }
+    else
+    {
+        return 0;
+    }
+}
 
-    return 0;
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_dc_correction(sdrio_device *dev, sdrio_uint8 enable)
+{
+    if (dev)
+    {
+        return sdrio_stream_set_dc_correction(&dev->rx_stream, enable);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_iq_correction(sdrio_device *dev, sdrio_float32 gain, sdrio_float32 phase)
+{
+    if (dev)
+    {
+        return sdrio_stream_set_iq_correction(&dev->rx_stream, gain, phase);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_iq_auto_correction(sdrio_device *dev, sdrio_uint8 enable)
+{
+    if (dev)
+    {
+        return sdrio_stream_set_iq_auto_correction(&dev->rx_stream, enable);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_get_rx_iq_correction(sdrio_device *dev, sdrio_float32 *gain, sdrio_float32 *phase)
+{
+    if (dev)
+    {
+        return sdrio_stream_get_iq_correction(&dev->rx_stream, gain, phase);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_spectrum(sdrio_device *dev, sdrio_uint32 size, sdrio_window window, sdrio_uint32 overlap, sdrio_uint32 averages, sdrio_rx_spectrum_callback callback, void *context)
+{
+    if (dev)
+    {
+        return sdrio_stream_set_spectrum(&dev->rx_stream, size, window, overlap, averages, callback, context);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_get_stats(sdrio_device *dev, sdrio_stats *stats)
+{
+    if (dev && stats)
+    {
+        sdrio_stream_get_stats(&dev->rx_stream, stats);
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_histograms(sdrio_device *dev, sdrio_uint8 enable)
+{
+    if (dev)
+    {
+        return sdrio_stream_set_histograms(&dev->rx_stream, enable);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_get_rx_histogram(sdrio_device *dev, sdrio_histogram_kind kind, sdrio_histogram *histogram)
+{
+    if (dev && histogram)
+    {
+        return sdrio_stream_get_histogram(&dev->rx_stream, kind, histogram);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_write_rx_histograms(sdrio_device *dev, const char *path)
+{
+    if (dev && path)
+    {
+        return sdrio_stream_write_histograms(&dev->rx_stream, path);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_start_rx_recording(sdrio_device *dev, const char *path, sdrio_uint8 native)
+{
+    if (dev && path)
+    {
+        return sdrio_stream_start_recording(&dev->rx_stream, path, native, dev->sample_rate, sdrio_get_device_string(dev));
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_stop_rx_recording(sdrio_device *dev)
+{
+    if (dev)
+    {
+        return sdrio_stream_stop_recording(&dev->rx_stream);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_get_rx_recording_stats(sdrio_device *dev, sdrio_recording_stats *stats)
+{
+    if (dev && stats)
+    {
+        sdrio_stream_get_recording_stats(&dev->rx_stream, stats);
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_start_rx_pretrigger(sdrio_device *dev, const char *path, sdrio_float64 pre_seconds, sdrio_float64 post_seconds)
+{
+    if (dev && path)
+    {
+        return sdrio_stream_start_pretrigger(&dev->rx_stream, path, pre_seconds, post_seconds, dev->sample_rate, sdrio_get_device_string(dev));
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_stop_rx_pretrigger(sdrio_device *dev)
+{
+    if (dev)
+    {
+        sdrio_stream_stop_pretrigger(&dev->rx_stream);
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_trigger_power(sdrio_device *dev, sdrio_float32 threshold, sdrio_uint32 window)
+{
+    if (dev)
+    {
+        sdrio_stream_set_trigger_power(&dev->rx_stream, threshold, window);
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_trigger_rx(sdrio_device *dev)
+{
+    if (dev)
+    {
+        return sdrio_stream_trigger(&dev->rx_stream);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_get_rx_pretrigger_stats(sdrio_device *dev, sdrio_pretrigger_stats *stats)
+{
+    if (dev && stats)
+    {
+        sdrio_stream_get_pretrigger_stats(&dev->rx_stream, stats);
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
 }
 
 SDRIOEXPORT sdrio_int32 sdrio_stop_rx(sdrio_device *dev)
 {
     if (dev)
     {
-        return (hackrf_stop_rx(dev->hackrf_device) == HACKRF_SUCCESS);
+        sdrio_int32 ret = (hackrf_stop_rx(dev->hackrf_device) == HACKRF_SUCCESS);
+        sdrio_stream_stop(&dev->rx_stream);
+
+        // The NCO only runs while streaming float32, so put the hardware on
+        // the target now.
+        if (sdrio_stream_get_offset(&dev->rx_stream))
+        {
+            sdrio_set_rx_frequency(dev, sdrio_get_rx_frequency(dev));
+        }
+        return ret;
     }
     else
     {
@@ -241,7 +503,32 @@ SDRIOEXPORT sdrio_int64 sdrio_get_rx_samplerate(sdrio_device *dev)
 {
     if (dev)
     {
-        return dev->sample_rate;
+        return sdrio_stream_get_rate(&dev->rx_stream, dev->sample_rate);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int64 sdrio_get_rx_block_frequency(sdrio_device *dev)
+{
+    if (dev)
+    {
+        return sdrio_stream_get_block_frequency(&dev->rx_stream);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_get_rx_block_meta(sdrio_device *dev, sdrio_rx_meta *meta)
+{
+    if (dev && meta)
+    {
+        sdrio_stream_get_block_meta(&dev->rx_stream, meta);
+        return 1;
     }
     else
     {
@@ -302,6 +589,7 @@ SDRIOEXPORT sdrio_int32 sdrio_set_rx_gain(sdrio_device *dev, sdrio_float32 gain)
         hackrf_set_lna_gain(dev->hackrf_device, lna_gain);
         hackrf_set_vga_gain(dev->hackrf_device, vga_gain);
 
+        sdrio_stream_set_gain(&dev->rx_stream, (sdrio_float32)(lna_gain + vga_gain));
         return 1;
     }
     else
@@ -6,6 +6,10 @@
 #include <math.h>
 
 #include "sdrio_ext.h"
+#include "sdrio_stream.h"
+#include "sdrio_null.h"
+#include "sdrio_null_gen.h"
+#include "sdrio_pacer.h"
 
 #include "pthread.h"
 
@@ -16,36 +20,42 @@
 #define MAX_GAIN 60.0f
 
 #define NUM_SAMPLES 16384
+#define MIN_BLOCK_SAMPLES 64
+#define MAX_BLOCK_SAMPLES (1024*1024)
 
-#include <Windows.h>
-#include <time.h>
-
-sdrio_float64 get_time()
-{
-    LARGE_INTEGER f, t;
-    QueryPerformanceFrequency(&f);
-    QueryPerformanceCounter(&t);
-    return (sdrio_float64)t.QuadPart / f.QuadPart;
-}
+// Rates below this are generated at a multiple and decimated.
+#define MIN_SAMPLERATE 192000
 
 typedef struct sdrio_device_t
 {
     volatile sdrio_uint8 running;
     sdrio_uint64 rx_freq;
 
-    sdrio_rx_async_callback callback;
-    void *callback_context;
+    sdrio_stream rx_stream;
     pthread_t tid;
 
     sdrio_iq *samples;
+    sdrio_uint32 block_samples;         // size of samples
+    volatile sdrio_uint32 next_block_samples;
     sdrio_uint64 sample_rate;
 
     sdrio_float32 gain;
 
-    sdrio_uint64 samples_since_last_rate_change;
-    sdrio_float64 timestamp_at_last_rate_change;
+    sdrio_null_gen gen;
+    sdrio_null_generator generator;     // applied by the generator thread
+    volatile sdrio_uint32 generator_serial;
+    sdrio_uint32 applied_serial;
+    pthread_mutex_t generator_lock;
+
+    sdrio_pacer pacer;
+    volatile sdrio_null_pacing pacing;
+    volatile sdrio_float64 jitter;
+    volatile sdrio_uint32 pacing_serial;    // bumped when the schedule needs replanning
+    sdrio_uint32 paced_serial;
 };
 
+static const sdrio_format_desc native_format = {sdrio_sample_format_cf32, sizeof(sdrio_iq), 0.0f, 1.0f};
+
 SDRIOEXPORT sdrio_int32 sdrio_init()
 {
     return 1;
@@ -63,11 +73,24 @@ SDRIOEXPORT sdrio_device * sdrio_open_device(sdrio_uint32 device_index)
     if (dev)
     {
         memset(dev, 0, sizeof(sdrio_device));
+
+        if (!sdrio_null_gen_init(&dev->gen))
+        {
+            free(dev);
+            return 0;
+        }
+
+        sdrio_null_gen_default(&dev->generator);
+        dev->generator_serial = 1;
+        pthread_mutex_init(&dev->generator_lock, 0);
+
+        sdrio_stream_init(&dev->rx_stream);
         dev->rx_freq = 100000000;
         dev->sample_rate = 1024*1024;
+        sdrio_stream_set_hw_frequency(&dev->rx_stream, dev->rx_freq);
 
-        dev->samples_since_last_rate_change = 0;
-        dev->timestamp_at_last_rate_change = get_time();
+        dev->next_block_samples = NUM_SAMPLES;
+        sdrio_pacer_init(&dev->pacer);
     }
 
     return dev;
@@ -77,6 +100,10 @@ SDRIOEXPORT sdrio_int32 sdrio_close_device(sdrio_device *dev)
 {
     if (dev)
     {
+        sdrio_null_gen_free(&dev->gen);
+        sdrio_pacer_free(&dev->pacer);
+        pthread_mutex_destroy(&dev->generator_lock);
+        free(dev->samples);
         free(dev);
         return 1;
     }
@@ -105,10 +132,18 @@ SDRIOEXPORT sdrio_int32 sdrio_set_rx_samplerate(sdrio_device *dev, sdrio_uint64
 {
     if (dev)
     {
-        dev->sample_rate = sample_rate;
-        dev->samples_since_last_rate_change = 0;
-        dev->timestamp_at_last_rate_change = get_time();
-        return 1;
+        sdrio_uint64 hw_rate;
+        sdrio_uint32 decimation, interp, decim;
+
+        if (!sdrio_resample_plan(sample_rate, 0, 0, MIN_SAMPLERATE, (sdrio_uint64)-1, &hw_rate, &decimation, &interp, &decim) ||
+            !sdrio_stream_check_rate(&dev->rx_stream, decimation, interp, decim))
+        {
+            return 0;
+        }
+
+        dev->sample_rate = hw_rate;
+        dev->pacing_serial++;
+        return sdrio_stream_set_rate(&dev->rx_stream, decimation, interp, decim);
     }
     else
     {
@@ -121,6 +156,11 @@ SDRIOEXPORT sdrio_int32 sdrio_set_rx_frequency(sdrio_device *dev, sdrio_uint64 f
     if (dev && (frequency >= MIN_FREQ) && (frequency <= MAX_FREQ))
     {
         dev->rx_freq = frequency;
+
+        if (!sdrio_stream_fine_tune(&dev->rx_stream, frequency, dev->sample_rate))
+        {
+            sdrio_stream_set_hw_frequency(&dev->rx_stream, frequency);
+        }
         return 1;
     }
     else
@@ -139,56 +179,374 @@ SDRIOEXPORT sdrio_int32 sdrio_set_tx_frequency(sdrio_device *dev, sdrio_uint64 f
     return 0;
 }
 
-sdrio_float32 rand_minus_one_to_one()
+// Rebuilds the generator's table when its settings, the tuning or the rate
+// have moved since the last block.
+static void update_generator(sdrio_device *dev)
 {
-    sdrio_float32 zero_to_one = rand() * (1.0f / RAND_MAX);
-    return (zero_to_one * 2.0f) - 1.0f;
+    sdrio_null_generator config;
+    sdrio_uint64 hw_frequency = dev->rx_stream.hw_frequency;
+
+    if ((dev->applied_serial != dev->generator_serial) || (dev->gen.hw_frequency != hw_frequency) || (dev->gen.sample_rate != dev->sample_rate))
+    {
+        pthread_mutex_lock(&dev->generator_lock);
+        config = dev->generator;
+        dev->applied_serial = dev->generator_serial;
+        pthread_mutex_unlock(&dev->generator_lock);
+
+        sdrio_null_gen_configure(&dev->gen, &config, hw_frequency, dev->sample_rate);
+    }
 }
 
 SDRIOEXPORT void * start_rx_routine(void *ctx)
 {
     sdrio_device *dev = (sdrio_device *)ctx;
 
+    dev->paced_serial = dev->pacing_serial - 1;
+
     while (dev->running)
     {
-        if (dev->callback)
+        if (dev->paced_serial != dev->pacing_serial)
         {
-            if (!dev->samples)
-            {
-                dev->samples = (sdrio_iq *)malloc(NUM_SAMPLES * sizeof(sdrio_iq));
-            }
-
-            if (dev->samples)
-            {
-                sdrio_uint32 i;
-                for (i=0; i<NUM_SAMPLES; i++)
-                {
-                    dev->samples[i].i = rand_minus_one_to_one() * dev->gain;
-                    dev->samples[i].q = rand_minus_one_to_one() * dev->gain;
-                }
-
-                dev->callback(dev->callback_context, dev->samples, NUM_SAMPLES);
-                dev->samples_since_last_rate_change += NUM_SAMPLES;
-            }
-
-            while ((dev->samples_since_last_rate_change / (get_time() - dev->timestamp_at_last_rate_change)) > dev->sample_rate)
-            {
-                Sleep(1);
-            }
+            dev->paced_serial = dev->pacing_serial;
+            sdrio_pacer_start(&dev->pacer,
+                              (dev->pacing == sdrio_null_pacing_unthrottled) ? 0.0 : (sdrio_float64)dev->sample_rate,
+                              (dev->pacing == sdrio_null_pacing_jitter) ? dev->jitter : 0.0);
         }
+
+        update_generator(dev);
+        sdrio_null_gen_fill(&dev->gen, dev->samples, dev->block_samples, dev->gen.config.noise * dev->gain);
+        sdrio_stream_process(&dev->rx_stream, dev->samples, dev->block_samples);
+
+        sdrio_pacer_wait(&dev->pacer, dev->block_samples);
     }
 
+    sdrio_pacer_stop(&dev->pacer);
     return 0;
 }
 
+static sdrio_int32 start_rx(sdrio_device *dev, sdrio_sample_format format, sdrio_rx_async_callback callback, sdrio_rx_native_callback native_callback, void *context)
+{
+    if (!dev)
+    {
+        return 0;
+    }
+
+    if (dev->block_samples != dev->next_block_samples)
+    {
+        free(dev->samples);
+        dev->block_samples = dev->next_block_samples;
+        dev->samples = (sdrio_iq *)malloc(dev->block_samples * sizeof(sdrio_iq));
+
+        if (!dev->samples)
+        {
+            dev->block_samples = 0;
+        }
+    }
+
+    if (dev->samples && sdrio_stream_start(&dev->rx_stream, &native_format, format, dev->block_samples, callback, native_callback, context))
+    {
+        dev->running = 1;
+        if (pthread_create(&dev->tid, 0, start_rx_routine, (void *)dev) != 0)
+        {
+            dev->running = 0;
+            sdrio_stream_stop(&dev->rx_stream);
+            return 0;
+        }
+
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
 SDRIOEXPORT sdrio_int32 sdrio_start_rx(sdrio_device *dev, sdrio_rx_async_callback callback, void *context)
+{
+    return start_rx(dev, sdrio_sample_format_cf32, callback, 0, context);
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_start_rx_native(sdrio_device *dev, sdrio_rx_native_callback callback, void *context)
+{
+    return start_rx(dev, native_format.format, 0, callback, context);
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_start_rx_format(sdrio_device *dev, sdrio_sample_format format, sdrio_rx_native_callback callback, void *context)
+{
+    return start_rx(dev, format, 0, callback, context);
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_queue_depth(sdrio_device *dev, sdrio_uint32 depth)
 {
     if (dev)
     {
-        dev->running = 1;
-        dev->callback = callback;
-        dev->callback_context = context;
-        return pthread_create(&dev->tid, 0, start_rx_routine, (void *)dev) == 0;
+        return sdrio_stream_set_queue_depth(&dev->rx_stream, depth);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_huge_pages(sdrio_device *dev, sdrio_uint8 enable)
+{
+    if (dev)
+    {
+        return sdrio_stream_set_huge_pages(&dev->rx_stream, enable);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_dc_correction(sdrio_device *dev, sdrio_uint8 enable)
+{
+    if (dev)
+    {
+        return sdrio_stream_set_dc_correction(&dev->rx_stream, enable);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_iq_correction(sdrio_device *dev, sdrio_float32 gain, sdrio_float32 phase)
+{
+    if (dev)
+    {
+        return sdrio_stream_set_iq_correction(&dev->rx_stream, gain, phase);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_iq_auto_correction(sdrio_device *dev, sdrio_uint8 enable)
+{
+    if (dev)
+    {
+        return sdrio_stream_set_iq_auto_correction(&dev->rx_stream, enable);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_get_rx_iq_correction(sdrio_device *dev, sdrio_float32 *gain, sdrio_float32 *phase)
+{
+    if (dev)
+    {
+        return sdrio_stream_get_iq_correction(&dev->rx_stream, gain, phase);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_spectrum(sdrio_device *dev, sdrio_uint32 size, sdrio_window window, sdrio_uint32 overlap, sdrio_uint32 averages, sdrio_rx_spectrum_callback callback, void *context)
+{
+    if (dev)
+    {
+        return sdrio_stream_set_spectrum(&dev->rx_stream, size, window, overlap, averages, callback, context);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_get_stats(sdrio_device *dev, sdrio_stats *stats)
+{
+    if (dev && stats)
+    {
+        sdrio_stream_get_stats(&dev->rx_stream, stats);
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_histograms(sdrio_device *dev, sdrio_uint8 enable)
+{
+    if (dev)
+    {
+        return sdrio_stream_set_histograms(&dev->rx_stream, enable);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_get_rx_histogram(sdrio_device *dev, sdrio_histogram_kind kind, sdrio_histogram *histogram)
+{
+    if (dev && histogram)
+    {
+        return sdrio_stream_get_histogram(&dev->rx_stream, kind, histogram);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_write_rx_histograms(sdrio_device *dev, const char *path)
+{
+    if (dev && path)
+    {
+        return sdrio_stream_write_histograms(&dev->rx_stream, path);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_start_rx_recording(sdrio_device *dev, const char *path, sdrio_uint8 native)
+{
+    if (dev && path)
+    {
+        return sdrio_stream_start_recording(&dev->rx_stream, path, native, dev->sample_rate, sdrio_get_device_string(dev));
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_stop_rx_recording(sdrio_device *dev)
+{
+    if (dev)
+    {
+        return sdrio_stream_stop_recording(&dev->rx_stream);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_get_rx_recording_stats(sdrio_device *dev, sdrio_recording_stats *stats)
+{
+    if (dev && stats)
+    {
+        sdrio_stream_get_recording_stats(&dev->rx_stream, stats);
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_start_rx_pretrigger(sdrio_device *dev, const char *path, sdrio_float64 pre_seconds, sdrio_float64 post_seconds)
+{
+    if (dev && path)
+    {
+        return sdrio_stream_start_pretrigger(&dev->rx_stream, path, pre_seconds, post_seconds, dev->sample_rate, sdrio_get_device_string(dev));
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_stop_rx_pretrigger(sdrio_device *dev)
+{
+    if (dev)
+    {
+        sdrio_stream_stop_pretrigger(&dev->rx_stream);
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_rx_trigger_power(sdrio_device *dev, sdrio_float32 threshold, sdrio_uint32 window)
+{
+    if (dev)
+    {
+        sdrio_stream_set_trigger_power(&dev->rx_stream, threshold, window);
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_trigger_rx(sdrio_device *dev)
+{
+    if (dev)
+    {
+        return sdrio_stream_trigger(&dev->rx_stream);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_get_rx_pretrigger_stats(sdrio_device *dev, sdrio_pretrigger_stats *stats)
+{
+    if (dev && stats)
+    {
+        sdrio_stream_get_pretrigger_stats(&dev->rx_stream, stats);
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_null_pacing(sdrio_device *dev, sdrio_null_pacing pacing)
+{
+    if (dev)
+    {
+        dev->pacing = pacing;
+        dev->pacing_serial++;
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_null_cadence(sdrio_device *dev, sdrio_uint32 block_samples, sdrio_float64 jitter)
+{
+    if (dev && (block_samples >= MIN_BLOCK_SAMPLES) && (block_samples <= MAX_BLOCK_SAMPLES) && (jitter >= 0.0))
+    {
+        dev->next_block_samples = block_samples;
+        dev->jitter = jitter;
+        dev->pacing_serial++;
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_set_null_generator(sdrio_device *dev, const sdrio_null_generator *generator)
+{
+    if (dev && generator && sdrio_null_gen_check(generator))
+    {
+        pthread_mutex_lock(&dev->generator_lock);
+        dev->generator = *generator;
+        dev->generator_serial++;
+        pthread_mutex_unlock(&dev->generator_lock);
+        return 1;
     }
     else
     {
@@ -202,6 +560,14 @@ SDRIOEXPORT sdrio_int32 sdrio_stop_rx(sdrio_device *dev)
     {
         dev->running = 0;
         pthread_join(dev->tid, 0);
+        sdrio_stream_stop(&dev->rx_stream);
+
+        // The NCO only runs while streaming float32, so put the hardware on
+        // the target now.
+        if (sdrio_stream_get_offset(&dev->rx_stream))
+        {
+            sdrio_set_rx_frequency(dev, sdrio_get_rx_frequency(dev));
+        }
         return 1;
     }
     else
@@ -247,7 +613,32 @@ SDRIOEXPORT sdrio_int64 sdrio_get_rx_samplerate(sdrio_device *dev)
 {
     if (dev)
     {
-        return dev->sample_rate;
+        return sdrio_stream_get_rate(&dev->rx_stream, dev->sample_rate);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int64 sdrio_get_rx_block_frequency(sdrio_device *dev)
+{
+    if (dev)
+    {
+        return sdrio_stream_get_block_frequency(&dev->rx_stream);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+SDRIOEXPORT sdrio_int32 sdrio_get_rx_block_meta(sdrio_device *dev, sdrio_rx_meta *meta)
+{
+    if (dev && meta)
+    {
+        sdrio_stream_get_block_meta(&dev->rx_stream, meta);
+        return 1;
     }
     else
     {
@@ -297,6 +688,7 @@ SDRIOEXPORT sdrio_int32 sdrio_set_rx_gain(sdrio_device *dev, sdrio_float32 gain)
     if (dev && (gain >= MIN_GAIN) && (gain <= MAX_GAIN))
     {
         dev->gain = (sdrio_float32)pow(10, (gain - MAX_GAIN) * 0.05f);
+        sdrio_stream_set_gain(&dev->rx_stream, gain);
         return 1;
     }
     else
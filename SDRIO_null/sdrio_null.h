@@ -0,0 +1,87 @@
+// Copyright Scott Cutler
+// This source file is licensed under the GNU Lesser General Public License (LGPL)
+
+#ifndef SDRIO_NULL_H
+#define SDRIO_NULL_H
+
+#include "sdrio_ext.h"
+
+// Exports only the null device has, for tests and benchmarks.  Look them up
+// with GetProcAddress like the optional exports in sdrio_ext.h; other
+// plugins don't have them.
+
+typedef enum
+{
+    sdrio_null_pacing_realtime,     // blocks arrive at the sample rate, like hardware
+    sdrio_null_pacing_unthrottled,  // as fast as the stream and the callback take them
+    sdrio_null_pacing_jitter        // real time on average, each block up to the jitter late
+} sdrio_null_pacing;
+
+// Can be changed while running.
+typedef sdrio_int32 (*sdrio_set_null_pacing_t)(sdrio_device *dev, sdrio_null_pacing pacing);
+
+// Samples per block, 64 to 1M (default 16384), so blocks arrive every
+// block_samples / sample rate seconds; takes effect on the next start.
+// jitter is in seconds, for sdrio_null_pacing_jitter, and applies at once.
+typedef sdrio_int32 (*sdrio_set_null_cadence_t)(sdrio_device *dev, sdrio_uint32 block_samples, sdrio_float64 jitter);
+
+#define SDRIO_NULL_MAX_TONES 8
+
+typedef enum
+{
+    sdrio_null_signal_tones,        // sum of carriers; the default is one beacon at 100.25 MHz
+    sdrio_null_signal_chirp,        // linear sweep from chirp_start to chirp_stop, repeating
+    sdrio_null_signal_modulated     // QPSK, root raised cosine shaped, PRBS9 symbols
+} sdrio_null_signal;
+
+// What the null device receives.  Frequencies are RF, so retuning moves the
+// signals like it would on hardware.  The signal is built into a table one
+// period long whenever the settings, the tuning or the rate change, and
+// streaming just copies it out, so frequencies are snapped to the nearest
+// one that repeats within the table: sample_rate / 65536 for tones, a
+// fraction of a cycle per period for the chirp.  The symbol rate becomes
+// sample_rate / samples_per_symbol.
+//
+// Gaussian noise is added on top, with rms per component of noise times the
+// gain set by sdrio_set_rx_gain (full gain is 1), so the gain moves the noise
+// floor and leaves the signals where they are.  Runs with the same seed give
+// the same samples.
+typedef struct sdrio_null_generator_t
+{
+    sdrio_null_signal signal;
+    sdrio_float32 noise;
+    sdrio_uint32 seed;
+
+    // sdrio_null_signal_tones: peak amplitudes, full scale is 1
+    sdrio_uint32 num_tones;
+    sdrio_float64 tone_frequency[SDRIO_NULL_MAX_TONES];
+    sdrio_float32 tone_level[SDRIO_NULL_MAX_TONES];
+
+    // sdrio_null_signal_chirp
+    sdrio_float64 chirp_start;
+    sdrio_float64 chirp_stop;
+    sdrio_float64 chirp_period;     // seconds, at most 2^21 samples
+    sdrio_float32 chirp_level;
+
+    // sdrio_null_signal_modulated: level is the rms amplitude
+    sdrio_float64 carrier;
+    sdrio_float64 symbol_rate;
+    sdrio_float32 level;
+} sdrio_null_generator;
+
+// Can be changed while running.
+typedef sdrio_int32 (*sdrio_set_null_generator_t)(sdrio_device *dev, const sdrio_null_generator *generator);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    SDRIOEXPORT sdrio_int32 sdrio_set_null_pacing(sdrio_device *dev, sdrio_null_pacing pacing);
+    SDRIOEXPORT sdrio_int32 sdrio_set_null_cadence(sdrio_device *dev, sdrio_uint32 block_samples, sdrio_float64 jitter);
+    SDRIOEXPORT sdrio_int32 sdrio_set_null_generator(sdrio_device *dev, const sdrio_null_generator *generator);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SDRIO_NULL_H
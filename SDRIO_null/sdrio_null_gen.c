@@ -0,0 +1,454 @@
+// Copyright Scott Cutler
+// This source file is licensed under the GNU Lesser General Public License (LGPL)
+
+#include <math.h>
+#include <string.h>
+
+#include <emmintrin.h>
+
+#include "sdrio_null_gen.h"
+#include "sdrio_convert.h"
+
+#define PI 3.14159265358979323846
+
+#define BEACON_FREQ 100250000
+#define BEACON_LEVEL 0.1f
+
+// Same power as the uniform noise the null device used to make.
+#define DEFAULT_NOISE 0.57735027f
+
+#define PRBS9_PERIOD 511
+#define RRC_ROLLOFF 0.35
+#define RRC_SPAN 4                  // symbols either side
+
+#define NOISE_GRID 64               // radii and angles in the noise table
+
+void sdrio_null_gen_default(sdrio_null_generator *config)
+{
+    memset(config, 0, sizeof(sdrio_null_generator));
+    config->signal = sdrio_null_signal_tones;
+    config->noise = DEFAULT_NOISE;
+    config->seed = 1;
+    config->num_tones = 1;
+    config->tone_frequency[0] = BEACON_FREQ;
+    config->tone_level[0] = BEACON_LEVEL;
+}
+
+sdrio_int32 sdrio_null_gen_check(const sdrio_null_generator *config)
+{
+    switch (config->signal)
+    {
+    case sdrio_null_signal_tones:
+        return config->num_tones <= SDRIO_NULL_MAX_TONES;
+    case sdrio_null_signal_chirp:
+        return config->chirp_period > 0.0;
+    case sdrio_null_signal_modulated:
+        return config->symbol_rate > 0.0;
+    default:
+        return 0;
+    }
+}
+
+sdrio_int32 sdrio_null_gen_init(sdrio_null_gen *gen)
+{
+    sdrio_uint32 n, a, b;
+    double r, theta, power = 0.0, scale;
+
+    memset(gen, 0, sizeof(sdrio_null_gen));
+    sdrio_null_gen_default(&gen->config);
+
+    if (!sdrio_pool_init(&gen->fixed_pool, 1, (SDRIO_NULL_GEN_TONE_TABLE + SDRIO_NULL_GEN_NOISE_TABLE) * sizeof(sdrio_iq), 0))
+    {
+        return 0;
+    }
+
+    gen->circle = (sdrio_iq *)sdrio_pool_block(&gen->fixed_pool, 0);
+    gen->noise = gen->circle + SDRIO_NULL_GEN_TONE_TABLE;
+
+    for (n=0; n<SDRIO_NULL_GEN_TONE_TABLE; n++)
+    {
+        gen->circle[n].i = (sdrio_float32)cos(2 * PI * n / SDRIO_NULL_GEN_TONE_TABLE);
+        gen->circle[n].q = (sdrio_float32)sin(2 * PI * n / SDRIO_NULL_GEN_TONE_TABLE);
+    }
+
+    // Box-Muller over an even grid rather than random points, so every
+    // table is the same and has no lumps.  Summing two entries fills in
+    // between the grid and the tails.
+    for (a=0; a<NOISE_GRID; a++)
+    {
+        r = sqrt(-2.0 * log((a + 0.5) / NOISE_GRID));
+
+        for (b=0; b<NOISE_GRID; b++)
+        {
+            theta = 2 * PI * (b + 0.5) / NOISE_GRID;
+            gen->noise[a * NOISE_GRID + b].i = (sdrio_float32)(r * cos(theta));
+            gen->noise[a * NOISE_GRID + b].q = (sdrio_float32)(r * sin(theta));
+            power += r * r;
+        }
+    }
+
+    // Variance 1/2 per component, so the sum of two has 1.
+    scale = sqrt(SDRIO_NULL_GEN_NOISE_TABLE / power);
+    for (n=0; n<SDRIO_NULL_GEN_NOISE_TABLE; n++)
+    {
+        gen->noise[n].i = (sdrio_float32)(gen->noise[n].i * scale);
+        gen->noise[n].q = (sdrio_float32)(gen->noise[n].q * scale);
+    }
+
+    return 1;
+}
+
+void sdrio_null_gen_free(sdrio_null_gen *gen)
+{
+    sdrio_pool_free(&gen->table_pool);
+    sdrio_pool_free(&gen->fixed_pool);
+    gen->table = 0;
+    gen->length = 0;
+}
+
+static void seed(sdrio_null_gen *gen, sdrio_uint32 value)
+{
+    sdrio_uint32 i, lane;
+    unsigned int x = (unsigned int)value;
+
+    // splitmix32, so nearby seeds give unrelated streams
+    for (i=0; i<4; i++)
+    {
+        for (lane=0; lane<4; lane++)
+        {
+            x += 0x9e3779b9;
+            gen->rng[i][lane] = x;
+            gen->rng[i][lane] ^= gen->rng[i][lane] >> 16;
+            gen->rng[i][lane] *= 0x85ebca6b;
+            gen->rng[i][lane] ^= gen->rng[i][lane] >> 13;
+            gen->rng[i][lane] *= 0xc2b2ae35;
+            gen->rng[i][lane] ^= gen->rng[i][lane] >> 16;
+        }
+    }
+
+    for (lane=0; lane<4; lane++)
+    {
+        if (!(gen->rng[0][lane] | gen->rng[1][lane] | gen->rng[2][lane] | gen->rng[3][lane]))
+        {
+            gen->rng[0][lane] = 1;
+        }
+    }
+}
+
+static void build_tones(sdrio_null_gen *gen)
+{
+    const sdrio_null_generator *config = &gen->config;
+    double rate = (double)gen->sample_rate;
+    double offset;
+    sdrio_uint32 t, n, k;
+    sdrio_float32 level;
+
+    memset(gen->table, 0, gen->length * sizeof(sdrio_iq));
+
+    for (t=0; t<config->num_tones; t++)
+    {
+        offset = config->tone_frequency[t] - (double)gen->hw_frequency;
+        level = config->tone_level[t];
+
+        if (fabs(offset) < rate / 2)
+        {
+            k = (sdrio_uint32)(sdrio_int32)floor(offset / rate * SDRIO_NULL_GEN_TONE_TABLE + 0.5);
+
+            for (n=0; n<SDRIO_NULL_GEN_TONE_TABLE; n++)
+            {
+                const sdrio_iq *p = &gen->circle[(k * n) & (SDRIO_NULL_GEN_TONE_TABLE - 1)];
+                gen->table[n].i += level * p->i;
+                gen->table[n].q += level * p->q;
+            }
+        }
+    }
+}
+
+// Nudges both ends by under half a cycle per period so the phase comes back
+// to where it started, and the table loops without a click.
+static void build_chirp(sdrio_null_gen *gen)
+{
+    const sdrio_null_generator *config = &gen->config;
+    double rate = (double)gen->sample_rate;
+    double length = gen->length;
+    double f0 = config->chirp_start - (double)gen->hw_frequency;
+    double f1 = config->chirp_stop - (double)gen->hw_frequency;
+    double cycles = length * (f0 + f1) / (2 * rate);
+    double nudge = (floor(cycles + 0.5) - cycles) * rate / length;
+    double phase;
+    sdrio_uint32 n;
+
+    f0 += nudge;
+    f1 += nudge;
+
+    for (n=0; n<gen->length; n++)
+    {
+        phase = f0 * n / rate + (f1 - f0) * ((double)n * n) / (2 * length * rate);
+        phase -= floor(phase);
+        gen->table[n].i = config->chirp_level * (sdrio_float32)cos(2 * PI * phase);
+        gen->table[n].q = config->chirp_level * (sdrio_float32)sin(2 * PI * phase);
+    }
+}
+
+static double rrc(double t)
+{
+    double b = RRC_ROLLOFF;
+
+    if (fabs(t) < 1e-9)
+    {
+        return 1 - b + 4 * b / PI;
+    }
+    else if (fabs(fabs(t) - 1 / (4 * b)) < 1e-9)
+    {
+        return b / sqrt(2.0) * ((1 + 2 / PI) * sin(PI / (4 * b)) + (1 - 2 / PI) * cos(PI / (4 * b)));
+    }
+    else
+    {
+        return (sin(PI * t * (1 - b)) + 4 * b * t * cos(PI * t * (1 + b))) / (PI * t * (1 - (4 * b * t) * (4 * b * t)));
+    }
+}
+
+// One PRBS9 period of QPSK symbols, filtered circularly so the table loops
+// cleanly, then moved up to the carrier.
+static void build_modulated(sdrio_null_gen *gen, sdrio_uint32 sps)
+{
+    const sdrio_null_generator *config = &gen->config;
+    double rate = (double)gen->sample_rate;
+    double offset = config->carrier - (double)gen->hw_frequency;
+    sdrio_float32 symbols[PRBS9_PERIOD][2];
+    sdrio_uint32 prbs = 0x1ff;
+    sdrio_uint32 n, s, bit, c;
+    sdrio_int32 k, first;
+    double t, h, i, q, power = 0.0, scale, phase;
+    sdrio_uint64 step;
+
+    for (s=0; s<PRBS9_PERIOD; s++)
+    {
+        for (c=0; c<2; c++)
+        {
+            bit = ((prbs >> 8) ^ (prbs >> 4)) & 1;
+            prbs = ((prbs << 1) | bit) & 0x1ff;
+            symbols[s][c] = bit ? -1.0f : 1.0f;
+        }
+    }
+
+    for (n=0; n<gen->length; n++)
+    {
+        t = (double)n / sps;
+        first = (sdrio_int32)floor(t) - RRC_SPAN;
+        i = q = 0.0;
+
+        for (k=first; k<=first+2*RRC_SPAN+1; k++)
+        {
+            h = rrc(t - k);
+            s = (sdrio_uint32)((k + PRBS9_PERIOD) % PRBS9_PERIOD);
+            i += h * symbols[s][0];
+            q += h * symbols[s][1];
+        }
+
+        gen->table[n].i = (sdrio_float32)i;
+        gen->table[n].q = (sdrio_float32)q;
+        power += i * i + q * q;
+    }
+
+    if (fabs(offset) >= rate / 2)
+    {
+        memset(gen->table, 0, gen->length * sizeof(sdrio_iq));
+        return;
+    }
+
+    scale = config->level / sqrt(power / gen->length);
+    step = (sdrio_uint64)((sdrio_int64)floor(offset / rate * gen->length + 0.5) + gen->length);
+
+    for (n=0; n<gen->length; n++)
+    {
+        phase = (double)((step * n) % gen->length) / gen->length;
+        i = gen->table[n].i * scale;
+        q = gen->table[n].q * scale;
+        gen->table[n].i = (sdrio_float32)(i * cos(2 * PI * phase) - q * sin(2 * PI * phase));
+        gen->table[n].q = (sdrio_float32)(i * sin(2 * PI * phase) + q * cos(2 * PI * phase));
+    }
+}
+
+sdrio_int32 sdrio_null_gen_configure(sdrio_null_gen *gen, const sdrio_null_generator *config, sdrio_uint64 hw_frequency, sdrio_uint64 sample_rate)
+{
+    double rate = (double)sample_rate;
+    sdrio_uint32 length = SDRIO_NULL_GEN_TONE_TABLE;
+    sdrio_uint32 sps = 0;
+    double span;
+
+    gen->config = *config;
+    gen->hw_frequency = hw_frequency;
+    gen->sample_rate = sample_rate;
+    gen->position = 0;
+    seed(gen, config->seed);
+
+    if (config->signal == sdrio_null_signal_chirp)
+    {
+        span = floor(config->chirp_period * rate + 0.5);
+        length = (span < 2) ? 2 : ((span > SDRIO_NULL_GEN_MAX_TABLE) ? SDRIO_NULL_GEN_MAX_TABLE : (sdrio_uint32)span);
+    }
+    else if (config->signal == sdrio_null_signal_modulated)
+    {
+        span = floor(rate / config->symbol_rate + 0.5);
+        sps = (span < 2) ? 2 : ((span > SDRIO_NULL_GEN_MAX_TABLE / PRBS9_PERIOD) ? SDRIO_NULL_GEN_MAX_TABLE / PRBS9_PERIOD : (sdrio_uint32)span);
+        length = sps * PRBS9_PERIOD;
+    }
+
+    // Only ever grows, so retuning doesn't go back to the allocator.
+    if (length * sizeof(sdrio_iq) > gen->table_pool.block_bytes)
+    {
+        sdrio_pool_free(&gen->table_pool);
+        gen->table = 0;
+        gen->length = 0;
+
+        if (!sdrio_pool_init(&gen->table_pool, 1, length * sizeof(sdrio_iq), 0))
+        {
+            return 0;
+        }
+    }
+
+    gen->table = (sdrio_iq *)sdrio_pool_block(&gen->table_pool, 0);
+    gen->length = length;
+
+    switch (config->signal)
+    {
+    case sdrio_null_signal_chirp:
+        build_chirp(gen);
+        break;
+    case sdrio_null_signal_modulated:
+        build_modulated(gen, sps);
+        break;
+    default:
+        build_tones(gen);
+        break;
+    }
+
+    return 1;
+}
+
+void sdrio_null_gen_noise_scalar(sdrio_null_gen *gen, sdrio_iq *samples, sdrio_uint32 num_samples, sdrio_float32 rms)
+{
+    const sdrio_iq *table = gen->noise;
+    sdrio_uint32 i, lane, count, a, b;
+    unsigned int t;
+
+    for (i=0; i<num_samples; i+=4)
+    {
+        count = (num_samples - i < 4) ? num_samples - i : 4;
+
+        for (lane=0; lane<4; lane++)
+        {
+            t = gen->rng[0][lane] ^ (gen->rng[0][lane] << 11);
+            gen->rng[0][lane] = gen->rng[1][lane];
+            gen->rng[1][lane] = gen->rng[2][lane];
+            gen->rng[2][lane] = gen->rng[3][lane];
+            gen->rng[3][lane] ^= (gen->rng[3][lane] >> 19) ^ t ^ (t >> 8);
+
+            if (lane < count)
+            {
+                a = gen->rng[3][lane] & (SDRIO_NULL_GEN_NOISE_TABLE - 1);
+                b = (gen->rng[3][lane] >> 16) & (SDRIO_NULL_GEN_NOISE_TABLE - 1);
+                samples[i + lane].i += rms * (table[a].i + table[b].i);
+                samples[i + lane].q += rms * (table[a].q + table[b].q);
+            }
+        }
+    }
+}
+
+void sdrio_null_gen_noise_sse2(sdrio_null_gen *gen, sdrio_iq *samples, sdrio_uint32 num_samples, sdrio_float32 rms)
+{
+    const sdrio_iq *table = gen->noise;
+    const __m128i mask = _mm_set1_epi32(SDRIO_NULL_GEN_NOISE_TABLE - 1);
+    const __m128 scale = _mm_set1_ps(rms);
+    __m128i x = _mm_loadu_si128((const __m128i *)gen->rng[0]);
+    __m128i y = _mm_loadu_si128((const __m128i *)gen->rng[1]);
+    __m128i z = _mm_loadu_si128((const __m128i *)gen->rng[2]);
+    __m128i w = _mm_loadu_si128((const __m128i *)gen->rng[3]);
+    __m128i t;
+    unsigned int lo[4], hi[4];
+    sdrio_uint32 i, lane, count;
+    __m128 n01, n23;
+
+    for (i=0; i<num_samples; i+=4)
+    {
+        t = _mm_xor_si128(x, _mm_slli_epi32(x, 11));
+        x = y;
+        y = z;
+        z = w;
+        w = _mm_xor_si128(_mm_xor_si128(w, _mm_srli_epi32(w, 19)), _mm_xor_si128(t, _mm_srli_epi32(t, 8)));
+
+        _mm_storeu_si128((__m128i *)lo, _mm_and_si128(w, mask));
+        _mm_storeu_si128((__m128i *)hi, _mm_and_si128(_mm_srli_epi32(w, 16), mask));
+
+        if (num_samples - i >= 4)
+        {
+            n01 = _mm_add_ps(_mm_loadh_pi(_mm_castpd_ps(_mm_load_sd((const double *)&table[lo[0]])), (const __m64 *)&table[lo[1]]),
+                             _mm_loadh_pi(_mm_castpd_ps(_mm_load_sd((const double *)&table[hi[0]])), (const __m64 *)&table[hi[1]]));
+            n23 = _mm_add_ps(_mm_loadh_pi(_mm_castpd_ps(_mm_load_sd((const double *)&table[lo[2]])), (const __m64 *)&table[lo[3]]),
+                             _mm_loadh_pi(_mm_castpd_ps(_mm_load_sd((const double *)&table[hi[2]])), (const __m64 *)&table[hi[3]]));
+
+            _mm_storeu_ps(&samples[i].i, _mm_add_ps(_mm_loadu_ps(&samples[i].i), _mm_mul_ps(n01, scale)));
+            _mm_storeu_ps(&samples[i + 2].i, _mm_add_ps(_mm_loadu_ps(&samples[i + 2].i), _mm_mul_ps(n23, scale)));
+        }
+        else
+        {
+            count = num_samples - i;
+            for (lane=0; lane<count; lane++)
+            {
+                samples[i + lane].i += rms * (table[lo[lane]].i + table[hi[lane]].i);
+                samples[i + lane].q += rms * (table[lo[lane]].q + table[hi[lane]].q);
+            }
+        }
+    }
+
+    _mm_storeu_si128((__m128i *)gen->rng[0], x);
+    _mm_storeu_si128((__m128i *)gen->rng[1], y);
+    _mm_storeu_si128((__m128i *)gen->rng[2], z);
+    _mm_storeu_si128((__m128i *)gen->rng[3], w);
+}
+
+void sdrio_null_gen_fill(sdrio_null_gen *gen, sdrio_iq *samples, sdrio_uint32 num_samples, sdrio_float32 rms)
+{
+    sdrio_iq *out = samples;
+    sdrio_uint32 left = num_samples;
+    sdrio_uint32 n;
+
+    if (gen->length)
+    {
+        while (left)
+        {
+            n = gen->length - gen->position;
+            if (n > left)
+            {
+                n = left;
+            }
+
+            memcpy(out, gen->table + gen->position, n * sizeof(sdrio_iq));
+            out += n;
+            left -= n;
+
+            gen->position += n;
+            if (gen->position == gen->length)
+            {
+                gen->position = 0;
+            }
+        }
+    }
+    else
+    {
+        memset(samples, 0, num_samples * sizeof(sdrio_iq));
+    }
+
+    if (rms > 0.0f)
+    {
+        if (sdrio_get_cpu_features() & SDRIO_CPU_SSE2)
+        {
+            sdrio_null_gen_noise_sse2(gen, samples, num_samples, rms);
+        }
+        else
+        {
+            sdrio_null_gen_noise_scalar(gen, samples, num_samples, rms);
+        }
+    }
+}
@@ -0,0 +1,64 @@
+// Copyright Scott Cutler
+// This source file is licensed under the GNU Lesser General Public License (LGPL)
+
+#ifndef SDRIO_NULL_GEN_H
+#define SDRIO_NULL_GEN_H
+
+#include "sdrio_ext.h"
+#include "sdrio_pool.h"
+#include "sdrio_null.h"
+
+#define SDRIO_NULL_GEN_TONE_TABLE 65536         // tones repeat every this many samples
+#define SDRIO_NULL_GEN_MAX_TABLE (1 << 21)
+#define SDRIO_NULL_GEN_NOISE_TABLE 4096
+
+// Signal source for the null device.  The deterministic part is a table one
+// period long, rebuilt by sdrio_null_gen_configure and copied out by
+// sdrio_null_gen_fill.  Noise comes from four xorshift128 generators run side
+// by side (one per SSE2 lane), each 32 bit output picking two entries of a
+// table of complex Gaussian values whose sum is the sample.
+typedef struct sdrio_null_gen_t
+{
+    sdrio_null_generator config;
+    sdrio_uint64 hw_frequency;      // table was built for
+    sdrio_uint64 sample_rate;
+
+    sdrio_iq *table;
+    sdrio_uint32 length;
+    sdrio_uint32 position;
+    sdrio_pool table_pool;
+
+    sdrio_iq *circle;               // e^(2 pi i n / SDRIO_NULL_GEN_TONE_TABLE)
+    sdrio_iq *noise;                // unit variance per component / sqrt(2)
+    sdrio_pool fixed_pool;
+
+    unsigned int rng[4][4];         // x, y, z, w, each across the four lanes
+} sdrio_null_gen;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    sdrio_int32 sdrio_null_gen_init(sdrio_null_gen *gen);
+    void sdrio_null_gen_free(sdrio_null_gen *gen);
+
+    // One beacon, at the level the null device has always had.
+    void sdrio_null_gen_default(sdrio_null_generator *config);
+
+    sdrio_int32 sdrio_null_gen_check(const sdrio_null_generator *config);
+
+    // Rebuilds the table and reseeds the noise.
+    sdrio_int32 sdrio_null_gen_configure(sdrio_null_gen *gen, const sdrio_null_generator *config, sdrio_uint64 hw_frequency, sdrio_uint64 sample_rate);
+
+    // Next num_samples of signal plus noise, with noise at rms per component.
+    void sdrio_null_gen_fill(sdrio_null_gen *gen, sdrio_iq *samples, sdrio_uint32 num_samples, sdrio_float32 rms);
+
+    // Adds noise; both give the same samples for the same state.
+    void sdrio_null_gen_noise_scalar(sdrio_null_gen *gen, sdrio_iq *samples, sdrio_uint32 num_samples, sdrio_float32 rms);
+    void sdrio_null_gen_noise_sse2(sdrio_null_gen *gen, sdrio_iq *samples, sdrio_uint32 num_samples, sdrio_float32 rms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SDRIO_NULL_GEN_H
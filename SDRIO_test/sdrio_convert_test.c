@@ -0,0 +1,231 @@
+// Copyright Scott Cutler
+// This source file is licensed under the GNU Lesser General Public License (LGPL)
+
+// Checks that every SSE2 and AVX2 kernel in the conversion table gives
+// exactly its scalar kernel's output: every length up to a few vector widths
+// past the unrolled loops, and source and destination offset from their
+// alignment so the tails are handled misaligned too.  8 bit sources cover
+// every byte value, 16 bit ones include the extremes, and float sources
+// include values well out of range, infinities and NaN so the saturating
+// paths are compared as well.  Guard bytes around the destination catch
+// writes past the end.  Exits non-zero on the first mismatch.
+//
+//   sdrio_convert_test
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sdrio_ext.h"
+#include "sdrio_convert.h"
+
+#define MAX_SAMPLES 1100
+#define MAX_OFFSET 32
+#define GUARD 64
+#define GUARD_BYTE 0xa5
+#define MAX_BYTES (MAX_SAMPLES * sizeof(sdrio_iq))
+
+typedef struct test_variant_t
+{
+    const char *name;
+    sdrio_uint32 feature;
+    sdrio_convert_t convert;
+} test_variant;
+
+static sdrio_uint8 src_buffer[MAX_BYTES + MAX_OFFSET + 64];
+static sdrio_uint8 expected[MAX_BYTES + MAX_OFFSET + 64];
+static sdrio_uint8 actual[MAX_BYTES + MAX_OFFSET + 2 * GUARD + 64];
+
+static const sdrio_int16 extremes16[] = {32767, -32768, -1, 0, 2047, -2048, 2048, -2049};
+
+static sdrio_float32 specials[16];
+static sdrio_uint32 num_specials;
+
+static const char * format_name(sdrio_sample_format format)
+{
+    switch (format)
+    {
+    case sdrio_sample_format_cu8:     return "u8";
+    case sdrio_sample_format_cs8:     return "s8";
+    case sdrio_sample_format_cs16:    return "s16";
+    case sdrio_sample_format_sc16q12: return "q12";
+    case sdrio_sample_format_cf32:    return "f32";
+    default:                          return "?";
+    }
+}
+
+static sdrio_float32 from_bits(sdrio_uint32 bits)
+{
+    sdrio_float32 f;
+
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+// Out of range, signed zeros, and values that land on a rounding tie after
+// scaling to 8 or 16 bits.
+static void init_specials()
+{
+    static const sdrio_float32 values[] = {0.0f, 1.0f, -1.0f, 1.5f, -1.5f, 1e30f, -1e30f, 0.5f / 32767, -0.5f / 32767, 2.5f / 127, -2.5f / 127};
+    sdrio_uint32 i;
+
+    for (i = 0; i < sizeof(values) / sizeof(values[0]); i++)
+    {
+        specials[num_specials++] = values[i];
+    }
+
+    specials[num_specials++] = from_bits(0x80000000);   // -0
+    specials[num_specials++] = from_bits(0x7f800000);   // +inf
+    specials[num_specials++] = from_bits(0xff800000);   // -inf
+    specials[num_specials++] = from_bits(0x7fc00000);   // NaN
+}
+
+// 8 bit sources get consecutive byte values, so every length from 128
+// samples on covers all 256 of them.  Wider ones are pseudo-random with an
+// extreme every few values.
+static void fill(sdrio_sample_format format, void *src, sdrio_uint32 num_samples, sdrio_uint32 seed)
+{
+    sdrio_uint32 count = num_samples * 2, state = seed * 2654435761u + 1, i;
+
+    for (i = 0; i < count; i++)
+    {
+        state = state * 1103515245 + 12345;
+
+        switch (format)
+        {
+        case sdrio_sample_format_cu8:
+        case sdrio_sample_format_cs8:
+            ((sdrio_uint8 *)src)[i] = (sdrio_uint8)(i + seed);
+            break;
+
+        case sdrio_sample_format_cs16:
+        case sdrio_sample_format_sc16q12:
+            ((sdrio_int16 *)src)[i] = ((i % 8) == 7) ? extremes16[(i / 8) % 8] : (sdrio_int16)(state >> 16);
+            break;
+
+        case sdrio_sample_format_cf32:
+            ((sdrio_float32 *)src)[i] = ((i % 4) == 3) ? specials[(i / 4) % num_specials] : ((sdrio_float32)(state >> 8) / (1 << 24) - 0.5f) * 2.5f;
+            break;
+
+        default:
+            break;
+        }
+    }
+}
+
+// Lengths worth checking: all of the short ones, where only the tail runs,
+// and a few either side of multiples of the widest loop.
+static sdrio_int32 interesting(sdrio_uint32 n)
+{
+    return (n <= 160) || ((n % 64) <= 1) || ((n % 64) >= 63) || (n == MAX_SAMPLES);
+}
+
+static sdrio_int32 check(const sdrio_converter_entry *entry, const test_variant *variant, sdrio_uint32 num_samples, sdrio_uint32 src_offset, sdrio_uint32 dst_offset, sdrio_uint32 seed)
+{
+    sdrio_uint8 *src = src_buffer + src_offset;
+    sdrio_uint8 *dst = actual + GUARD + dst_offset;
+    sdrio_uint32 sample_bytes = sdrio_get_format_size(entry->dst);
+    sdrio_uint32 bytes = num_samples * sample_bytes, i;
+
+    fill(entry->src, src, num_samples, seed);
+    entry->scalar(expected, src, num_samples);
+
+    memset(actual, GUARD_BYTE, sizeof(actual));
+    variant->convert(dst, src, num_samples);
+
+    if (memcmp(dst, expected, bytes))
+    {
+        for (i = 0; (i < bytes) && (dst[i] == expected[i]); i++)
+        {
+        }
+        printf("%s_%s %s: %lu samples, src +%lu, dst +%lu: differs from scalar at sample %lu\n", format_name(entry->src), format_name(entry->dst), variant->name,
+               (unsigned long)num_samples, (unsigned long)src_offset, (unsigned long)dst_offset, (unsigned long)(i / sample_bytes));
+        return 0;
+    }
+
+    for (i = 0; i < GUARD; i++)
+    {
+        if ((dst[i - GUARD] != GUARD_BYTE) || (dst[bytes + i] != GUARD_BYTE))
+        {
+            printf("%s_%s %s: %lu samples, src +%lu, dst +%lu: wrote outside the destination\n", format_name(entry->src), format_name(entry->dst), variant->name,
+                   (unsigned long)num_samples, (unsigned long)src_offset, (unsigned long)dst_offset);
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static sdrio_int32 check_variant(const sdrio_converter_entry *entry, const test_variant *variant)
+{
+    // Offsets stay aligned to the I and Q components, as the stream's
+    // buffers and the drivers' transfers are.
+    sdrio_uint32 src_step = sdrio_get_format_size(entry->src) / 2;
+    sdrio_uint32 dst_step = sdrio_get_format_size(entry->dst) / 2;
+    sdrio_uint32 n, src_offset, dst_offset, checks = 0;
+
+    for (n = 0; n <= MAX_SAMPLES; n++)
+    {
+        if (!interesting(n))
+        {
+            continue;
+        }
+
+        for (src_offset = 0; src_offset < MAX_OFFSET; src_offset += src_step)
+        {
+            for (dst_offset = 0; dst_offset < MAX_OFFSET; dst_offset += dst_step)
+            {
+                if (!check(entry, variant, n, src_offset, dst_offset, n + src_offset))
+                {
+                    return 0;
+                }
+                checks++;
+            }
+        }
+    }
+
+    printf("%s_%s %s: bit-identical to scalar in %lu cases\n", format_name(entry->src), format_name(entry->dst), variant->name, (unsigned long)checks);
+    return 1;
+}
+
+int main()
+{
+    sdrio_uint32 features = sdrio_get_cpu_features();
+    const sdrio_converter_entry *converters;
+    sdrio_uint32 num_converters, c, v;
+    test_variant variants[2];
+
+    init_specials();
+    converters = sdrio_get_converters(&num_converters);
+
+    for (c = 0; c < num_converters; c++)
+    {
+        variants[0].name = "sse2";
+        variants[0].feature = SDRIO_CPU_SSE2;
+        variants[0].convert = converters[c].sse2;
+        variants[1].name = "avx2";
+        variants[1].feature = SDRIO_CPU_AVX2;
+        variants[1].convert = converters[c].avx2;
+
+        for (v = 0; v < sizeof(variants) / sizeof(variants[0]); v++)
+        {
+            if (!variants[v].convert)
+            {
+                continue;
+            }
+
+            if (!(features & variants[v].feature))
+            {
+                printf("%s_%s %s: not supported by this CPU, skipped\n", format_name(converters[c].src), format_name(converters[c].dst), variants[v].name);
+                continue;
+            }
+
+            if (!check_variant(&converters[c], &variants[v]))
+            {
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}